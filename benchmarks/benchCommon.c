@@ -0,0 +1,463 @@
+/****************************************************************************
+ *
+ * Filename: benchCommon.c
+ *
+ * Description:
+ *	Shared part of the streaming callback benchmarks. See benchCommon.h.
+ *
+ *	Usage: bench_psXXXX [--format csv|json] [--samples n] [--chunk-sizes n,n,...]
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "benchCommon.h"
+
+#define BENCH_MAX_CHUNK_SIZES	16
+
+/////////////////////////////////
+//
+//	Variable definitions
+//
+/////////////////////////////////
+
+static BENCH_BUFFERS	_buffers;
+static uint32_t			_chunkSize = 0;
+static uint32_t			_bufferLength = 0;
+static uint32_t			_nextStartIndex = 0;
+
+static const uint32_t	_defaultChunkSizes[] = { 1000, 10000, 100000 };
+
+/////////////////////////////////
+//
+//	Function definitions
+//
+/////////////////////////////////
+
+/****************************************************************************
+* getTimeNanoseconds
+*
+* Returns a monotonic time stamp in nanoseconds.
+*
+****************************************************************************/
+static uint64_t getTimeNanoseconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+/****************************************************************************
+* openCacheMissCounter
+*
+* Opens a hardware counter for the cache misses of this thread.
+*
+* Returns:
+*
+* The counter file descriptor, or -1 if the counter is not available (for
+* example in a virtual machine, or if perf_event_paranoid prevents it).
+*
+****************************************************************************/
+static int openCacheMissCounter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/****************************************************************************
+* benchNextChunk
+*
+* Returns the size of the next chunk of the synthetic driver buffers and
+* its start index. The chunks move through the buffers in turn, as the
+* driver does, so each callback touches different memory.
+*
+****************************************************************************/
+uint32_t benchNextChunk(uint32_t * startIndex)
+{
+	*startIndex = _nextStartIndex;
+
+	_nextStartIndex += _chunkSize;
+
+	if (_nextStartIndex >= _bufferLength)
+	{
+		_nextStartIndex = 0;
+	}
+
+	return _chunkSize;
+}
+
+/****************************************************************************
+* benchNextOverviewChunk
+*
+* Sets overviewBuffers to the next chunk of each synthetic driver buffer,
+* for the ps2000 and ps3000 overview buffer callbacks, and returns the size
+* of the chunk.
+*
+****************************************************************************/
+uint32_t benchNextOverviewChunk(int16_t ** overviewBuffers, int16_t nBuffers)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+	int16_t i = 0;
+
+	for (i = 0; i < nBuffers && i < BENCH_MAX_BUFFERS; i++)
+	{
+		overviewBuffers[i] = (_buffers.driverBuffers[i] != NULL) ? &_buffers.driverBuffers[i][startIndex] : NULL;
+	}
+
+	return noOfSamples;
+}
+
+/****************************************************************************
+* freeBuffers
+*
+* Frees the buffers of a measurement.
+*
+****************************************************************************/
+static void freeBuffers(void)
+{
+	int16_t i = 0;
+
+	for (i = 0; i < BENCH_MAX_BUFFERS; i++)
+	{
+		free(_buffers.driverBuffers[i]);
+		free(_buffers.appBuffers[i]);
+	}
+
+	memset(&_buffers, 0, sizeof(_buffers));
+}
+
+/****************************************************************************
+* allocateBuffers
+*
+* Allocates the buffers for the enabled sources and fills the driver
+* buffers with a synthetic signal. The application buffers are written
+* once so that page faults are not counted in the measurement.
+*
+* Returns:
+*
+* 1 if successful, otherwise 0.
+*
+****************************************************************************/
+static int16_t allocateBuffers(const BENCH_CONFIG * config)
+{
+	int16_t source = 0;
+	int16_t buffer = 0;
+	uint32_t i = 0;
+
+	freeBuffers();
+
+	for (source = 0; source < BENCH_MAX_SOURCES; source++)
+	{
+		if (source < BENCH_MAX_CHANNELS ? source >= config->channels : source - BENCH_MAX_CHANNELS >= config->digitalPorts)
+		{
+			continue;
+		}
+
+		for (buffer = source * 2; buffer < source * 2 + (config->aggregation ? 2 : 1); buffer++)
+		{
+			_buffers.driverBuffers[buffer] = (int16_t *) malloc(config->bufferLength * sizeof(int16_t));
+			_buffers.appBuffers[buffer] = (int16_t *) malloc(config->bufferLength * sizeof(int16_t));
+
+			if (_buffers.driverBuffers[buffer] == NULL || _buffers.appBuffers[buffer] == NULL)
+			{
+				freeBuffers();
+				return 0;
+			}
+
+			for (i = 0; i < config->bufferLength; i++)
+			{
+				_buffers.driverBuffers[buffer][i] = (int16_t) ((i * 37 + buffer * 1013) & 0x7FFF);
+			}
+
+			memset(_buffers.appBuffers[buffer], 0, config->bufferLength * sizeof(int16_t));
+		}
+	}
+
+	return 1;
+}
+
+/****************************************************************************
+* printResult
+*
+* Prints the result of one measurement.
+*
+****************************************************************************/
+static void printResult(BENCH_FORMAT format, const char * series, const BENCH_CONFIG * config, uint32_t callbacks,
+	uint64_t elapsedNs, int64_t cacheMisses, int16_t first)
+{
+	uint64_t samples = (uint64_t) callbacks * config->chunkSize * (config->channels + config->digitalPorts);
+	double seconds = elapsedNs / 1e9;
+
+	if (format == BENCH_FORMAT_JSON)
+	{
+		printf("%s  {\"series\": \"%s\", \"channels\": %d, \"digital_ports\": %d, \"chunk_size\": %u, \"aggregation\": %d, "
+			"\"callbacks\": %u, \"samples\": %llu, \"elapsed_s\": %.6f, \"samples_per_s\": %.0f, \"ns_per_callback\": %.1f, ",
+			first ? "" : ",\n", series, config->channels, config->digitalPorts, config->chunkSize, config->aggregation,
+			callbacks, (unsigned long long) samples, seconds, samples / seconds, (double) elapsedNs / callbacks);
+
+		if (cacheMisses >= 0)
+		{
+			printf("\"cache_misses\": %lld, \"cache_misses_per_callback\": %.1f}", (long long) cacheMisses, (double) cacheMisses / callbacks);
+		}
+		else
+		{
+			printf("\"cache_misses\": null, \"cache_misses_per_callback\": null}");
+		}
+	}
+	else
+	{
+		printf("%s,%d,%d,%u,%d,%u,%llu,%.6f,%.0f,%.1f,", series, config->channels, config->digitalPorts, config->chunkSize,
+			config->aggregation, callbacks, (unsigned long long) samples, seconds, samples / seconds, (double) elapsedNs / callbacks);
+
+		if (cacheMisses >= 0)
+		{
+			printf("%lld,%.1f\n", (long long) cacheMisses, (double) cacheMisses / callbacks);
+		}
+		else
+		{
+			printf(",\n");
+		}
+	}
+
+	fflush(stdout);
+}
+
+/****************************************************************************
+* runConfig
+*
+* Measures one combination of parameters.
+*
+* Returns:
+*
+* 1 if successful, otherwise 0.
+*
+****************************************************************************/
+static int16_t runConfig(const BENCH_SERIES * series, const BENCH_CONFIG * config, uint64_t samplesPerSource, BENCH_FORMAT format,
+	int cacheCounter, int16_t first)
+{
+	uint32_t callbacks = (uint32_t) (samplesPerSource / config->chunkSize);
+	uint32_t i = 0;
+	uint64_t start = 0;
+	uint64_t elapsed = 0;
+	int64_t cacheMisses = -1;
+	int16_t ok = 1;
+
+	if (callbacks < BENCH_MIN_CALLBACKS)
+	{
+		callbacks = BENCH_MIN_CALLBACKS;
+	}
+
+	if (!allocateBuffers(config))
+	{
+		fprintf(stderr, "%s: could not allocate buffers for chunk size %u\n", series->name, config->chunkSize);
+		return 0;
+	}
+
+	_chunkSize = config->chunkSize;
+	_bufferLength = config->bufferLength;
+	_nextStartIndex = 0;
+
+	if (!series->setup(config, &_buffers))
+	{
+		fprintf(stderr, "%s: setup failed\n", series->name);
+		freeBuffers();
+		return 0;
+	}
+
+	// One pass through the buffers to warm the caches
+	for (i = 0; i < BENCH_CHUNKS_PER_BUFFER && ok; i++)
+	{
+		ok = series->poll();
+	}
+
+	if (cacheCounter >= 0)
+	{
+		ioctl(cacheCounter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(cacheCounter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	start = getTimeNanoseconds();
+
+	for (i = 0; i < callbacks && ok; i++)
+	{
+		ok = series->poll();
+	}
+
+	elapsed = getTimeNanoseconds() - start;
+
+	if (cacheCounter >= 0)
+	{
+		ioctl(cacheCounter, PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(cacheCounter, &cacheMisses, sizeof(cacheMisses)) != sizeof(cacheMisses))
+		{
+			cacheMisses = -1;
+		}
+	}
+
+	series->teardown();
+	freeBuffers();
+
+	if (!ok)
+	{
+		fprintf(stderr, "%s: poll failed\n", series->name);
+		return 0;
+	}
+
+	printResult(format, series->name, config, callbacks, elapsed, cacheMisses, first);
+
+	return 1;
+}
+
+/****************************************************************************
+* printUsage
+*
+* Prints the command line options.
+*
+****************************************************************************/
+static void printUsage(const char * program)
+{
+	fprintf(stderr, "Usage: %s [--format csv|json] [--samples n] [--chunk-sizes n,n,...]\n\n", program);
+	fprintf(stderr, "  --format       output format (default csv)\n");
+	fprintf(stderr, "  --samples      samples per channel for each measurement (default %u)\n", BENCH_DEFAULT_SAMPLES);
+	fprintf(stderr, "  --chunk-sizes  samples passed to each callback (default 1000,10000,100000)\n");
+}
+
+/****************************************************************************
+* benchMain
+*
+* Parses the command line and runs every combination of channel count,
+* chunk size, aggregation and digital ports supported by the series.
+*
+* Returns:
+*
+* 0 if every measurement completed, otherwise 1.
+*
+****************************************************************************/
+int benchMain(int argc, char ** argv, const BENCH_SERIES * series)
+{
+	BENCH_FORMAT format = BENCH_FORMAT_CSV;
+	BENCH_CONFIG config;
+	uint64_t samplesPerSource = BENCH_DEFAULT_SAMPLES;
+	uint32_t chunkSizes[BENCH_MAX_CHUNK_SIZES];
+	int16_t nChunkSizes = 0;
+	int16_t chunk = 0;
+	int16_t channels = 0;
+	int16_t digitalPorts = 0;
+	int16_t first = 1;
+	int16_t failed = 0;
+	int cacheCounter = -1;
+	char * token = NULL;
+	int i = 0;
+
+	for (nChunkSizes = 0; nChunkSizes < (int16_t) (sizeof(_defaultChunkSizes) / sizeof(_defaultChunkSizes[0])); nChunkSizes++)
+	{
+		chunkSizes[nChunkSizes] = _defaultChunkSizes[nChunkSizes];
+	}
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			format = (strcmp(argv[++i], "json") == 0) ? BENCH_FORMAT_JSON : BENCH_FORMAT_CSV;
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+		{
+			samplesPerSource = strtoull(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--chunk-sizes") == 0 && i + 1 < argc)
+		{
+			nChunkSizes = 0;
+
+			for (token = strtok(argv[++i], ","); token != NULL && nChunkSizes < BENCH_MAX_CHUNK_SIZES; token = strtok(NULL, ","))
+			{
+				if (strtoul(token, NULL, 0) > 0)
+				{
+					chunkSizes[nChunkSizes++] = (uint32_t) strtoul(token, NULL, 0);
+				}
+			}
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	cacheCounter = openCacheMissCounter();
+
+	if (format == BENCH_FORMAT_JSON)
+	{
+		printf("[\n");
+	}
+	else
+	{
+		printf("series,channels,digital_ports,chunk_size,aggregation,callbacks,samples,elapsed_s,samples_per_s,ns_per_callback,"
+			"cache_misses,cache_misses_per_callback\n");
+	}
+
+	for (chunk = 0; chunk < nChunkSizes; chunk++)
+	{
+		for (channels = 1; channels <= series->maxChannels; channels *= 2)
+		{
+			for (digitalPorts = 0; digitalPorts <= series->maxDigitalPorts; digitalPorts += series->maxDigitalPorts)
+			{
+				memset(&config, 0, sizeof(config));
+				config.channels = channels;
+				config.digitalPorts = digitalPorts;
+				config.chunkSize = chunkSizes[chunk];
+				config.bufferLength = chunkSizes[chunk] * BENCH_CHUNKS_PER_BUFFER;
+
+				for (config.aggregation = 0; config.aggregation <= 1; config.aggregation++)
+				{
+					if (runConfig(series, &config, samplesPerSource, format, cacheCounter, first))
+					{
+						first = 0;
+					}
+					else
+					{
+						failed = 1;
+					}
+				}
+
+				if (series->maxDigitalPorts == 0)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	if (format == BENCH_FORMAT_JSON)
+	{
+		printf("\n]\n");
+	}
+
+	if (cacheCounter >= 0)
+	{
+		close(cacheCounter);
+	}
+
+	return failed;
+}
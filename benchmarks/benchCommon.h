@@ -0,0 +1,107 @@
+/****************************************************************************
+ *
+ * Filename: benchCommon.h
+ *
+ * Description:
+ *	This header defines the shared part of the streaming callback
+ *	benchmarks.
+ *
+ *	Each benchmark (psXXXXBench.c) is linked with the source of one wrapper
+ *	and the simulated driver from the simulator directory. The driver
+ *	function that the wrapper calls to collect streaming data is replaced
+ *	at link time (ld --wrap) by a function that passes the next chunk of a
+ *	set of synthetic driver buffers straight to the wrapper's streaming
+ *	callback, so the time measured is the time spent in the wrapper.
+ *
+ *	For each combination of channel count, chunk size, aggregation and
+ *	digital ports the benchmark reports the number of samples copied per
+ *	second (counting each enabled channel and port), the time per
+ *	callback, and the number of cache misses where the kernel allows the
+ *	hardware counters to be read.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#ifndef __BENCHCOMMON_H__
+#define __BENCHCOMMON_H__
+
+#include <stdint.h>
+
+#define BENCH_MAX_CHANNELS			8
+#define BENCH_MAX_DIGITAL_PORTS		2
+#define BENCH_MAX_SOURCES			(BENCH_MAX_CHANNELS + BENCH_MAX_DIGITAL_PORTS)	// Digital port n is source BENCH_MAX_CHANNELS + n
+#define BENCH_MAX_BUFFERS			(BENCH_MAX_SOURCES * 2)							// Max and min buffer for each source
+
+#define BENCH_CHUNKS_PER_BUFFER		8				// Driver and application buffers hold this many chunks
+#define BENCH_MIN_CALLBACKS			64
+#define BENCH_DEFAULT_SAMPLES		20000000		// Samples per source for each measurement
+
+typedef enum enBenchFormat
+{
+	BENCH_FORMAT_CSV,
+	BENCH_FORMAT_JSON
+} BENCH_FORMAT;
+
+/****************************************************************************
+* tBenchConfig
+*
+* One combination of benchmark parameters.
+*
+****************************************************************************/
+typedef struct tBenchConfig
+{
+	int16_t		channels;				// Channels A to channels - 1 are enabled
+	int16_t		digitalPorts;			// Ports 0 to digitalPorts - 1 are enabled
+	uint32_t	chunkSize;				// Samples passed to each callback
+	int16_t		aggregation;			// Max and min buffers if set, otherwise a single buffer per source
+	uint32_t	bufferLength;			// Length of each driver and application buffer
+} BENCH_CONFIG;
+
+/****************************************************************************
+* tBenchBuffers
+*
+* The buffers for one measurement, max then min for each source. Min
+* buffers are only allocated when aggregation is on.
+*
+****************************************************************************/
+typedef struct tBenchBuffers
+{
+	int16_t *	driverBuffers[BENCH_MAX_BUFFERS];
+	int16_t *	appBuffers[BENCH_MAX_BUFFERS];
+} BENCH_BUFFERS;
+
+/****************************************************************************
+* tBenchSeries
+*
+* The functions that adapt the benchmark to one wrapper.
+*
+* setup - opens the device and registers the buffers with the wrapper.
+*		Returns 1 if successful.
+* poll - collects one chunk through the wrapper. Returns 1 if successful.
+* teardown - releases the wrapper state and closes the device.
+*
+****************************************************************************/
+typedef struct tBenchSeries
+{
+	const char *	name;
+	int16_t			maxChannels;
+	int16_t			maxDigitalPorts;
+	int16_t			(*setup)(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers);
+	int16_t			(*poll)(void);
+	void			(*teardown)(void);
+} BENCH_SERIES;
+
+/////////////////////////////////
+//
+//	Function declarations
+//
+/////////////////////////////////
+
+extern int benchMain(int argc, char ** argv, const BENCH_SERIES * series);
+
+extern uint32_t benchNextChunk(uint32_t * startIndex);
+
+extern uint32_t benchNextOverviewChunk(int16_t ** overviewBuffers, int16_t nBuffers);
+
+#endif
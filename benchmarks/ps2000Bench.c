@@ -0,0 +1,136 @@
+/****************************************************************************
+ *
+ * Filename: ps2000Bench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps2000Wrap library. See
+ *	benchCommon.h.
+ *
+ *	ps2000_get_streaming_last_values is replaced at link time by
+ *	__wrap_ps2000_get_streaming_last_values, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's GetValuesCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PS2000_BENCH_CHANNELS	2
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern int16_t ps2000_open_unit(void);
+extern int16_t ps2000_close_unit(int16_t handle);
+
+extern int16_t PollFastStreaming(int16_t handle);
+extern void SetBuffer(int16_t handle, int16_t channel, int16_t * buffer, uint32_t bufferSize);
+extern void SetAggregateBuffer(int16_t handle, int16_t channel, int16_t * bufferMax, int16_t * bufferMin, uint32_t bufferSize);
+extern void setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+extern void clearFastStreamingParameters(int16_t handle);
+extern int16_t setCollectionInfo(int16_t handle, uint32_t collectionSize, uint32_t overviewBufferSize);
+
+typedef void (*BENCH_OVERVIEW_READY)(int16_t ** overviewBuffers, int16_t overflow, uint32_t triggeredAt, int16_t triggered,
+	int16_t autoStop, uint32_t nValues);
+
+static int16_t	_handle = 0;
+static uint32_t	_polls = 0;
+
+/****************************************************************************
+* __wrap_ps2000_get_streaming_last_values
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback as the
+* overview buffers.
+*
+****************************************************************************/
+int16_t __wrap_ps2000_get_streaming_last_values(int16_t handle, BENCH_OVERVIEW_READY lpGetOverviewBuffersMaxMin)
+{
+	int16_t * overviewBuffers[PS2000_BENCH_CHANNELS * 2];
+	uint32_t nValues = benchNextOverviewChunk(overviewBuffers, PS2000_BENCH_CHANNELS * 2);
+
+	lpGetOverviewBuffersMaxMin(overviewBuffers, 0, 0, 0, 0, nValues);
+
+	return 1;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the application buffers with the wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS2000_BENCH_CHANNELS];
+	int16_t channel = 0;
+
+	if ((_handle = ps2000_open_unit()) <= 0)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS2000_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+
+		if (config->aggregation)
+		{
+			SetAggregateBuffer(_handle, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1], config->bufferLength);
+		}
+		else
+		{
+			SetBuffer(_handle, channel, buffers->appBuffers[channel * 2], config->bufferLength);
+		}
+	}
+
+	setEnabledChannels(_handle, enabledChannels);
+	clearFastStreamingParameters(_handle);
+	_polls = 0;
+
+	return setCollectionInfo(_handle, config->bufferLength, config->chunkSize);
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk. The wrapper fills the application buffers from the
+* start, so the collection is restarted each time they are full.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	if (_polls++ % BENCH_CHUNKS_PER_BUFFER == 0)
+	{
+		clearFastStreamingParameters(_handle);
+	}
+
+	return PollFastStreaming(_handle) != 0;
+}
+
+/****************************************************************************
+* teardown
+*
+* Closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	ps2000_close_unit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps2000", PS2000_BENCH_CHANNELS, 0, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
@@ -0,0 +1,181 @@
+/****************************************************************************
+ *
+ * Filename: ps2000aBench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps2000aWrap library. See
+ *	benchCommon.h.
+ *
+ *	ps2000aGetStreamingLatestValues is replaced at link time by
+ *	__wrap_ps2000aGetStreamingLatestValues, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's StreamingCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PICO_OK	0
+
+#define PS2000A_BENCH_CHANNELS	2
+#define PS2000A_BENCH_DIGITAL_PORTS	2
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern uint32_t ps2000aOpenUnit(int16_t * handle, int8_t * serial);
+extern uint32_t ps2000aCloseUnit(int16_t handle);
+
+extern uint32_t GetStreamingLatestValues(int16_t handle);
+extern uint32_t setChannelCount(int16_t handle);
+extern uint32_t setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+extern uint32_t setEnabledDigitalPorts(int16_t handle, int16_t * enabledDigitalPorts);
+extern uint32_t setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer,
+	int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength);
+extern uint32_t setAppAndDriverDigiBuffers(int16_t handle, int16_t digiPort, int16_t * appDigiBuffer, int16_t * driverDigiBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverDigiBuffers(int16_t handle, int16_t digiPort, int16_t * appMaxDigiBuffer, int16_t * appMinDigiBuffer,
+	int16_t * driverMaxDigiBuffer, int16_t * driverMinDigiBuffer, int32_t bufferLength);
+
+typedef void (*BENCH_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+static int16_t	_handle = 0;
+
+/****************************************************************************
+* __wrap_ps2000aGetStreamingLatestValues
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback.
+*
+****************************************************************************/
+uint32_t __wrap_ps2000aGetStreamingLatestValues(int16_t handle, BENCH_STREAMING_READY lpReady, void * pParameter)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+
+	lpReady(handle, (int32_t) noOfSamples, startIndex, 0, 0, 0, 0, pParameter);
+
+	return 0;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the driver and application buffers with the
+* wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[4] = { 0, 0, 0, 0 };
+	int16_t enabledDigitalPorts[PS2000A_BENCH_DIGITAL_PORTS];
+	int16_t channel = 0;
+	int16_t port = 0;
+	int16_t source = 0;
+	uint32_t status = ps2000aOpenUnit(&_handle, NULL);
+
+	if (status != PICO_OK || setChannelCount(_handle) != PICO_OK)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS2000A_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+	}
+
+	for (port = 0; port < PS2000A_BENCH_DIGITAL_PORTS; port++)
+	{
+		enabledDigitalPorts[port] = (port < config->digitalPorts);
+	}
+
+	status = setEnabledChannels(_handle, enabledChannels);
+
+	if (status == PICO_OK)
+	{
+		status = setEnabledDigitalPorts(_handle, enabledDigitalPorts);
+	}
+
+	for (channel = 0; channel < config->channels && status == PICO_OK; channel++)
+	{
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1],
+				buffers->driverBuffers[channel * 2], buffers->driverBuffers[channel * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->driverBuffers[channel * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	for (port = 0; port < config->digitalPorts && status == PICO_OK; port++)
+	{
+		source = BENCH_MAX_CHANNELS + port;
+
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverDigiBuffers(_handle, port, buffers->appBuffers[source * 2], buffers->appBuffers[source * 2 + 1],
+				buffers->driverBuffers[source * 2], buffers->driverBuffers[source * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverDigiBuffers(_handle, port, buffers->appBuffers[source * 2], buffers->driverBuffers[source * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	return status == PICO_OK;
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLatestValues(_handle) == PICO_OK;
+}
+
+/****************************************************************************
+* teardown
+*
+* Clears the buffers registered with the wrapper, which keeps them between
+* devices, and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	int16_t channel = 0;
+	int16_t port = 0;
+
+	for (channel = 0; channel < PS2000A_BENCH_CHANNELS; channel++)
+	{
+		setMaxMinAppAndDriverBuffers(_handle, channel, NULL, NULL, NULL, NULL, 0);
+	}
+
+	for (port = 0; port < PS2000A_BENCH_DIGITAL_PORTS; port++)
+	{
+		setMaxMinAppAndDriverDigiBuffers(_handle, port, NULL, NULL, NULL, NULL, 0);
+	}
+
+	ps2000aCloseUnit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps2000a", PS2000A_BENCH_CHANNELS, PS2000A_BENCH_DIGITAL_PORTS, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
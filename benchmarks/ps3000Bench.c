@@ -0,0 +1,132 @@
+/****************************************************************************
+ *
+ * Filename: ps3000Bench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps3000Wrap library. See
+ *	benchCommon.h.
+ *
+ *	ps3000_get_streaming_last_values is replaced at link time by
+ *	__wrap_ps3000_get_streaming_last_values, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's my_get_overview_buffers callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PS3000_BENCH_CHANNELS	4
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern int16_t ps3000_open_unit(void);
+extern int16_t ps3000_close_unit(int16_t handle);
+
+extern int16_t GetStreamingLastValues(int16_t handle);
+extern int16_t SetDataBuffer(int16_t handle, int16_t channel, int16_t * buffer, uint32_t bufferLength);
+extern int16_t SetDataBuffersV2(int16_t handle, int16_t channel, int16_t * minBuffer, int16_t * maxBuffer, uint32_t bufferLength);
+extern int16_t setChannelCount(int16_t handle, int16_t channelCount);
+extern int16_t setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+
+typedef void (*BENCH_OVERVIEW_READY)(int16_t ** overviewBuffers, int16_t overflow, uint32_t triggeredAt, int16_t triggered,
+	int16_t autoStop, uint32_t nValues);
+
+static int16_t	_handle = 0;
+
+/****************************************************************************
+* __wrap_ps3000_get_streaming_last_values
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback as the
+* overview buffers.
+*
+****************************************************************************/
+int16_t __wrap_ps3000_get_streaming_last_values(int16_t handle, BENCH_OVERVIEW_READY lpGetOverviewBuffersMaxMin)
+{
+	int16_t * overviewBuffers[PS3000_BENCH_CHANNELS * 2];
+	uint32_t nValues = benchNextOverviewChunk(overviewBuffers, PS3000_BENCH_CHANNELS * 2);
+
+	lpGetOverviewBuffersMaxMin(overviewBuffers, 0, 0, 0, 0, nValues);
+
+	return 1;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the application buffers with the wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS3000_BENCH_CHANNELS];
+	int16_t channel = 0;
+
+	if ((_handle = ps3000_open_unit()) <= 0 || !setChannelCount(_handle, PS3000_BENCH_CHANNELS))
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS3000_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+
+		if (config->aggregation)
+		{
+			SetDataBuffersV2(_handle, channel, buffers->appBuffers[channel * 2 + 1], buffers->appBuffers[channel * 2], config->bufferLength);
+		}
+		else
+		{
+			SetDataBuffer(_handle, channel, buffers->appBuffers[channel * 2], config->bufferLength);
+		}
+	}
+
+	return setEnabledChannels(_handle, enabledChannels);
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLastValues(_handle) != 0;
+}
+
+/****************************************************************************
+* teardown
+*
+* Clears the buffers registered with the wrapper, which keeps them between
+* devices, and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	int16_t channel = 0;
+
+	for (channel = 0; channel < PS3000_BENCH_CHANNELS; channel++)
+	{
+		SetDataBuffersV2(_handle, channel, NULL, NULL, 0);
+	}
+
+	ps3000_close_unit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps3000", PS3000_BENCH_CHANNELS, 0, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
@@ -0,0 +1,187 @@
+/****************************************************************************
+ *
+ * Filename: ps3000aBench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps3000aWrap library. See
+ *	benchCommon.h.
+ *
+ *	ps3000aGetStreamingLatestValues is replaced at link time by
+ *	__wrap_ps3000aGetStreamingLatestValues, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's StreamingCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PICO_OK	0
+
+#define PS3000A_BENCH_CHANNELS	4
+#define PS3000A_BENCH_DIGITAL_PORTS	2
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern uint32_t ps3000aOpenUnit(int16_t * handle, int8_t * serial);
+extern uint32_t ps3000aCloseUnit(int16_t handle);
+
+extern uint32_t initWrapUnitInfo(int16_t handle, uint16_t * deviceIndex);
+extern uint32_t decrementDeviceCount(uint16_t deviceIndex);
+extern uint32_t GetStreamingLatestValues(uint16_t deviceIndex);
+extern uint32_t setChannelCount(uint16_t deviceIndex, int16_t channelCount);
+extern uint32_t setEnabledChannels(uint16_t deviceIndex, int16_t * enabledChannels);
+extern uint32_t setDigitalPortCount(uint16_t deviceIndex, int16_t digitalPortCount);
+extern uint32_t setEnabledDigitalPorts(uint16_t deviceIndex, int16_t * enabledDigitalPorts);
+extern uint32_t setAppAndDriverBuffers(uint16_t deviceIndex, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverBuffers(uint16_t deviceIndex, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer,
+	int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength);
+extern uint32_t setAppAndDriverDigiBuffers(uint16_t deviceIndex, int16_t digiPort, int16_t * appDigiBuffer, int16_t * driverDigiBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverDigiBuffers(uint16_t deviceIndex, int16_t digiPort, int16_t * appMaxDigiBuffer, int16_t * appMinDigiBuffer,
+	int16_t * driverMaxDigiBuffer, int16_t * driverMinDigiBuffer, int32_t bufferLength);
+
+typedef void (*BENCH_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+static int16_t	_handle = 0;
+static uint16_t	_deviceIndex = 0;
+
+/****************************************************************************
+* __wrap_ps3000aGetStreamingLatestValues
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback.
+*
+****************************************************************************/
+uint32_t __wrap_ps3000aGetStreamingLatestValues(int16_t handle, BENCH_STREAMING_READY lpReady, void * pParameter)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+
+	lpReady(handle, (int32_t) noOfSamples, startIndex, 0, 0, 0, 0, pParameter);
+
+	return 0;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the driver and application buffers with the
+* wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS3000A_BENCH_CHANNELS];
+	int16_t enabledDigitalPorts[4] = { 0, 0, 0, 0 };
+	int16_t channel = 0;
+	int16_t port = 0;
+	int16_t source = 0;
+	uint32_t status = ps3000aOpenUnit(&_handle, NULL);
+
+	if (status == PICO_OK)
+	{
+		status = initWrapUnitInfo(_handle, &_deviceIndex);
+	}
+
+	if (status != PICO_OK)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS3000A_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+	}
+
+	for (port = 0; port < PS3000A_BENCH_DIGITAL_PORTS; port++)
+	{
+		enabledDigitalPorts[port] = (port < config->digitalPorts);
+	}
+
+	status = setChannelCount(_deviceIndex, PS3000A_BENCH_CHANNELS);
+
+	if (status == PICO_OK)
+	{
+		status = setEnabledChannels(_deviceIndex, enabledChannels);
+	}
+
+	if (status == PICO_OK)
+	{
+		status = setDigitalPortCount(_deviceIndex, PS3000A_BENCH_DIGITAL_PORTS);
+	}
+
+	if (status == PICO_OK)
+	{
+		status = setEnabledDigitalPorts(_deviceIndex, enabledDigitalPorts);
+	}
+
+	for (channel = 0; channel < config->channels && status == PICO_OK; channel++)
+	{
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverBuffers(_deviceIndex, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1],
+				buffers->driverBuffers[channel * 2], buffers->driverBuffers[channel * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverBuffers(_deviceIndex, channel, buffers->appBuffers[channel * 2], buffers->driverBuffers[channel * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	for (port = 0; port < config->digitalPorts && status == PICO_OK; port++)
+	{
+		source = BENCH_MAX_CHANNELS + port;
+
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverDigiBuffers(_deviceIndex, port, buffers->appBuffers[source * 2], buffers->appBuffers[source * 2 + 1],
+				buffers->driverBuffers[source * 2], buffers->driverBuffers[source * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverDigiBuffers(_deviceIndex, port, buffers->appBuffers[source * 2], buffers->driverBuffers[source * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	return status == PICO_OK;
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLatestValues(_deviceIndex) == PICO_OK;
+}
+
+/****************************************************************************
+* teardown
+*
+* Releases the wrapper state and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	decrementDeviceCount(_deviceIndex);
+	ps3000aCloseUnit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps3000a", PS3000A_BENCH_CHANNELS, PS3000A_BENCH_DIGITAL_PORTS, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
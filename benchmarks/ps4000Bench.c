@@ -0,0 +1,148 @@
+/****************************************************************************
+ *
+ * Filename: ps4000Bench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps4000Wrap library. See
+ *	benchCommon.h.
+ *
+ *	ps4000GetStreamingLatestValues is replaced at link time by
+ *	__wrap_ps4000GetStreamingLatestValues, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's StreamingCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PICO_OK	0
+
+#define PS4000_BENCH_CHANNELS	4
+#define PS4000_BENCH_DIGITAL_PORTS	0
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern uint32_t ps4000OpenUnit(int16_t * handle);
+extern uint32_t ps4000CloseUnit(int16_t handle);
+
+extern uint32_t GetStreamingLatestValues(int16_t handle);
+extern uint32_t setChannelCount(int16_t handle, int16_t channelCount);
+extern uint32_t setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+extern uint32_t setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer,
+	int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength);
+
+typedef void (*BENCH_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+static int16_t	_handle = 0;
+
+/****************************************************************************
+* __wrap_ps4000GetStreamingLatestValues
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback.
+*
+****************************************************************************/
+uint32_t __wrap_ps4000GetStreamingLatestValues(int16_t handle, BENCH_STREAMING_READY lpReady, void * pParameter)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+
+	lpReady(handle, (int32_t) noOfSamples, startIndex, 0, 0, 0, 0, pParameter);
+
+	return 0;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the driver and application buffers with the
+* wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS4000_BENCH_CHANNELS];
+	int16_t channel = 0;
+	uint32_t status = ps4000OpenUnit(&_handle);
+
+	if (status != PICO_OK)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS4000_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+	}
+
+	status = setChannelCount(_handle, PS4000_BENCH_CHANNELS);
+
+	if (status == PICO_OK)
+	{
+		status = setEnabledChannels(_handle, enabledChannels);
+	}
+
+	for (channel = 0; channel < config->channels && status == PICO_OK; channel++)
+	{
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1],
+				buffers->driverBuffers[channel * 2], buffers->driverBuffers[channel * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->driverBuffers[channel * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	return status == PICO_OK;
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLatestValues(_handle) == PICO_OK;
+}
+
+/****************************************************************************
+* teardown
+*
+* Clears the buffers registered with the wrapper, which keeps them between
+* devices, and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	int16_t channel = 0;
+
+	for (channel = 0; channel < PS4000_BENCH_CHANNELS; channel++)
+	{
+		setMaxMinAppAndDriverBuffers(_handle, channel, NULL, NULL, NULL, NULL, 0);
+	}
+
+	ps4000CloseUnit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps4000", PS4000_BENCH_CHANNELS, PS4000_BENCH_DIGITAL_PORTS, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
@@ -0,0 +1,142 @@
+/****************************************************************************
+ *
+ * Filename: ps4000aBench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps4000aWrap library. See
+ *	benchCommon.h.
+ *
+ *	ps4000aGetStreamingLatestValues is replaced at link time by
+ *	__wrap_ps4000aGetStreamingLatestValues, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's StreamingCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PICO_OK	0
+
+#define PS4000A_BENCH_CHANNELS	8
+#define PS4000A_BENCH_DIGITAL_PORTS	0
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern uint32_t ps4000aOpenUnit(int16_t * handle, int8_t * serial);
+extern uint32_t ps4000aCloseUnit(int16_t handle);
+
+extern uint32_t GetStreamingLatestValues(int16_t handle);
+extern uint32_t releaseWrapUnitInfo(int16_t handle);
+extern uint32_t setChannelCount(int16_t handle, int16_t channelCount);
+extern uint32_t setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+extern uint32_t setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength);
+extern uint32_t setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer,
+	int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength);
+
+typedef void (*BENCH_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+static int16_t	_handle = 0;
+
+/****************************************************************************
+* __wrap_ps4000aGetStreamingLatestValues
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback.
+*
+****************************************************************************/
+uint32_t __wrap_ps4000aGetStreamingLatestValues(int16_t handle, BENCH_STREAMING_READY lpReady, void * pParameter)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+
+	lpReady(handle, (int32_t) noOfSamples, startIndex, 0, 0, 0, 0, pParameter);
+
+	return 0;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the driver and application buffers with the
+* wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS4000A_BENCH_CHANNELS];
+	int16_t channel = 0;
+	uint32_t status = ps4000aOpenUnit(&_handle, NULL);
+
+	if (status != PICO_OK)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS4000A_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+	}
+
+	status = setChannelCount(_handle, PS4000A_BENCH_CHANNELS);
+
+	if (status == PICO_OK)
+	{
+		status = setEnabledChannels(_handle, enabledChannels);
+	}
+
+	for (channel = 0; channel < config->channels && status == PICO_OK; channel++)
+	{
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1],
+				buffers->driverBuffers[channel * 2], buffers->driverBuffers[channel * 2 + 1], (int32_t) config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->driverBuffers[channel * 2], (int32_t) config->bufferLength);
+		}
+	}
+
+	return status == PICO_OK;
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLatestValues(_handle) == PICO_OK;
+}
+
+/****************************************************************************
+* teardown
+*
+* Releases the wrapper state and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	releaseWrapUnitInfo(_handle);
+	ps4000aCloseUnit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps4000a", PS4000A_BENCH_CHANNELS, PS4000A_BENCH_DIGITAL_PORTS, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
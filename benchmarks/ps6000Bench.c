@@ -0,0 +1,138 @@
+/****************************************************************************
+ *
+ * Filename: ps6000Bench.c
+ *
+ * Description:
+ *	Streaming callback benchmark for the ps6000Wrap library. See
+ *	benchCommon.h.
+ *
+ *	ps6000GetStreamingLatestValues is replaced at link time by
+ *	__wrap_ps6000GetStreamingLatestValues, which passes the next chunk of the
+ *	synthetic driver buffers to the wrapper's StreamingCallback callback.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchCommon.h"
+
+#define PICO_OK	0
+
+#define PS6000_BENCH_CHANNELS	4
+#define PS6000_BENCH_DIGITAL_PORTS	0
+
+// Driver and wrapper functions, declared here as the wrapper header defines variables
+
+extern uint32_t ps6000OpenUnit(int16_t * handle, int8_t * serial);
+extern uint32_t ps6000CloseUnit(int16_t handle);
+
+extern uint32_t GetStreamingLatestValues(int16_t handle);
+extern uint32_t releaseWrapUnitInfo(int16_t handle);
+extern void setChannelCount(int16_t handle, int16_t channelCount);
+extern int16_t setEnabledChannels(int16_t handle, int16_t * enabledChannels);
+extern int16_t setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, uint32_t bufferLength);
+extern int16_t setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer,
+	int16_t * driverMaxBuffer, int16_t * driverMinBuffer, uint32_t bufferLength);
+
+typedef void (*BENCH_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+static int16_t	_handle = 0;
+
+/****************************************************************************
+* __wrap_ps6000GetStreamingLatestValues
+*
+* Replaces the driver function called by the wrapper, passing the next
+* chunk of the synthetic driver buffers to the wrapper callback.
+*
+****************************************************************************/
+uint32_t __wrap_ps6000GetStreamingLatestValues(int16_t handle, BENCH_STREAMING_READY lpReady, void * pParameter)
+{
+	uint32_t startIndex = 0;
+	uint32_t noOfSamples = benchNextChunk(&startIndex);
+
+	lpReady(handle, (int32_t) noOfSamples, startIndex, 0, 0, 0, 0, pParameter);
+
+	return 0;
+}
+
+/****************************************************************************
+* setup
+*
+* Opens the device and registers the driver and application buffers with the
+* wrapper.
+*
+****************************************************************************/
+static int16_t setup(const BENCH_CONFIG * config, BENCH_BUFFERS * buffers)
+{
+	int16_t enabledChannels[PS6000_BENCH_CHANNELS];
+	int16_t channel = 0;
+	int16_t status = 0;
+
+	if (ps6000OpenUnit(&_handle, NULL) != PICO_OK)
+	{
+		return 0;
+	}
+
+	for (channel = 0; channel < PS6000_BENCH_CHANNELS; channel++)
+	{
+		enabledChannels[channel] = (channel < config->channels);
+	}
+
+	setChannelCount(_handle, PS6000_BENCH_CHANNELS);
+	status = setEnabledChannels(_handle, enabledChannels);
+
+	for (channel = 0; channel < config->channels && status == 0; channel++)
+	{
+		if (config->aggregation)
+		{
+			status = setMaxMinAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->appBuffers[channel * 2 + 1],
+				buffers->driverBuffers[channel * 2], buffers->driverBuffers[channel * 2 + 1], config->bufferLength);
+		}
+		else
+		{
+			status = setAppAndDriverBuffers(_handle, channel, buffers->appBuffers[channel * 2], buffers->driverBuffers[channel * 2], config->bufferLength);
+		}
+	}
+
+	return status == 0;
+}
+
+/****************************************************************************
+* poll
+*
+* Collects one chunk.
+*
+****************************************************************************/
+static int16_t poll(void)
+{
+	return GetStreamingLatestValues(_handle) == PICO_OK;
+}
+
+/****************************************************************************
+* teardown
+*
+* Releases the wrapper state and closes the device.
+*
+****************************************************************************/
+static void teardown(void)
+{
+	releaseWrapUnitInfo(_handle);
+	ps6000CloseUnit(_handle);
+}
+
+/****************************************************************************
+* main
+*
+* Runs the benchmark. See benchMain for the command line options.
+*
+****************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const BENCH_SERIES series = { "ps6000", PS6000_BENCH_CHANNELS, PS6000_BENCH_DIGITAL_PORTS, setup, poll, teardown };
+
+	return benchMain(argc, argv, &series);
+}
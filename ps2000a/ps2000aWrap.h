@@ -29,6 +29,13 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #elif _WIN64
 #include "windows.h"
 #include <stdio.h>
@@ -44,6 +51,13 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #else
 #include <sys/types.h>
 #include <string.h>
@@ -51,6 +65,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #include <libps2000a-1.1/ps2000aApi.h>
 #ifndef PICO_STATUS
 #include <libps2000a-1.1/PicoStatus.h>
@@ -61,12 +78,46 @@
 #define PREF0
 #define PREF1
 
+#define WRAP_MEMORY_BARRIER() __sync_synchronize()
+
+typedef pthread_mutex_t WRAP_LOCK;
+typedef pthread_cond_t WRAP_CONDITION;
+#define WRAP_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define WRAP_CONDITION_INIT PTHREAD_COND_INITIALIZER
+
 typedef enum enBOOL
 {
   FALSE, TRUE
 } BOOL;
 #endif
 
+// Instruction set extensions used by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
+
 // 2205 MSO also has 2 digital ports
 #define MAX_DIGITAL_PORTS			(PS2000A_MAX_DIGITAL_PORTS / 2)		// 2
 #define MAX_DIGITAL_BUFFERS			4									// 4 - Port 0 Max/Min and Port 1 Max/Min
@@ -103,6 +154,50 @@ typedef struct tWrapBufferInfo
 
 WRAP_BUFFER_INFO g_wrapBufferInfo;
 
+#define WRAP_STREAMING_EVENT_QUEUE_SIZE		1024	// Number of streaming callback records held - must be a power of 2
+#define WRAP_STREAMING_EVENT_FIELDS			8		// Number of values per record returned by DrainStreamingEvents
+
+/****************************************************************************
+* tWrapStreamingEvent
+*
+* A record of the parameters passed to one call of the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEvent
+{
+	uint32_t	numSamples;
+	uint32_t	startIndex;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		overflow;
+	int16_t		autoStop;
+	uint64_t	timestamp;			// Host time in microseconds when the callback was received
+} WRAP_STREAMING_EVENT;
+
+/****************************************************************************
+* tWrapStreamingEventQueue
+*
+* Single-producer/single-consumer queue of streaming callback records. The 
+* streaming callback is the only writer of writeIndex and droppedEvents, and 
+* DrainStreamingEvents is the only writer of readIndex, so no lock is needed.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEventQueue
+{
+	WRAP_STREAMING_EVENT	events[WRAP_STREAMING_EVENT_QUEUE_SIZE];
+	volatile uint32_t		writeIndex;				// Total number of records added
+	volatile uint32_t		readIndex;				// Total number of records removed
+	volatile uint32_t		droppedEvents;			// Total number of records lost because the queue was full
+	uint32_t				reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainStreamingEvents
+} WRAP_STREAMING_EVENT_QUEUE;
+
+WRAP_STREAMING_EVENT_QUEUE g_streamingEventQueue;
+
+#define WRAP_WAIT_INFINITE	0xFFFFFFFF
+
+WRAP_LOCK		g_readyLock = WRAP_LOCK_INIT;			// Protects g_ready for WaitForStreamingData and WaitForBlockReady
+WRAP_CONDITION	g_readyCondition;						// Initialised on first use by getReadyCondition
+
 // Enum to define Digital Port indices
 typedef enum enPS2000AWrapDigitalPortIndex
 {
@@ -146,6 +241,18 @@ extern int16_t PREF0 PREF1 IsReady
 	int16_t handle
 );
 
+extern int16_t PREF0 PREF1 WaitForStreamingData
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
+extern int16_t PREF0 PREF1 WaitForBlockReady
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
 extern int16_t PREF0 PREF1 IsTriggerReady
 (
 	int16_t handle, 
@@ -246,4 +353,19 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverDigiBuffers
 	int16_t * driverMinDigiBuffer,
 	int32_t bufferLength
 );
+
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents
+(
+	int16_t handle,
+	uint32_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
 #endif
@@ -31,6 +31,239 @@
 //
 /////////////////////////////////
 
+static int16_t _simdLevel = -1;
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+
+/****************************************************************************
+* detectSimdLevel
+*
+* Returns the widest instruction set extension that can be used for the 
+* streaming copy on this processor (WRAP_SIMD_NONE, WRAP_SIMD_SSE2, 
+* WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512).
+*
+****************************************************************************/
+static int16_t detectSimdLevel(void)
+{
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[3] & (1 << 26)) == 0)
+	{
+		return WRAP_SIMD_NONE;
+	}
+
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+
+	if (osSavesAvxState && maxLeaf >= 7)
+	{
+		__cpuidex(cpuInfo, 7, 0);
+
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
+		}
+
+		if (cpuInfo[1] & (1 << 5))
+		{
+			return WRAP_SIMD_AVX2;
+		}
+	}
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
+}
+
+/****************************************************************************
+* getSimdLevel
+*
+* Returns the result of detectSimdLevel, which is only run the first time.
+*
+****************************************************************************/
+static int16_t getSimdLevel(void)
+{
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
+}
+
+#ifdef WRAP_SIMD_X86
+/****************************************************************************
+* copyNonTemporalSse2
+*
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
+*
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
+
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+#endif
+
+/****************************************************************************
+* copySamples
+*
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
+*
+****************************************************************************/
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	size_t nBytes = noOfSamples * sizeof(int16_t);
+
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
+}
+
 /****************************************************************************
 * Streaming Callback
 *
@@ -70,15 +303,13 @@ void PREF1 my_get_overview_buffers(
 				// Max buffers
 				if (g_overviewBuffers[channel * 2] && overviewBuffers[channel * 2])
 				{
-					memcpy_s(g_overviewBuffers[channel * 2], g_nValues * sizeof(int16_t),
-						overviewBuffers[channel * 2], g_nValues * sizeof(int16_t));
+					copySamples(g_overviewBuffers[channel * 2], overviewBuffers[channel * 2], g_nValues);
 				}
 
 				// Min buffers
 				if (g_overviewBuffers[channel * 2 + 1] && overviewBuffers[channel * 2 + 1])
 				{
-					memcpy_s(g_overviewBuffers[channel * 2 + 1], g_nValues * sizeof(int16_t),
-						overviewBuffers[channel * 2 + 1], g_nValues * sizeof(int16_t));
+					copySamples(g_overviewBuffers[channel * 2 + 1], overviewBuffers[channel * 2 + 1], g_nValues);
 				}
 			}
 		}
@@ -441,3 +672,28 @@ extern int16_t PREF0 PREF1 clearFastStreamingParameters(int16_t handle)
 	}
 
 }
+
+/****************************************************************************
+* setNonTemporalCopyThreshold
+*
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
+*
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
+*
+* Input Arguments:
+*
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
+*
+****************************************************************************/
+extern void PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
+{
+	_nonTemporalCopyThreshold = thresholdBytes;
+}
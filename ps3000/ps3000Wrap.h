@@ -47,6 +47,33 @@ typedef enum enBOOL
 } BOOL;
 #endif
 
+// Instruction set extensions used by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
+
 ///////////////////////////////////////
 //
 //	Constant and variable definitions
@@ -147,4 +174,9 @@ extern int16_t PREF0 PREF1 clearFastStreamingParameters
 	int16_t handle
 );
 
+extern void PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
 #endif
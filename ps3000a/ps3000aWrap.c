@@ -29,197 +29,1849 @@
 //
 /////////////////////////////////
 
+static int16_t _simdLevel = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+static LARGE_INTEGER _timestampFrequency = { 0 };
+#endif
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+static WRAP_TRIGGER_ARENA * _triggerArenas[WRAP_MAX_HANDLE + 1];	// Trigger arena for each handle, allocated when first used
+static size_t _triggerArenaSizes[WRAP_MAX_HANDLE + 1];				// Size of each trigger arena in bytes - at least sizeof(WRAP_TRIGGER_ARENA)
+
+/****************************************************************************
+* detectSimdLevel
+*
+* Returns the widest instruction set extension that can be used for the 
+* streaming copy on this processor (WRAP_SIMD_NONE, WRAP_SIMD_SSE2, 
+* WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512).
+*
+****************************************************************************/
+static int16_t detectSimdLevel(void)
+{
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[3] & (1 << 26)) == 0)
+	{
+		return WRAP_SIMD_NONE;
+	}
+
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+
+	if (osSavesAvxState && maxLeaf >= 7)
+	{
+		__cpuidex(cpuInfo, 7, 0);
+
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
+		}
+
+		if (cpuInfo[1] & (1 << 5))
+		{
+			return WRAP_SIMD_AVX2;
+		}
+	}
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
+}
+
+/****************************************************************************
+* getSimdLevel
+*
+* Returns the result of detectSimdLevel, which is only run the first time.
+*
+****************************************************************************/
+static int16_t getSimdLevel(void)
+{
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
+}
+
+#ifdef WRAP_SIMD_X86
+/****************************************************************************
+* copyNonTemporalSse2
+*
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
+*
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
+
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+#endif
+
+/****************************************************************************
+* copySamples
+*
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
+*
+****************************************************************************/
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	size_t nBytes = noOfSamples * sizeof(int16_t);
+
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
+}
+
+/****************************************************************************
+* getHostTimestamp
+*
+* Returns a monotonic host time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getHostTimestamp(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	LARGE_INTEGER counter;
+
+	// The frequency is fixed at boot, so it is only read once
+	if (_timestampFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&_timestampFrequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / _timestampFrequency.QuadPart) * 1000000 + 
+		((counter.QuadPart % _timestampFrequency.QuadPart) * 1000000) / _timestampFrequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
+}
+
+/****************************************************************************
+* pushStreamingEvent
+*
+* Adds a record of a streaming callback to the event queue. Called only from 
+* the streaming callback. If the queue is full, the record is discarded and 
+* counted as dropped.
+*
+****************************************************************************/
+static void pushStreamingEvent(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t numSamples, uint32_t startIndex, int16_t triggered, 
+	uint32_t triggeredAt, int16_t overflow, int16_t autoStop)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_STREAMING_EVENT_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+	event->numSamples = numSamples;
+	event->startIndex = startIndex;
+	event->triggered = triggered;
+	event->triggeredAt = triggeredAt;
+	event->overflow = overflow;
+	event->autoStop = autoStop;
+	event->timestamp = getHostTimestamp();
+
+	// Make sure the record is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* drainStreamingEventQueue
+*
+* Copies up to maxEvents records out of the event queue into a flat array and
+* removes them from the queue. Called only from DrainStreamingEvents.
+*
+****************************************************************************/
+static void drainStreamingEventQueue(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, 
+	uint32_t * droppedEvents)
+{
+	uint32_t readIndex = queue->readIndex;
+	uint32_t writeIndex = queue->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+		events[j]		= event->numSamples;
+		events[j + 1]	= event->startIndex;
+		events[j + 2]	= (uint32_t) event->triggered;
+		events[j + 3]	= event->triggeredAt;
+		events[j + 4]	= (uint32_t) (uint16_t) event->overflow;
+		events[j + 5]	= (uint32_t) event->autoStop;
+		events[j + 6]	= (uint32_t) (event->timestamp & 0xFFFFFFFF);
+		events[j + 7]	= (uint32_t) (event->timestamp >> 32);
+
+		j = j + WRAP_STREAMING_EVENT_FIELDS;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+}
+
+/****************************************************************************
+* logStreamingTrigger
+*
+* Adds the trigger reported by a streaming callback, if any, to the trigger 
+* log and advances the sample count past the samples in the callback. 
+* Called only from the streaming callback. If the log is full, the trigger 
+* is discarded and counted as dropped.
+*
+****************************************************************************/
+static void logStreamingTrigger(WRAP_TRIGGER_LOG * log, int32_t numSamples, int16_t triggered, uint32_t triggeredAt)
+{
+	uint32_t writeIndex = log->writeIndex;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	if (triggered)
+	{
+		if (writeIndex - log->readIndex >= WRAP_TRIGGER_LOG_SIZE)
+		{
+			log->droppedRecords = log->droppedRecords + 1;
+		}
+		else
+		{
+			record = &log->records[writeIndex & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+			record->sampleIndex = log->sampleCount + triggeredAt;
+			record->timestamp = getHostTimestamp();
+
+			// Make sure the record is complete before it is made visible to the reader
+			WRAP_MEMORY_BARRIER();
+
+			log->writeIndex = writeIndex + 1;
+		}
+	}
+
+	if (numSamples > 0)
+	{
+		log->sampleCount += (uint32_t) numSamples;
+	}
+}
+
+/****************************************************************************
+* drainTriggerLog
+*
+* Copies up to maxTriggers records out of the trigger log into a flat array
+* and removes them from the log. Called only from DrainTriggerLog.
+*
+****************************************************************************/
+static void drainTriggerLog(WRAP_TRIGGER_LOG * log, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, 
+	uint32_t * droppedTriggers)
+{
+	uint32_t readIndex = log->readIndex;
+	uint32_t writeIndex = log->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxTriggers)
+	{
+		count = maxTriggers;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &log->records[(readIndex + i) & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS]		= record->sampleIndex;
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS + 1]	= record->timestamp;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	log->readIndex = readIndex + count;
+	*nTriggers = count;
+
+	if (droppedTriggers != NULL)
+	{
+		dropped = log->droppedRecords;
+		*droppedTriggers = dropped - log->reportedDroppedRecords;
+		log->reportedDroppedRecords = dropped;
+	}
+}
+
+/****************************************************************************
+* allocateWindowBuffer
+*
+* Allocates a page-aligned buffer of nSamples samples for zero-copy 
+* streaming. Returns NULL if the memory could not be allocated.
+*
+****************************************************************************/
+static int16_t * allocateWindowBuffer(uint32_t nSamples)
+{
+#if defined(WIN32) || defined(_WIN64)
+	return (int16_t *) _aligned_malloc(nSamples * sizeof(int16_t), WRAP_STREAMING_WINDOW_ALIGNMENT);
+#else
+	void * buffer = NULL;
+
+	if (posix_memalign(&buffer, WRAP_STREAMING_WINDOW_ALIGNMENT, nSamples * sizeof(int16_t)) != 0)
+	{
+		return NULL;
+	}
+
+	return (int16_t *) buffer;
+#endif
+}
+
+/****************************************************************************
+* freeWindowBuffer
+*
+* Frees a buffer allocated by allocateWindowBuffer.
+*
+****************************************************************************/
+static void freeWindowBuffer(int16_t * buffer)
+{
+#if defined(WIN32) || defined(_WIN64)
+	_aligned_free(buffer);
+#else
+	free(buffer);
+#endif
+}
+
+/****************************************************************************
+* lockStreamingWindows
+*
+* Acquires the lock that protects the state of the zero-copy windows of a 
+* device. Each change of state is made with the lock held, because windows 
+* are moved between states both by the thread calling the driver and by the
+* application. The lock is never held while calling the driver.
+*
+****************************************************************************/
+static void lockStreamingWindows(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->windowLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->windowLock);
+#endif
+}
+
+/****************************************************************************
+* unlockStreamingWindows
+*
+* Releases the lock taken by lockStreamingWindows.
+*
+****************************************************************************/
+static void unlockStreamingWindows(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->windowLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->windowLock);
+#endif
+}
+
+/****************************************************************************
+* isStreamingWindowHeld
+*
+* Returns TRUE if the application holds any zero-copy window of a device.
+*
+****************************************************************************/
+static int16_t isStreamingWindowHeld(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	uint16_t window = 0;
+	int16_t held = FALSE;
+
+	lockStreamingWindows(wrapUnitInfo);
+
+	for (window = 0; window < wrapUnitInfo->zeroCopyWindowCount; window++)
+	{
+		if (wrapUnitInfo->windows[window].state == WRAP_WINDOW_HELD)
+		{
+			held = TRUE;
+		}
+	}
+
+	unlockStreamingWindows(wrapUnitInfo);
+
+	return held;
+}
+
+/****************************************************************************
+* freeStreamingWindows
+*
+* Frees all zero-copy streaming buffers owned by a device and disables 
+* zero-copy streaming.
+*
+****************************************************************************/
+static void freeStreamingWindows(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	uint16_t window = 0;
+	int16_t i = 0;
+
+	lockStreamingWindows(wrapUnitInfo);
+
+	for (window = 0; window < WRAP_MAX_STREAMING_WINDOWS; window++)
+	{
+		for (i = 0; i < PS3000A_MAX_CHANNEL_BUFFERS; i++)
+		{
+			if (wrapUnitInfo->windows[window].buffers[i] != NULL)
+			{
+				freeWindowBuffer(wrapUnitInfo->windows[window].buffers[i]);
+				wrapUnitInfo->windows[window].buffers[i] = NULL;
+			}
+		}
+
+		for (i = 0; i < MAX_DIGITAL_BUFFERS; i++)
+		{
+			if (wrapUnitInfo->windows[window].digiBuffers[i] != NULL)
+			{
+				freeWindowBuffer(wrapUnitInfo->windows[window].digiBuffers[i]);
+				wrapUnitInfo->windows[window].digiBuffers[i] = NULL;
+			}
+		}
+
+		wrapUnitInfo->windows[window].state = WRAP_WINDOW_FREE;
+	}
+
+	wrapUnitInfo->zeroCopyEnabled = 0;
+	wrapUnitInfo->zeroCopyWindowCount = 0;
+	wrapUnitInfo->zeroCopyBufferLength = 0;
+	wrapUnitInfo->currentWindow = -1;
+
+	unlockStreamingWindows(wrapUnitInfo);
+}
+
+/****************************************************************************
+* registerStreamingWindow
+*
+* Registers the buffers of a zero-copy streaming window with the driver for 
+* each enabled channel and digital port.
+*
+****************************************************************************/
+static PICO_STATUS registerStreamingWindow(WRAP_UNIT_INFO * wrapUnitInfo, int16_t window)
+{
+	PICO_STATUS status = PICO_OK;
+	int16_t channel = 0;
+	int16_t digitalPort = 0;
+	WRAP_STREAMING_WINDOW * streamingWindow = &wrapUnitInfo->windows[window];
+
+	for (channel = (int16_t) PS3000A_CHANNEL_A; channel < wrapUnitInfo->channelCount && status == PICO_OK; channel++)
+	{
+		if (wrapUnitInfo->enabledChannels[channel])
+		{
+			status = ps3000aSetDataBuffers(wrapUnitInfo->handle, (PS3000A_CHANNEL) channel, streamingWindow->buffers[channel * 2], 
+				streamingWindow->buffers[channel * 2 + 1], wrapUnitInfo->zeroCopyBufferLength, 0, 
+				wrapUnitInfo->zeroCopyAggregate ? PS3000A_RATIO_MODE_AGGREGATE : PS3000A_RATIO_MODE_NONE);
+		}
+	}
+
+	for (digitalPort = (int16_t) PS3000A_WRAP_DIGITAL_PORT0; digitalPort < wrapUnitInfo->digitalPortCount && status == PICO_OK; digitalPort++)
+	{
+		if (wrapUnitInfo->enabledDigitalPorts[digitalPort])
+		{
+			status = ps3000aSetDataBuffers(wrapUnitInfo->handle, (PS3000A_CHANNEL) (PS3000A_DIGITAL_PORT0 + digitalPort), 
+				streamingWindow->digiBuffers[digitalPort * 2], streamingWindow->digiBuffers[digitalPort * 2 + 1], 
+				wrapUnitInfo->zeroCopyBufferLength, 0, wrapUnitInfo->zeroCopyAggregate ? PS3000A_RATIO_MODE_AGGREGATE : PS3000A_RATIO_MODE_NONE);
+		}
+	}
+
+	if (status == PICO_OK)
+	{
+		lockStreamingWindows(wrapUnitInfo);
+		streamingWindow->state = WRAP_WINDOW_REGISTERED;
+		wrapUnitInfo->currentWindow = window;
+		unlockStreamingWindows(wrapUnitInfo);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* rotateStreamingWindow
+*
+* Makes sure a window that the application does not hold is registered with
+* the driver before the next call to ps3000aGetStreamingLatestValues. A 
+* window that is still waiting for data is kept; otherwise the next free 
+* window is registered.
+*
+* Returns PICO_BUSY if every window is filled or held by the application.
+*
+****************************************************************************/
+static PICO_STATUS rotateStreamingWindow(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	uint16_t i = 0;
+	int16_t window = 0;
+	int16_t freeWindow = -1;
+
+	lockStreamingWindows(wrapUnitInfo);
+
+	if (wrapUnitInfo->currentWindow >= 0 && wrapUnitInfo->windows[wrapUnitInfo->currentWindow].state == WRAP_WINDOW_REGISTERED)
+	{
+		unlockStreamingWindows(wrapUnitInfo);
+		return PICO_OK;
+	}
+
+	for (i = 1; i <= wrapUnitInfo->zeroCopyWindowCount && freeWindow < 0; i++)
+	{
+		window = (int16_t) ((wrapUnitInfo->currentWindow + i) % wrapUnitInfo->zeroCopyWindowCount);
+
+		if (wrapUnitInfo->windows[window].state == WRAP_WINDOW_FREE)
+		{
+			freeWindow = window;
+		}
+	}
+
+	unlockStreamingWindows(wrapUnitInfo);
+
+	// Only this thread takes windows out of the free state, so the window stays free while it is registered
+	if (freeWindow >= 0)
+	{
+		return registerStreamingWindow(wrapUnitInfo, freeWindow);
+	}
+
+	return PICO_BUSY;
+}
+
+/****************************************************************************
+* initMonotonicCondition
+*
+* Initialises a condition variable whose timed waits are measured against 
+* CLOCK_MONOTONIC, so that waitForReady is not affected by changes to the 
+* system time.
+*
+****************************************************************************/
+#if !defined(WIN32) && !defined(_WIN64)
+static void initMonotonicCondition(WRAP_CONDITION * condition)
+{
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+#endif
+
+/****************************************************************************
+* setReady
+*
+* Sets a ready flag and wakes any threads waiting for it in waitForReady.
+*
+****************************************************************************/
+static void setReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(lock);
+	*ready = 1;
+	ReleaseSRWLockExclusive(lock);
+	WakeAllConditionVariable(condition);
+#else
+	pthread_mutex_lock(lock);
+	*ready = 1;
+	pthread_cond_broadcast(condition);
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+/****************************************************************************
+* readStreamingResult
+*
+* Copies the result of the latest streaming callback or block capture.
+*
+****************************************************************************/
+static void readStreamingResult(WRAP_UNIT_INFO * wrapUnitInfo, WRAP_STREAMING_RESULT * result)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->readyLock);
+	*result = wrapUnitInfo->result;
+	ReleaseSRWLockExclusive(&wrapUnitInfo->readyLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->readyLock);
+	*result = wrapUnitInfo->result;
+	pthread_mutex_unlock(&wrapUnitInfo->readyLock);
+#endif
+}
+
+/****************************************************************************
+* publishStreamingResult
+*
+* Replaces the result read by readStreamingResult and wakes any threads 
+* waiting in waitForReady if the new result is ready.
+*
+****************************************************************************/
+static void publishStreamingResult(WRAP_UNIT_INFO * wrapUnitInfo, const WRAP_STREAMING_RESULT * result)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->readyLock);
+	wrapUnitInfo->result = *result;
+	ReleaseSRWLockExclusive(&wrapUnitInfo->readyLock);
+
+	if (result->ready)
+	{
+		WakeAllConditionVariable(&wrapUnitInfo->readyCondition);
+	}
+#else
+	pthread_mutex_lock(&wrapUnitInfo->readyLock);
+	wrapUnitInfo->result = *result;
+
+	if (result->ready)
+	{
+		pthread_cond_broadcast(&wrapUnitInfo->readyCondition);
+	}
+
+	pthread_mutex_unlock(&wrapUnitInfo->readyLock);
+#endif
+}
+
+/****************************************************************************
+* resetStreamingResult
+*
+* Clears the ready flag before the driver is asked for new data. numSamples
+* is set to the number of samples expected, or 0 when streaming.
+*
+****************************************************************************/
+static void resetStreamingResult(WRAP_UNIT_INFO * wrapUnitInfo, int32_t numSamples)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->readyLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->readyLock);
+#endif
+
+	wrapUnitInfo->result.ready = 0;
+	wrapUnitInfo->result.numSamples = numSamples;
+	wrapUnitInfo->result.autoStop = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->readyLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->readyLock);
+#endif
+}
+
+/****************************************************************************
+* waitForReady
+*
+* Blocks the calling thread until a ready flag is set by setReady or the 
+* timeout expires, and returns the value of the flag. A timeout of 
+* WRAP_WAIT_INFINITE waits indefinitely. The wait also ends if the released
+* flag is set, so that a device can be released while a thread waits on it.
+*
+****************************************************************************/
+static int16_t waitForReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready, 
+	volatile int16_t * released, uint32_t timeoutMs)
+{
+	int16_t isReady = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	ULONGLONG now = 0;
+
+	AcquireSRWLockExclusive(lock);
+
+	while (!*ready && !*released)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+			continue;
+		}
+
+		now = GetTickCount64();
+
+		if (now >= deadline)
+		{
+			break;
+		}
+
+		SleepConditionVariableSRW(condition, lock, (DWORD) (deadline - now), 0);
+	}
+
+	isReady = *ready;
+	ReleaseSRWLockExclusive(lock);
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(lock);
+
+	while (!*ready && !*released)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			pthread_cond_wait(condition, lock);
+		}
+		else if (pthread_cond_timedwait(condition, lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	isReady = *ready;
+	pthread_mutex_unlock(lock);
+#endif
+
+	return isReady;
+}
+
+/****************************************************************************
+* lockDeviceSlots
+*
+* Acquires g_deviceSlotLock. The lock must not be held while calling the 
+* driver, as the driver may be waiting to call BlockCallback.
+*
+****************************************************************************/
+static void lockDeviceSlots(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&g_deviceSlotLock);
+#else
+	pthread_mutex_lock(&g_deviceSlotLock);
+#endif
+}
+
+/****************************************************************************
+* unlockDeviceSlots
+*
+* Releases g_deviceSlotLock.
+*
+****************************************************************************/
+static void unlockDeviceSlots(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&g_deviceSlotLock);
+#else
+	pthread_mutex_unlock(&g_deviceSlotLock);
+#endif
+}
+
+/****************************************************************************
+* getDeviceSlot
+*
+* Returns the registry entry for a slot number below g_nextDeviceIndex.
+*
+****************************************************************************/
+static WRAP_DEVICE_SLOT * getDeviceSlot(uint16_t slot)
+{
+	return &g_deviceSlotChunks[slot / WRAP_DEVICE_SLOT_CHUNK][slot % WRAP_DEVICE_SLOT_CHUNK];
+}
+
+/****************************************************************************
+* findWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure for a device index, or NULL if the 
+* index is out of range or refers to a device that has been released.
+* g_deviceSlotLock must be held by the caller.
+*
+****************************************************************************/
+static WRAP_UNIT_INFO * findWrapUnitInfo(uint16_t deviceIndex)
+{
+	uint16_t slot = deviceIndex & WRAP_DEVICE_SLOT_MASK;
+	uint16_t generation = deviceIndex >> WRAP_DEVICE_SLOT_BITS;
+
+	if (slot >= g_nextDeviceIndex || getDeviceSlot(slot)->generation != generation)
+	{
+		return NULL;
+	}
+
+	return getDeviceSlot(slot)->unitInfo;
+}
+
+/****************************************************************************
+* acquireWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure for a device index and takes a 
+* reference to it, or returns NULL if the index is out of range or refers to
+* a device that has been released. The structure is not freed until the 
+* reference is returned with releaseWrapUnitInfo.
+*
+****************************************************************************/
+static WRAP_UNIT_INFO * acquireWrapUnitInfo(uint16_t deviceIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	lockDeviceSlots();
+
+	wrapUnitInfo = findWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo != NULL)
+	{
+		wrapUnitInfo->references = wrapUnitInfo->references + 1;
+	}
+
+	unlockDeviceSlots();
+
+	return wrapUnitInfo;
+}
+
+/****************************************************************************
+* releaseWrapUnitInfo
+*
+* Returns a reference taken by acquireWrapUnitInfo. wrapUnitInfo may be NULL.
+*
+****************************************************************************/
+static void releaseWrapUnitInfo(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	if (wrapUnitInfo == NULL)
+	{
+		return;
+	}
+
+	lockDeviceSlots();
+
+	wrapUnitInfo->references = wrapUnitInfo->references - 1;
+
+	if (wrapUnitInfo->references == 0)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		WakeAllConditionVariable(&g_deviceReleaseCondition);
+#else
+		pthread_cond_broadcast(&g_deviceReleaseCondition);
+#endif
+	}
+
+	unlockDeviceSlots();
+}
+
+/****************************************************************************
+* updateCopyPlan
+*
+* Rebuilds the list of buffers copied by the streaming callback from the 
+* enabled channels and digital ports and the buffers registered for them, 
+* so that the callback does not need to check each channel and port.
+*
+* Called by each function that changes the channels, ports or buffers. The
+* plan is rewritten in place, so those functions refuse to run while the 
+* streaming engine thread may be reading it.
+*
+****************************************************************************/
+static void updateCopyPlan(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	int16_t channel = 0;
+	int16_t digitalPort = 0;
+	int16_t buffer = 0;
+	int16_t length = 0;
+
+	// Analogue channels, max then min buffer
+	for (channel = (int16_t) PS3000A_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+	{
+		if (wrapUnitInfo->enabledChannels[channel])
+		{
+			for (buffer = channel * 2; buffer <= channel * 2 + 1; buffer++)
+			{
+				if (wrapUnitInfo->appBuffers[buffer] && wrapUnitInfo->driverBuffers[buffer])
+				{
+					wrapUnitInfo->copyPlan[length].source = wrapUnitInfo->driverBuffers[buffer];
+					wrapUnitInfo->copyPlan[length].destination = wrapUnitInfo->appBuffers[buffer];
+					length++;
+				}
+			}
+		}
+	}
+
+	// Digital ports, max then min buffer
+	for (digitalPort = (int16_t) PS3000A_WRAP_DIGITAL_PORT0; digitalPort < wrapUnitInfo->digitalPortCount; digitalPort++)
+	{
+		if (wrapUnitInfo->enabledDigitalPorts[digitalPort])
+		{
+			for (buffer = digitalPort * 2; buffer <= digitalPort * 2 + 1; buffer++)
+			{
+				if (wrapUnitInfo->appDigiBuffers[buffer] && wrapUnitInfo->driverDigiBuffers[buffer])
+				{
+					wrapUnitInfo->copyPlan[length].source = wrapUnitInfo->driverDigiBuffers[buffer];
+					wrapUnitInfo->copyPlan[length].destination = wrapUnitInfo->appDigiBuffers[buffer];
+					length++;
+				}
+			}
+		}
+	}
+
+	wrapUnitInfo->copyPlanLength = length;
+}
+
+/****************************************************************************
+* Streaming Callback
+*
+* See ps3000aStreamingReady (callback)
+*
+****************************************************************************/
+void PREF1 StreamingCallback(
+    int16_t handle,
+	int32_t noOfSamples,
+	uint32_t startIndex,
+	int16_t overflow,
+	uint32_t triggerAt,
+	int16_t triggered,
+	int16_t autoStop,
+	void * pParameter)
+{
+	int16_t entry = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_RESULT result;
+	
+	if (pParameter != NULL)
+	{
+		wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+	}
+
+	// Assign values to structure
+	result.ready = 1;
+	result.numSamples = noOfSamples;
+	result.autoStop = autoStop;
+	result.startIndex = startIndex;
+
+	result.triggered = triggered;
+	result.triggeredAt = triggerAt;
+  
+	result.overflow = overflow;
+
+	// In zero-copy mode the data stays in the window registered with the driver
+	if (wrapUnitInfo != NULL && wrapUnitInfo->zeroCopyEnabled)
+	{
+		lockStreamingWindows(wrapUnitInfo);
+
+		if (noOfSamples && wrapUnitInfo->currentWindow >= 0)
+		{
+			wrapUnitInfo->windows[wrapUnitInfo->currentWindow].startIndex = startIndex;
+			wrapUnitInfo->windows[wrapUnitInfo->currentWindow].numSamples = noOfSamples;
+			wrapUnitInfo->windows[wrapUnitInfo->currentWindow].sequence = wrapUnitInfo->nextWindowSequence++;
+			wrapUnitInfo->windows[wrapUnitInfo->currentWindow].state = WRAP_WINDOW_FILLED;
+		}
+
+		unlockStreamingWindows(wrapUnitInfo);
+	}
+	// Verify if wrapper buffer info set and data received
+	else if (wrapUnitInfo != NULL && noOfSamples)
+	{
+		// Copy data from each driver buffer in the plan to its application buffer
+		for (entry = 0; entry < wrapUnitInfo->copyPlanLength; entry++)
+		{
+			copySamples(&wrapUnitInfo->copyPlan[entry].destination[startIndex], &wrapUnitInfo->copyPlan[entry].source[startIndex], noOfSamples);
+		}
+	}
+
+	logStreamingTrigger(&wrapUnitInfo->triggerLog, noOfSamples, triggered, triggerAt);
+	pushStreamingEvent(&wrapUnitInfo->eventQueue, noOfSamples, startIndex, triggered, triggerAt, overflow, autoStop);
+
+	publishStreamingResult(wrapUnitInfo, &result);
+}
+
+/****************************************************************************
+* BlockCallback
+*
+* See ps3000aBlockReady (callback)
+*
+****************************************************************************/
+void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	// Holding the lock stops releaseDeviceSlot freeing the device until the callback has finished
+	lockDeviceSlots();
+
+	wrapUnitInfo = findWrapUnitInfo((uint16_t) (uintptr_t) pParameter);
+
+	// The device may have been released while the capture was in progress
+	if (wrapUnitInfo != NULL)
+	{
+		setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->result.ready);
+	}
+
+	unlockDeviceSlots();
+
+	status = PICO_OK;
+
+}
+
+/****************************************************************************
+* getLatestValues
+*
+* Requests the next block of streaming data from the driver for a device, 
+* registering a new window first if zero-copy streaming is enabled. Used by 
+* GetStreamingLatestValues and the streaming engine.
+*
+****************************************************************************/
+static PICO_STATUS getLatestValues(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	PICO_STATUS status = PICO_OK;
+
+	resetStreamingResult(wrapUnitInfo, 0);
+
+	if (wrapUnitInfo->zeroCopyEnabled)
+	{
+		status = rotateStreamingWindow(wrapUnitInfo);
+	}
+
+	if (status == PICO_OK)
+	{
+		status = ps3000aGetStreamingLatestValues(wrapUnitInfo->handle, StreamingCallback, wrapUnitInfo);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* sleepMicroseconds
+*
+* Suspends the calling thread for at least the given time. On Windows the 
+* time is rounded up to a whole number of milliseconds.
+*
+****************************************************************************/
+static void sleepMicroseconds(uint32_t microseconds)
+{
+#if defined(WIN32) || defined(_WIN64)
+	Sleep((microseconds + 999) / 1000);
+#else
+	usleep(microseconds);
+#endif
+}
+
+/****************************************************************************
+* runStreamingEngine
+*
+* Body of the streaming engine thread. Calls the driver for new data until 
+* it is asked to stop, streaming autostops, or the driver returns an error.
+* The thread only sleeps when the driver has no new data, so that the 
+* driver's buffer is emptied as quickly as possible.
+*
+****************************************************************************/
+static void runStreamingEngine(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	PICO_STATUS status = PICO_OK;
+	WRAP_STREAMING_RESULT result;
+
+	while (!wrapUnitInfo->engineStopRequested)
+	{
+		status = getLatestValues(wrapUnitInfo);
+		readStreamingResult(wrapUnitInfo, &result);
+
+		if (status == PICO_OK && result.ready && result.numSamples > 0)
+		{
+			wrapUnitInfo->engineTotalSamples += result.numSamples;
+		}
+		else if (status != PICO_OK && status != PICO_BUSY)
+		{
+			// PICO_BUSY means the driver has no new data yet, or all zero-copy windows are held
+			break;
+		}
+		else
+		{
+			sleepMicroseconds(wrapUnitInfo->enginePollIntervalUs);
+		}
+
+		if (result.ready && result.autoStop)
+		{
+			break;
+		}
+	}
+
+	wrapUnitInfo->engineStatus = status;
+
+	WRAP_MEMORY_BARRIER();
+
+	wrapUnitInfo->engineRunning = 0;
+}
+
+#if defined(WIN32) || defined(_WIN64)
+static DWORD WINAPI streamingEngineThread(LPVOID parameter)
+{
+	runStreamingEngine((WRAP_UNIT_INFO *) parameter);
+	return 0;
+}
+#else
+static void * streamingEngineThread(void * parameter)
+{
+	runStreamingEngine((WRAP_UNIT_INFO *) parameter);
+	return NULL;
+}
+#endif
+
+/****************************************************************************
+* stopEngineThread
+*
+* Asks the streaming engine thread of a device to stop and waits for it to 
+* exit.
+*
+****************************************************************************/
+static void stopEngineThread(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	if (!wrapUnitInfo->engineThreadCreated)
+	{
+		return;
+	}
+
+	wrapUnitInfo->engineStopRequested = 1;
+
+#if defined(WIN32) || defined(_WIN64)
+	WaitForSingleObject(wrapUnitInfo->engineThread, INFINITE);
+	CloseHandle(wrapUnitInfo->engineThread);
+#else
+	pthread_join(wrapUnitInfo->engineThread, NULL);
+#endif
+
+	wrapUnitInfo->engineThreadCreated = 0;
+	wrapUnitInfo->engineRunning = 0;
+}
+
+/****************************************************************************
+* acquireDeviceSlot
+*
+* Returns a free slot in the device registry, reusing released slots before
+* allocating a new chunk. Returns WRAP_NO_FREE_SLOT if the registry is full 
+* or cannot be grown. g_deviceSlotLock must be held by the caller.
+*
+****************************************************************************/
+static uint16_t acquireDeviceSlot(void)
+{
+	uint16_t slot = g_freeDeviceSlot;
+	uint16_t chunk = g_nextDeviceIndex / WRAP_DEVICE_SLOT_CHUNK;
+
+	if (slot != WRAP_NO_FREE_SLOT)
+	{
+		g_freeDeviceSlot = getDeviceSlot(slot)->nextFree;
+		return slot;
+	}
+
+	if (g_nextDeviceIndex == WRAP_MAX_DEVICE_SLOTS)
+	{
+		return WRAP_NO_FREE_SLOT;
+	}
+
+	if (g_deviceSlotChunks[chunk] == NULL)
+	{
+		g_deviceSlotChunks[chunk] = (WRAP_DEVICE_SLOT *) calloc(WRAP_DEVICE_SLOT_CHUNK, sizeof(WRAP_DEVICE_SLOT));
+
+		if (g_deviceSlotChunks[chunk] == NULL)
+		{
+			return WRAP_NO_FREE_SLOT;
+		}
+	}
+
+	slot = g_nextDeviceIndex;
+	g_nextDeviceIndex = g_nextDeviceIndex + 1;
+
+	return slot;
+}
+
 /****************************************************************************
-* Streaming Callback
+* getTriggerArena
 *
-* See ps3000aStreamingReady (callback)
+* Returns the trigger arena for a handle, cleared for nStructures structures
+* of structureSize bytes, allocating it the first time the handle is used.
+* The arena is grown if there are more structures than it holds.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_INVALID_PARAMETER, if nStructures is negative.
+* PICO_MEMORY_FAIL, if the arena could not be allocated or grown.
 *
 ****************************************************************************/
-void PREF1 StreamingCallback(
-    int16_t handle,
-	int32_t noOfSamples,
-	uint32_t startIndex,
-	int16_t overflow,
-	uint32_t triggerAt,
-	int16_t triggered,
-	int16_t autoStop,
-	void * pParameter)
+static PICO_STATUS getTriggerArena(int16_t handle, int16_t nStructures, size_t structureSize, void ** arena)
 {
-	int16_t channel = 0;
-	int16_t digitalPort = 0;
-	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
-	
-	if (pParameter != NULL)
+	size_t size = (size_t) nStructures * structureSize;
+	size_t arenaSize = sizeof(WRAP_TRIGGER_ARENA);
+	WRAP_TRIGGER_ARENA * newArena = NULL;
+
+	if (handle <= 0)
 	{
-		wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+		return PICO_INVALID_HANDLE;
 	}
 
-	// Assign values to structure
-	wrapUnitInfo->numSamples = noOfSamples;
-	wrapUnitInfo->autoStop = autoStop;
-	wrapUnitInfo->startIndex = startIndex;
+	if (nStructures < 0)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
 
-	wrapUnitInfo->triggered = triggered;
-	wrapUnitInfo->triggeredAt = triggerAt;
-  
-	wrapUnitInfo->overflow = overflow;
+	// The arena holds WRAP_MAX_TRIGGER_STRUCTURES of the largest structure, and is grown for more
+	if (size > arenaSize)
+	{
+		arenaSize = size;
+	}
 
-	// Verify if wrapper buffer info set and data received
-	if (wrapUnitInfo != NULL && noOfSamples)
+	if (_triggerArenaSizes[handle] < arenaSize)
 	{
-		for (channel = (int16_t) PS3000A_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+		newArena = (WRAP_TRIGGER_ARENA *) realloc(_triggerArenas[handle], arenaSize);
+
+		if (newArena == NULL)
 		{
-			// Analogue channels
-			if (wrapUnitInfo->enabledChannels[channel])
-			{
-				// Copy data...
-				if (wrapUnitInfo->appBuffers && wrapUnitInfo->driverBuffers)
-				{
-					// Max buffers
-					if (wrapUnitInfo->appBuffers[channel * 2]  && wrapUnitInfo->driverBuffers[channel * 2])
-					{
-						memcpy_s (&wrapUnitInfo->appBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t),
-							&wrapUnitInfo->driverBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t));
-					}
-
-					// Min buffers
-					if (wrapUnitInfo->appBuffers[channel * 2 + 1] && wrapUnitInfo->driverBuffers[channel * 2 + 1])
-					{
-						memcpy_s (&wrapUnitInfo->appBuffers[channel * 2 + 1][startIndex],  noOfSamples * sizeof(int16_t),
-							&wrapUnitInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-					}
-				}
-			}
+			return PICO_MEMORY_FAIL;
 		}
 
-		// Digital channels
-		if (wrapUnitInfo->digitalPortCount > 0)
+		_triggerArenas[handle] = newArena;
+		_triggerArenaSizes[handle] = arenaSize;
+	}
+
+	memset(_triggerArenas[handle], 0, size);
+	*arena = _triggerArenas[handle];
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* releaseDeviceSlot
+*
+* Removes the device held in a registry slot and returns the slot to the 
+* free list. The slot generation is incremented so that the old device index
+* is rejected, and a slot that has used every generation is retired rather 
+* than reused. g_deviceSlotLock must be held by the caller.
+*
+* Returns the WRAP_UNIT_INFO structure of the device, or NULL if the slot 
+* was free. The caller frees it with freeWrapUnitInfo once the lock has been
+* released, by which time no BlockCallback can still be using it.
+*
+****************************************************************************/
+static WRAP_UNIT_INFO * releaseDeviceSlot(uint16_t slot)
+{
+	WRAP_DEVICE_SLOT * deviceSlot = getDeviceSlot(slot);
+	WRAP_UNIT_INFO * wrapUnitInfo = deviceSlot->unitInfo;
+
+	if (wrapUnitInfo == NULL)
+	{
+		return NULL;
+	}
+
+	if (g_handleToDeviceSlot[wrapUnitInfo->handle] == slot + 1)
+	{
+		g_handleToDeviceSlot[wrapUnitInfo->handle] = 0;
+	}
+
+	deviceSlot->unitInfo = NULL;
+
+	if (deviceSlot->generation == WRAP_DEVICE_GENERATION_MASK)
+	{
+		deviceSlot->generation = WRAP_RETIRED_GENERATION;
+	}
+	else
+	{
+		deviceSlot->generation = deviceSlot->generation + 1;
+		deviceSlot->nextFree = g_freeDeviceSlot;
+		g_freeDeviceSlot = slot;
+	}
+
+	g_deviceCount = g_deviceCount - 1;
+
+	return wrapUnitInfo;
+}
+
+/****************************************************************************
+* freeWrapUnitInfo
+*
+* Stops any wrapper activity for a device removed by releaseDeviceSlot and 
+* frees its WRAP_UNIT_INFO structure. Threads waiting in WaitForStreamingData
+* or WaitForBlockReady are woken, and the structure is not freed until every
+* reference taken by acquireWrapUnitInfo has been returned.
+*
+****************************************************************************/
+static void freeWrapUnitInfo(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	if (wrapUnitInfo == NULL)
+	{
+		return;
+	}
+
+	setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->released);
+
+	lockDeviceSlots();
+
+	while (wrapUnitInfo->references > 0)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		SleepConditionVariableSRW(&g_deviceReleaseCondition, &g_deviceSlotLock, INFINITE, 0);
+#else
+		pthread_cond_wait(&g_deviceReleaseCondition, &g_deviceSlotLock);
+#endif
+	}
+
+	unlockDeviceSlots();
+
+	stopEngineThread(wrapUnitInfo);
+	freeStreamingWindows(wrapUnitInfo);
+
+	free(_triggerArenas[wrapUnitInfo->handle]);
+	_triggerArenas[wrapUnitInfo->handle] = NULL;
+	_triggerArenaSizes[wrapUnitInfo->handle] = 0;
+
+#if !defined(WIN32) && !defined(_WIN64)
+	pthread_mutex_destroy(&wrapUnitInfo->readyLock);
+	pthread_mutex_destroy(&wrapUnitInfo->windowLock);
+	pthread_cond_destroy(&wrapUnitInfo->readyCondition);
+#endif
+
+	free(wrapUnitInfo);
+}
+
+/****************************************************************************
+* AcquireStreamingWindow
+*
+* When zero-copy streaming is enabled (see setZeroCopyStreaming), hands the 
+* oldest window of data received from the driver to the application. The 
+* data can be read directly from the wrapper-owned buffers returned by 
+* getStreamingWindowBuffers, from startIndex to startIndex + numSamples - 1.
+*
+* The driver will not write into the window until the application returns it
+* with ReleaseStreamingWindow.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* windowIndex - on exit, the index of the window acquired.
+* startIndex - on exit, the index of the first valid sample in each buffer 
+*				of the window.
+* numSamples - on exit, the number of valid samples in each buffer of the 
+*				window.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds or zero-copy 
+*							streaming is not enabled.
+* PICO_NO_SAMPLES_AVAILABLE, if there is no window waiting to be read.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 AcquireStreamingWindow(uint16_t deviceIndex, uint16_t * windowIndex, uint32_t * startIndex, uint32_t * numSamples)
+{
+	uint16_t window = 0;
+	int16_t oldest = -1;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo == NULL || !wrapUnitInfo->zeroCopyEnabled)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	lockStreamingWindows(wrapUnitInfo);
+
+	for (window = 0; window < wrapUnitInfo->zeroCopyWindowCount; window++)
+	{
+		if (wrapUnitInfo->windows[window].state == WRAP_WINDOW_FILLED)
 		{
-			// Use index 0 to indicate Digital Port 0
-			for (digitalPort = (int16_t) PS3000A_WRAP_DIGITAL_PORT0; digitalPort < wrapUnitInfo->digitalPortCount; digitalPort++)
+			if (oldest < 0 || (int32_t) (wrapUnitInfo->windows[window].sequence - wrapUnitInfo->windows[oldest].sequence) < 0)
 			{
-				if (wrapUnitInfo->enabledDigitalPorts[digitalPort])
-				{
-					// Copy data...
-					if (wrapUnitInfo->appDigiBuffers && wrapUnitInfo->driverDigiBuffers)
-					{
-						// Max digital buffers
-						if (wrapUnitInfo->appDigiBuffers[digitalPort * 2]  && wrapUnitInfo->driverDigiBuffers[digitalPort * 2])
-						{	
-							memcpy_s (&wrapUnitInfo->appDigiBuffers[digitalPort * 2][startIndex], noOfSamples * sizeof(int16_t),
-								&wrapUnitInfo->driverDigiBuffers[digitalPort * 2][startIndex], noOfSamples * sizeof(int16_t));
-						}
-
-						// Min digital buffers
-						if (wrapUnitInfo->appDigiBuffers[digitalPort * 2 + 1]  && wrapUnitInfo->driverDigiBuffers[digitalPort * 2 + 1])
-						{
-							memcpy_s (&wrapUnitInfo->appDigiBuffers[digitalPort * 2 + 1][startIndex],  noOfSamples * sizeof(int16_t),
-								&wrapUnitInfo->driverDigiBuffers[digitalPort * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-						}
-					}
-				}
+				oldest = (int16_t) window;
 			}
 		}
+	}
 
+	if (oldest < 0)
+	{
+		unlockStreamingWindows(wrapUnitInfo);
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_NO_SAMPLES_AVAILABLE;
 	}
 
-	wrapUnitInfo->ready = 1;
+	wrapUnitInfo->windows[oldest].state = WRAP_WINDOW_HELD;
+
+	*windowIndex = (uint16_t) oldest;
+	*startIndex = wrapUnitInfo->windows[oldest].startIndex;
+	*numSamples = wrapUnitInfo->windows[oldest].numSamples;
+
+	unlockStreamingWindows(wrapUnitInfo);
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* BlockCallback
+* AutoStopped
 *
-* See ps3000aBlockReady (callback)
+* Indicates if the device has stopped on collection of the number of samples 
+* specified in the call to the ps3000aRunStreaming function (if the 
+* ps3000aRunStreaming function's autostop flag is set).
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+*
+* Returns:
+*
+* Zero - if streaming has not stopped or the deviceIndex is out of range.
+* Non-zero - if streaming has stopped automoatically.
 *
 ****************************************************************************/
-void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+extern int16_t PREF0 PREF1 AutoStopped(uint16_t deviceIndex)
 {
-	int16_t device_index = (int16_t) pParameter;
-	
-	g_deviceInfo[device_index].ready = 1;
-	status = PICO_OK;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	WRAP_STREAMING_RESULT result;
+	int16_t autoStop = 0;
+
+	if (wrapUnitInfo != NULL)
+	{
+		readStreamingResult(wrapUnitInfo, &result);
+
+		if ( result.ready ) 
+		{
+			autoStop = result.autoStop;
+		}
+
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return autoStop;
+}
+
+/****************************************************************************
+* Available Data
+*
+* Returns the number of samples returned from the driver and shows the start 
+* index of the data in the application buffer when collecting data in 
+* streaming mode.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* startIndex - on exit, an index to the first valid sample in the buffer 
+*				(When data is available).
+*
+* Returns:
+*
+* 0 - Data is not yet available or the device index is invalid.
+* Non-zero - the number of samples returned from the driver.
+*
+****************************************************************************/
+extern uint32_t PREF0 PREF1 AvailableData(uint16_t deviceIndex, uint32_t *startIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	WRAP_STREAMING_RESULT result;
+	uint32_t numSamples = 0;
+
+	if (wrapUnitInfo == NULL)
+	{
+		numSamples = 0;
+	}
+	else
+	{
+		readStreamingResult(wrapUnitInfo, &result);
+
+		if ( result.ready ) 
+		{
+			*startIndex = result.startIndex;
+			numSamples = result.numSamples;
+		}
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return numSamples;
+}
+
+/****************************************************************************
+* ClearTriggerReady
+*
+* Clears the triggered and triggeredAt flags in relation to streaming mode 
+* capture.
+*
+* Triggers recorded for DrainTriggerLog are not affected.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 ClearTriggerReady(uint16_t deviceIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	PICO_STATUS status = PICO_OK;
+
+	if (wrapUnitInfo != NULL)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		AcquireSRWLockExclusive(&wrapUnitInfo->readyLock);
+#else
+		pthread_mutex_lock(&wrapUnitInfo->readyLock);
+#endif
+
+		wrapUnitInfo->result.triggered = FALSE;
+		wrapUnitInfo->result.triggeredAt = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&wrapUnitInfo->readyLock);
+#else
+		pthread_mutex_unlock(&wrapUnitInfo->readyLock);
+#endif
+	}
+	else
+	{
+		status = PICO_INVALID_PARAMETER;
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return status;
+}
+
+/****************************************************************************
+* decrementDeviceCount
+*
+* Reduces the count of the number of PicoScope devices being controlled by
+* the application and releases the wrapper's record of the device. The 
+* device index is no longer valid after this call, and the registry slot 
+* will be reused by the next call to initWrapUnitInfo.
+*
+* NOTE: This function does not close the connection to the device being 
+*		controlled - use the ps3000aCloseUnit function for this.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds or has already 
+*							been released.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 decrementDeviceCount(uint16_t deviceIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+
+	lockDeviceSlots();
+
+	if (findWrapUnitInfo(deviceIndex) != NULL)
+	{
+		wrapUnitInfo = releaseDeviceSlot(deviceIndex & WRAP_DEVICE_SLOT_MASK);
+	}
+	else
+	{
+		status = PICO_INVALID_PARAMETER;
+	}
+
+	unlockDeviceSlots();
+
+	freeWrapUnitInfo(wrapUnitInfo);
 
+	return status;
 }
 
 /****************************************************************************
-* AutoStopped
+* DrainStreamingEvents
 *
-* Indicates if the device has stopped on collection of the number of samples 
-* specified in the call to the ps3000aRunStreaming function (if the 
-* ps3000aRunStreaming function's autostop flag is set).
+* Returns the records of all streaming callbacks received since the last call
+* to this function, oldest first, in a single call. Unlike AvailableData and 
+* IsTriggerReady, which only report the latest callback, no callback 
+* information is lost if the application polls slowly, provided the queue of
+* 1024 records does not fill up.
+*
+* Each record is returned as 8 consecutive values in the events array:
+*
+* [0] numSamples - the number of samples collected.
+* [1] startIndex - an index to the first valid sample in the buffer.
+* [2] triggered - non-zero if a trigger occurred.
+* [3] triggeredAt - the index of the trigger point relative to startIndex.
+* [4] overflow - overvoltage flags, bit 0 denoting channel A.
+* [5] autoStop - non-zero if streaming has autostopped.
+* [6] timestamp (low 32 bits) - host time in microseconds when the callback
+*		was received.
+* [7] timestamp (high 32 bits).
+*
+* See also ps3000aStreamingReady for a description of the callback parameters.
 *
 * Input Arguments:
 *
 * deviceIndex - the index assigned by the wrapper corresponding to the 
 *				required device.
+* events - an array of at least maxEvents * 8 elements.
+* maxEvents - the maximum number of records to return.
+* nEvents - on exit, the number of records copied into events.
+* droppedEvents - on exit, the number of records that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
 * Returns:
 *
-* Zero - if streaming has not stopped or the deviceIndex is out of range.
-* Non-zero - if streaming has stopped automoatically.
-*
+* PICO_OK, if successful
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds, or
+*						if events or nEvents is NULL
 ****************************************************************************/
-extern int16_t PREF0 PREF1 AutoStopped(uint16_t deviceIndex)
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents(uint16_t deviceIndex, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
 {
-	int16_t autoStop = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL && events != NULL && nEvents != NULL)
 	{
-		if ( g_deviceInfo[deviceIndex].ready ) 
-		{
-			autoStop = g_deviceInfo[deviceIndex].autoStop;
-		}
-
+		drainStreamingEventQueue(&wrapUnitInfo->eventQueue, events, maxEvents, nEvents, droppedEvents);
 	}
-  
-	return autoStop;
+	else
+	{
+		status = PICO_INVALID_PARAMETER;
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return status;
 }
 
 /****************************************************************************
-* Available Data
+* DrainTriggerLog
 *
-* Returns the number of samples returned from the driver and shows the start 
-* index of the data in the application buffer when collecting data in 
-* streaming mode.
+* Returns the triggers reported by the streaming callback since the last 
+* call to this function, oldest first. Every trigger is kept until it is
+* read, provided the log of 4096 records does not fill up, so unlike 
+* IsTriggerReady no trigger is lost if the application polls slowly, and 
+* ClearTriggerReady has no effect on the log.
+*
+* Each record is returned as 2 consecutive values in the triggers array:
+*
+* [0] sampleIndex - the index of the trigger point counted from the first 
+*		sample received after resetTriggerLog (or after the wrapper state 
+*		was created). It counts every sample passed to the streaming 
+*		callback (aggregated samples if aggregation is used) and does not
+*		wrap or depend on the size of the driver buffers.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received, on the same clock as the timestamps 
+*		returned by DrainStreamingEvents.
 *
 * Input Arguments:
 *
 * deviceIndex - the index assigned by the wrapper corresponding to the 
 *				required device.
-* startIndex - on exit, an index to the first valid sample in the buffer 
-*				(When data is available).
+* triggers - an array of at least maxTriggers * 2 elements.
+* maxTriggers - the maximum number of records to return.
+* nTriggers - on exit, the number of records copied into triggers.
+* droppedTriggers - on exit, the number of triggers that have been 
+*					discarded because the log was full since the last call 
+*					to this function. May be NULL.
 *
 * Returns:
 *
-* 0 - Data is not yet available or the device index is invalid.
-* Non-zero - the number of samples returned from the driver.
-*
+* PICO_OK, if successful
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds, or
+*						if triggers or nTriggers is NULL
 ****************************************************************************/
-extern uint32_t PREF0 PREF1 AvailableData(uint16_t deviceIndex, uint32_t *startIndex)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog(uint16_t deviceIndex, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, uint32_t * droppedTriggers)
 {
-	uint32_t numSamples = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex < 0 || deviceIndex >= g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL && triggers != NULL && nTriggers != NULL)
 	{
-		numSamples = 0;
+		drainTriggerLog(&wrapUnitInfo->triggerLog, triggers, maxTriggers, nTriggers, droppedTriggers);
 	}
 	else
 	{
-		if ( g_deviceInfo[deviceIndex].ready ) 
-		{
-			*startIndex = g_deviceInfo[deviceIndex].startIndex;
-			numSamples = g_deviceInfo[deviceIndex].numSamples;
-		}
+		status = PICO_INVALID_PARAMETER;
 	}
-	
-	return numSamples;
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return status;
 }
 
 /****************************************************************************
-* ClearTriggerReady
+* resetTriggerLog
 *
-* Clears the triggered and triggeredAt flags in relation to streaming mode 
-* capture.
+* Discards any triggers in the trigger log and restarts the sample count 
+* used for trigger positions from zero. Call this function before 
+* ps3000aRunStreaming, while the device is not streaming, so that trigger
+* positions are counted from the start of the capture.
 *
 * Input Arguments:
 *
@@ -230,90 +1882,198 @@ extern uint32_t PREF0 PREF1 AvailableData(uint16_t deviceIndex, uint32_t *startI
 *
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds
-*
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 ClearTriggerReady(uint16_t deviceIndex)
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog(uint16_t deviceIndex)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL)
 	{
-		g_deviceInfo[deviceIndex].triggered = FALSE;
-		g_deviceInfo[deviceIndex].triggeredAt = 0;
+		wrapUnitInfo->triggerLog.sampleCount = 0;
+		wrapUnitInfo->triggerLog.readIndex = wrapUnitInfo->triggerLog.writeIndex;
+		wrapUnitInfo->triggerLog.reportedDroppedRecords = wrapUnitInfo->triggerLog.droppedRecords;
 	}
 	else
 	{
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
 /****************************************************************************
-* decrementDeviceCount
+* getDeviceCount
 *
-* Reduces the count of the number of PicoScope devices being controlled by
-* the application.
+* Returns the number of PicoScope 3000 devices being controlled by the 
+* application.
 *
-* NOTE: This function does not close the connection to the device being 
-*		controlled - use the ps3000aCloseUnit function for this.
+* Input Arguments:
+*
+* None
+*
+* Returns:
+*
+* The number of PicoScope 3000 devices being controlled.
+*
+****************************************************************************/
+extern uint16_t PREF0 PREF1 getDeviceCount(void)
+{
+	return g_deviceCount;
+}
+
+/****************************************************************************
+* getDeviceIndexFromHandle
+*
+* Returns the index assigned by the wrapper to the device with the given 
+* handle.
 *
 * Input Arguments:
 *
-* deviceIndex - the index assigned by the wrapper corresponding to the 
-*				required device.
+* handle - the handle of the required device.
+* deviceIndex - on exit, the index assigned by initWrapUnitInfo.
 *
 * Returns:
 *
 * PICO_OK, if successful.
-* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
+* PICO_INVALID_HANDLE, if no device with this handle is registered with the
+*						wrapper.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 decrementDeviceCount(uint16_t deviceIndex)
+extern PICO_STATUS PREF0 PREF1 getDeviceIndexFromHandle(int16_t handle, uint16_t * deviceIndex)
 {
 	PICO_STATUS status = PICO_OK;
+	uint16_t slot = 0;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (handle <= 0)
 	{
-		//Reset parameters
-		g_deviceInfo[deviceIndex].handle = 0;
-		g_deviceInfo[deviceIndex].autoStop = 0;
-		g_deviceInfo[deviceIndex].channelCount = 0;
-		g_deviceInfo[deviceIndex].digitalPortCount = 0;
-		g_deviceInfo[deviceIndex].numSamples = 0;
-		g_deviceInfo[deviceIndex].overflow = 0;
-		g_deviceInfo[deviceIndex].startIndex = 0;
-		g_deviceInfo[deviceIndex].triggered = 0;
-		g_deviceInfo[deviceIndex].triggeredAt = 0;
+		return PICO_INVALID_HANDLE;
+	}
+
+	lockDeviceSlots();
 
-		g_deviceCount = g_deviceCount - 1;
+	if (g_handleToDeviceSlot[handle] == 0)
+	{
+		status = PICO_INVALID_HANDLE;
 	}
 	else
 	{
-		status = PICO_INVALID_PARAMETER;
+		slot = g_handleToDeviceSlot[handle] - 1;
+		*deviceIndex = slot | (getDeviceSlot(slot)->generation << WRAP_DEVICE_SLOT_BITS);
 	}
 
+	unlockDeviceSlots();
+
 	return status;
 }
 
 /****************************************************************************
-* getDeviceCount
+* getStreamingEngineStatus
 *
-* Returns the number of PicoScope 3000 devices being controlled by the 
-* application.
+* Returns the state of the streaming engine for a device.
 *
 * Input Arguments:
 *
-* None
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* running - on exit, non-zero if the engine thread is still collecting data.
+* engineStatus - on exit, PICO_OK while the engine is running, otherwise the
+*				status of the last driver call the engine made before it 
+*				stopped.
+* totalSamples - on exit, the number of samples received since the engine 
+*				was started.
 *
 * Returns:
 *
-* The number of PicoScope 3000 devices being controlled.
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
 *
 ****************************************************************************/
-extern uint16_t PREF0 PREF1 getDeviceCount(void)
+extern PICO_STATUS PREF0 PREF1 getStreamingEngineStatus(uint16_t deviceIndex, int16_t * running, PICO_STATUS * engineStatus, uint32_t * totalSamples)
 {
-	return g_deviceCount;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	*running = wrapUnitInfo->engineRunning;
+	*engineStatus = wrapUnitInfo->engineStatus;
+	*totalSamples = wrapUnitInfo->engineTotalSamples;
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* getStreamingWindowBuffers
+*
+* Returns pointers to the wrapper-owned buffers of a zero-copy streaming 
+* window for a channel or digital port.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* windowIndex - the index of the window (see AcquireStreamingWindow).
+* channel - the channel number (a PS3000A_CHANNEL enumeration value, 
+*			including PS3000A_DIGITAL_PORT0 and PS3000A_DIGITAL_PORT1).
+* maxBuffer - on exit, the max buffer (or the only buffer if data is not 
+*				aggregated). NULL if the channel is not enabled.
+* minBuffer - on exit, the min buffer. NULL if data is not aggregated or the 
+*				channel is not enabled. May be NULL.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex or windowIndex is out of bounds.
+* PICO_INVALID_CHANNEL, if channel is not valid.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getStreamingWindowBuffers(uint16_t deviceIndex, uint16_t windowIndex, int16_t channel, int16_t ** maxBuffer, int16_t ** minBuffer)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	int16_t digitalPort = 0;
+	int16_t ** buffers = NULL;
+	int16_t bufferIndex = 0;
+
+	if (wrapUnitInfo == NULL || windowIndex >= wrapUnitInfo->zeroCopyWindowCount)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if (channel >= PS3000A_CHANNEL_A && channel < wrapUnitInfo->channelCount)
+	{
+		buffers = wrapUnitInfo->windows[windowIndex].buffers;
+		bufferIndex = channel * 2;
+	}
+	else if (channel >= PS3000A_DIGITAL_PORT0 && channel < PS3000A_DIGITAL_PORT0 + wrapUnitInfo->digitalPortCount)
+	{
+		digitalPort = channel - PS3000A_DIGITAL_PORT0;
+		buffers = wrapUnitInfo->windows[windowIndex].digiBuffers;
+		bufferIndex = digitalPort * 2;
+	}
+	else
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_CHANNEL;
+	}
+
+	*maxBuffer = buffers[bufferIndex];
+
+	if (minBuffer != NULL)
+	{
+		*minBuffer = buffers[bufferIndex + 1];
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
@@ -331,26 +2091,33 @@ extern uint16_t PREF0 PREF1 getDeviceCount(void)
 * Returns:
 *
 * PICO_INVALID_PARAMETER, if deviceIndex is invalid.
+* PICO_BUSY, if zero-copy streaming is enabled and all windows are waiting
+*				to be read or are held by the application, or if the 
+*				streaming engine is running (see StartStreamingEngine).
 * See also ps3000aGetStreamingLatestValues return values.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(uint16_t deviceIndex)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status;
 
-	if (deviceIndex < 0 || deviceIndex >= g_nextDeviceIndex)
+	if (wrapUnitInfo == NULL)
 	{
 		status = PICO_INVALID_PARAMETER;
 	}
+	else if (wrapUnitInfo->engineRunning)
+	{
+		// The streaming engine is calling the driver for this device
+		status = PICO_BUSY;
+	}
 	else
 	{
-		g_deviceInfo[deviceIndex].ready = 0;
-		g_deviceInfo[deviceIndex].numSamples = 0;
-		g_deviceInfo[deviceIndex].autoStop = 0;
-
-		status = ps3000aGetStreamingLatestValues(g_deviceInfo[deviceIndex].handle, StreamingCallback, &g_deviceInfo[deviceIndex]);
+		status = getLatestValues(wrapUnitInfo);
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -358,24 +2125,26 @@ extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(uint16_t deviceIndex)
 * initWrapUnitInfo
 *
 * This function initialises a WRAP_UNIT_INFO structure for a PicoScope 3000
-* series device and places it in the g_deviceInfo array at the next 
-* available index.
+* series device and stores it in the device registry, reusing a slot 
+* released by decrementDeviceCount where possible.
 *
-* A maximum of 4 devices can be supported by the wrapper.
+* The registry grows as required, up to 1024 devices. The indices returned 
+* for the first 4 devices opened are 0 to 3. If a record already exists for
+* the handle, it is released and a new index is returned.
 *
-* The user's main application should map the handle to the index starting
-* with the first handle corresponding to index 0.
+* Use getDeviceIndexFromHandle to look up the index for a handle.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* deviceIndex - on exit, the index at which the WRAP_UNIT_INFO structure will 
-*				be stored in the g_deviceInfo array.
+* deviceIndex - on exit, the index assigned to the device. This must be 
+*				passed to the other wrapper functions for this device.
 *
 * Returns:
 *
 * PICO_OK, if successful.
 * PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_MEMORY_FAIL, if the WRAP_UNIT_INFO structure could not be allocated.
 * PICO_MAX_UNITS_OPENED, if the wrapper already has records for the maximum
 *						number of devices that it will support.
 *
@@ -383,31 +2152,69 @@ extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(uint16_t deviceIndex)
 extern PICO_STATUS PREF0 PREF1 initWrapUnitInfo(int16_t handle, uint16_t * deviceIndex)
 {
 	PICO_STATUS status = PICO_OK;
-	struct tWrapUnitInfo wrapUnitInfo;
-	uint16_t devIndex = g_nextDeviceIndex;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	uint16_t slot = 0;
 
 	if (handle <= 0)
 	{
-		status = PICO_INVALID_HANDLE;
+		return PICO_INVALID_HANDLE;
+	}
+
+	// The driver reuses handles, so discard any record left by a device that was not released
+	lockDeviceSlots();
+
+	if (g_handleToDeviceSlot[handle] != 0)
+	{
+		wrapUnitInfo = releaseDeviceSlot(g_handleToDeviceSlot[handle] - 1);
+	}
+
+	unlockDeviceSlots();
+
+	freeWrapUnitInfo(wrapUnitInfo);
+
+	wrapUnitInfo = (WRAP_UNIT_INFO *) calloc(1, sizeof(WRAP_UNIT_INFO));
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_MEMORY_FAIL;
 	}
-	else if (devIndex == WRAP_MAX_PICO_DEVICES)
+
+	wrapUnitInfo->handle = handle;
+	wrapUnitInfo->currentWindow = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+	InitializeSRWLock(&wrapUnitInfo->readyLock);
+	InitializeSRWLock(&wrapUnitInfo->windowLock);
+	InitializeConditionVariable(&wrapUnitInfo->readyCondition);
+#else
+	pthread_mutex_init(&wrapUnitInfo->readyLock, NULL);
+	pthread_mutex_init(&wrapUnitInfo->windowLock, NULL);
+	initMonotonicCondition(&wrapUnitInfo->readyCondition);
+#endif
+
+	lockDeviceSlots();
+
+	if ((slot = acquireDeviceSlot()) == WRAP_NO_FREE_SLOT)
 	{
 		status = PICO_MAX_UNITS_OPENED;
 	}
 	else
 	{
-		// Initialise struct
-		memset(&wrapUnitInfo, 0, sizeof(WRAP_UNIT_INFO));
+		getDeviceSlot(slot)->unitInfo = wrapUnitInfo;
+		g_handleToDeviceSlot[handle] = slot + 1;
 
-		wrapUnitInfo.handle = handle;
-		g_deviceInfo[devIndex] = wrapUnitInfo;
-
-		*deviceIndex = devIndex;
+		*deviceIndex = slot | (getDeviceSlot(slot)->generation << WRAP_DEVICE_SLOT_BITS);
 		
-		g_nextDeviceIndex = g_nextDeviceIndex + 1;
 		g_deviceCount = g_deviceCount + 1;		
 	}
 
+	unlockDeviceSlots();
+
+	if (status != PICO_OK)
+	{
+		freeWrapUnitInfo(wrapUnitInfo);
+	}
+
 	return status;
 }
 
@@ -431,13 +2238,18 @@ extern PICO_STATUS PREF0 PREF1 initWrapUnitInfo(int16_t handle, uint16_t * devic
 ****************************************************************************/
 extern int16_t PREF0 PREF1 IsReady(uint16_t deviceIndex)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	WRAP_STREAMING_RESULT result;
 	int16_t ready = 0;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL)
 	{
-		ready = g_deviceInfo[deviceIndex].ready;
+		readStreamingResult(wrapUnitInfo, &result);
+		ready = result.ready;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return ready;
 }
 
@@ -463,21 +2275,204 @@ extern int16_t PREF0 PREF1 IsReady(uint16_t deviceIndex)
 ****************************************************************************/
 extern int16_t PREF0 PREF1 IsTriggerReady(uint16_t deviceIndex, uint32_t *triggeredAt)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	WRAP_STREAMING_RESULT result;
 	int16_t triggered = 0;
 	*triggeredAt = 0;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL)
 	{
-		if (g_deviceInfo[deviceIndex].triggered)
+		readStreamingResult(wrapUnitInfo, &result);
+
+		if (result.triggered)
 		{
-			triggered = g_deviceInfo[deviceIndex].triggered;
-			*triggeredAt = g_deviceInfo[deviceIndex].triggeredAt;
+			triggered = result.triggered;
+			*triggeredAt = result.triggeredAt;
 		}
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return triggered;
 }
 
+/****************************************************************************
+* PollAllDevices
+*
+* Services every device registered with initWrapUnitInfo in one call, for 
+* applications that would otherwise call GetStreamingLatestValues, IsReady,
+* AvailableData and AutoStopped for each device in turn. The driver is 
+* called for each device as by GetStreamingLatestValues, and the results are
+* written to the output arrays at the same position for each device, in 
+* order of device index.
+*
+* Each output array must have at least maxDevices elements.
+*
+* Input Arguments:
+*
+* maxDevices - the number of elements in each output array. This must be at
+*				least the number of registered devices (see getDeviceCount).
+* nDevices - on exit, the number of devices polled.
+* deviceIndices - on exit, the device index of each device polled.
+* statuses - on exit, the status returned for each device, as for 
+*				GetStreamingLatestValues. PICO_BUSY is returned without 
+*				calling the driver if the streaming engine is running for 
+*				the device (see StartStreamingEngine), and 
+*				PICO_INVALID_PARAMETER if the device was released by 
+*				another thread before it could be polled. A device that is
+*				released while it is being polled is not freed until its 
+*				results have been written.
+* readyFlags - on exit, the value that IsReady would return for each device.
+* counts - on exit, the value that AvailableData would return for each 
+*				device (0 if data is not ready).
+* startIndices - on exit, the start index of the data for each device that
+*				is ready, otherwise 0.
+* autoStopped - on exit, the value that AutoStopped would return for each 
+*				device. May be NULL.
+*
+* Returns:
+*
+* PICO_OK, if successful. The status for each device is in statuses.
+* PICO_INVALID_PARAMETER, if an output array other than autoStopped is NULL,
+*							or maxDevices is less than the number of 
+*							registered devices. No devices are polled.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 PollAllDevices(uint16_t maxDevices, uint16_t * nDevices, uint16_t * deviceIndices, PICO_STATUS * statuses, 
+	int16_t * readyFlags, uint32_t * counts, uint32_t * startIndices, int16_t * autoStopped)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_RESULT result;
+	uint16_t slot = 0;
+	uint16_t device = 0;
+	uint16_t nPolled = 0;
+
+	if (nDevices == NULL || deviceIndices == NULL || statuses == NULL || readyFlags == NULL || counts == NULL || startIndices == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	*nDevices = 0;
+
+	lockDeviceSlots();
+
+	if (g_deviceCount > maxDevices)
+	{
+		unlockDeviceSlots();
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// Take the indices under the lock, but poll the driver without it
+	for (slot = 0; slot < g_nextDeviceIndex; slot++)
+	{
+		if (getDeviceSlot(slot)->unitInfo != NULL)
+		{
+			deviceIndices[device++] = slot | (getDeviceSlot(slot)->generation << WRAP_DEVICE_SLOT_BITS);
+		}
+	}
+
+	unlockDeviceSlots();
+
+	nPolled = device;
+
+	for (device = 0; device < nPolled; device++)
+	{
+		wrapUnitInfo = acquireWrapUnitInfo(deviceIndices[device]);
+
+		if (wrapUnitInfo == NULL)
+		{
+			// Released by another thread since the indices were taken
+			statuses[device] = PICO_INVALID_PARAMETER;
+			readyFlags[device] = 0;
+			counts[device] = 0;
+			startIndices[device] = 0;
+
+			if (autoStopped != NULL)
+			{
+				autoStopped[device] = 0;
+			}
+
+			continue;
+		}
+
+		if (wrapUnitInfo->engineRunning)
+		{
+			// The streaming engine is calling the driver for this device
+			statuses[device] = PICO_BUSY;
+		}
+		else
+		{
+			statuses[device] = getLatestValues(wrapUnitInfo);
+		}
+
+		readStreamingResult(wrapUnitInfo, &result);
+
+		readyFlags[device] = result.ready;
+		counts[device] = result.ready ? (uint32_t) result.numSamples : 0;
+		startIndices[device] = result.ready ? result.startIndex : 0;
+
+		if (autoStopped != NULL)
+		{
+			autoStopped[device] = result.ready ? result.autoStop : 0;
+		}
+
+		releaseWrapUnitInfo(wrapUnitInfo);
+	}
+
+	*nDevices = nPolled;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* ReleaseStreamingWindow
+*
+* Returns a zero-copy streaming window acquired with AcquireStreamingWindow 
+* to the wrapper, so that it can be registered with the driver again. The 
+* application must not access the window's buffers after this call.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* windowIndex - the index of the window to release.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex or windowIndex is out of bounds, or
+*							the window is not held by the application.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 ReleaseStreamingWindow(uint16_t deviceIndex, uint16_t windowIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo == NULL || windowIndex >= wrapUnitInfo->zeroCopyWindowCount)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// Releasing the lock also makes sure the application's reads complete before the window can be reused
+	lockStreamingWindows(wrapUnitInfo);
+
+	if (wrapUnitInfo->windows[windowIndex].state != WRAP_WINDOW_HELD)
+	{
+		unlockStreamingWindows(wrapUnitInfo);
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	wrapUnitInfo->windows[windowIndex].state = WRAP_WINDOW_FREE;
+
+	unlockStreamingWindows(wrapUnitInfo);
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
+}
+
 /****************************************************************************
 * RunBlock
 *
@@ -503,22 +2498,24 @@ extern int16_t PREF0 PREF1 IsTriggerReady(uint16_t deviceIndex, uint32_t *trigge
 extern PICO_STATUS PREF0 PREF1 RunBlock(uint16_t deviceIndex, int32_t preTriggerSamples, int32_t postTriggerSamples,
             uint32_t timebase, uint32_t segmentIndex)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 	int16_t oversample = 1;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL)
 	{
-		g_deviceInfo[deviceIndex].ready = 0;
-		g_deviceInfo[deviceIndex].numSamples = preTriggerSamples + postTriggerSamples;
+		resetStreamingResult(wrapUnitInfo, preTriggerSamples + postTriggerSamples);
 
-		status = ps3000aRunBlock(g_deviceInfo[deviceIndex].handle, preTriggerSamples, postTriggerSamples, timebase, oversample, 
-						NULL, segmentIndex, BlockCallback, (void *) deviceIndex);
+		status = ps3000aRunBlock(wrapUnitInfo->handle, preTriggerSamples, postTriggerSamples, timebase, oversample, 
+						NULL, segmentIndex, BlockCallback, (void *) (uintptr_t) deviceIndex);
 	}
 	else
 	{
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -545,19 +2542,30 @@ extern PICO_STATUS PREF0 PREF1 RunBlock(uint16_t deviceIndex, int32_t preTrigger
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
 * PICO_INVALID_CHANNEL, if channel is not valid.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(uint16_t deviceIndex, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
-		if (channel >= PS3000A_CHANNEL_A && channel < g_deviceInfo[deviceIndex].channelCount)
+		if (channel >= PS3000A_CHANNEL_A && channel < wrapUnitInfo->channelCount)
 		{
-			g_deviceInfo[deviceIndex].appBuffers[channel * 2] = appBuffer;
-			g_deviceInfo[deviceIndex].driverBuffers[channel * 2] = driverBuffer;
+			wrapUnitInfo->appBuffers[channel * 2] = appBuffer;
+			wrapUnitInfo->driverBuffers[channel * 2] = driverBuffer;
 				
-			g_deviceInfo[deviceIndex].bufferLengths[channel] = bufferLength;
+			wrapUnitInfo->bufferLengths[channel] = bufferLength;
+
+			updateCopyPlan(wrapUnitInfo);
 		}
 		else
 		{
@@ -569,6 +2577,8 @@ extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(uint16_t deviceIndex, int1
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -598,22 +2608,33 @@ extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(uint16_t deviceIndex, int1
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
 * PICO_INVALID_CHANNEL, if channel is not valid.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(uint16_t deviceIndex, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
-		if (channel >= PS3000A_CHANNEL_A && channel < g_deviceInfo[deviceIndex].channelCount)
+		if (channel >= PS3000A_CHANNEL_A && channel < wrapUnitInfo->channelCount)
 		{
-			g_deviceInfo[deviceIndex].appBuffers[channel * 2] = appMaxBuffer;
-			g_deviceInfo[deviceIndex].driverBuffers[channel * 2] = driverMaxBuffer;
+			wrapUnitInfo->appBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->driverBuffers[channel * 2] = driverMaxBuffer;
 
-			g_deviceInfo[deviceIndex].appBuffers[channel * 2 + 1] = appMinBuffer;
-			g_deviceInfo[deviceIndex].driverBuffers[channel * 2 + 1] = driverMinBuffer;
+			wrapUnitInfo->appBuffers[channel * 2 + 1] = appMinBuffer;
+			wrapUnitInfo->driverBuffers[channel * 2 + 1] = driverMinBuffer;
 
-			g_deviceInfo[deviceIndex].bufferLengths[channel] = bufferLength;
+			wrapUnitInfo->bufferLengths[channel] = bufferLength;
+
+			updateCopyPlan(wrapUnitInfo);
 		}
 		else
 		{
@@ -625,6 +2646,8 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(uint16_t deviceIndex
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -652,19 +2675,30 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(uint16_t deviceIndex
 * PICO_OK, if successful.
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
 * PICO_INVALID_DIGITAL_PORT, if digiPort is not 0 (Port 0) or 1 (Port 1).
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setAppAndDriverDigiBuffers(uint16_t deviceIndex, int16_t digiPort, int16_t * appDigiBuffer, int16_t * driverDigiBuffer, int32_t bufferLength)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
 		if (digiPort == PS3000A_WRAP_DIGITAL_PORT0 || digiPort == PS3000A_WRAP_DIGITAL_PORT1)
 		{
-			g_deviceInfo[deviceIndex].appDigiBuffers[digiPort * 2] = appDigiBuffer;
-			g_deviceInfo[deviceIndex].driverDigiBuffers[digiPort * 2] = driverDigiBuffer;
+			wrapUnitInfo->appDigiBuffers[digiPort * 2] = appDigiBuffer;
+			wrapUnitInfo->driverDigiBuffers[digiPort * 2] = driverDigiBuffer;
 				
-			g_deviceInfo[deviceIndex].digiBufferLengths[digiPort] = bufferLength;
+			wrapUnitInfo->digiBufferLengths[digiPort] = bufferLength;
+
+			updateCopyPlan(wrapUnitInfo);
 		}
 		else
 		{
@@ -676,6 +2710,8 @@ extern PICO_STATUS PREF0 PREF1 setAppAndDriverDigiBuffers(uint16_t deviceIndex,
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -706,22 +2742,33 @@ extern PICO_STATUS PREF0 PREF1 setAppAndDriverDigiBuffers(uint16_t deviceIndex,
 * PICO_OK, if successful.
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
 * PICO_INVALID_DIGITAL_PORT, if digiPort is not 0 (Port 0) or 1 (Port 1).
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverDigiBuffers(uint16_t deviceIndex, int16_t digiPort, int16_t * appMaxDigiBuffer, int16_t * appMinDigiBuffer, int16_t * driverMaxDigiBuffer, int16_t * driverMinDigiBuffer, int32_t bufferLength)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
 		if (digiPort == PS3000A_WRAP_DIGITAL_PORT0 || digiPort == PS3000A_WRAP_DIGITAL_PORT1)
 		{
-			g_deviceInfo[deviceIndex].appDigiBuffers[digiPort * 2] = appMaxDigiBuffer;
-			g_deviceInfo[deviceIndex].driverDigiBuffers[digiPort * 2] = driverMaxDigiBuffer;
+			wrapUnitInfo->appDigiBuffers[digiPort * 2] = appMaxDigiBuffer;
+			wrapUnitInfo->driverDigiBuffers[digiPort * 2] = driverMaxDigiBuffer;
 
-			g_deviceInfo[deviceIndex].appDigiBuffers[digiPort * 2 + 1] = appMinDigiBuffer;
-			g_deviceInfo[deviceIndex].driverDigiBuffers[digiPort * 2 + 1] = driverMinDigiBuffer;
+			wrapUnitInfo->appDigiBuffers[digiPort * 2 + 1] = appMinDigiBuffer;
+			wrapUnitInfo->driverDigiBuffers[digiPort * 2 + 1] = driverMinDigiBuffer;
 
-			g_deviceInfo[deviceIndex].digiBufferLengths[digiPort] = bufferLength;
+			wrapUnitInfo->digiBufferLengths[digiPort] = bufferLength;
+
+			updateCopyPlan(wrapUnitInfo);
 		}
 		else
 		{
@@ -733,6 +2780,8 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverDigiBuffers(uint16_t deviceI
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -755,16 +2804,27 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverDigiBuffers(uint16_t deviceI
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds or channelCount
 *							is not 2 or 4.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setChannelCount(uint16_t deviceIndex, int16_t channelCount)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
 		if (channelCount == DUAL_SCOPE || channelCount == PS3000A_MAX_CHANNELS)
 		{
-			g_deviceInfo[deviceIndex].channelCount = channelCount;
+			wrapUnitInfo->channelCount = channelCount;
+
+			updateCopyPlan(wrapUnitInfo);
 
 			status = PICO_OK;
 		}
@@ -778,6 +2838,8 @@ extern PICO_STATUS PREF0 PREF1 setChannelCount(uint16_t deviceIndex, int16_t cha
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -791,7 +2853,7 @@ extern PICO_STATUS PREF0 PREF1 setChannelCount(uint16_t deviceIndex, int16_t cha
 *
 * Input Arguments:
 *
-* deviceIndex - the index in the g_deviceInfo array corresponding to the
+* deviceIndex - the index assigned by the wrapper corresponding to the
 *				required device.
 * enabledChannels - an array representing the channel states. This must be 
 *					4 elements in size.
@@ -801,18 +2863,29 @@ extern PICO_STATUS PREF0 PREF1 setChannelCount(uint16_t deviceIndex, int16_t cha
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, deviceIndex is out of bounds or channelCount
 *							is not 2 or 4.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setEnabledChannels(uint16_t deviceIndex, int16_t * enabledChannels)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
-		if (g_deviceInfo[deviceIndex].channelCount == DUAL_SCOPE || g_deviceInfo[deviceIndex].channelCount == PS3000A_MAX_CHANNELS)
+		if (wrapUnitInfo->channelCount == DUAL_SCOPE || wrapUnitInfo->channelCount == PS3000A_MAX_CHANNELS)
 		{
-			memcpy_s((int16_t *) g_deviceInfo[deviceIndex].enabledChannels, PS3000A_MAX_CHANNELS * sizeof(int16_t), 
+			memcpy_s((int16_t *) wrapUnitInfo->enabledChannels, PS3000A_MAX_CHANNELS * sizeof(int16_t), 
 				(int16_t *) enabledChannels, PS3000A_MAX_CHANNELS * sizeof(int16_t));
 
+			updateCopyPlan(wrapUnitInfo);
+
 			status = PICO_OK;
 		}
 		else
@@ -825,6 +2898,8 @@ extern PICO_STATUS PREF0 PREF1 setEnabledChannels(uint16_t deviceIndex, int16_t
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -849,16 +2924,27 @@ extern PICO_STATUS PREF0 PREF1 setEnabledChannels(uint16_t deviceIndex, int16_t
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, deviceIndex is out of bounds or digitalPortCount
 							is invalid.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setDigitalPortCount(uint16_t deviceIndex, int16_t digitalPortCount)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	if (wrapUnitInfo != NULL)
 	{
 		if (digitalPortCount == 0 || digitalPortCount == DUAL_PORT_MSO || digitalPortCount == PS3000A_MAX_DIGITAL_PORTS)
 		{
-			g_deviceInfo[deviceIndex].digitalPortCount = digitalPortCount;
+			wrapUnitInfo->digitalPortCount = digitalPortCount;
+
+			updateCopyPlan(wrapUnitInfo);
 
 			status = PICO_OK;
 		}
@@ -872,6 +2958,8 @@ extern PICO_STATUS PREF0 PREF1 setDigitalPortCount(uint16_t deviceIndex, int16_t
 		status = PICO_INVALID_PARAMETER;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -886,7 +2974,7 @@ extern PICO_STATUS PREF0 PREF1 setDigitalPortCount(uint16_t deviceIndex, int16_t
 *
 * Input Arguments:
 *
-* deviceIndex - the index in the g_deviceInfo array corresponding to the
+* deviceIndex - the index assigned by the wrapper corresponding to the
 *				required device.
 * enabledDigitalPorts - an array representing the digital port states. This 
 *						must be 4 elements in size.
@@ -896,20 +2984,30 @@ extern PICO_STATUS PREF0 PREF1 setDigitalPortCount(uint16_t deviceIndex, int16_t
 * PICO_OK, if successful
 * PICO_INVALID_PARAMETER, if deviceIndex is out of bounds, or 
 *							digitalPortCount is invalid.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine).
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(uint16_t deviceIndex, int16_t * enabledDigitalPorts)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
 	PICO_STATUS status = PICO_OK;
 
-	int16_t digiPortCount = g_deviceInfo[deviceIndex].digitalPortCount;
+	int16_t digiPortCount = wrapUnitInfo->digitalPortCount;
+
+	// The streaming engine thread reads the copy plan without a lock
+	if (wrapUnitInfo != NULL && wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
 
-	if (deviceIndex >= 0 && deviceIndex < g_nextDeviceIndex)
+	if (wrapUnitInfo != NULL)
 	{
 		if (digiPortCount == 0 || digiPortCount == DUAL_PORT_MSO || digiPortCount == PS3000A_MAX_DIGITAL_PORTS)
 		{
-			memcpy_s((int16_t *) g_deviceInfo[deviceIndex].enabledDigitalPorts, PS3000A_MAX_DIGITAL_PORTS * sizeof(int16_t), 
+			memcpy_s((int16_t *) wrapUnitInfo->enabledDigitalPorts, PS3000A_MAX_DIGITAL_PORTS * sizeof(int16_t), 
 				(int16_t *) enabledDigitalPorts, PS3000A_MAX_DIGITAL_PORTS * sizeof(int16_t));
 
+			updateCopyPlan(wrapUnitInfo);
 		}
 		else
 		{
@@ -921,6 +3019,145 @@ extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(uint16_t deviceIndex, int1
 		status = PICO_INVALID_HANDLE;
 	}
 
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return status;
+}
+
+/****************************************************************************
+* setZeroCopyStreaming
+*
+* Enables or disables zero-copy streaming. Instead of copying the data from 
+* the driver buffers into application buffers in the streaming callback, the
+* wrapper allocates nWindows page-aligned sets of buffers for the enabled 
+* channels and digital ports and registers them with the driver in turn. 
+* Each call to GetStreamingLatestValues that returns data fills one window,
+* which the application then reads in place using AcquireStreamingWindow, 
+* getStreamingWindowBuffers and ReleaseStreamingWindow.
+*
+* A window held by the application is never registered with the driver. If 
+* all windows are filled or held, GetStreamingLatestValues returns PICO_BUSY
+* until the application releases a window.
+*
+* setChannelCount, setEnabledChannels and (for MSO models) 
+* setDigitalPortCount and setEnabledDigitalPorts must be called before this 
+* function, and this function must be called before ps3000aRunStreaming. 
+* Call with enable set to 0 after ps3000aStop to free the buffers. The 
+* windows cannot be changed while the streaming engine is running or the 
+* application holds a window.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* enable - 1 to enable zero-copy streaming, 0 to disable it.
+* bufferLength - the length of each buffer in a window, in samples. See 
+*				bufferLth in ps3000aSetDataBuffers.
+* nWindows - the number of windows (2 to WRAP_MAX_STREAMING_WINDOWS).
+* downSampleRatioMode - the downsampling mode that will be passed to 
+*				ps3000aRunStreaming. Min buffers are only allocated for 
+*				PS3000A_RATIO_MODE_AGGREGATE.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds, or bufferLength 
+*							or nWindows is invalid.
+* PICO_MEMORY, if the buffers could not be allocated.
+* PICO_BUSY, if the streaming engine is running (see StartStreamingEngine) or
+*				the application holds a window.
+* See also ps3000aSetDataBuffers return values.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setZeroCopyStreaming(uint16_t deviceIndex, int16_t enable, uint32_t bufferLength, uint16_t nWindows, int32_t downSampleRatioMode)
+{
+	PICO_STATUS status = PICO_OK;
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	uint16_t window = 0;
+	int16_t channel = 0;
+	int16_t digitalPort = 0;
+	int16_t buffersPerChannel = 1;
+	int16_t i = 0;
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// The engine registers the windows with the driver, and the application reads held windows in place
+	if (wrapUnitInfo->engineRunning || isStreamingWindowHeld(wrapUnitInfo))
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	freeStreamingWindows(wrapUnitInfo);
+
+	if (!enable)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_OK;
+	}
+
+	if (bufferLength == 0 || nWindows < 2 || nWindows > WRAP_MAX_STREAMING_WINDOWS)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	wrapUnitInfo->zeroCopyAggregate = (downSampleRatioMode == PS3000A_RATIO_MODE_AGGREGATE);
+	buffersPerChannel = wrapUnitInfo->zeroCopyAggregate ? 2 : 1;
+
+	for (window = 0; window < nWindows && status == PICO_OK; window++)
+	{
+		for (channel = (int16_t) PS3000A_CHANNEL_A; channel < wrapUnitInfo->channelCount && status == PICO_OK; channel++)
+		{
+			for (i = 0; i < buffersPerChannel && wrapUnitInfo->enabledChannels[channel]; i++)
+			{
+				wrapUnitInfo->windows[window].buffers[channel * 2 + i] = allocateWindowBuffer(bufferLength);
+
+				if (wrapUnitInfo->windows[window].buffers[channel * 2 + i] == NULL)
+				{
+					status = PICO_MEMORY;
+					break;
+				}
+			}
+		}
+
+		for (digitalPort = (int16_t) PS3000A_WRAP_DIGITAL_PORT0; digitalPort < wrapUnitInfo->digitalPortCount && status == PICO_OK; digitalPort++)
+		{
+			for (i = 0; i < buffersPerChannel && wrapUnitInfo->enabledDigitalPorts[digitalPort]; i++)
+			{
+				wrapUnitInfo->windows[window].digiBuffers[digitalPort * 2 + i] = allocateWindowBuffer(bufferLength);
+
+				if (wrapUnitInfo->windows[window].digiBuffers[digitalPort * 2 + i] == NULL)
+				{
+					status = PICO_MEMORY;
+					break;
+				}
+			}
+		}
+
+		wrapUnitInfo->windows[window].state = WRAP_WINDOW_FREE;
+	}
+
+	if (status == PICO_OK)
+	{
+		wrapUnitInfo->zeroCopyBufferLength = bufferLength;
+		wrapUnitInfo->zeroCopyWindowCount = nWindows;
+		wrapUnitInfo->nextWindowSequence = 0;
+		wrapUnitInfo->zeroCopyEnabled = 1;
+
+		// The driver requires buffers to be registered before ps3000aRunStreaming is called
+		status = registerStreamingWindow(wrapUnitInfo, 0);
+	}
+
+	if (status != PICO_OK)
+	{
+		freeStreamingWindows(wrapUnitInfo);
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
 	return status;
 }
 
@@ -945,6 +3182,8 @@ extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(uint16_t deviceIndex, int1
 * nConditions - the number that will be passed after the wrapper code has 
 *				created its structures. (i.e. the number of 
 *				pwqConditionsArray elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
 * direction - the direction of the signal required for the pulse width
 *				trigger to fire (see PS3000A_THRESHOLD_DIRECTION enumerations).
 * lower - the lower limit of the pulse-width counter, measured in samples.
@@ -954,19 +3193,28 @@ extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(uint16_t deviceIndex, int1
 * Returns:
 *
 * See ps3000aSetPulseWidthQualifier return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(int16_t handle, uint32_t *pwqConditionsArray, int16_t nConditions,
 																			uint32_t direction, uint32_t lower, uint32_t upper, uint32_t type)
 {
-	// Allocate memory
-	PS3000A_PWQ_CONDITIONS *pwqConditions = (PS3000A_PWQ_CONDITIONS *) calloc(nConditions, sizeof(PS3000A_PWQ_CONDITIONS));
+	PS3000A_PWQ_CONDITIONS * pwqConditions = NULL;
 
 	int16_t i;
 	int16_t j = 0;
 
 	PICO_STATUS status;
 
+	status = getTriggerArena(handle, nConditions, sizeof(PS3000A_PWQ_CONDITIONS), (void **) &pwqConditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
 	for (i = 0; i < nConditions; i++)
 	{
 		pwqConditions[i].channelA = (PS3000A_TRIGGER_STATE) pwqConditionsArray[j];
@@ -980,7 +3228,6 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(int16_t handle, uint32_t *
 	}
 
 	status = ps3000aSetPulseWidthQualifier(handle, pwqConditions, nConditions, (PS3000A_THRESHOLD_DIRECTION) direction, lower, upper, (PS3000A_PULSE_WIDTH_TYPE) type);
-	free(pwqConditions);
 	return status;
 }
 
@@ -1004,6 +3251,8 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(int16_t handle, uint32_t *
 * nConditions - the number that will be passed after the wrapper code has 
 *				created its structures. (i.e. the number of 
 *				pwqConditionsArray elements / 7)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
 * direction - the direction of the signal required for the pulse width
 *				trigger to fire (see PS3000A_THRESHOLD_DIRECTION enumerations).
 * lower - the lower limit of the pulse-width counter, measured in samples.
@@ -1013,20 +3262,29 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(int16_t handle, uint32_t *
 * Returns:
 *
 * See ps3000aSetPulseWidthQualifier return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierV2( int16_t handle, uint32_t *pwqConditionsArrayV2,
 																				int16_t nConditions, uint32_t direction, uint32_t lower,
 																				uint32_t upper, uint32_t type)
 {
-	// Allocate memory
-	PS3000A_PWQ_CONDITIONS_V2 *pwqConditionsV2 = (PS3000A_PWQ_CONDITIONS_V2 *) calloc(nConditions, sizeof(PS3000A_PWQ_CONDITIONS_V2));
+	PS3000A_PWQ_CONDITIONS_V2 * pwqConditionsV2 = NULL;
 
 	int16_t i;
 	int16_t j = 0;
 
 	PICO_STATUS status;
 
+	status = getTriggerArena(handle, nConditions, sizeof(PS3000A_PWQ_CONDITIONS_V2), (void **) &pwqConditionsV2);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
 	for (i = 0; i < nConditions; i++)
 	{
 		pwqConditionsV2[i].channelA = (PS3000A_TRIGGER_STATE) pwqConditionsArrayV2[j];
@@ -1041,7 +3299,6 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierV2( int16_t handle, uint32_
 	}
 
 	status = ps3000aSetPulseWidthQualifierV2(handle, pwqConditionsV2, nConditions, (PS3000A_THRESHOLD_DIRECTION) direction, lower, upper, (PS3000A_PULSE_WIDTH_TYPE) type);
-	free(pwqConditionsV2);
 	return status;
 }
 
@@ -1064,10 +3321,15 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierV2( int16_t handle, uint32_
 * nConditions - the number that will be passed after the wrapper code has 
 *				created its structures. (i.e. the number of conditionsArray 
 *				elements / 7)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
 *
 * Returns:
 *
 * See ps3000aSetTriggerChannelConditions return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, uint32_t *conditionsArray, int16_t nConditions)
@@ -1076,7 +3338,14 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, uint32_t *co
 	int16_t i = 0;
 	int16_t j = 0;
 
-	PS3000A_TRIGGER_CONDITIONS *conditions = (PS3000A_TRIGGER_CONDITIONS *) calloc (nConditions, sizeof(PS3000A_TRIGGER_CONDITIONS));
+	PS3000A_TRIGGER_CONDITIONS * conditions = NULL;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS3000A_TRIGGER_CONDITIONS), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
 	for (i = 0; i < nConditions; i++)
 	{
@@ -1091,7 +3360,6 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, uint32_t *co
 		j = j + 7;
 	}
 	status = ps3000aSetTriggerChannelConditions(handle, conditions, nConditions);
-	free (conditions);
 
 	return status;
 }
@@ -1114,10 +3382,15 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, uint32_t *co
 * nConditions - the number that will be passed after the wrapper code has 
 *				created its structures. (i.e. the number of conditionsArray 
 *				elements / 8)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
 *
 * Returns:
 *
 * See ps3000aSetTriggerChannelConditionsV2 return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, uint32_t *conditionsArrayV2, int16_t nConditions)
@@ -1126,7 +3399,14 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, uint32_t *
 	int16_t i = 0;
 	int16_t j = 0;
 
-	PS3000A_TRIGGER_CONDITIONS_V2 *conditions = (PS3000A_TRIGGER_CONDITIONS_V2 *) calloc (nConditions, sizeof(PS3000A_TRIGGER_CONDITIONS_V2));
+	PS3000A_TRIGGER_CONDITIONS_V2 * conditions = NULL;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS3000A_TRIGGER_CONDITIONS_V2), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
 	for (i = 0; i < nConditions; i++)
 	{
@@ -1142,7 +3422,6 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, uint32_t *
 		j = j + 8;
 	}
 	status = ps3000aSetTriggerChannelConditionsV2(handle, conditions, nConditions);
-	free (conditions);
 
 	return status;
 }
@@ -1169,22 +3448,34 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, uint32_t *
 * nProperties - the number that will be passed after the wrapper code has 
 *				created its structures. (i.e. the number of propertiesArray 
 *				elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
 * autoTrig - see autoTriggerMilliseconds in ps3000aSetTriggerChannelProperties.
 *
 *
 * Returns:
 *
 * See ps3000aSetTriggerChannelProperties return values.
+* PICO_INVALID_PARAMETER, if nProperties is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(int16_t handle, uint32_t *propertiesArray, int16_t nProperties, int32_t autoTrig)
 {
-	PS3000A_TRIGGER_CHANNEL_PROPERTIES *channelProperties = (PS3000A_TRIGGER_CHANNEL_PROPERTIES *) calloc(nProperties, sizeof(PS3000A_TRIGGER_CHANNEL_PROPERTIES));
+	PS3000A_TRIGGER_CHANNEL_PROPERTIES * channelProperties = NULL;
 	int16_t i;
 	int16_t j = 0;
 	PICO_STATUS status;
 	int16_t auxEnable = 0;
 	
+	status = getTriggerArena(handle, nProperties, sizeof(PS3000A_TRIGGER_CHANNEL_PROPERTIES), (void **) &channelProperties);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
 	for (i = 0; i < nProperties; i++)
 	{
 		channelProperties[i].thresholdUpper				= propertiesArray[j];
@@ -1197,15 +3488,195 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(int16_t handle, uint32_t *pr
 		j = j + 6;
 	}
 	status = ps3000aSetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
-	free(channelProperties);
 	return status;
 }
 
+/****************************************************************************
+* StartStreamingEngine
+*
+* Starts a wrapper-owned thread that calls ps3000aGetStreamingLatestValues 
+* for the device, so that the application does not need to call 
+* GetStreamingLatestValues and poll IsReady in a loop. Data is copied into 
+* the application buffers (or zero-copy windows) as normal, and every 
+* callback is recorded in the queue read by DrainStreamingEvents.
+*
+* Call this function after ps3000aRunStreaming. The engine stops by itself
+* when streaming autostops or the driver returns an error; call 
+* StopStreamingEngine before ps3000aStop in all cases.
+*
+* Buffers, channel counts and enabled channels and ports cannot be changed 
+* while the engine is running; the functions that set them return PICO_BUSY.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* pollIntervalUs - the time in microseconds that the engine waits before 
+*				calling the driver again when no new data was returned.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
+* PICO_BUSY, if the engine is already running for this device.
+* PICO_OPERATION_FAILED, if the thread could not be created.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 StartStreamingEngine(uint16_t deviceIndex, uint32_t pollIntervalUs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if (wrapUnitInfo->engineRunning)
+	{
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_BUSY;
+	}
+
+	// Clean up after an engine that has stopped by itself
+	stopEngineThread(wrapUnitInfo);
+
+	wrapUnitInfo->enginePollIntervalUs = pollIntervalUs;
+	wrapUnitInfo->engineStopRequested = 0;
+	wrapUnitInfo->engineStatus = PICO_OK;
+	wrapUnitInfo->engineTotalSamples = 0;
+	wrapUnitInfo->engineRunning = 1;
+
+#if defined(WIN32) || defined(_WIN64)
+	wrapUnitInfo->engineThread = CreateThread(NULL, 0, streamingEngineThread, wrapUnitInfo, 0, NULL);
+
+	if (wrapUnitInfo->engineThread == NULL)
+#else
+	if (pthread_create(&wrapUnitInfo->engineThread, NULL, streamingEngineThread, wrapUnitInfo) != 0)
+#endif
+	{
+		wrapUnitInfo->engineRunning = 0;
+		releaseWrapUnitInfo(wrapUnitInfo);
+		return PICO_OPERATION_FAILED;
+	}
+
+	wrapUnitInfo->engineThreadCreated = 1;
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* StopStreamingEngine
+*
+* Stops the streaming engine thread for a device and waits for it to exit. 
+* This function does not stop the device - use ps3000aStop for this.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if deviceIndex is out of bounds.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 StopStreamingEngine(uint16_t deviceIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	stopEngineThread(wrapUnitInfo);
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* WaitForStreamingData
+*
+* Blocks the calling thread until the streaming callback has been called 
+* following a call to GetStreamingLatestValues, or until the timeout 
+* expires. Use this function instead of polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - Data is not yet available (the timeout expired) or deviceIndex is out of range.
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForStreamingData(uint16_t deviceIndex, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	int16_t ready = 0;
+
+	if (wrapUnitInfo != NULL)
+	{
+		ready = waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, 
+			&wrapUnitInfo->result.ready, &wrapUnitInfo->released, timeoutMs);
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return ready;
+}
+
+/****************************************************************************
+* WaitForBlockReady
+*
+* Blocks the calling thread until a block mode capture started with RunBlock
+* has completed, or until the timeout expires. Use this function instead of
+* polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* deviceIndex - the index assigned by the wrapper corresponding to the 
+*				required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - The capture has not completed (the timeout expired) or deviceIndex is out of range.
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForBlockReady(uint16_t deviceIndex, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = acquireWrapUnitInfo(deviceIndex);
+	int16_t ready = 0;
+
+	if (wrapUnitInfo != NULL)
+	{
+		ready = waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, 
+			&wrapUnitInfo->result.ready, &wrapUnitInfo->released, timeoutMs);
+	}
+
+	releaseWrapUnitInfo(wrapUnitInfo);
+
+	return ready;
+}
+
 /****************************************************************************
 * resetNextDeviceIndex
 *
-* This function is used to reset the index used to determine the next point 
-* at which to store a WRAP_UNIT_INFO structure.
+* This function releases the records of all devices and frees the device 
+* registry, so that the indices returned by initWrapUnitInfo start again 
+* from 0.
 *
 * This function should only be called once the devices have been disconnected.
 *
@@ -1220,7 +3691,70 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(int16_t handle, uint32_t *pr
 ****************************************************************************/
 extern PICO_STATUS PREF0 PREF1 resetNextDeviceIndex(void)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	uint16_t slot = 0;
+	uint16_t chunk = 0;
+	int32_t handle = 0;
+
+	for (slot = 0; slot < g_nextDeviceIndex; slot++)
+	{
+		lockDeviceSlots();
+		wrapUnitInfo = releaseDeviceSlot(slot);
+		unlockDeviceSlots();
+
+		freeWrapUnitInfo(wrapUnitInfo);
+	}
+
+	for (handle = 0; handle <= WRAP_MAX_HANDLE; handle++)
+	{
+		free(_triggerArenas[handle]);
+		_triggerArenas[handle] = NULL;
+		_triggerArenaSizes[handle] = 0;
+	}
+
+	lockDeviceSlots();
+
+	for (chunk = 0; chunk < WRAP_MAX_DEVICE_SLOT_CHUNKS; chunk++)
+	{
+		free(g_deviceSlotChunks[chunk]);
+		g_deviceSlotChunks[chunk] = NULL;
+	}
+
 	g_nextDeviceIndex = 0;
+	g_freeDeviceSlot = WRAP_NO_FREE_SLOT;
+	g_deviceCount = 0;
+
+	unlockDeviceSlots();
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* setNonTemporalCopyThreshold
+*
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
+*
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
+*
+* Input Arguments:
+*
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
+*
+* Returns:
+*
+* PICO_OK.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
+{
+	_nonTemporalCopyThreshold = thresholdBytes;
 
 	return PICO_OK;
 }
@@ -18,6 +18,7 @@
 #include "windows.h"
 #include <stdio.h>
 #include "ps3000aApi.h"
+#include <malloc.h>
 
 #ifdef PREF0
 #undef PREF0
@@ -29,10 +30,19 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #elif _WIN64
 #include "windows.h"
 #include <stdio.h>
 #include "ps3000aApi.h"
+#include <malloc.h>
 
 #ifdef PREF0
 #undef PREF0
@@ -44,6 +54,14 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #else
 #include <libps3000a-1.1/ps3000aApi.h>
 #include <sys/types.h>
@@ -52,6 +70,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #ifndef PICO_STATUS
 #include <libps3000a-1.1/PicoStatus.h>
 #endif
@@ -61,14 +82,57 @@
 #define PREF0
 #define PREF1
 
+#define WRAP_MEMORY_BARRIER() __sync_synchronize()
+
+typedef pthread_t WRAP_THREAD;
+typedef pthread_mutex_t WRAP_LOCK;
+typedef pthread_cond_t WRAP_CONDITION;
+#define WRAP_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define WRAP_CONDITION_INIT PTHREAD_COND_INITIALIZER
+
 typedef enum enBOOL
 {
   FALSE, TRUE
 } BOOL;
 #endif
 
+// Instruction set extensions used by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
+
 #define MAX_PICO_DEVICES 64
-#define WRAP_MAX_PICO_DEVICES 4
+#define WRAP_DEVICE_SLOT_CHUNK		16		// Number of device slots allocated at a time
+#define WRAP_MAX_DEVICE_SLOTS		1024	// The registry grows one chunk at a time up to this limit
+#define WRAP_MAX_DEVICE_SLOT_CHUNKS	(WRAP_MAX_DEVICE_SLOTS / WRAP_DEVICE_SLOT_CHUNK)
+#define WRAP_DEVICE_SLOT_BITS		10		// Low bits of a device index hold the slot number
+#define WRAP_DEVICE_SLOT_MASK		((1 << WRAP_DEVICE_SLOT_BITS) - 1)
+#define WRAP_DEVICE_GENERATION_MASK	0x3F	// High bits of a device index hold the slot generation
+#define WRAP_RETIRED_GENERATION		(WRAP_DEVICE_GENERATION_MASK + 1)	// Never matches a device index
+#define WRAP_NO_FREE_SLOT			0xFFFF
+#define WRAP_MAX_HANDLE				32767
 
 #define DUAL_SCOPE	2
 #define DUAL_PORT_MSO 2
@@ -83,6 +147,144 @@ typedef enum enPS3000AWrapDigitalPortIndex
 	PS3000A_WRAP_DIGITAL_PORT1
 } PS3000A_WRAP_DIGITAL_PORT_INDEX;
 
+#define WRAP_STREAMING_EVENT_QUEUE_SIZE		1024	// Number of streaming callback records held - must be a power of 2
+#define WRAP_STREAMING_EVENT_FIELDS			8		// Number of values per record returned by DrainStreamingEvents
+
+/****************************************************************************
+* tWrapStreamingEvent
+*
+* A record of the parameters passed to one call of the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEvent
+{
+	uint32_t	numSamples;
+	uint32_t	startIndex;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		overflow;
+	int16_t		autoStop;
+	uint64_t	timestamp;			// Host time in microseconds when the callback was received
+} WRAP_STREAMING_EVENT;
+
+/****************************************************************************
+* tWrapStreamingEventQueue
+*
+* Single-producer/single-consumer queue of streaming callback records. The 
+* streaming callback is the only writer of writeIndex and droppedEvents, and 
+* DrainStreamingEvents is the only writer of readIndex, so no lock is needed.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEventQueue
+{
+	WRAP_STREAMING_EVENT	events[WRAP_STREAMING_EVENT_QUEUE_SIZE];
+	volatile uint32_t		writeIndex;				// Total number of records added
+	volatile uint32_t		readIndex;				// Total number of records removed
+	volatile uint32_t		droppedEvents;			// Total number of records lost because the queue was full
+	uint32_t				reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainStreamingEvents
+} WRAP_STREAMING_EVENT_QUEUE;
+
+#define WRAP_TRIGGER_LOG_SIZE				4096	// Number of trigger records held - must be a power of 2
+#define WRAP_TRIGGER_LOG_FIELDS				2		// Number of values per record returned by DrainTriggerLog
+
+/****************************************************************************
+* tWrapTriggerRecord
+*
+* The position of one trigger reported by the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapTriggerRecord
+{
+	uint64_t	sampleIndex;		// Index of the trigger point counted from the first sample after resetTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_RECORD;
+
+/****************************************************************************
+* tWrapTriggerLog
+*
+* Single-producer/single-consumer log of streaming triggers, shared in the 
+* same way as WRAP_STREAMING_EVENT_QUEUE. sampleCount counts every sample 
+* the driver has passed to the streaming callback, so trigger positions do 
+* not depend on where the driver placed the data in its buffers and do not
+* wrap.
+*
+****************************************************************************/
+typedef struct tWrapTriggerLog
+{
+	WRAP_TRIGGER_RECORD	records[WRAP_TRIGGER_LOG_SIZE];
+	uint64_t			sampleCount;			// Samples received since the last resetTriggerLog
+	volatile uint32_t	writeIndex;				// Total number of records added
+	volatile uint32_t	readIndex;				// Total number of records removed
+	volatile uint32_t	droppedRecords;			// Total number of records lost because the log was full
+	uint32_t			reportedDroppedRecords;	// Value of droppedRecords at the last call to DrainTriggerLog
+} WRAP_TRIGGER_LOG;
+
+#define WRAP_WAIT_INFINITE	0xFFFFFFFF
+
+#define WRAP_MAX_STREAMING_WINDOWS		8		// Maximum number of buffer sets used for zero-copy streaming
+#define WRAP_STREAMING_WINDOW_ALIGNMENT	4096	// Alignment in bytes of zero-copy streaming buffers
+
+// State of a zero-copy streaming buffer set
+typedef enum enWrapStreamingWindowState
+{
+	WRAP_WINDOW_FREE,			// Not in use
+	WRAP_WINDOW_REGISTERED,		// Registered with the driver, waiting for data
+	WRAP_WINDOW_FILLED,			// Contains data not yet acquired by the application
+	WRAP_WINDOW_HELD			// Acquired by the application
+} WRAP_STREAMING_WINDOW_STATE;
+
+/****************************************************************************
+* tWrapStreamingWindow
+*
+* A set of wrapper-owned buffers registered with the driver for zero-copy 
+* streaming, and the location of the data written into them by the driver.
+*
+****************************************************************************/
+typedef struct tWrapStreamingWindow
+{
+	volatile WRAP_STREAMING_WINDOW_STATE state;
+	uint32_t	sequence;										// Order in which the window was filled
+	uint32_t	startIndex;										// Index of the first valid sample in each buffer
+	uint32_t	numSamples;										// Number of valid samples in each buffer
+	int16_t		*buffers[PS3000A_MAX_CHANNEL_BUFFERS];			// Analogue channel buffers (max, min)
+	int16_t		*digiBuffers[MAX_DIGITAL_BUFFERS];				// Digital port buffers (max, min)
+} WRAP_STREAMING_WINDOW;
+
+#define WRAP_MAX_COPY_ENTRIES	(PS3000A_MAX_CHANNEL_BUFFERS + MAX_DIGITAL_BUFFERS)
+
+/****************************************************************************
+* tWrapCopyEntry
+*
+* A driver buffer and the application buffer that the streaming callback
+* copies its data into.
+*
+****************************************************************************/
+typedef struct tWrapCopyEntry
+{
+	int16_t		*source;				// Buffer registered with the driver
+	int16_t		*destination;			// Application buffer
+} WRAP_COPY_ENTRY;
+
+/****************************************************************************
+* tWrapStreamingResult
+*
+* The result of the latest streaming callback or block capture for a device.
+* The callbacks write it while the application, or the streaming engine, 
+* reads it and resets it before each call to the driver, so it is only 
+* accessed with the readyLock of the device held.
+*
+****************************************************************************/
+typedef struct tWrapStreamingResult
+{
+	int16_t		ready;
+	int32_t		numSamples;
+	uint32_t	startIndex;
+	int16_t		overflow;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		autoStop;
+} WRAP_STREAMING_RESULT;
+
 /****************************************************************************
 * tWrapUnitInfo
 *
@@ -101,13 +303,10 @@ typedef struct tWrapUnitInfo
 	int16_t enabledDigitalPorts[PS3000A_MAX_DIGITAL_PORTS];		// Keep a record of the ports that are enabled.
 
 	// Streaming Parameters
-	int16_t		ready;
-	int32_t		numSamples;
-	uint32_t	startIndex;
-	int16_t		overflow;
-	uint32_t	triggeredAt;
-	int16_t		triggered;
-	int16_t		autoStop;
+	WRAP_STREAMING_RESULT result;
+	int16_t		released;				// Set once the device has been released, to end any waits
+	WRAP_LOCK	readyLock;				// Protects result and released
+	WRAP_CONDITION readyCondition;
 
 	// Data Buffers
 
@@ -120,18 +319,107 @@ typedef struct tWrapUnitInfo
 	int16_t *driverDigiBuffers[MAX_DIGITAL_BUFFERS];		// The buffers registered with the driver for the digital ports.
 	int16_t *appDigiBuffers[MAX_DIGITAL_BUFFERS];			// Application buffers to copy the driver digital data into.
 	int32_t digiBufferLengths[PS3000A_MAX_DIGITAL_PORTS];	// Buffer lengths for digital ports.
+
+	// Buffers copied by the streaming callback, rebuilt whenever the channels, ports or buffers change
+	WRAP_COPY_ENTRY copyPlan[WRAP_MAX_COPY_ENTRIES];
+	int16_t copyPlanLength;
+
+	// Record of every streaming callback, read by DrainStreamingEvents
+	WRAP_STREAMING_EVENT_QUEUE eventQueue;
+
+	// Absolute positions of streaming triggers, read by DrainTriggerLog
+	WRAP_TRIGGER_LOG triggerLog;
+
+	// Zero-copy streaming
+	int16_t		zeroCopyEnabled;
+	uint32_t	zeroCopyBufferLength;								// Length of each buffer in a window
+	uint16_t	zeroCopyWindowCount;								// Number of windows allocated
+	int16_t		zeroCopyAggregate;									// Non-zero if min buffers are registered
+	int16_t		currentWindow;										// Window registered with the driver, -1 if none
+	uint32_t	nextWindowSequence;
+	WRAP_STREAMING_WINDOW windows[WRAP_MAX_STREAMING_WINDOWS];
+	WRAP_LOCK	windowLock;											// Protects the state of each window and currentWindow
+
+	// Streaming engine. Functions that must not run alongside the engine test 
+	// engineRunning, which is cleared as soon as the thread stops calling the driver.
+	volatile int16_t		engineRunning;
+	volatile int16_t		engineStopRequested;
+	uint32_t				enginePollIntervalUs;					// Time to wait when the driver has no new data
+	volatile PICO_STATUS	engineStatus;							// Status of the last driver call made by the engine
+	volatile uint32_t		engineTotalSamples;						// Number of samples received since the engine started
+	WRAP_THREAD				engineThread;
+	int16_t					engineThreadCreated;					// Set while engineThread has not been joined
+
+	// Number of exported functions using the structure, protected by g_deviceSlotLock
+	uint32_t				references;
 	
 } WRAP_UNIT_INFO;
 
-WRAP_UNIT_INFO	g_deviceInfo[WRAP_MAX_PICO_DEVICES];	// Hold structures for each device
+#define WRAP_MAX_TRIGGER_STRUCTURES			32		// Largest number of structures converted by one call to a trigger function
+
+/****************************************************************************
+* uWrapTriggerArena
+*
+* The space in which the trigger functions convert their arrays of integers
+* to driver structures. An arena is allocated for each handle the first 
+* time it is used and kept until the device is released, so that setting up
+* a trigger does not allocate memory after that.
+* The arena is grown on the heap if a trigger function is passed more than
+* WRAP_MAX_TRIGGER_STRUCTURES structures.
+*
+****************************************************************************/
+typedef union uWrapTriggerArena
+{
+	PS3000A_TRIGGER_CONDITIONS			conditions[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS3000A_TRIGGER_CONDITIONS_V2		conditionsV2[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS3000A_TRIGGER_CHANNEL_PROPERTIES	channelProperties[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS3000A_PWQ_CONDITIONS				pwqConditions[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS3000A_PWQ_CONDITIONS_V2			pwqConditionsV2[WRAP_MAX_TRIGGER_STRUCTURES];
+} WRAP_TRIGGER_ARENA;
+
+/****************************************************************************
+* tWrapDeviceSlot
+*
+* An entry in the device registry. A device index returned by 
+* initWrapUnitInfo combines the slot number with the generation of the slot,
+* which is incremented each time the slot is released, so an index kept by 
+* the application after decrementDeviceCount is rejected rather than 
+* referring to a different device.
+* A slot whose generation has reached WRAP_DEVICE_GENERATION_MASK is retired
+* instead of being returned to the free list, so that a generation is never
+* reused. Retired slots are recovered by resetNextDeviceIndex.
+*
+****************************************************************************/
+typedef struct tWrapDeviceSlot
+{
+	WRAP_UNIT_INFO *	unitInfo;			// NULL if the slot is free
+	uint16_t			generation;
+	uint16_t			nextFree;			// Next slot in the free list
+} WRAP_DEVICE_SLOT;
+
+// Hold structures for each device. Chunks are never moved once allocated, so 
+// that a slot can be read while the registry grows.
+WRAP_DEVICE_SLOT *	g_deviceSlotChunks[WRAP_MAX_DEVICE_SLOT_CHUNKS];
+WRAP_LOCK			g_deviceSlotLock = WRAP_LOCK_INIT;	// Protects the registry and g_handleToDeviceSlot
+WRAP_CONDITION		g_deviceReleaseCondition = WRAP_CONDITION_INIT;	// Signalled when the references to a device drop to 0
 
 // Global parameters
 
-uint16_t	g_deviceCount = 0;			// Keep a record of the number of devices
-uint16_t	g_nextDeviceIndex = 0;		// Keep track of the next index to use (only from 0 to 3)
+uint16_t	g_deviceCount = 0;						// Keep a record of the number of devices
+uint16_t	g_nextDeviceIndex = 0;					// Keep track of the next slot that has never been used
+uint16_t	g_freeDeviceSlot = WRAP_NO_FREE_SLOT;	// Head of the list of released slots
+uint16_t	g_handleToDeviceSlot[WRAP_MAX_HANDLE + 1];	// Slot number + 1 for each open handle, 0 if none
 
 // Function declarations
 
+extern PICO_STATUS PREF0 PREF1 AcquireStreamingWindow
+(
+	uint16_t deviceIndex,
+	uint16_t * windowIndex,
+	uint32_t * startIndex,
+	uint32_t * numSamples
+);
+
 extern int16_t PREF0 PREF1 AutoStopped
 (
 	uint16_t deviceIndex
@@ -153,11 +441,57 @@ extern PICO_STATUS PREF0 PREF1 decrementDeviceCount
 	uint16_t deviceIndex
 );
 
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents
+(
+	uint16_t deviceIndex,
+	uint32_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog
+(
+	uint16_t deviceIndex,
+	uint64_t * triggers,
+	uint32_t maxTriggers,
+	uint32_t * nTriggers,
+	uint32_t * droppedTriggers
+);
+
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog
+(
+	uint16_t deviceIndex
+);
+
 extern uint16_t PREF0 PREF1 getDeviceCount
 (
 	void
 );
 
+extern PICO_STATUS PREF0 PREF1 getDeviceIndexFromHandle
+(
+	int16_t handle,
+	uint16_t * deviceIndex
+);
+
+extern PICO_STATUS PREF0 PREF1 getStreamingWindowBuffers
+(
+	uint16_t deviceIndex,
+	uint16_t windowIndex,
+	int16_t channel,
+	int16_t ** maxBuffer,
+	int16_t ** minBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 getStreamingEngineStatus
+(
+	uint16_t deviceIndex,
+	int16_t * running,
+	PICO_STATUS * engineStatus,
+	uint32_t * totalSamples
+);
+
 extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues
 (
 	uint16_t deviceIndex
@@ -180,6 +514,24 @@ extern int16_t PREF0 PREF1 IsTriggerReady
 	uint32_t *triggeredAt
 );
 
+extern PICO_STATUS PREF0 PREF1 PollAllDevices
+(
+	uint16_t maxDevices,
+	uint16_t * nDevices,
+	uint16_t * deviceIndices,
+	PICO_STATUS * statuses,
+	int16_t * readyFlags,
+	uint32_t * counts,
+	uint32_t * startIndices,
+	int16_t * autoStopped
+);
+
+extern PICO_STATUS PREF0 PREF1 ReleaseStreamingWindow
+(
+	uint16_t deviceIndex,
+	uint16_t windowIndex
+);
+
 extern PICO_STATUS PREF0 PREF1 RunBlock
 (
 	uint16_t deviceIndex, 
@@ -253,6 +605,15 @@ extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts
 	int16_t * enabledDigitalPorts
 );
 
+extern PICO_STATUS PREF0 PREF1 setZeroCopyStreaming
+(
+	uint16_t deviceIndex,
+	int16_t enable,
+	uint32_t bufferLength,
+	uint16_t nWindows,
+	int32_t downSampleRatioMode
+);
+
 extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier
 (
 	int16_t handle,
@@ -297,9 +658,37 @@ extern PICO_STATUS PREF0 PREF1 SetTriggerProperties
 	int32_t autoTrig
 );
 
+extern PICO_STATUS PREF0 PREF1 StartStreamingEngine
+(
+	uint16_t deviceIndex,
+	uint32_t pollIntervalUs
+);
+
+extern PICO_STATUS PREF0 PREF1 StopStreamingEngine
+(
+	uint16_t deviceIndex
+);
+
+extern int16_t PREF0 PREF1 WaitForStreamingData
+(
+	uint16_t deviceIndex,
+	uint32_t timeoutMs
+);
+
+extern int16_t PREF0 PREF1 WaitForBlockReady
+(
+	uint16_t deviceIndex,
+	uint32_t timeoutMs
+);
+
 extern PICO_STATUS PREF0 PREF1 resetNextDeviceIndex
 (
 	void
 );
 
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
 #endif
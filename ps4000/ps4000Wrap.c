@@ -30,6 +30,504 @@
 //
 /////////////////////////////////
 
+static int16_t _simdLevel = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+static LARGE_INTEGER _timestampFrequency = { 0 };
+#endif
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+
+/****************************************************************************
+* detectSimdLevel
+*
+* Returns the widest instruction set extension that can be used for the 
+* streaming copy on this processor (WRAP_SIMD_NONE, WRAP_SIMD_SSE2, 
+* WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512).
+*
+****************************************************************************/
+static int16_t detectSimdLevel(void)
+{
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[3] & (1 << 26)) == 0)
+	{
+		return WRAP_SIMD_NONE;
+	}
+
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+
+	if (osSavesAvxState && maxLeaf >= 7)
+	{
+		__cpuidex(cpuInfo, 7, 0);
+
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
+		}
+
+		if (cpuInfo[1] & (1 << 5))
+		{
+			return WRAP_SIMD_AVX2;
+		}
+	}
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
+}
+
+/****************************************************************************
+* getSimdLevel
+*
+* Returns the result of detectSimdLevel, which is only run the first time.
+*
+****************************************************************************/
+static int16_t getSimdLevel(void)
+{
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
+}
+
+#ifdef WRAP_SIMD_X86
+/****************************************************************************
+* copyNonTemporalSse2
+*
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
+*
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
+
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+#endif
+
+/****************************************************************************
+* copySamples
+*
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
+*
+****************************************************************************/
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	size_t nBytes = noOfSamples * sizeof(int16_t);
+
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
+}
+
+/****************************************************************************
+* getHostTimestamp
+*
+* Returns a monotonic host time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getHostTimestamp(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	LARGE_INTEGER counter;
+
+	// The frequency is fixed at boot, so it is only read once
+	if (_timestampFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&_timestampFrequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / _timestampFrequency.QuadPart) * 1000000 + 
+		((counter.QuadPart % _timestampFrequency.QuadPart) * 1000000) / _timestampFrequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
+}
+
+/****************************************************************************
+* pushStreamingEvent
+*
+* Adds a record of a streaming callback to the event queue. Called only from 
+* the streaming callback. If the queue is full, the record is discarded and 
+* counted as dropped.
+*
+****************************************************************************/
+static void pushStreamingEvent(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t numSamples, uint32_t startIndex, int16_t triggered, 
+	uint32_t triggeredAt, int16_t overflow, int16_t autoStop)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_STREAMING_EVENT_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+	event->numSamples = numSamples;
+	event->startIndex = startIndex;
+	event->triggered = triggered;
+	event->triggeredAt = triggeredAt;
+	event->overflow = overflow;
+	event->autoStop = autoStop;
+	event->timestamp = getHostTimestamp();
+
+	// Make sure the record is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* drainStreamingEventQueue
+*
+* Copies up to maxEvents records out of the event queue into a flat array and
+* removes them from the queue. Called only from DrainStreamingEvents.
+*
+****************************************************************************/
+static void drainStreamingEventQueue(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, 
+	uint32_t * droppedEvents)
+{
+	uint32_t readIndex = queue->readIndex;
+	uint32_t writeIndex = queue->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+		events[j]		= event->numSamples;
+		events[j + 1]	= event->startIndex;
+		events[j + 2]	= (uint32_t) event->triggered;
+		events[j + 3]	= event->triggeredAt;
+		events[j + 4]	= (uint32_t) (uint16_t) event->overflow;
+		events[j + 5]	= (uint32_t) event->autoStop;
+		events[j + 6]	= (uint32_t) (event->timestamp & 0xFFFFFFFF);
+		events[j + 7]	= (uint32_t) (event->timestamp >> 32);
+
+		j = j + WRAP_STREAMING_EVENT_FIELDS;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+}
+
+/****************************************************************************
+* initMonotonicCondition
+*
+* Initialises a condition variable whose timed waits are measured against 
+* CLOCK_MONOTONIC, so that waitForReady is not affected by changes to the 
+* system time.
+*
+****************************************************************************/
+#if !defined(WIN32) && !defined(_WIN64)
+static void initMonotonicCondition(WRAP_CONDITION * condition)
+{
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+#endif
+
+#if !defined(WIN32) && !defined(_WIN64)
+static pthread_once_t _readyConditionOnce = PTHREAD_ONCE_INIT;
+
+static void initReadyCondition(void)
+{
+	initMonotonicCondition(&_readyCondition);
+}
+#endif
+
+/****************************************************************************
+* getReadyCondition
+*
+* Returns the condition signalled by setReady, initialising it on first use.
+*
+****************************************************************************/
+static WRAP_CONDITION * getReadyCondition(void)
+{
+#if !defined(WIN32) && !defined(_WIN64)
+	pthread_once(&_readyConditionOnce, initReadyCondition);
+#endif
+
+	return &_readyCondition;
+}
+
+/****************************************************************************
+* setReady
+*
+* Sets a ready flag and wakes any threads waiting for it in waitForReady.
+*
+****************************************************************************/
+static void setReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(lock);
+	*ready = 1;
+	ReleaseSRWLockExclusive(lock);
+	WakeAllConditionVariable(condition);
+#else
+	pthread_mutex_lock(lock);
+	*ready = 1;
+	pthread_cond_broadcast(condition);
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+/****************************************************************************
+* waitForReady
+*
+* Blocks the calling thread until a ready flag is set by setReady or the 
+* timeout expires, and returns the value of the flag. A timeout of 
+* WRAP_WAIT_INFINITE waits indefinitely.
+*
+****************************************************************************/
+static int16_t waitForReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready, uint32_t timeoutMs)
+{
+	int16_t isReady = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	ULONGLONG now = 0;
+
+	AcquireSRWLockExclusive(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+			continue;
+		}
+
+		now = GetTickCount64();
+
+		if (now >= deadline)
+		{
+			break;
+		}
+
+		SleepConditionVariableSRW(condition, lock, (DWORD) (deadline - now), 0);
+	}
+
+	isReady = *ready;
+	ReleaseSRWLockExclusive(lock);
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			pthread_cond_wait(condition, lock);
+		}
+		else if (pthread_cond_timedwait(condition, lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	isReady = *ready;
+	pthread_mutex_unlock(lock);
+#endif
+
+	return isReady;
+}
+
 /****************************************************************************
 * Streaming Callback
 *
@@ -74,22 +572,22 @@ void PREF1 StreamingCallback(
 					// Max buffers
 					if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
 					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t));
+						copySamples(&_wrapBufferInfo->appBuffers[channel * 2][startIndex], &_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
 					}
 
 					// Min buffers
 					if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
 					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
+						copySamples(&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], &_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples);
 					}
 				}
 			}
 		}
 	}
   
-	_ready = 1;
+	pushStreamingEvent(&_streamingEventQueue, noOfSamples, startIndex, triggered, triggerAt, overflow, autoStop);
+
+	setReady(&_readyLock, getReadyCondition(), &_ready);
 }
 
 /****************************************************************************
@@ -100,7 +598,7 @@ void PREF1 StreamingCallback(
 ****************************************************************************/
 void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
 {
-	_ready = 1;
+	setReady(&_readyLock, getReadyCondition(), &_ready);
 }
 
 /****************************************************************************
@@ -240,6 +738,54 @@ extern int16_t PREF0 PREF1 IsReady(int16_t handle)
 	return _ready;
 }
 
+/****************************************************************************
+* WaitForStreamingData
+*
+* Blocks the calling thread until the streaming callback has been called 
+* following a call to GetStreamingLatestValues, or until the timeout 
+* expires. Use this function instead of polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - Data is not yet available (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForStreamingData(int16_t handle, uint32_t timeoutMs)
+{
+	return waitForReady(&_readyLock, getReadyCondition(), &_ready, timeoutMs);
+}
+
+/****************************************************************************
+* WaitForBlockReady
+*
+* Blocks the calling thread until a block mode capture started with RunBlock
+* has completed, or until the timeout expires. Use this function instead of
+* polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - The capture has not completed (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForBlockReady(int16_t handle, uint32_t timeoutMs)
+{
+	return waitForReady(&_readyLock, getReadyCondition(), &_ready, timeoutMs);
+}
+
 /****************************************************************************
 * IsTriggerReady
 *
@@ -644,3 +1190,89 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, int1
 		return PICO_INVALID_HANDLE;
 	}
 }
+
+/****************************************************************************
+* DrainStreamingEvents
+*
+* Returns the records of all streaming callbacks received since the last call
+* to this function, oldest first, in a single call. Unlike AvailableData and 
+* IsTriggerReady, which only report the latest callback, no callback 
+* information is lost if the application polls slowly, provided the queue of
+* 1024 records does not fill up.
+*
+* Each record is returned as 8 consecutive values in the events array:
+*
+* [0] numSamples - the number of samples collected.
+* [1] startIndex - an index to the first valid sample in the buffer.
+* [2] triggered - non-zero if a trigger occurred.
+* [3] triggeredAt - the index of the trigger point relative to startIndex.
+* [4] overflow - overvoltage flags, bit 0 denoting channel A.
+* [5] autoStop - non-zero if streaming has autostopped.
+* [6] timestamp (low 32 bits) - host time in microseconds when the callback
+*		was received.
+* [7] timestamp (high 32 bits).
+*
+* See also ps4000StreamingReady for a description of the callback parameters.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* events - an array of at least maxEvents * 8 elements.
+* maxEvents - the maximum number of records to return.
+* nEvents - on exit, the number of records copied into events.
+* droppedEvents - on exit, the number of records that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if events or nEvents is NULL
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents(int16_t handle, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
+{
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	if (events == NULL || nEvents == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	drainStreamingEventQueue(&_streamingEventQueue, events, maxEvents, nEvents, droppedEvents);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* setNonTemporalCopyThreshold
+*
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
+*
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
+*
+* Input Arguments:
+*
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
+*
+* Returns:
+*
+* PICO_OK.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
+{
+	_nonTemporalCopyThreshold = thresholdBytes;
+
+	return PICO_OK;
+}
@@ -23,375 +23,2908 @@
 //
 /////////////////////////////////
 
+static const uint32_t _rangeMillivolts[PS4000A_MAX_RANGES] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000 };
+
+static int16_t _simdLevel = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+static LARGE_INTEGER _timestampFrequency = { 0 };
+#endif
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+
 /****************************************************************************
-* Streaming Callback
+* detectSimdLevel
 *
-* See ps4000aStreamingReady (callback)
+* Returns the widest instruction set extension that can be used for the 
+* volts conversion and the streaming copy on this processor (WRAP_SIMD_NONE,
+* WRAP_SIMD_SSE2, WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512). The volts conversion
+* uses the AVX2 kernels on processors with AVX-512.
 *
 ****************************************************************************/
-void PREF1 StreamingCallback(
-    int16_t handle,
-	int32_t noOfSamples,
-	uint32_t startIndex,
-	int16_t overflow,
-	uint32_t triggerAt,
-	int16_t triggered,
-	int16_t autoStop,
-	void * pParameter)
+static int16_t detectSimdLevel(void)
 {
-	int16_t channel = 0;
-	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
-	
-	if (pParameter != NULL)
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[3] & (1 << 26)) == 0)
 	{
-		_wrapBufferInfo = (WRAP_BUFFER_INFO *) pParameter;
+		return WRAP_SIMD_NONE;
 	}
 
-	_numSamples = noOfSamples;
-	_autoStop = autoStop;
-	_startIndex = startIndex;
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
 
-	_triggered = triggered;
-	_triggeredAt = triggerAt;
+	if (osSavesAvxState && maxLeaf >= 7)
+	{
+		__cpuidex(cpuInfo, 7, 0);
 
-	_overflow = overflow;
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
+		}
 
-	if (_wrapBufferInfo != NULL && noOfSamples)
-	{
-		for (channel = (int16_t) PS4000A_CHANNEL_A; channel < _channelCount; channel++)
+		if (cpuInfo[1] & (1 << 5))
 		{
-			if (_enabledChannels[channel])
-			{
-				if (_wrapBufferInfo->appBuffers && _wrapBufferInfo->driverBuffers)
-				{
-					// Max buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t));
-					}
-
-					// Min buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-					}
-				}
-			}
+			return WRAP_SIMD_AVX2;
 		}
 	}
-  
-  _ready = 1;
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
 }
 
 /****************************************************************************
-* BlockCallback
+* getSimdLevel
 *
-* See ps4000aBlockReady (callback)
+* Returns the result of detectSimdLevel, which is only run the first time.
 *
 ****************************************************************************/
-void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+static int16_t getSimdLevel(void)
 {
-  _ready = 1;
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
 }
 
+#ifdef WRAP_SIMD_X86
 /****************************************************************************
-* Probe Interaction Callback
+* copyNonTemporalSse2
 *
-* See ps4000aProbeInteractions (callback)
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
+*
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
 *
 ****************************************************************************/
-void PREF4 ProbeInteractions(int16_t handle, PICO_STATUS status, PS4000A_USER_PROBE_INTERACTIONS * probes, uint32_t	nProbes)
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
 {
 	uint32_t i = 0;
 
-	wrapUserProbeInfo.status = status;
-	wrapUserProbeInfo.numberOfProbes = nProbes;
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
 
-	for (i = 0; i < nProbes; ++i)
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
 	{
-		wrapUserProbeInfo.userProbeInteractions[i].connected = probes[i].connected;
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
 
-		wrapUserProbeInfo.userProbeInteractions[i].channel			= probes[i].channel;
-		wrapUserProbeInfo.userProbeInteractions[i].enabled			= probes[i].enabled;
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
 
-		wrapUserProbeInfo.userProbeInteractions[i].probeName		= probes[i].probeName;
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
 
-		wrapUserProbeInfo.userProbeInteractions[i].requiresPower_	= probes[i].requiresPower_;
-		wrapUserProbeInfo.userProbeInteractions[i].isPowered_		= probes[i].isPowered_;
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
 
-		wrapUserProbeInfo.userProbeInteractions[i].status_			= probes[i].status_;
+	_mm_sfence();
+}
 
-		wrapUserProbeInfo.userProbeInteractions[i].probeOff			= probes[i].probeOff;
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
 
-		wrapUserProbeInfo.userProbeInteractions[i].rangeFirst_		= probes[i].rangeFirst_;
-		wrapUserProbeInfo.userProbeInteractions[i].rangeLast_		= probes[i].rangeLast_;
-		wrapUserProbeInfo.userProbeInteractions[i].rangeCurrent_	= probes[i].rangeLast_;
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
 
-		wrapUserProbeInfo.userProbeInteractions[i].couplingFirst_	= probes[i].couplingFirst_;
-		wrapUserProbeInfo.userProbeInteractions[i].couplingLast_	= probes[i].couplingLast_;
-		wrapUserProbeInfo.userProbeInteractions[i].couplingCurrent_ = probes[i].couplingCurrent_;
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
 
-		wrapUserProbeInfo.userProbeInteractions[i].filterFlags_		= probes[i].filterFlags_;
-		wrapUserProbeInfo.userProbeInteractions[i].filterCurrent_	= probes[i].filterCurrent_;
-		wrapUserProbeInfo.userProbeInteractions[i].defaultFilter_	= probes[i].defaultFilter_;
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
 	}
 
-	_probeStateChanged = 1;
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
 
+	_mm_sfence();
 }
+#endif
 
 /****************************************************************************
-* RunBlock
-*
-* This function starts collecting data in block mode without the requirement 
-* for specifying callback functions. Use the IsReady function in conjunction 
-* to poll the driver once this function has been called.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-* preTriggerSamples - see noOfPreTriggerSamples in ps4000aRunBlock.
-* postTriggerSamples - see noOfPreTriggerSamples in ps4000aRunBlock.
-* timebase - see ps4000aRunBlock.
-* segmentIndex - see ps4000aRunBlock.
-*
-*
-* Returns:
+* copySamples
 *
-* See ps4000aRunBlock return values.
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 RunBlock(int16_t handle, int32_t preTriggerSamples, int32_t postTriggerSamples,
-            uint32_t timebase, uint32_t segmentIndex)
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
 {
-	_ready = 0;
-	_numSamples = preTriggerSamples + postTriggerSamples;
+	size_t nBytes = noOfSamples * sizeof(int16_t);
 
-	return ps4000aRunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, 
-		NULL, segmentIndex, BlockCallback, NULL);
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
 }
 
 /****************************************************************************
-* GetStreamingLatestValues
-*
-* facilitates communication with the driver to return the next block of 
-* values to your application when capturing data in streaming mode. Use with 
-* programming languages that do not support callback functions.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-*
-* Returns:
+* convertToFloatScalar
 *
-* See ps4000aGetStreamingLatestValues return values.
+* Converts noOfSamples ADC counts to volts one sample at a time. Used when 
+* the processor has no suitable extensions and for the samples left over 
+* at the end of the vector loops.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+static void convertToFloatScalar(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
 {
-	_ready = 0;
-	_numSamples = 0;
-	_autoStop = 0;
+	uint32_t i = 0;
 
-	return ps4000aGetStreamingLatestValues(handle, StreamingCallback, &_wrapBufferInfo);
+	for (i = 0; i < noOfSamples; i++)
+	{
+		destination[i] = (float) source[i] * scale + offset;
+	}
 }
 
 /****************************************************************************
-* Available Data
-*
-* Returns the number of samples returned from the driver and shows 
-* the start index of the data in the buffer when collecting data in 
-* streaming mode.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-* startIndex - on exit, an index to the first valid sample in the buffer 
-*				(When data is available).
-*
-* Returns:
+* convertToDoubleScalar
 *
-* 0 - Data is not yet available.
-* Non-zero - the number of samples returned from the driver.
+* As convertToFloatScalar, for double precision application buffers.
 *
 ****************************************************************************/
-extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+static void convertToDoubleScalar(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
 {
-	if ( _ready ) 
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
 	{
-		*startIndex = _startIndex;
-		return _numSamples;
+		destination[i] = (double) source[i] * scale + offset;
 	}
-
-	return 0;
 }
 
+#ifdef WRAP_SIMD_X86
+
 /****************************************************************************
-* AutoStopped
-*
-* Indicates if the device has stopped on collection of the number of samples 
-* specified in the call to the ps4000aRunStreaming function (if the 
-* ps4000aRunStreaming function's autostop flag is set).
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-*
-* Returns:
+* convertToFloatSse2
 *
-* Non-zero - if streaming has autostopped.
+* Converts ADC counts to volts 8 samples at a time using SSE2. The counts 
+* are sign extended to 32 bits by unpacking each one into the upper half of 
+* a 32-bit lane and shifting it back down.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+static WRAP_TARGET_SSE2 void convertToFloatSse2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
 {
-	if ( _ready) 
-	{
-		return _autoStop;
-	}
-	else
+	uint32_t i = 0;
+	__m128 scaleVector = _mm_set1_ps(scale);
+	__m128 offsetVector = _mm_set1_ps(offset);
+	__m128i counts;
+	__m128i low;
+	__m128i high;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
 	{
-		return 0;
+		counts = _mm_loadu_si128((const __m128i *) &source[i]);
+
+		low = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+		high = _mm_srai_epi32(_mm_unpackhi_epi16(counts, counts), 16);
+
+		_mm_storeu_ps(&destination[i], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm_storeu_ps(&destination[i + 4], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), scaleVector), offsetVector));
 	}
+
+	convertToFloatScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
 }
 
 /****************************************************************************
-* IsReady
-*
-* This function is used to poll the driver to verify that data is ready to be 
-* received. The RunBlock or GetStreamingLatestValues function must have been 
-* called prior to calling this function.
+* convertToFloatAvx2
 *
-* Input Arguments:
-*
-* handle - the handle of the required device.
-*
-* Returns:
-*
-* 0 - Data is not yet available.
-* Non-zero - Data is ready to be collected.
+* Converts ADC counts to volts 16 samples at a time using AVX2, leaving any 
+* remaining samples to convertToFloatSse2.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+static WRAP_TARGET_AVX2 void convertToFloatAvx2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
 {
-	return _ready;
+	uint32_t i = 0;
+	__m256 scaleVector = _mm256_set1_ps(scale);
+	__m256 offsetVector = _mm256_set1_ps(offset);
+	__m256i counts;
+	__m256i low;
+	__m256i high;
+
+	for (i = 0; i + 16 <= noOfSamples; i += 16)
+	{
+		counts = _mm256_loadu_si256((const __m256i *) &source[i]);
+
+		low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(counts));
+		high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(counts, 1));
+
+		_mm256_storeu_ps(&destination[i], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm256_storeu_ps(&destination[i + 8], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(high), scaleVector), offsetVector));
+	}
+
+	convertToFloatSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
 }
 
 /****************************************************************************
-* IsTriggerReady
-*
-* Indicates whether a trigger has occurred when collecting data in streaming 
-* mode, and the location of the trigger point in the buffer.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-* triggeredAt � on exit, the index of the sample in the buffer where the 
-* trigger occurred.
-*
-* Returns:
+* convertToDoubleSse2
 *
-* 0 - The device has not triggered.
-* Non-zero - The device has been triggered.
+* Converts ADC counts to volts 4 samples at a time using SSE2.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+static WRAP_TARGET_SSE2 void convertToDoubleSse2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
 {
-	if (_triggered)
+	uint32_t i = 0;
+	__m128d scaleVector = _mm_set1_pd(scale);
+	__m128d offsetVector = _mm_set1_pd(offset);
+	__m128i counts;
+	__m128i words;
+
+	for (i = 0; i + 4 <= noOfSamples; i += 4)
 	{
-		*triggeredAt = _triggeredAt;
+		counts = _mm_loadl_epi64((const __m128i *) &source[i]);
+		words = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+
+		_mm_storeu_pd(&destination[i], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(words), scaleVector), offsetVector));
+		_mm_storeu_pd(&destination[i + 2], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(words, _MM_SHUFFLE(3, 2, 3, 2))), 
+			scaleVector), offsetVector));
 	}
 
-	return _triggered;
+	convertToDoubleScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
 }
 
 /****************************************************************************
-* ClearTriggerReady
-*
-* Clears the triggered and triggeredAt flags in relation to streaming mode 
-* capture.
-*
-* Input Arguments:
+* convertToDoubleAvx2
 *
-* handle - the handle of the required device.
-*
-* Returns:
-*
-* 1
+* Converts ADC counts to volts 8 samples at a time using AVX2, leaving any 
+* remaining samples to convertToDoubleSse2.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 ClearTriggerReady(int16_t handle)
+static WRAP_TARGET_AVX2 void convertToDoubleAvx2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
 {
-	_triggeredAt = 0;
-	_triggered = FALSE;
-	return 1;
+	uint32_t i = 0;
+	__m256d scaleVector = _mm256_set1_pd(scale);
+	__m256d offsetVector = _mm256_set1_pd(offset);
+	__m256i words;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		words = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &source[i]));
+
+		_mm256_storeu_pd(&destination[i], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(words)), 
+			scaleVector), offsetVector));
+		_mm256_storeu_pd(&destination[i + 4], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(words, 1)), 
+			scaleVector), offsetVector));
+	}
+
+	convertToDoubleSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
 }
 
+#endif
+
 /****************************************************************************
-* setChannelCount
-*
-* Sets the number of channels on the device. This is used to assist with 
-* copying data in the streaming callback.
-*
-* Input Arguments:
+* convertSamples
 *
-* handle - the device handle.
-* channelCount - the number of channels on the device.
+* Converts noOfSamples ADC counts to volts using the scaling for a channel, 
+* writing the result to the float and/or double buffer given. Either buffer 
+* may be NULL.
 *
-* PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is less than or equal to 0
-* PICO_INVALID_PARAMETER, if channelCount is less than 0 or greater than
-*	the number of analogue channels
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
+static void convertSamples(WRAP_CHANNEL_SCALING * scaling, const int16_t * source, float * floatBuffer, double * doubleBuffer, uint32_t noOfSamples)
 {
-	if (handle > 0)
-	{
-		if (channelCount > 0 && channelCount <= PS4000A_MAX_CHANNELS)
-		{
-			_channelCount = channelCount;
+	int16_t simdLevel = getSimdLevel();
 
-			return PICO_OK;
-		}
-		else
+	if (floatBuffer != NULL)
+	{
+		switch (simdLevel)
 		{
-			return PICO_INVALID_PARAMETER;
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToFloatAvx2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToFloatSse2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+#endif
+			default:
+				convertToFloatScalar(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
 		}
 	}
-	else
+
+	if (doubleBuffer != NULL)
 	{
-		return PICO_INVALID_HANDLE;
+		switch (simdLevel)
+		{
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToDoubleAvx2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToDoubleSse2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+#endif
+			default:
+				convertToDoubleScalar(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+		}
+	}
+}
+
+/****************************************************************************
+* minMaxScalar
+*
+* Updates maxValue and minValue with the largest sample in maxSource and the 
+* smallest sample in minSource.
+*
+****************************************************************************/
+static void minMaxScalar(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		if (maxSource[i] > *maxValue)
+		{
+			*maxValue = maxSource[i];
+		}
+
+		if (minSource[i] < *minValue)
+		{
+			*minValue = minSource[i];
+		}
+	}
+}
+
+/****************************************************************************
+* sumScalar
+*
+* Returns the sum of noOfSamples samples.
+*
+****************************************************************************/
+static int64_t sumScalar(const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	int64_t sum = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		sum += source[i];
+	}
+
+	return sum;
+}
+
+#ifdef WRAP_SIMD_X86
+
+/****************************************************************************
+* minMaxSse2
+*
+* As minMaxScalar, comparing 8 samples at a time using SSE2.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void minMaxSse2(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+	uint32_t i = 0;
+	int16_t maxLanes[8];
+	int16_t minLanes[8];
+	__m128i maxVector = _mm_set1_epi16(*maxValue);
+	__m128i minVector = _mm_set1_epi16(*minValue);
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		maxVector = _mm_max_epi16(maxVector, _mm_loadu_si128((const __m128i *) &maxSource[i]));
+		minVector = _mm_min_epi16(minVector, _mm_loadu_si128((const __m128i *) &minSource[i]));
+	}
+
+	_mm_storeu_si128((__m128i *) maxLanes, maxVector);
+	_mm_storeu_si128((__m128i *) minLanes, minVector);
+	minMaxScalar(maxLanes, minLanes, 8, maxValue, minValue);
+
+	minMaxScalar(&maxSource[i], &minSource[i], noOfSamples - i, maxValue, minValue);
+}
+
+/****************************************************************************
+* sumSse2
+*
+* As sumScalar, adding 8 samples at a time using SSE2. The 32-bit lane 
+* totals are moved into the 64-bit sum before they can overflow.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 int64_t sumSse2(const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	uint32_t end = 0;
+	int32_t lanes[4];
+	int64_t sum = 0;
+	__m128i ones = _mm_set1_epi16(1);
+	__m128i total;
+
+	while (i + 8 <= noOfSamples)
+	{
+		end = (noOfSamples - i > WRAP_DECIMATION_SUM_BLOCK) ? i + WRAP_DECIMATION_SUM_BLOCK : noOfSamples;
+		total = _mm_setzero_si128();
+
+		for (; i + 8 <= end; i += 8)
+		{
+			// Multiplying by 1 and adding pairs widens the samples to 32 bits
+			total = _mm_add_epi32(total, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &source[i]), ones));
+		}
+
+		_mm_storeu_si128((__m128i *) lanes, total);
+		sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+
+	return sum + sumScalar(&source[i], noOfSamples - i);
+}
+
+#endif
+
+/****************************************************************************
+* minMaxSamples
+*
+* Calls minMaxSse2 or minMaxScalar depending on the processor.
+*
+****************************************************************************/
+static void minMaxSamples(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+#ifdef WRAP_SIMD_X86
+	if (getSimdLevel() >= WRAP_SIMD_SSE2)
+	{
+		minMaxSse2(maxSource, minSource, noOfSamples, maxValue, minValue);
+		return;
+	}
+#endif
+	minMaxScalar(maxSource, minSource, noOfSamples, maxValue, minValue);
+}
+
+/****************************************************************************
+* sumSamples
+*
+* Calls sumSse2 or sumScalar depending on the processor.
+*
+****************************************************************************/
+static int64_t sumSamples(const int16_t * source, uint32_t noOfSamples)
+{
+#ifdef WRAP_SIMD_X86
+	if (getSimdLevel() >= WRAP_SIMD_SSE2)
+	{
+		return sumSse2(source, noOfSamples);
+	}
+#endif
+	return sumScalar(source, noOfSamples);
+}
+
+/****************************************************************************
+* resetDecimationBlock
+*
+* Clears the state of the partly complete block for a channel.
+*
+****************************************************************************/
+static void resetDecimationBlock(WRAP_DECIMATION_INFO * decimation)
+{
+	decimation->blockCount = 0;
+	decimation->blockMax = INT16_MIN;
+	decimation->blockMin = INT16_MAX;
+	decimation->blockSum = 0;
+}
+
+/****************************************************************************
+* decimateStreamingData
+*
+* Adds noOfSamples samples to the decimation for a channel, writing a value 
+* to the application buffers each time a block of ratio samples completes.
+* minSource is only used in min/max mode, and may be the same as maxSource 
+* when the data is not aggregated.
+*
+****************************************************************************/
+static void decimateStreamingData(WRAP_DECIMATION_INFO * decimation, const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	uint32_t blockSamples = 0;
+	uint32_t outputIndex = 0;
+
+	while (i < noOfSamples)
+	{
+		blockSamples = decimation->ratio - decimation->blockCount;
+
+		if (blockSamples > noOfSamples - i)
+		{
+			blockSamples = noOfSamples - i;
+		}
+
+		switch (decimation->mode)
+		{
+			case WRAP_DECIMATION_MIN_MAX:
+				minMaxSamples(&maxSource[i], &minSource[i], blockSamples, &decimation->blockMax, &decimation->blockMin);
+				break;
+
+			case WRAP_DECIMATION_MEAN:
+				decimation->blockSum += sumSamples(&maxSource[i], blockSamples);
+				break;
+
+			case WRAP_DECIMATION_EVERY_NTH:
+				if (decimation->blockCount == 0)
+				{
+					decimation->blockMax = maxSource[i];
+				}
+				break;
+
+			default:
+				return;
+		}
+
+		decimation->blockCount += blockSamples;
+		i += blockSamples;
+
+		if (decimation->blockCount == decimation->ratio)
+		{
+			outputIndex = (uint32_t) (decimation->writeCount % decimation->bufferLength);
+
+			if (decimation->mode == WRAP_DECIMATION_MEAN)
+			{
+				decimation->appMaxBuffer[outputIndex] = (int16_t) (decimation->blockSum / (int64_t) decimation->ratio);
+			}
+			else
+			{
+				decimation->appMaxBuffer[outputIndex] = decimation->blockMax;
+			}
+
+			if (decimation->mode == WRAP_DECIMATION_MIN_MAX)
+			{
+				decimation->appMinBuffer[outputIndex] = decimation->blockMin;
+			}
+
+			// The release store makes sure the value is in the buffer before it is counted
+			WRAP_STORE_UINT64(&decimation->writeCount, decimation->writeCount + 1);
+
+			resetDecimationBlock(decimation);
+		}
+	}
+}
+
+/****************************************************************************
+* convertStreamingData
+*
+* Converts noOfSamples samples starting at startIndex in a driver buffer to 
+* volts, writing them at the same index in the float and double application 
+* buffers registered for it.
+*
+****************************************************************************/
+static void convertStreamingData(WRAP_BUFFER_INFO * wrapBufferInfo, int16_t channel, int16_t bufferIndex, uint32_t startIndex, uint32_t noOfSamples)
+{
+	float * floatBuffer = wrapBufferInfo->appFloatBuffers[bufferIndex];
+	double * doubleBuffer = wrapBufferInfo->appDoubleBuffers[bufferIndex];
+
+	if (wrapBufferInfo->driverBuffers[bufferIndex] == NULL || (floatBuffer == NULL && doubleBuffer == NULL))
+	{
+		return;
+	}
+
+	convertSamples(&wrapBufferInfo->scaling[channel], &wrapBufferInfo->driverBuffers[bufferIndex][startIndex], 
+		floatBuffer ? &floatBuffer[startIndex] : NULL, doubleBuffer ? &doubleBuffer[startIndex] : NULL, noOfSamples);
+}
+
+/****************************************************************************
+* processStreamingChannel
+*
+* Copies, converts and decimates the data for one enabled channel in the 
+* streaming callback. Called on the callback thread, or on a worker thread 
+* if the work is shared with the worker pool.
+*
+****************************************************************************/
+static void processStreamingChannel(WRAP_BUFFER_INFO * wrapBufferInfo, int16_t channel, uint32_t startIndex, uint32_t noOfSamples)
+{
+	// Max buffers
+	if (wrapBufferInfo->appBuffers[channel * 2] && wrapBufferInfo->driverBuffers[channel * 2])
+	{
+		copySamples(&wrapBufferInfo->appBuffers[channel * 2][startIndex], &wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
+	}
+
+	// Min buffers
+	if (wrapBufferInfo->appBuffers[channel * 2 + 1] && wrapBufferInfo->driverBuffers[channel * 2 + 1])
+	{
+		copySamples(&wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], &wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples);
+	}
+
+	// Conversion to volts
+	if (wrapBufferInfo->scaling[channel].maxADCValue > 0)
+	{
+		convertStreamingData(wrapBufferInfo, channel, channel * 2, startIndex, noOfSamples);
+		convertStreamingData(wrapBufferInfo, channel, channel * 2 + 1, startIndex, noOfSamples);
+	}
+
+	// Decimation
+	if (wrapBufferInfo->decimation[channel].mode != WRAP_DECIMATION_NONE && wrapBufferInfo->driverBuffers[channel * 2])
+	{
+		decimateStreamingData(&wrapBufferInfo->decimation[channel], &wrapBufferInfo->driverBuffers[channel * 2][startIndex],
+			wrapBufferInfo->driverBuffers[channel * 2 + 1] ? &wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex] : 
+			&wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
+	}
+}
+
+/****************************************************************************
+* getHostTimestamp
+*
+* Returns a monotonic host time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getHostTimestamp(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	LARGE_INTEGER counter;
+
+	// The frequency is fixed at boot, so it is only read once
+	if (_timestampFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&_timestampFrequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / _timestampFrequency.QuadPart) * 1000000 + 
+		((counter.QuadPart % _timestampFrequency.QuadPart) * 1000000) / _timestampFrequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
+}
+
+/****************************************************************************
+* pushStreamingEvent
+*
+* Adds a record of a streaming callback to the event queue. Called only from 
+* the streaming callback. If the queue is full, the record is discarded and 
+* counted as dropped.
+*
+****************************************************************************/
+static void pushStreamingEvent(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t numSamples, uint32_t startIndex, int16_t triggered, 
+	uint32_t triggeredAt, int16_t overflow, int16_t autoStop)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_STREAMING_EVENT_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+	event->numSamples = numSamples;
+	event->startIndex = startIndex;
+	event->triggered = triggered;
+	event->triggeredAt = triggeredAt;
+	event->overflow = overflow;
+	event->autoStop = autoStop;
+	event->timestamp = getHostTimestamp();
+
+	// Make sure the record is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* drainStreamingEventQueue
+*
+* Copies up to maxEvents records out of the event queue into a flat array and
+* removes them from the queue. Called only from DrainStreamingEvents.
+*
+****************************************************************************/
+static void drainStreamingEventQueue(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, 
+	uint32_t * droppedEvents)
+{
+	uint32_t readIndex = queue->readIndex;
+	uint32_t writeIndex = queue->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+		events[j]		= event->numSamples;
+		events[j + 1]	= event->startIndex;
+		events[j + 2]	= (uint32_t) event->triggered;
+		events[j + 3]	= event->triggeredAt;
+		events[j + 4]	= (uint32_t) (uint16_t) event->overflow;
+		events[j + 5]	= (uint32_t) event->autoStop;
+		events[j + 6]	= (uint32_t) (event->timestamp & 0xFFFFFFFF);
+		events[j + 7]	= (uint32_t) (event->timestamp >> 32);
+
+		j = j + WRAP_STREAMING_EVENT_FIELDS;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+}
+
+/****************************************************************************
+* logStreamingTrigger
+*
+* Adds the trigger reported by a streaming callback, if any, to the trigger 
+* log and advances the sample count past the samples in the callback. 
+* Called only from the streaming callback. If the log is full, the trigger 
+* is discarded and counted as dropped.
+*
+****************************************************************************/
+static void logStreamingTrigger(WRAP_TRIGGER_LOG * log, int32_t numSamples, int16_t triggered, uint32_t triggeredAt)
+{
+	uint32_t writeIndex = log->writeIndex;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	if (triggered)
+	{
+		if (writeIndex - log->readIndex >= WRAP_TRIGGER_LOG_SIZE)
+		{
+			log->droppedRecords = log->droppedRecords + 1;
+		}
+		else
+		{
+			record = &log->records[writeIndex & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+			record->sampleIndex = log->sampleCount + triggeredAt;
+			record->timestamp = getHostTimestamp();
+
+			// Make sure the record is complete before it is made visible to the reader
+			WRAP_MEMORY_BARRIER();
+
+			log->writeIndex = writeIndex + 1;
+		}
+	}
+
+	if (numSamples > 0)
+	{
+		log->sampleCount += (uint32_t) numSamples;
+	}
+}
+
+/****************************************************************************
+* drainTriggerLog
+*
+* Copies up to maxTriggers records out of the trigger log into a flat array
+* and removes them from the log. Called only from DrainTriggerLog.
+*
+****************************************************************************/
+static void drainTriggerLog(WRAP_TRIGGER_LOG * log, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, 
+	uint32_t * droppedTriggers)
+{
+	uint32_t readIndex = log->readIndex;
+	uint32_t writeIndex = log->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxTriggers)
+	{
+		count = maxTriggers;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &log->records[(readIndex + i) & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS]		= record->sampleIndex;
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS + 1]	= record->timestamp;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	log->readIndex = readIndex + count;
+	*nTriggers = count;
+
+	if (droppedTriggers != NULL)
+	{
+		dropped = log->droppedRecords;
+		*droppedTriggers = dropped - log->reportedDroppedRecords;
+		log->reportedDroppedRecords = dropped;
+	}
+}
+
+/****************************************************************************
+* copyTriggerHistory
+*
+* Copies count samples starting at position from (toHistory set) or to a 
+* history ring of length samples. The ring holds sample n at index 
+* n % length.
+*
+****************************************************************************/
+static void copyTriggerHistory(int16_t * ring, uint32_t length, uint64_t position, int16_t * samples, uint32_t count, int16_t toHistory)
+{
+	uint32_t index = (uint32_t) (position % length);
+	uint32_t first = (count < length - index) ? count : length - index;
+
+	if (toHistory)
+	{
+		memcpy(&ring[index], samples, first * sizeof(int16_t));
+		memcpy(ring, &samples[first], (count - first) * sizeof(int16_t));
+	}
+	else
+	{
+		memcpy(samples, &ring[index], first * sizeof(int16_t));
+		memcpy(&samples[first], ring, (count - first) * sizeof(int16_t));
+	}
+}
+
+/****************************************************************************
+* startTriggerCaptureRecord
+*
+* Starts a record for a trigger at triggerPosition, reported in a block 
+* starting at position, and copies in the pre-trigger samples held in the 
+* history rings. Pre-trigger samples from before the start of the capture 
+* are set to 0.
+*
+****************************************************************************/
+static void startTriggerCaptureRecord(WRAP_TRIGGER_CAPTURE * capture, uint64_t position, uint64_t triggerPosition, uint64_t sampleIndex)
+{
+	WRAP_TRIGGER_CAPTURE_RECORD * record = &capture->records[capture->startedRecords % capture->maxRecords];
+	int16_t * data = &capture->recordData[(size_t) (capture->startedRecords % capture->maxRecords) * capture->recordLength];
+	uint64_t windowStart = 0;
+	uint64_t historyStart = 0;
+	uint32_t missing = 0;
+	int16_t i = 0;
+
+	if (capture->startedRecords - capture->readIndex >= capture->maxRecords)
+	{
+		capture->droppedRecords = capture->droppedRecords + 1;
+		return;
+	}
+
+	if (triggerPosition < capture->preTriggerSamples)
+	{
+		missing = capture->preTriggerSamples - (uint32_t) triggerPosition;
+	}
+	else
+	{
+		windowStart = triggerPosition - capture->preTriggerSamples;
+	}
+
+	historyStart = windowStart;
+
+	for (i = 0; i < capture->nChannels; i++)
+	{
+		memset(&data[i * capture->windowLength], 0, missing * sizeof(int16_t));
+
+		if (historyStart < position)
+		{
+			copyTriggerHistory(&capture->history[i * capture->preTriggerSamples], capture->preTriggerSamples, historyStart, 
+				&data[i * capture->windowLength + missing], (uint32_t) (position - historyStart), 0);
+		}
+	}
+
+	record->triggerPosition = triggerPosition;
+	record->nextPosition = (historyStart < position) ? position : historyStart;
+	record->sampleIndex = sampleIndex;
+	record->timestamp = getHostTimestamp();
+
+	capture->startedRecords++;
+}
+
+/****************************************************************************
+* captureTriggerWindows
+*
+* Updates the trigger capture for one streaming callback: starts a record if
+* a trigger was reported, copies the samples in the block into the records 
+* that need them, completes any records that are full and updates the 
+* history rings. Called only from the streaming callback.
+*
+****************************************************************************/
+static void captureTriggerWindows(WRAP_UNIT_INFO * wrapUnitInfo, int32_t noOfSamples, uint32_t startIndex, int16_t triggered, uint32_t triggeredAt)
+{
+	WRAP_TRIGGER_CAPTURE * capture = wrapUnitInfo->triggerCapture;
+	WRAP_TRIGGER_CAPTURE_RECORD * record = NULL;
+	int16_t * source = NULL;
+	int16_t * data = NULL;
+	uint64_t position = 0;
+	uint64_t end = 0;
+	uint64_t windowEnd = 0;
+	uint32_t numSamples = (noOfSamples > 0) ? (uint32_t) noOfSamples : 0;
+	uint32_t count = 0;
+	uint32_t offset = 0;
+	uint32_t r = 0;
+	int16_t i = 0;
+
+	if (capture == NULL)
+	{
+		return;
+	}
+
+	position = capture->samplesSeen;
+	end = position + numSamples;
+
+	if (triggered)
+	{
+		startTriggerCaptureRecord(capture, position, position + triggeredAt, wrapUnitInfo->triggerLog.sampleCount + triggeredAt);
+	}
+
+	// Copy the block into every record still being filled
+	for (r = capture->writeIndex; r != capture->startedRecords; r++)
+	{
+		record = &capture->records[r % capture->maxRecords];
+		data = &capture->recordData[(size_t) (r % capture->maxRecords) * capture->recordLength];
+		windowEnd = record->triggerPosition + capture->postTriggerSamples;
+
+		if (record->nextPosition >= end || record->nextPosition >= windowEnd)
+		{
+			continue;
+		}
+
+		count = (uint32_t) (((end < windowEnd) ? end : windowEnd) - record->nextPosition);
+		offset = (uint32_t) (record->nextPosition + capture->preTriggerSamples - record->triggerPosition);
+
+		for (i = 0; i < capture->nChannels; i++)
+		{
+			source = wrapUnitInfo->wrapBufferInfo.driverBuffers[capture->channels[i] * 2];
+
+			if (source != NULL)
+			{
+				memcpy(&data[i * capture->windowLength + offset], &source[startIndex + (uint32_t) (record->nextPosition - position)], count * sizeof(int16_t));
+			}
+			else
+			{
+				memset(&data[i * capture->windowLength + offset], 0, count * sizeof(int16_t));
+			}
+		}
+
+		record->nextPosition += count;
+	}
+
+	// Records complete in the order they were started
+	while (capture->writeIndex != capture->startedRecords)
+	{
+		record = &capture->records[capture->writeIndex % capture->maxRecords];
+
+		if (record->nextPosition < record->triggerPosition + capture->postTriggerSamples)
+		{
+			break;
+		}
+
+		// Make sure the record is complete before it is made visible to the reader
+		WRAP_MEMORY_BARRIER();
+
+		capture->writeIndex = capture->writeIndex + 1;
+	}
+
+	// Keep the last preTriggerSamples samples of each channel
+	if (capture->preTriggerSamples > 0 && numSamples > 0)
+	{
+		count = (numSamples < capture->preTriggerSamples) ? numSamples : capture->preTriggerSamples;
+
+		for (i = 0; i < capture->nChannels; i++)
+		{
+			source = wrapUnitInfo->wrapBufferInfo.driverBuffers[capture->channels[i] * 2];
+
+			if (source != NULL)
+			{
+				copyTriggerHistory(&capture->history[i * capture->preTriggerSamples], capture->preTriggerSamples, end - count, 
+					&source[startIndex + numSamples - count], count, 1);
+			}
+		}
+	}
+
+	capture->samplesSeen = end;
+}
+
+/****************************************************************************
+* freeTriggerCapture
+*
+* Frees a trigger capture and its buffers.
+*
+****************************************************************************/
+static void freeTriggerCapture(WRAP_TRIGGER_CAPTURE * capture)
+{
+	if (capture == NULL)
+	{
+		return;
+	}
+
+	free(capture->history);
+	free(capture->recordData);
+	free(capture->records);
+	free(capture);
+}
+
+/****************************************************************************
+* initMonotonicCondition
+*
+* Initialises a condition variable whose timed waits are measured against 
+* CLOCK_MONOTONIC, so that waitForReady is not affected by changes to the 
+* system time.
+*
+****************************************************************************/
+#if !defined(WIN32) && !defined(_WIN64)
+static void initMonotonicCondition(WRAP_CONDITION * condition)
+{
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+#endif
+
+/****************************************************************************
+* setReady
+*
+* Sets a ready flag and wakes any threads waiting for it in waitForReady.
+*
+****************************************************************************/
+static void setReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(lock);
+	*ready = 1;
+	ReleaseSRWLockExclusive(lock);
+	WakeAllConditionVariable(condition);
+#else
+	pthread_mutex_lock(lock);
+	*ready = 1;
+	pthread_cond_broadcast(condition);
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+/****************************************************************************
+* waitForReady
+*
+* Blocks the calling thread until a ready flag is set by setReady or the 
+* timeout expires, and returns the value of the flag. A timeout of 
+* WRAP_WAIT_INFINITE waits indefinitely.
+*
+****************************************************************************/
+static int16_t waitForReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready, uint32_t timeoutMs)
+{
+	int16_t isReady = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	ULONGLONG now = 0;
+
+	AcquireSRWLockExclusive(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+			continue;
+		}
+
+		now = GetTickCount64();
+
+		if (now >= deadline)
+		{
+			break;
+		}
+
+		SleepConditionVariableSRW(condition, lock, (DWORD) (deadline - now), 0);
+	}
+
+	isReady = *ready;
+	ReleaseSRWLockExclusive(lock);
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			pthread_cond_wait(condition, lock);
+		}
+		else if (pthread_cond_timedwait(condition, lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	isReady = *ready;
+	pthread_mutex_unlock(lock);
+#endif
+
+	return isReady;
+}
+
+/****************************************************************************
+* publishStreamingSnapshot
+*
+* Copies the streaming status into the snapshot read by GetStreamingSnapshot,
+* with ready set to the value given. Writers are serialised by snapshotLock.
+*
+****************************************************************************/
+static void publishStreamingSnapshot(WRAP_UNIT_INFO * wrapUnitInfo, int16_t ready)
+{
+	WRAP_STREAMING_SNAPSHOT * snapshot = &wrapUnitInfo->snapshot;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->snapshotLock);
+#endif
+
+	snapshot->sequence++;
+	WRAP_MEMORY_BARRIER();
+
+	snapshot->ready = ready;
+	snapshot->numSamples = wrapUnitInfo->numSamples;
+	snapshot->startIndex = wrapUnitInfo->startIndex;
+	snapshot->triggered = wrapUnitInfo->triggered;
+	snapshot->triggeredAt = wrapUnitInfo->triggeredAt;
+	snapshot->overflow = wrapUnitInfo->overflow;
+	snapshot->autoStop = wrapUnitInfo->autoStop;
+	snapshot->callbackCount = wrapUnitInfo->callbackCount;
+
+	WRAP_MEMORY_BARRIER();
+	snapshot->sequence++;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->snapshotLock);
+#endif
+}
+
+/****************************************************************************
+* getWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device, creating it the first time the handle is used.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_MEMORY_FAIL, if the structure could not be allocated.
+*
+****************************************************************************/
+static PICO_STATUS getWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	WRAP_UNIT_INFO * unitInfo = NULL;
+
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo != NULL)
+	{
+		*wrapUnitInfo = unitInfo;
+		return PICO_OK;
+	}
+
+	// Threads using a new handle at the same time must share one structure
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo == NULL)
+	{
+		unitInfo = (WRAP_UNIT_INFO *) calloc(1, sizeof(WRAP_UNIT_INFO));
+
+		if (unitInfo != NULL)
+		{
+			unitInfo->handle = handle;
+
+#if defined(WIN32) || defined(_WIN64)
+			InitializeSRWLock(&unitInfo->readyLock);
+			InitializeConditionVariable(&unitInfo->readyCondition);
+			InitializeSRWLock(&unitInfo->snapshotLock);
+			InitializeSRWLock(&unitInfo->workerPool.lock);
+			InitializeConditionVariable(&unitInfo->workerPool.startCondition);
+			InitializeConditionVariable(&unitInfo->workerPool.doneCondition);
+#else
+			pthread_mutex_init(&unitInfo->readyLock, NULL);
+			initMonotonicCondition(&unitInfo->readyCondition);
+			pthread_mutex_init(&unitInfo->snapshotLock, NULL);
+			pthread_mutex_init(&unitInfo->workerPool.lock, NULL);
+			pthread_cond_init(&unitInfo->workerPool.startCondition, NULL);
+			pthread_cond_init(&unitInfo->workerPool.doneCondition, NULL);
+#endif
+
+			WRAP_MEMORY_BARRIER();
+
+			_wrapUnitInfo[handle] = unitInfo;
+		}
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (unitInfo == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	*wrapUnitInfo = unitInfo;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* findWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device without creating it. Used by the functions that only read or clear
+* the results of a capture, which have nothing to report for a device that 
+* has not been set up.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS findWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	if (handle <= 0 || _wrapUnitInfo[handle] == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	*wrapUnitInfo = _wrapUnitInfo[handle];
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* beginStreamingCall
+*
+* Finds the wrapper state for a device and records that a call to the 
+* driver that may run StreamingCallback with it is in progress, so that 
+* releaseWrapUnitInfo does not free the state until endStreamingCall.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS beginStreamingCall(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	PICO_STATUS status = PICO_OK;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	status = findWrapUnitInfo(handle, wrapUnitInfo);
+
+	if (status == PICO_OK)
+	{
+		(*wrapUnitInfo)->streamingCallsInProgress++;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	return status;
+}
+
+/****************************************************************************
+* endStreamingCall
+*
+* Records the end of a call started with beginStreamingCall and wakes 
+* releaseWrapUnitInfo if it is waiting for the state of the device.
+*
+****************************************************************************/
+static void endStreamingCall(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+	WakeAllConditionVariable(&_wrapUnitInfoCondition);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	pthread_cond_broadcast(&_wrapUnitInfoCondition);
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* lockWorkerPool, unlockWorkerPool, waitWorkerPool, wakeWorkerPool
+*
+* Lock and condition variable operations on a worker pool.
+*
+****************************************************************************/
+static void lockWorkerPool(WRAP_WORKER_POOL * pool)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&pool->lock);
+#else
+	pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void unlockWorkerPool(WRAP_WORKER_POOL * pool)
+{
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&pool->lock);
+#else
+	pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+static void waitWorkerPool(WRAP_WORKER_POOL * pool, WRAP_CONDITION * condition)
+{
+#if defined(WIN32) || defined(_WIN64)
+	SleepConditionVariableSRW(condition, &pool->lock, INFINITE, 0);
+#else
+	pthread_cond_wait(condition, &pool->lock);
+#endif
+}
+
+static void wakeWorkerPool(WRAP_CONDITION * condition)
+{
+#if defined(WIN32) || defined(_WIN64)
+	WakeAllConditionVariable(condition);
+#else
+	pthread_cond_broadcast(condition);
+#endif
+}
+
+/****************************************************************************
+* runPostedChannels
+*
+* Takes channels posted to the worker pool one at a time and processes them
+* until none are left. Run by the callback thread and the workers.
+*
+****************************************************************************/
+static void runPostedChannels(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	WRAP_WORKER_POOL * pool = &wrapUnitInfo->workerPool;
+	int16_t channel = 0;
+
+	lockWorkerPool(pool);
+
+	while (pool->nextChannel < pool->nChannels)
+	{
+		channel = pool->channels[pool->nextChannel++];
+		unlockWorkerPool(pool);
+
+		processStreamingChannel(&wrapUnitInfo->wrapBufferInfo, channel, pool->startIndex, pool->noOfSamples);
+
+		lockWorkerPool(pool);
+
+		if (--pool->channelsRemaining == 0)
+		{
+			wakeWorkerPool(&pool->doneCondition);
+		}
+	}
+
+	unlockWorkerPool(pool);
+}
+
+/****************************************************************************
+* processChannelsInParallel
+*
+* Posts the channels for one streaming callback to the worker pool, helps 
+* to process them, and waits until every channel is finished.
+*
+****************************************************************************/
+static void processChannelsInParallel(WRAP_UNIT_INFO * wrapUnitInfo, const int16_t * channels, int16_t nChannels, uint32_t startIndex, uint32_t noOfSamples)
+{
+	WRAP_WORKER_POOL * pool = &wrapUnitInfo->workerPool;
+
+	lockWorkerPool(pool);
+
+	memcpy_s(pool->channels, sizeof(pool->channels), channels, nChannels * sizeof(int16_t));
+	pool->nChannels = nChannels;
+	pool->nextChannel = 0;
+	pool->channelsRemaining = nChannels;
+	pool->startIndex = startIndex;
+	pool->noOfSamples = noOfSamples;
+	pool->generation++;
+
+	unlockWorkerPool(pool);
+	wakeWorkerPool(&pool->startCondition);
+
+	runPostedChannels(wrapUnitInfo);
+
+	lockWorkerPool(pool);
+
+	while (pool->channelsRemaining > 0)
+	{
+		waitWorkerPool(pool, &pool->doneCondition);
+	}
+
+	unlockWorkerPool(pool);
+}
+
+/****************************************************************************
+* runStreamingWorker
+*
+* Body of a worker thread. Waits for the streaming callback to post 
+* channels and helps to process them, until the pool is stopped.
+*
+****************************************************************************/
+static void runStreamingWorker(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	WRAP_WORKER_POOL * pool = &wrapUnitInfo->workerPool;
+	uint32_t generation = 0;
+
+	lockWorkerPool(pool);
+
+	generation = pool->generation;
+
+	while (!pool->stopRequested)
+	{
+		if (pool->generation == generation)
+		{
+			waitWorkerPool(pool, &pool->startCondition);
+			continue;
+		}
+
+		generation = pool->generation;
+		unlockWorkerPool(pool);
+
+		runPostedChannels(wrapUnitInfo);
+
+		lockWorkerPool(pool);
+	}
+
+	unlockWorkerPool(pool);
+}
+
+#if defined(WIN32) || defined(_WIN64)
+static DWORD WINAPI streamingWorkerThread(LPVOID parameter)
+{
+	runStreamingWorker((WRAP_UNIT_INFO *) parameter);
+	return 0;
+}
+#else
+static void * streamingWorkerThread(void * parameter)
+{
+	runStreamingWorker((WRAP_UNIT_INFO *) parameter);
+	return NULL;
+}
+#endif
+
+/****************************************************************************
+* stopWorkerPool
+*
+* Asks the worker threads of a device to stop and waits for them to exit.
+*
+****************************************************************************/
+static void stopWorkerPool(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	WRAP_WORKER_POOL * pool = &wrapUnitInfo->workerPool;
+	int16_t i = 0;
+
+	if (pool->nWorkers == 0)
+	{
+		return;
+	}
+
+	lockWorkerPool(pool);
+	pool->stopRequested = 1;
+	unlockWorkerPool(pool);
+
+	wakeWorkerPool(&pool->startCondition);
+
+	for (i = 0; i < pool->nWorkers; i++)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		WaitForSingleObject(pool->threads[i], INFINITE);
+		CloseHandle(pool->threads[i]);
+#else
+		pthread_join(pool->threads[i], NULL);
+#endif
+	}
+
+	pool->nWorkers = 0;
+	pool->stopRequested = 0;
+}
+
+/****************************************************************************
+* startWorkerPool
+*
+* Starts nWorkers worker threads for a device. If firstCpu is 0 or more, 
+* worker n is pinned to processor firstCpu + n where the operating system 
+* allows it; otherwise the workers may run on any processor.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_OPERATION_FAILED, if a thread could not be created. Any workers 
+*							already started are stopped.
+*
+****************************************************************************/
+static PICO_STATUS startWorkerPool(WRAP_UNIT_INFO * wrapUnitInfo, int16_t nWorkers, int16_t firstCpu)
+{
+	WRAP_WORKER_POOL * pool = &wrapUnitInfo->workerPool;
+	int16_t i = 0;
+#if !defined(WIN32) && !defined(_WIN64) && defined(__linux__)
+	cpu_set_t cpuSet;
+#endif
+
+	for (i = 0; i < nWorkers; i++)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		pool->threads[i] = CreateThread(NULL, 0, streamingWorkerThread, wrapUnitInfo, 0, NULL);
+
+		if (pool->threads[i] == NULL)
+#else
+		if (pthread_create(&pool->threads[i], NULL, streamingWorkerThread, wrapUnitInfo) != 0)
+#endif
+		{
+			pool->nWorkers = i;
+			stopWorkerPool(wrapUnitInfo);
+			return PICO_OPERATION_FAILED;
+		}
+
+		// Pinning is only a preference - a processor that does not exist leaves the worker unpinned
+		if (firstCpu >= 0)
+		{
+#if defined(WIN32) || defined(_WIN64)
+			if (firstCpu + i < (int16_t) (sizeof(DWORD_PTR) * 8))
+			{
+				SetThreadAffinityMask(pool->threads[i], (DWORD_PTR) 1 << (firstCpu + i));
+			}
+#elif defined(__linux__)
+			if (firstCpu + i < CPU_SETSIZE)
+			{
+				CPU_ZERO(&cpuSet);
+				CPU_SET(firstCpu + i, &cpuSet);
+				pthread_setaffinity_np(pool->threads[i], sizeof(cpu_set_t), &cpuSet);
+			}
+#endif
+		}
+	}
+
+	pool->nWorkers = nWorkers;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* Streaming Callback
+*
+* See ps4000aStreamingReady (callback)
+*
+****************************************************************************/
+void PREF1 StreamingCallback(
+    int16_t handle,
+	int32_t noOfSamples,
+	uint32_t startIndex,
+	int16_t overflow,
+	uint32_t triggerAt,
+	int16_t triggered,
+	int16_t autoStop,
+	void * pParameter)
+{
+	int16_t channel = 0;
+	int16_t channels[PS4000A_MAX_CHANNELS];
+	int16_t nChannels = 0;
+	int16_t i = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
+	
+	if (pParameter == NULL)
+	{
+		return;
+	}
+
+	wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+	_wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+
+	wrapUnitInfo->numSamples = noOfSamples;
+	wrapUnitInfo->autoStop = autoStop;
+	wrapUnitInfo->startIndex = startIndex;
+
+	wrapUnitInfo->triggered = triggered;
+	wrapUnitInfo->triggeredAt = triggerAt;
+
+	wrapUnitInfo->overflow = overflow;
+
+	if (noOfSamples)
+	{
+		for (channel = (int16_t) PS4000A_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+		{
+			if (wrapUnitInfo->enabledChannels[channel])
+			{
+				channels[nChannels++] = channel;
+			}
+		}
+
+		// Share the channels with the worker pool if there is enough data to be worth waking it
+		if (wrapUnitInfo->workerPool.nWorkers > 0 && nChannels > 1 && (uint32_t) noOfSamples >= wrapUnitInfo->workerPool.parallelThreshold)
+		{
+			processChannelsInParallel(wrapUnitInfo, channels, nChannels, startIndex, noOfSamples);
+		}
+		else
+		{
+			for (i = 0; i < nChannels; i++)
+			{
+				processStreamingChannel(_wrapBufferInfo, channels[i], startIndex, noOfSamples);
+			}
+		}
+	}
+  
+  captureTriggerWindows(wrapUnitInfo, noOfSamples, startIndex, triggered, triggerAt);
+  logStreamingTrigger(&wrapUnitInfo->triggerLog, noOfSamples, triggered, triggerAt);
+  pushStreamingEvent(&wrapUnitInfo->eventQueue, noOfSamples, startIndex, triggered, triggerAt, overflow, autoStop);
+
+  wrapUnitInfo->callbackCount++;
+  publishStreamingSnapshot(wrapUnitInfo, 1);
+
+  setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+}
+
+/****************************************************************************
+* BlockCallback
+*
+* See ps4000aBlockReady (callback)
+*
+****************************************************************************/
+void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+{
+  WRAP_UNIT_INFO * wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+
+  // Holding the lock stops releaseWrapUnitInfo freeing the state until the callback has finished
+#if defined(WIN32) || defined(_WIN64)
+  AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+  pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+  // The state may have been released since the capture was started
+  if (wrapUnitInfo != NULL && handle > 0 && _wrapUnitInfo[handle] == wrapUnitInfo)
+  {
+    publishStreamingSnapshot(wrapUnitInfo, 1);
+    setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+  }
+
+#if defined(WIN32) || defined(_WIN64)
+  ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+  pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* Probe Interaction Callback
+*
+* See ps4000aProbeInteractions (callback)
+*
+****************************************************************************/
+void PREF4 ProbeInteractions(int16_t handle, PICO_STATUS status, PS4000A_USER_PROBE_INTERACTIONS * probes, uint32_t	nProbes)
+{
+	uint32_t i = 0;
+	WRAP_USER_PROBE_INFO * wrapUserProbeInfo = NULL;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	// This callback has no parameter argument, so find the device state from the handle, 
+	// holding the lock so that releaseWrapUnitInfo cannot free it until the callback has finished
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+		pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+		return;
+	}
+
+	wrapUserProbeInfo = &wrapUnitInfo->userProbeInfo;
+
+	wrapUserProbeInfo->status = status;
+	wrapUserProbeInfo->numberOfProbes = nProbes;
+
+	for (i = 0; i < nProbes; ++i)
+	{
+		wrapUserProbeInfo->userProbeInteractions[i].connected = probes[i].connected;
+
+		wrapUserProbeInfo->userProbeInteractions[i].channel			= probes[i].channel;
+		wrapUserProbeInfo->userProbeInteractions[i].enabled			= probes[i].enabled;
+
+		wrapUserProbeInfo->userProbeInteractions[i].probeName		= probes[i].probeName;
+
+		wrapUserProbeInfo->userProbeInteractions[i].requiresPower_	= probes[i].requiresPower_;
+		wrapUserProbeInfo->userProbeInteractions[i].isPowered_		= probes[i].isPowered_;
+
+		wrapUserProbeInfo->userProbeInteractions[i].status_			= probes[i].status_;
+
+		wrapUserProbeInfo->userProbeInteractions[i].probeOff			= probes[i].probeOff;
+
+		wrapUserProbeInfo->userProbeInteractions[i].rangeFirst_		= probes[i].rangeFirst_;
+		wrapUserProbeInfo->userProbeInteractions[i].rangeLast_		= probes[i].rangeLast_;
+		wrapUserProbeInfo->userProbeInteractions[i].rangeCurrent_	= probes[i].rangeLast_;
+
+		wrapUserProbeInfo->userProbeInteractions[i].couplingFirst_	= probes[i].couplingFirst_;
+		wrapUserProbeInfo->userProbeInteractions[i].couplingLast_	= probes[i].couplingLast_;
+		wrapUserProbeInfo->userProbeInteractions[i].couplingCurrent_ = probes[i].couplingCurrent_;
+
+		wrapUserProbeInfo->userProbeInteractions[i].filterFlags_		= probes[i].filterFlags_;
+		wrapUserProbeInfo->userProbeInteractions[i].filterCurrent_	= probes[i].filterCurrent_;
+		wrapUserProbeInfo->userProbeInteractions[i].defaultFilter_	= probes[i].defaultFilter_;
+	}
+
+	wrapUnitInfo->probeStateChanged = 1;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* RunBlock
+*
+* This function starts collecting data in block mode without the requirement 
+* for specifying callback functions. Use the IsReady function in conjunction 
+* to poll the driver once this function has been called.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* preTriggerSamples - see noOfPreTriggerSamples in ps4000aRunBlock.
+* postTriggerSamples - see noOfPreTriggerSamples in ps4000aRunBlock.
+* timebase - see ps4000aRunBlock.
+* segmentIndex - see ps4000aRunBlock.
+*
+*
+* Returns:
+*
+* See ps4000aRunBlock return values.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 RunBlock(int16_t handle, int32_t preTriggerSamples, int32_t postTriggerSamples,
+            uint32_t timebase, uint32_t segmentIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = preTriggerSamples + postTriggerSamples;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	return ps4000aRunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, 
+		NULL, segmentIndex, BlockCallback, wrapUnitInfo);
+}
+
+/****************************************************************************
+* GetStreamingLatestValues
+*
+* facilitates communication with the driver to return the next block of 
+* values to your application when capturing data in streaming mode. Use with 
+* programming languages that do not support callback functions.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* See ps4000aGetStreamingLatestValues return values.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = beginStreamingCall(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = 0;
+	wrapUnitInfo->autoStop = 0;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	status = ps4000aGetStreamingLatestValues(handle, StreamingCallback, wrapUnitInfo);
+
+	endStreamingCall(wrapUnitInfo);
+
+	return status;
+}
+
+/****************************************************************************
+* Available Data
+*
+* Returns the number of samples returned from the driver and shows 
+* the start index of the data in the buffer when collecting data in 
+* streaming mode.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* startIndex - on exit, an index to the first valid sample in the buffer 
+*				(When data is available).
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - the number of samples returned from the driver.
+*
+****************************************************************************/
+extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if ( wrapUnitInfo->ready ) 
+	{
+		*startIndex = wrapUnitInfo->startIndex;
+		return wrapUnitInfo->numSamples;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+* AutoStopped
+*
+* Indicates if the device has stopped on collection of the number of samples 
+* specified in the call to the ps4000aRunStreaming function (if the 
+* ps4000aRunStreaming function's autostop flag is set).
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* Non-zero - if streaming has autostopped.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if ( wrapUnitInfo->ready) 
+	{
+		return wrapUnitInfo->autoStop;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/****************************************************************************
+* IsReady
+*
+* This function is used to poll the driver to verify that data is ready to be 
+* received. The RunBlock or GetStreamingLatestValues function must have been 
+* called prior to calling this function.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return wrapUnitInfo->ready;
+}
+
+/****************************************************************************
+* WaitForStreamingData
+*
+* Blocks the calling thread until the streaming callback has been called 
+* following a call to GetStreamingLatestValues, or until the timeout 
+* expires. Use this function instead of polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - Data is not yet available (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForStreamingData(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* WaitForBlockReady
+*
+* Blocks the calling thread until a block mode capture started with RunBlock
+* has completed, or until the timeout expires. Use this function instead of
+* polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - The capture has not completed (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForBlockReady(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* IsTriggerReady
+*
+* Indicates whether a trigger has occurred when collecting data in streaming 
+* mode, and the location of the trigger point in the buffer.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* triggeredAt � on exit, the index of the sample in the buffer where the 
+* trigger occurred.
+*
+* Returns:
+*
+* 0 - The device has not triggered.
+* Non-zero - The device has been triggered.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if (wrapUnitInfo->triggered)
+	{
+		*triggeredAt = wrapUnitInfo->triggeredAt;
+	}
+
+	return wrapUnitInfo->triggered;
+}
+
+/****************************************************************************
+* ClearTriggerReady
+*
+* Clears the triggered and triggeredAt flags in relation to streaming mode 
+* capture.
+*
+* Triggers recorded for DrainTriggerLog are not affected.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* 1
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 ClearTriggerReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		wrapUnitInfo->triggeredAt = 0;
+		wrapUnitInfo->triggered = FALSE;
+	}
+
+	return 1;
+}
+
+/****************************************************************************
+* setChannelCount
+*
+* Sets the number of channels on the device. This is used to assist with 
+* copying data in the streaming callback.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channelCount - the number of channels on the device.
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if channelCount is less than 0 or greater than
+*	the number of analogue channels
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channelCount > 0 && channelCount <= PS4000A_MAX_CHANNELS)
+		{
+			wrapUnitInfo->channelCount = channelCount;
+
+			return PICO_OK;
+		}
+		else
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
 	}
 }
 
 /****************************************************************************
 * setEnabledChannels
 *
-* Sets the number of enabled channels on the device. This is used to assist with 
-* copying data in the streaming callback.
+* Sets the number of enabled channels on the device. This is used to assist with 
+* copying data in the streaming callback.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* enabledChannels - an array representing the channel states. This should be 
+*					8 elements in size.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if the channel count is invalid
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (wrapUnitInfo->channelCount > 0 && wrapUnitInfo->channelCount <= PS4000A_MAX_CHANNELS)
+		{
+			memcpy_s((int16_t *)wrapUnitInfo->enabledChannels, PS4000A_MAX_CHANNELS * sizeof(int16_t), 
+				(int16_t *)enabledChannels, PS4000A_MAX_CHANNELS * sizeof(int16_t));
+			
+			return PICO_OK;
+		}
+		else
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+}
+
+/****************************************************************************
+* setAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffer in order for the 
+* streaming callback to copy the data for the channel from the driver buffer 
+* to the application buffer.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* appBuffer - the application buffer.
+* driverBuffer - the buffer set by the driver.
+* bufferLength - the length of the buffers (the length of the buffers must be
+*				 equal).
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
+				
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+}
+
+/****************************************************************************
+* setMaxMinAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffers in order for the 
+* streaming callback to copy the data for the channel from the driver max and 
+* min buffers to the respective application buffers for aggregated data 
+* collection.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* appMaxBuffer - the application max buffer.
+* appMinBuffer - the application min buffer.
+* driverMaxBuffer - the max buffer set by the driver.
+* driverMinBuffer - the min buffer set by the driver.
+* bufferLength - the length of the buffers (the length of the buffers must be
+*				 equal).
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
+
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
+
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* setTriggerConditions
+*
+* This function sets up trigger conditions on the scope's inputs. The trigger 
+* is defined by one or more sets of integers corresponding to 
+* PS4000A_CONDITION structures which are then converted and passed 
+* to the ps4000aSetTriggerChannelConditions function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* conditionsArray - an array of integer values specifying the conditions 
+*					for each channel.
+* nConditions - the number that will be passed after the wrapper code has 
+*				created its structures
+				(i.e. the number of conditionsArray elements / 2).
+* info - see info in ps4000SetTriggerChannelConditions. 
+*
+* Returns:
+*
+* See ps4000aSetTriggerChannelConditions return values.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions, int32_t info)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS4000A_CONDITION *conditions = (PS4000A_CONDITION *) calloc(nConditions, sizeof(PS4000A_CONDITION));
+
+	for (i = 0; i < nConditions; i++)
+	{
+		conditions[i].source	= (PS4000A_CHANNEL) conditionsArray[j];
+		conditions[i].condition = (PS4000A_TRIGGER_STATE) conditionsArray[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps4000aSetTriggerChannelConditions(handle, conditions, nConditions, (PS4000A_CONDITIONS_INFO) info);
+	free(conditions);
+
+	return status;
+}
+
+/****************************************************************************
+* setTriggerDirections
+*
+* This function sets the direction of the trigger for the specified channels.
+* The trigger direction(s) is(are) defined by one or more sets of integers 
+* corresponding to PS4000A_DIRECTION structures which are then converted and 
+* passed to the ps4000aSetTriggerChannelDirections function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* directionsArray - an array of integer values specifying the directions 
+*					for each channel.
+* nDirections - the number that will be passed after the wrapper code has 
+*				created its structures 
+*				(i.e. the number of directionsArray elements / 2).
+*
+* Returns:
+*
+* See ps4000aSetTriggerChannelDirections return values.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setTriggerDirections(int16_t handle, int32_t *directionsArray, int16_t nDirections)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS4000A_DIRECTION *directions = (PS4000A_DIRECTION *) calloc(nDirections, sizeof(PS4000A_DIRECTION));
+
+	for (i = 0; i < nDirections; i++)
+	{
+		directions[i].channel	= (PS4000A_CHANNEL) directionsArray[j];
+		directions[i].direction = (PS4000A_THRESHOLD_DIRECTION) directionsArray[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps4000aSetTriggerChannelDirections(handle, directions, nDirections);
+	free(directions);
+
+	return status;
+}
+
+/****************************************************************************
+* setTriggerProperties
+*
+* This function is used to enable or disable triggering and set its
+* parameters by means of assigning the values from the propertiesArray to an
+* array of PS4000A_TRIGGER_CHANNEL_PROPERTIES structures which are then 
+* passed to the ps4000aSetTriggerChannelProperties function with the other 
+* parameters.
+
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* propertiesArray - an array of sets of integers corresponding to
+*					PS4000A_TRIGGER_CHANNEL_PROPERTIES structures describing the
+*					required properties to be set. See also channelProperties
+*					in ps4000aSetTriggerChannelProperties.
+* nProperties - the number that will be passed after the wrapper code has
+*				created its structures. (i.e. the number of propertiesArray
+*				elements / 6).
+* autoTrig - see autoTriggerMilliseconds in ps4000aSetTriggerChannelProperties.
+*
+*
+* Returns:
+*
+* See ps4000aSetChannelTriggerProperties return values.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setTriggerProperties(int16_t handle, int32_t *propertiesArray, int16_t nProperties, int32_t autoTrig)
+{
+	PS4000A_TRIGGER_CHANNEL_PROPERTIES *channelProperties = (PS4000A_TRIGGER_CHANNEL_PROPERTIES *) 
+																calloc(nProperties, sizeof(PS4000A_TRIGGER_CHANNEL_PROPERTIES));
+	
+	int16_t i;
+	int16_t j = 0;
+	int16_t auxEnable = 0;
+	PICO_STATUS status;
+
+	for (i = 0; i < nProperties; i++)
+	{
+		channelProperties[i].thresholdUpper				= (int16_t) propertiesArray[j];
+		channelProperties[i].thresholdUpperHysteresis	= (uint16_t) propertiesArray[j + 1];
+		channelProperties[i].thresholdLower				= (int16_t) propertiesArray[j + 2];
+		channelProperties[i].thresholdLowerHysteresis	= (uint16_t) propertiesArray[j + 3];
+		channelProperties[i].channel					= (PS4000A_CHANNEL) propertiesArray[j + 4];
+		channelProperties[i].thresholdMode				= (PS4000A_THRESHOLD_MODE) propertiesArray[j + 5];
+
+		j = j + 6;
+	}
+	status = ps4000aSetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
+	free(channelProperties);
+
+	return status;
+}
+
+/****************************************************************************
+* setPulseWidthQualifierConditions
+*
+* This function sets up the conditions for pulse width qualification. 
+* The pulse width qualifier (PWQ) is defined by one or more sets of integers 
+* corresponding to PS4000A_CONDITION structures which are then converted 
+* and passed to the ps4000aSetPulseWidthQualifierConditions function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* conditionsArray - an array of integer values specifying the PWQ conditions
+*					for each channel.
+* nConditions - the number that will be passed after the wrapper code has
+*				created its structures
+(i.e. the number of conditionsArray elements / 2).
+* info - see info in ps4000SetTriggerChannelConditions.
+*
+* Returns:
+*
+* See ps4000aSetPulseWidthQualifierConditions.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setPulseWidthQualifierConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions, int32_t info)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS4000A_CONDITION *conditions = (PS4000A_CONDITION *)calloc(nConditions, sizeof(PS4000A_CONDITION));
+
+	for (i = 0; i < nConditions; i++)
+	{
+		conditions[i].source = (PS4000A_CHANNEL)conditionsArray[j];
+		conditions[i].condition = (PS4000A_TRIGGER_STATE)conditionsArray[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps4000aSetPulseWidthQualifierConditions(handle, conditions, nConditions, (PS4000A_CONDITIONS_INFO)info);
+	free(conditions);
+
+	return status;
+}
+
+/****************************************************************************
+* setProbeInteractionCallback
+*
+* This function sets the ProbeInteractions callback with the ps4000a driver.
+* This function should be called after the PicoScope 4444 device has been
+* successfully opened and before any call to ps4000aSetChannel().
+* Use with programming languages that do not support callback functions.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+*
+* Returns:
+*
+* See ps4000aSetProbeInteractionCallback.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setProbeInteractionCallback(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->probeStateChanged = 0;
+	return ps4000aSetProbeInteractionCallback(handle, ProbeInteractions);
+	
+}
+
+/****************************************************************************
+* hasProbeStateChanged
+*
+* This function sets the ProbeInteractions callback with the ps4000a driver.
+* Use with programming languages that do not support callback functions.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* probeStateChanged - on exit, 1 if the probe state has changed, 0 otherwise. 
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 hasProbeStateChanged(int16_t handle, int16_t * probeStateChanged)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		*probeStateChanged = wrapUnitInfo->probeStateChanged;
+	}
+	else
+	{
+		status = PICO_INVALID_HANDLE;
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* clearProbeStateChanged
+*
+* Clears the probe state changed flag. This function should be called after 
+* having completed retrieval of the probe information.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 clearProbeStateChanged(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		wrapUnitInfo->probeStateChanged = 0;
+	}
+	else
+	{
+		status = PICO_INVALID_HANDLE;
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* getUserProbeInteractionsInfo
+*
+* Retrieves information on probe changes on scope devices that support 
+* PicoConnect (TM) probes. Use this function with programming languages that 
+* support structs.
+*
+* The hasProbeStateChanged() function should be called prior to calling this 
+* function to verify if there has been a change in the probe state.
+*
+* If this function is called, it is not necessary to call the 
+* clearProbeStateChanged() function after retrieving the probe information.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* probes - on entry a pointer to an array of PS4000A_USER_PROBE_INTERACTIONS
+*			structures.
+* nProbes - the number of elements in the probes array.
+*
+* Returns:
+*
+* Status code from ps4000aProbeInteractions, or
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if probes is NULL
+* PICO_MEMORY, if the array is not large enough for the number of probes
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getUserProbeInteractionsInfo(int16_t handle, PS4000A_USER_PROBE_INTERACTIONS * probes, uint32_t * nProbes)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+	uint32_t i = 0;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		status = wrapUnitInfo->userProbeInfo.status;
+		*nProbes = wrapUnitInfo->userProbeInfo.numberOfProbes;
+		
+		if (probes != NULL)
+		{
+			// Copy probe information
+			for (i = 0; i < wrapUnitInfo->userProbeInfo.numberOfProbes; i++)
+			{
+				if (&probes[i] && &wrapUnitInfo->userProbeInfo.userProbeInteractions[i])
+				{
+					memcpy_s(&probes[i], sizeof(PS4000A_USER_PROBE_INTERACTIONS), &wrapUnitInfo->userProbeInfo.userProbeInteractions[i], sizeof(PS4000A_USER_PROBE_INTERACTIONS));
+				}
+				else
+				{
+					return PICO_MEMORY;
+				}
+			}
+		}
+		else
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+		
+		wrapUnitInfo->probeStateChanged = 0;
+	}
+	else
+	{
+		status = PICO_INVALID_HANDLE;
+	}
+
+	return status;
+
+}
+
+/****************************************************************************
+* getNumberOfProbes
+*
+* Retrieves the number of probes and status code returned by the 
+* ps4000aProbeInteractions callback.
+*
+* Use this function with programming languages that do not support structs.
+*
+* The hasProbeStateChanged() function should have been called/polled before
+* calling this function.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* enabledChannels - an array representing the channel states. This should be 
-*					8 elements in size.
+* numberOfProbes - on exit, see ps4000aProbeInteractions.
+*
+* Returns:
+*
+* PICO_INVALID_HANDLE, if handle is invalid, 
+* Otherwise see ps4000aProbeInteractions
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getNumberOfProbes(int16_t handle, int32_t * numberOfProbes)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		*numberOfProbes = (int32_t) wrapUnitInfo->userProbeInfo.numberOfProbes;
+
+		return wrapUnitInfo->userProbeInfo.status;
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* getUserProbeTypeInfo
+*
+* Retrieves information on the probe type for the probe number specified 
+* on scope devices that support PicoConnect (TM) probes.
+*
+* Use this function with programming languages that do not support structs.
+*
+* The getNumberOfProbes() function should be called prior to calling this
+* function.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* probeNumber - a zero-based index corresponding to the probe for which
+*				information is required.
+* connected - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* channel - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* enabled - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* probeName - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* requiresPower - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* isPowered - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* status - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+*
+* Returns:
+*
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if probeNumber is invalid
+* Otherwise see PS4000A_USER_PROBE_INTERACTIONS structure
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getUserProbeTypeInfo(int16_t handle, int32_t probeNumber, int16_t * connected, int32_t * channel, int16_t * enabled, int32_t * probeName, 
+														int8_t * requiresPower, int8_t * isPowered)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUnitInfo->userProbeInfo.numberOfProbes)
+		{
+			*connected		= (int16_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].connected;
+			*channel		= (int32_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].channel;
+			*enabled		= (int16_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].enabled;
+			*probeName		= (int32_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].probeName;
+			*requiresPower	= (int8_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].requiresPower_;
+			*isPowered		= (int8_t) wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].isPowered_;
+
+			return wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].status_;
+		}
+		else
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* getUserProbeRangeInfo
+*
+* Retrieves information on the probe range for the probe number specified
+* on scope devices that support PicoConnect (TM) probes.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* probeNumber - a zero-based index corresponding to the probe for which
+*				information is required.
+* probeOff - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* rangeFirst - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* rangeLast - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* rangeCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is less than or equal to 0
-* PICO_INVALID_PARAMETER, if _channelCount is invalid
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if probeNumber is invalid
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+extern PICO_STATUS PREF0 PREF1 getUserProbeRangeInfo(int16_t handle, int32_t probeNumber, int32_t * probeOff, int32_t * rangeFirst, int32_t * rangeLast, int32_t * rangeCurrent)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	if (handle > 0)
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		if (_channelCount > 0 && _channelCount <= PS4000A_MAX_CHANNELS)
+		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUnitInfo->userProbeInfo.numberOfProbes)
 		{
-			memcpy_s((int16_t *)_enabledChannels, PS4000A_MAX_CHANNELS * sizeof(int16_t), 
-				(int16_t *)enabledChannels, PS4000A_MAX_CHANNELS * sizeof(int16_t));
+			*probeOff		= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].probeOff;
+			*rangeFirst		= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].rangeFirst_;
+			*rangeLast		= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].rangeLast_;
+			*rangeCurrent	= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].rangeCurrent_;
 			
 			return PICO_OK;
 		}
@@ -404,685 +2937,1063 @@ extern PICO_STATUS PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enab
 	{
 		return PICO_INVALID_HANDLE;
 	}
-
 }
 
 /****************************************************************************
-* setAppAndDriverBuffers
+* getUserProbeCouplingInfo
 *
-* Set the application and corresponding driver buffer in order for the 
-* streaming callback to copy the data for the channel from the driver buffer 
-* to the application buffer.
+* Retrieves information on the probe coupling for the probe number specified
+* on scope devices that support PicoConnect (TM) probes.
+*
+* Use this function with programming languages that do not support structs.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
-* appBuffer - the application buffer.
-* driverBuffer - the buffer set by the driver.
-* bufferLength - the length of the buffers (the length of the buffers must be
-*				 equal).
+* probeNumber - a zero-based index corresponding to the probe for which
+*				information is required.
+* couplingFirst - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* couplingLast - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* couplingCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if probeNumber is invalid
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, int32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 getUserProbeCouplingInfo(int16_t handle, int32_t probeNumber, int32_t * couplingFirst, int32_t * couplingLast, int32_t * couplingCurrent)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		if (channel < PS4000A_CHANNEL_A || channel >= _channelCount)
+		if (probeNumber >= 0 && probeNumber < (int32_t)wrapUnitInfo->userProbeInfo.numberOfProbes)
 		{
-			return PICO_INVALID_CHANNEL;
+			*couplingFirst = (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].couplingFirst_;
+			*couplingLast = (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].couplingLast_;
+			*couplingCurrent = (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].couplingCurrent_;
+
+			return PICO_OK;
 		}
 		else
 		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
-				
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* getUserProbeBandwidthInfo
+*
+* Retrieves information on the probe bandwidth limiter options for the 
+* probe number specified on scope devices that support PicoConnect (TM) 
+* probes.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* probeNumber - a zero-based index corresponding to the probe for which
+*				information is required.
+* filterFlags - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* filterCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* defaultFilter - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if probeNumber is invalid
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getUserProbeBandwidthInfo(int16_t handle, int32_t probeNumber, int32_t * filterFlags, int32_t * filterCurrent, int32_t * defaultFilter)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUnitInfo->userProbeInfo.numberOfProbes)
+		{
+			*filterFlags	= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].filterFlags_;
+			*filterCurrent	= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].filterCurrent_;
+			*defaultFilter	= (int32_t)wrapUnitInfo->userProbeInfo.userProbeInteractions[probeNumber].defaultFilter_;
 
 			return PICO_OK;
 		}
+		else
+		{
+			return PICO_INVALID_PARAMETER;
+		}
 	}
 	else
 	{
 		return PICO_INVALID_HANDLE;
 	}
-
 }
 
 /****************************************************************************
-* setMaxMinAppAndDriverBuffers
+* DrainStreamingEvents
 *
-* Set the application and corresponding driver buffers in order for the 
-* streaming callback to copy the data for the channel from the driver max and 
-* min buffers to the respective application buffers for aggregated data 
-* collection.
+* Returns the records of all streaming callbacks received since the last call
+* to this function, oldest first, in a single call. Unlike AvailableData and 
+* IsTriggerReady, which only report the latest callback, no callback 
+* information is lost if the application polls slowly, provided the queue of
+* 1024 records does not fill up.
+*
+* Each record is returned as 8 consecutive values in the events array:
+*
+* [0] numSamples - the number of samples collected.
+* [1] startIndex - an index to the first valid sample in the buffer.
+* [2] triggered - non-zero if a trigger occurred.
+* [3] triggeredAt - the index of the trigger point relative to startIndex.
+* [4] overflow - overvoltage flags, bit 0 denoting channel A.
+* [5] autoStop - non-zero if streaming has autostopped.
+* [6] timestamp (low 32 bits) - host time in microseconds when the callback
+*		was received.
+* [7] timestamp (high 32 bits).
+*
+* See also ps4000aStreamingReady for a description of the callback parameters.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
-* appMaxBuffer - the application max buffer.
-* appMinBuffer - the application min buffer.
-* driverMaxBuffer - the max buffer set by the driver.
-* driverMinBuffer - the min buffer set by the driver.
-* bufferLength - the length of the buffers (the length of the buffers must be
-*				 equal).
+* handle - the handle of the required device.
+* events - an array of at least maxEvents * 8 elements.
+* maxEvents - the maximum number of records to return.
+* nEvents - on exit, the number of records copied into events.
+* droppedEvents - on exit, the number of records that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if events or nEvents is NULL
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents(int16_t handle, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (events == NULL || nEvents == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	drainStreamingEventQueue(&wrapUnitInfo->eventQueue, events, maxEvents, nEvents, droppedEvents);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* DrainTriggerLog
+*
+* Returns the triggers reported by the streaming callback since the last 
+* call to this function, oldest first. Every trigger is kept until it is
+* read, provided the log of 4096 records does not fill up, so unlike 
+* IsTriggerReady no trigger is lost if the application polls slowly, and 
+* ClearTriggerReady has no effect on the log.
+*
+* Each record is returned as 2 consecutive values in the triggers array:
+*
+* [0] sampleIndex - the index of the trigger point counted from the first 
+*		sample received after resetTriggerLog (or after the wrapper state 
+*		was created). It counts every sample passed to the streaming 
+*		callback (aggregated samples if aggregation is used) and does not
+*		wrap or depend on the size of the driver buffers.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received, on the same clock as the timestamps 
+*		returned by DrainStreamingEvents.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* triggers - an array of at least maxTriggers * 2 elements.
+* maxTriggers - the maximum number of records to return.
+* nTriggers - on exit, the number of records copied into triggers.
+* droppedTriggers - on exit, the number of triggers that have been 
+*					discarded because the log was full since the last call 
+*					to this function. May be NULL.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if triggers or nTriggers is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, int32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog(int16_t handle, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, uint32_t * droppedTriggers)
 {
-	if (handle > 0)
-	{
-		if (channel < PS4000A_CHANNEL_A || channel >= _channelCount)
-		{
-			return PICO_INVALID_CHANNEL;
-		}
-		else
-		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-			_wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
-
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
-
-			return PICO_OK;
-		}
+	if (status != PICO_OK)
+	{
+		return status;
 	}
-	else
+
+	if (triggers == NULL || nTriggers == NULL)
 	{
-		return PICO_INVALID_HANDLE;
+		return PICO_INVALID_PARAMETER;
 	}
+
+	drainTriggerLog(&wrapUnitInfo->triggerLog, triggers, maxTriggers, nTriggers, droppedTriggers);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setTriggerConditions
-*
-* This function sets up trigger conditions on the scope's inputs. The trigger 
-* is defined by one or more sets of integers corresponding to 
-* PS4000A_CONDITION structures which are then converted and passed 
-* to the ps4000aSetTriggerChannelConditions function.
+* resetTriggerLog
 *
-* Use this function with programming languages that do not support structs.
+* Discards any triggers in the trigger log and restarts the sample count 
+* used for trigger positions from zero. Call this function before 
+* ps4000aRunStreaming, while the device is not streaming, so that trigger
+* positions are counted from the start of the capture.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* conditionsArray - an array of integer values specifying the conditions 
-*					for each channel.
-* nConditions - the number that will be passed after the wrapper code has 
-*				created its structures
-				(i.e. the number of conditionsArray elements / 2).
-* info - see info in ps4000SetTriggerChannelConditions. 
+* handle - the handle of the required device.
 *
 * Returns:
 *
-* See ps4000aSetTriggerChannelConditions return values.
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions, int32_t info)
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog(int16_t handle)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
-
-	PS4000A_CONDITION *conditions = (PS4000A_CONDITION *) calloc(nConditions, sizeof(PS4000A_CONDITION));
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	for (i = 0; i < nConditions; i++)
+	if (status != PICO_OK)
 	{
-		conditions[i].source	= (PS4000A_CHANNEL) conditionsArray[j];
-		conditions[i].condition = (PS4000A_TRIGGER_STATE) conditionsArray[j + 1];
-
-		j = j + 2;
+		return status;
 	}
 
-	status = ps4000aSetTriggerChannelConditions(handle, conditions, nConditions, (PS4000A_CONDITIONS_INFO) info);
-	free(conditions);
+	wrapUnitInfo->triggerLog.sampleCount = 0;
+	wrapUnitInfo->triggerLog.readIndex = wrapUnitInfo->triggerLog.writeIndex;
+	wrapUnitInfo->triggerLog.reportedDroppedRecords = wrapUnitInfo->triggerLog.droppedRecords;
 
-	return status;
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setTriggerDirections
+* releaseWrapUnitInfo
 *
-* This function sets the direction of the trigger for the specified channels.
-* The trigger direction(s) is(are) defined by one or more sets of integers 
-* corresponding to PS4000A_DIRECTION structures which are then converted and 
-* passed to the ps4000aSetTriggerChannelDirections function.
+* Frees the wrapper state held for a device. Call this function after
+* ps4000aCloseUnit so that the memory is returned and a device opened later 
+* with the same handle starts from a clean state.
 *
-* Use this function with programming languages that do not support structs.
+* The function waits for any call to GetStreamingLatestValues in progress on
+* another thread to return before freeing the state, and a BlockCallback 
+* arriving afterwards finds no state and is ignored.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* directionsArray - an array of integer values specifying the directions 
-*					for each channel.
-* nDirections - the number that will be passed after the wrapper code has 
-*				created its structures 
-*				(i.e. the number of directionsArray elements / 2).
+* handle - the handle of the required device.
 *
 * Returns:
 *
-* See ps4000aSetTriggerChannelDirections return values.
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the wrapper holds no state for the handle.
+*
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setTriggerDirections(int16_t handle, int32_t *directionsArray, int16_t nDirections)
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo(int16_t handle)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	PS4000A_DIRECTION *directions = (PS4000A_DIRECTION *) calloc(nDirections, sizeof(PS4000A_DIRECTION));
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
 
-	for (i = 0; i < nDirections; i++)
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	wrapUnitInfo = _wrapUnitInfo[handle];
+	_wrapUnitInfo[handle] = NULL;
+
+	// Wait for any GetStreamingLatestValues call that may still run StreamingCallback with the state
+	while (wrapUnitInfo != NULL && wrapUnitInfo->streamingCallsInProgress > 0)
 	{
-		directions[i].channel	= (PS4000A_CHANNEL) directionsArray[j];
-		directions[i].direction = (PS4000A_THRESHOLD_DIRECTION) directionsArray[j + 1];
+#if defined(WIN32) || defined(_WIN64)
+		SleepConditionVariableSRW(&_wrapUnitInfoCondition, &_wrapUnitInfoLock, INFINITE, 0);
+#else
+		pthread_cond_wait(&_wrapUnitInfoCondition, &_wrapUnitInfoLock);
+#endif
+	}
 
-		j = j + 2;
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_HANDLE;
 	}
 
-	status = ps4000aSetTriggerChannelDirections(handle, directions, nDirections);
-	free(directions);
+	freeTriggerCapture(wrapUnitInfo->triggerCapture);
 
-	return status;
+	stopWorkerPool(wrapUnitInfo);
+
+#if !defined(WIN32) && !defined(_WIN64)
+	pthread_mutex_destroy(&wrapUnitInfo->readyLock);
+	pthread_cond_destroy(&wrapUnitInfo->readyCondition);
+	pthread_mutex_destroy(&wrapUnitInfo->snapshotLock);
+	pthread_mutex_destroy(&wrapUnitInfo->workerPool.lock);
+	pthread_cond_destroy(&wrapUnitInfo->workerPool.startCondition);
+	pthread_cond_destroy(&wrapUnitInfo->workerPool.doneCondition);
+#endif
+
+	free(wrapUnitInfo);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setTriggerProperties
+* setChannelScaling
 *
-* This function is used to enable or disable triggering and set its
-* parameters by means of assigning the values from the propertiesArray to an
-* array of PS4000A_TRIGGER_CHANNEL_PROPERTIES structures which are then 
-* passed to the ps4000aSetTriggerChannelProperties function with the other 
-* parameters.
-
-* Use this function with programming languages that do not support structs.
+* Sets the values used to convert the data for a channel to volts when float 
+* or double application buffers have been set with setAppFloatBuffers or 
+* setAppDoubleBuffers. The values should match those passed to the driver 
+* for the channel, and should be set before streaming starts.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* propertiesArray - an array of sets of integers corresponding to
-*					PS4000A_TRIGGER_CHANNEL_PROPERTIES structures describing the
-*					required properties to be set. See also channelProperties
-*					in ps4000aSetTriggerChannelProperties.
-* nProperties - the number that will be passed after the wrapper code has
-*				created its structures. (i.e. the number of propertiesArray
-*				elements / 6).
-* autoTrig - see autoTriggerMilliseconds in ps4000aSetTriggerChannelProperties.
-*
+* handle - the device handle.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* range - the PS4000A_RANGE value set for the channel.
+* analogueOffset - the analogue offset in volts set for the channel.
+* maxADCValue - the value returned by ps4000aMaximumValue. Set to 0 to stop 
+*				converting the data for the channel.
+* probeAttenuation - the probe attenuation, e.g. 10 for a x10 probe, or 1 if 
+*				 no probe scaling is required.
 *
 * Returns:
 *
-* See ps4000aSetChannelTriggerProperties return values.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_VOLTAGE_RANGE, if range is not a valid PS4000A_RANGE value
+* PICO_INVALID_PARAMETER, if maxADCValue is negative or probeAttenuation is 
+*							not greater than 0
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setTriggerProperties(int16_t handle, int32_t *propertiesArray, int16_t nProperties, int32_t autoTrig)
+extern PICO_STATUS PREF0 PREF1 setChannelScaling(int16_t handle, int16_t channel, int32_t range, float analogueOffset, int16_t maxADCValue, float probeAttenuation)
 {
-	PS4000A_TRIGGER_CHANNEL_PROPERTIES *channelProperties = (PS4000A_TRIGGER_CHANNEL_PROPERTIES *) 
-																calloc(nProperties, sizeof(PS4000A_TRIGGER_CHANNEL_PROPERTIES));
-	
-	int16_t i;
-	int16_t j = 0;
-	int16_t auxEnable = 0;
-	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_CHANNEL_SCALING * scaling = NULL;
 
-	for (i = 0; i < nProperties; i++)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		channelProperties[i].thresholdUpper				= (int16_t) propertiesArray[j];
-		channelProperties[i].thresholdUpperHysteresis	= (uint16_t) propertiesArray[j + 1];
-		channelProperties[i].thresholdLower				= (int16_t) propertiesArray[j + 2];
-		channelProperties[i].thresholdLowerHysteresis	= (uint16_t) propertiesArray[j + 3];
-		channelProperties[i].channel					= (PS4000A_CHANNEL) propertiesArray[j + 4];
-		channelProperties[i].thresholdMode				= (PS4000A_THRESHOLD_MODE) propertiesArray[j + 5];
+		return PICO_INVALID_HANDLE;
+	}
 
-		j = j + 6;
+	if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+	{
+		return PICO_INVALID_CHANNEL;
 	}
-	status = ps4000aSetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
-	free(channelProperties);
+	else if (range < PS4000A_10MV || range >= PS4000A_MAX_RANGES)
+	{
+		return PICO_INVALID_VOLTAGE_RANGE;
+	}
+	else if (maxADCValue < 0 || probeAttenuation <= 0.0f)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+	else
+	{
+		scaling = &wrapUnitInfo->wrapBufferInfo.scaling[channel];
 
-	return status;
+		scaling->range = range;
+		scaling->analogueOffset = analogueOffset;
+		scaling->maxADCValue = maxADCValue;
+		scaling->probeAttenuation = probeAttenuation;
+
+		if (maxADCValue > 0)
+		{
+			scaling->scale = (_rangeMillivolts[range] / 1000.0) * probeAttenuation / maxADCValue;
+			scaling->offset = -(double) analogueOffset * probeAttenuation;
+		}
+		else
+		{
+			scaling->scale = 0.0;
+			scaling->offset = 0.0;
+		}
+
+		return PICO_OK;
+	}
 }
 
 /****************************************************************************
-* setPulseWidthQualifierConditions
-*
-* This function sets up the conditions for pulse width qualification. 
-* The pulse width qualifier (PWQ) is defined by one or more sets of integers 
-* corresponding to PS4000A_CONDITION structures which are then converted 
-* and passed to the ps4000aSetPulseWidthQualifierConditions function.
+* setAppFloatBuffers
 *
-* Use this function with programming languages that do not support structs.
+* Set the application buffers that the streaming callback writes the data 
+* for a channel into after converting it to volts, using the values set with 
+* setChannelScaling. The buffers are filled from the driver buffers set 
+* with setAppAndDriverBuffers or setMaxMinAppAndDriverBuffers, and must be 
+* the same length.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* conditionsArray - an array of integer values specifying the PWQ conditions
-*					for each channel.
-* nConditions - the number that will be passed after the wrapper code has
-*				created its structures
-(i.e. the number of conditionsArray elements / 2).
-* info - see info in ps4000SetTriggerChannelConditions.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
 *
 * Returns:
 *
-* See ps4000aSetPulseWidthQualifierConditions.
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setPulseWidthQualifierConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions, int32_t info)
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers(int16_t handle, int16_t channel, float * appMaxBuffer, float * appMinBuffer)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
-
-	PS4000A_CONDITION *conditions = (PS4000A_CONDITION *)calloc(nConditions, sizeof(PS4000A_CONDITION));
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	for (i = 0; i < nConditions; i++)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		conditions[i].source = (PS4000A_CHANNEL)conditionsArray[j];
-		conditions[i].condition = (PS4000A_TRIGGER_STATE)conditionsArray[j + 1];
+		if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2 + 1] = appMinBuffer;
 
-		j = j + 2;
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
 	}
-
-	status = ps4000aSetPulseWidthQualifierConditions(handle, conditions, nConditions, (PS4000A_CONDITIONS_INFO)info);
-	free(conditions);
-
-	return status;
 }
 
 /****************************************************************************
-* setProbeInteractionCallback
+* setAppDoubleBuffers
 *
-* This function sets the ProbeInteractions callback with the ps4000a driver.
-* This function should be called after the PicoScope 4444 device has been
-* successfully opened and before any call to ps4000aSetChannel().
-* Use with programming languages that do not support callback functions.
+* As setAppFloatBuffers, for double precision application buffers. Float 
+* and double buffers may be set for the same channel.
 *
 * Input Arguments:
 *
 * handle - the device handle.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
 *
 * Returns:
 *
-* See ps4000aSetProbeInteractionCallback.
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setProbeInteractionCallback(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers(int16_t handle, int16_t channel, double * appMaxBuffer, double * appMinBuffer)
 {
-	_probeStateChanged = 0;
-	return ps4000aSetProbeInteractionCallback(handle, ProbeInteractions);
-	
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2 + 1] = appMinBuffer;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
 }
 
 /****************************************************************************
-* hasProbeStateChanged
+* setChannelDecimation
 *
-* This function sets the ProbeInteractions callback with the ps4000a driver.
-* Use with programming languages that do not support callback functions.
+* Sets up the streaming callback to reduce the data for a channel by a 
+* fixed ratio and write the result to a separate set of application buffers, 
+* alongside the data copied to the buffers set with setAppAndDriverBuffers or 
+* setMaxMinAppAndDriverBuffers. The application buffers are written as rings, 
+* use getDecimatedValues to find the new values. Any partly complete block 
+* and count of values is cleared, so call this before each streaming run.
+* The settings cannot be changed while GetStreamingLatestValues is running 
+* for the device on another thread.
+*
+* In min/max mode the max and min driver buffers are used if the data is 
+* aggregated, otherwise both values are taken from the one driver buffer. 
+* The other modes use the max (or non-aggregated) driver buffer.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* probeStateChanged - on exit, 1 if the probe state has changed, 0 otherwise. 
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* mode - a WRAP_DECIMATION_MODE value. WRAP_DECIMATION_NONE turns the 
+*		 decimation for the channel off.
+* ratio - the number of samples reduced to each output value.
+* appMaxBuffer - the application buffer for the output values, or the max 
+*				 values in min/max mode.
+* appMinBuffer - the application buffer for the min values in min/max mode. 
+*				 Not used in the other modes and may be NULL.
+* bufferLength - the length of the application buffers.
 *
 * Returns:
 *
 * PICO_OK, if successful
 * PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_PARAMETER, if mode is not valid, or ratio or bufferLength is 0, 
+*							or a buffer needed for the mode is NULL
+* PICO_BUSY, if GetStreamingLatestValues is running for the device
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 hasProbeStateChanged(int16_t handle, int16_t * probeStateChanged)
+extern PICO_STATUS PREF0 PREF1 setChannelDecimation(int16_t handle, int16_t channel, int32_t mode, uint32_t ratio, int16_t * appMaxBuffer, 
+	int16_t * appMinBuffer, uint32_t bufferLength)
 {
-	PICO_STATUS status = PICO_OK;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DECIMATION_INFO * decimation = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+	{
+		return PICO_INVALID_CHANNEL;
+	}
+
+	if (mode < WRAP_DECIMATION_NONE || mode > WRAP_DECIMATION_EVERY_NTH)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if (mode != WRAP_DECIMATION_NONE)
+	{
+		if (ratio == 0 || bufferLength == 0 || appMaxBuffer == NULL || (mode == WRAP_DECIMATION_MIN_MAX && appMinBuffer == NULL))
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+
+	decimation = &wrapUnitInfo->wrapBufferInfo.decimation[channel];
+
+	// Holding the lock stops a streaming call starting while the settings change
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
 
-	if (handle > 0)
+	if (wrapUnitInfo->streamingCallsInProgress > 0)
 	{
-		*probeStateChanged = _probeStateChanged;
-	}
-	else
-	{
-		status = PICO_INVALID_HANDLE;
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+		pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+		return PICO_BUSY;
 	}
 
-	return status;
+	decimation->mode = mode;
+	decimation->ratio = ratio;
+	decimation->appMaxBuffer = appMaxBuffer;
+	decimation->appMinBuffer = appMinBuffer;
+	decimation->bufferLength = bufferLength;
+	WRAP_STORE_UINT64(&decimation->writeCount, 0);
+	decimation->readCount = 0;
+	resetDecimationBlock(decimation);
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* clearProbeStateChanged
+* getDecimatedValues
 *
-* Clears the _probeStateChanged flag. This function should be called after 
-* having completed retrieval of the probe information.
+* Returns the position of the decimated values written for a channel since 
+* the last call, and marks them as read. The values may wrap around the end 
+* of the application buffers. If more than bufferLength values have been 
+* written, only the most recent bufferLength values are returned.
 *
 * Input Arguments:
 *
 * handle - the device handle.
+* channel - the channel number (should be a PS4000A_CHANNEL enumeration value).
+* startIndex - on exit, the index in the application buffers of the first 
+*				new value.
+* noOfValues - on exit, the number of new values.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_PARAMETER, if startIndex or noOfValues is NULL, or decimation 
+*							is not set up for the channel
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 clearProbeStateChanged(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 getDecimatedValues(int16_t handle, int16_t channel, uint32_t * startIndex, uint32_t * noOfValues)
 {
-	PICO_STATUS status = PICO_OK;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DECIMATION_INFO * decimation = NULL;
+	uint64_t writeCount = 0;
 
-	if (handle > 0)
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		_probeStateChanged = 0;
+		return PICO_INVALID_HANDLE;
 	}
-	else
+
+	if (channel < PS4000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
 	{
-		status = PICO_INVALID_HANDLE;
+		return PICO_INVALID_CHANNEL;
 	}
 
-	return status;
-}
-
-/****************************************************************************
-* getUserProbeInteractionsInfo
-*
-* Retrieves information on probe changes on scope devices that support 
-* PicoConnect (TM) probes. Use this function with programming languages that 
-* support structs.
-*
-* The hasProbeStateChanged() function should be called prior to calling this 
-* function to verify if there has been a change in the probe state.
-*
-* If this function is called, it is not necessary to call the 
-* clearProbeStateChanged() function after retrieving the probe information.
-*
-* Input Arguments:
-*
-* handle - the device handle.
-* probes - on entry a pointer to an array of PS4000A_USER_PROBE_INTERACTIONS
-*			structures.
-* nProbes - the number of elements in the probes array.
-*
-* Returns:
-*
-* Status code from ps4000aProbeInteractions, or
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_PARAMETER, if probes is NULL
-* PICO_MEMORY, if the array is not large enough for the number of probes
-****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getUserProbeInteractionsInfo(int16_t handle, PS4000A_USER_PROBE_INTERACTIONS * probes, uint32_t * nProbes)
-{
-	PICO_STATUS status = PICO_OK;
-	uint32_t i = 0;
+	decimation = &wrapUnitInfo->wrapBufferInfo.decimation[channel];
 
-	if (handle > 0)
+	if (startIndex == NULL || noOfValues == NULL || decimation->mode == WRAP_DECIMATION_NONE)
 	{
-		status = wrapUserProbeInfo.status;
-		*nProbes = wrapUserProbeInfo.numberOfProbes;
-		
-		if (probes != NULL)
-		{
-			// Copy probe information
-			for (i = 0; i < wrapUserProbeInfo.numberOfProbes; i++)
-			{
-				if (&probes[i] && &wrapUserProbeInfo.userProbeInteractions[i])
-				{
-					memcpy_s(&probes[i], sizeof(PS4000A_USER_PROBE_INTERACTIONS), &wrapUserProbeInfo.userProbeInteractions[i], sizeof(PS4000A_USER_PROBE_INTERACTIONS));
-				}
-				else
-				{
-					return PICO_MEMORY;
-				}
-			}
-		}
-		else
-		{
-			return PICO_INVALID_PARAMETER;
-		}
-		
+		return PICO_INVALID_PARAMETER;
 	}
-	else
+
+	// A single 64-bit load, so the count cannot be torn on a 32-bit build
+	writeCount = WRAP_LOAD_UINT64(&decimation->writeCount);
+
+	if (writeCount - decimation->readCount > decimation->bufferLength)
 	{
-		status = PICO_INVALID_HANDLE;
+		decimation->readCount = writeCount - decimation->bufferLength;
 	}
 
-	_probeStateChanged = 0;
+	*startIndex = (uint32_t) (decimation->readCount % decimation->bufferLength);
+	*noOfValues = (uint32_t) (writeCount - decimation->readCount);
 
-	return status;
+	decimation->readCount = writeCount;
 
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getNumberOfProbes
-*
-* Retrieves the number of probes and status code returned by the 
-* ps4000aProbeInteractions callback.
+* setNonTemporalCopyThreshold
 *
-* Use this function with programming languages that do not support structs.
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
 *
-* The hasProbeStateChanged() function should have been called/polled before
-* calling this function.
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* numberOfProbes - on exit, see ps4000aProbeInteractions.
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
 *
 * Returns:
 *
-* PICO_INVALID_HANDLE, if handle is invalid, 
-* Otherwise see ps4000aProbeInteractions
+* PICO_OK.
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getNumberOfProbes(int16_t handle, int32_t * numberOfProbes)
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
 {
-	if (handle > 0)
-	{
-		*numberOfProbes = (int32_t) wrapUserProbeInfo.numberOfProbes;
+	_nonTemporalCopyThreshold = thresholdBytes;
 
-		return wrapUserProbeInfo.status;
-	}
-	else
-	{
-		return PICO_INVALID_HANDLE;
-	}
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getUserProbeTypeInfo
+* setStreamingWorkers
 *
-* Retrieves information on the probe type for the probe number specified 
-* on scope devices that support PicoConnect (TM) probes.
+* Starts a pool of worker threads that share the work of the streaming 
+* callback for a device. Each enabled channel is copied, converted to volts
+* and decimated by whichever of the driver's callback thread and the 
+* workers is free, and the callback returns to the driver once every 
+* channel is finished. On hosts with several cores this shortens the time 
+* spent in the driver's callback when many channels are enabled.
 *
-* Use this function with programming languages that do not support structs.
+* Callbacks with fewer than parallelThreshold samples, or with only one 
+* enabled channel, are processed on the callback thread alone, as waking 
+* the workers would take longer than the work.
 *
-* The getNumberOfProbes() function should be called prior to calling this
-* function.
+* Call this function before ps4000aRunStreaming or after ps4000aStop, not 
+* while streaming. Any workers already running are stopped first. The 
+* workers are stopped by releaseWrapUnitInfo.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* probeNumber - a zero-based index corresponding to the probe for which
-*				information is required.
-* connected - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* channel - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* enabled - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* probeName - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* requiresPower - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* isPowered - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* status - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* nWorkers - the number of worker threads, from 0 (all work is done on the
+*			callback thread) to WRAP_MAX_STREAMING_WORKERS.
+* parallelThreshold - the number of samples in a callback from which the 
+*			work is shared with the workers.
+* firstCpu - the processor to pin the first worker to, with each further 
+*			worker pinned to the next processor, or -1 to let the workers
+*			run on any processor. Pinning is supported on Windows and Linux,
+*			and a processor that does not exist leaves the worker unpinned.
 *
 * Returns:
 *
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_PARAMETER, if probeNumber is invalid
-* Otherwise see PS4000A_USER_PROBE_INTERACTIONS structure
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if handle is invalid.
+* PICO_INVALID_PARAMETER, if nWorkers is out of range.
+* PICO_MEMORY_FAIL, if the wrapper state could not be allocated.
+* PICO_OPERATION_FAILED, if a worker thread could not be created. No 
+*							workers are left running.
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getUserProbeTypeInfo(int16_t handle, int32_t probeNumber, int16_t * connected, int32_t * channel, int16_t * enabled, int32_t * probeName, 
-														int8_t * requiresPower, int8_t * isPowered)
+extern PICO_STATUS PREF0 PREF1 setStreamingWorkers(int16_t handle, int16_t nWorkers, uint32_t parallelThreshold, int16_t firstCpu)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
 	{
-		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUserProbeInfo.numberOfProbes)
-		{
-			*connected		= (int16_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].connected;
-			*channel		= (int32_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].channel;
-			*enabled		= (int16_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].enabled;
-			*probeName		= (int32_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].probeName;
-			*requiresPower	= (int8_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].requiresPower_;
-			*isPowered		= (int8_t) wrapUserProbeInfo.userProbeInteractions[probeNumber].isPowered_;
-
-			return wrapUserProbeInfo.userProbeInteractions[probeNumber].status_;
-		}
-		else
-		{
-			return PICO_INVALID_PARAMETER;
-		}
+		return status;
 	}
-	else
+
+	if (nWorkers < 0 || nWorkers > WRAP_MAX_STREAMING_WORKERS)
 	{
-		return PICO_INVALID_HANDLE;
+		return PICO_INVALID_PARAMETER;
 	}
+
+	stopWorkerPool(wrapUnitInfo);
+
+	wrapUnitInfo->workerPool.parallelThreshold = parallelThreshold;
+
+	return startWorkerPool(wrapUnitInfo, nWorkers, firstCpu);
 }
 
 /****************************************************************************
-* getUserProbeRangeInfo
+* GetStreamingSnapshot
 *
-* Retrieves information on the probe range for the probe number specified
-* on scope devices that support PicoConnect (TM) probes.
+* Returns the streaming status from the latest streaming callback in one 
+* call. Unlike separate calls to AvailableData, IsTriggerReady, AutoStopped
+* and IsReady, which can see values written by different callbacks,
+* all of the values come from the same callback. The function does not 
+* block the streaming callback.
 *
-* Use this function with programming languages that do not support structs.
+* The values are written to the snapshot array in the order:
+*
+* [0] ready - non-zero if data is available, as returned by IsReady. This 
+*		is cleared by GetStreamingLatestValues and RunBlock.
+* [1] numSamples - the number of samples collected.
+* [2] startIndex - an index to the first valid sample in the buffer.
+* [3] triggered - non-zero if a trigger occurred.
+* [4] triggeredAt - the index of the trigger point relative to startIndex.
+* [5] overflow - overvoltage flags, bit 0 denoting channel A.
+* [6] autoStop - non-zero if streaming has autostopped.
+* [7] callbackCount - the number of streaming callbacks received for the 
+*		device, which can be used to tell whether the data is new.
+*
+* ClearTriggerReady does not change the snapshot.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* probeNumber - a zero-based index corresponding to the probe for which
-*				information is required.
-* probeOff - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* rangeFirst - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* rangeLast - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* rangeCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* handle - the handle of the required device.
+* snapshot - an array of at least 8 elements.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_PARAMETER, if probeNumber is invalid
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if snapshot is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getUserProbeRangeInfo(int16_t handle, int32_t probeNumber, int32_t * probeOff, int32_t * rangeFirst, int32_t * rangeLast, int32_t * rangeCurrent)
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot(int16_t handle, uint32_t * snapshot)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_SNAPSHOT copy;
+	uint32_t sequence = 0;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
 	{
-		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUserProbeInfo.numberOfProbes)
-		{
-			*probeOff		= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].probeOff;
-			*rangeFirst		= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].rangeFirst_;
-			*rangeLast		= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].rangeLast_;
-			*rangeCurrent	= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].rangeCurrent_;
-			
-			return PICO_OK;
-		}
-		else
-		{
-			return PICO_INVALID_PARAMETER;
-		}
+		return status;
 	}
-	else
+
+	if (snapshot == NULL)
 	{
-		return PICO_INVALID_HANDLE;
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// Read again if the callback was writing the snapshot
+	do
+	{
+		sequence = wrapUnitInfo->snapshot.sequence;
+		WRAP_MEMORY_BARRIER();
+
+		copy = wrapUnitInfo->snapshot;
+
+		WRAP_MEMORY_BARRIER();
 	}
+	while ((sequence & 1) != 0 || wrapUnitInfo->snapshot.sequence != sequence);
+
+	snapshot[0] = (uint32_t) copy.ready;
+	snapshot[1] = copy.numSamples;
+	snapshot[2] = copy.startIndex;
+	snapshot[3] = (uint32_t) copy.triggered;
+	snapshot[4] = copy.triggeredAt;
+	snapshot[5] = (uint32_t) (uint16_t) copy.overflow;
+	snapshot[6] = (uint32_t) copy.autoStop;
+	snapshot[7] = copy.callbackCount;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getUserProbeCouplingInfo
+* setTriggerCapture
 *
-* Retrieves information on the probe coupling for the probe number specified
-* on scope devices that support PicoConnect (TM) probes.
+* Sets up the capture of a window of samples around each trigger reported 
+* while streaming, so that the application does not need to keep the whole
+* stream to see the samples before a trigger. The streaming callback keeps 
+* a history of the last preTriggerSamples samples of each channel and, for 
+* each trigger, assembles a record of preTriggerSamples samples before the
+* trigger point followed by postTriggerSamples samples from the trigger 
+* point on. Completed records are read with DrainTriggerCaptures.
 *
-* Use this function with programming languages that do not support structs.
+* The channels enabled when this function is called are captured, from the
+* driver buffers (the max buffers if aggregation is used), which must be 
+* set before streaming starts. Each record holds the window for each 
+* captured channel in turn, in channel order.
+*
+* Call this function while the device is not streaming. Any records not yet
+* read are discarded. Call with maxRecords set to 0 to stop capturing and 
+* free the buffers.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* probeNumber - a zero-based index corresponding to the probe for which
-*				information is required.
-* couplingFirst - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* couplingLast - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* couplingCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* handle - the handle of the required device.
+* preTriggerSamples - the number of samples before the trigger point in 
+*						each record.
+* postTriggerSamples - the number of samples from the trigger point on in
+*						each record.
+* maxRecords - the number of completed records that can be held until 
+*				they are read. Triggers that arrive while the queue is full
+*				are dropped.
+* recordLength - on exit, the number of samples in each record (the window
+*				length multiplied by the number of captured channels). May
+*				be NULL.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_PARAMETER, if probeNumber is invalid
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if maxRecords is not 0 and the window is empty or
+*						no channels are enabled
+* PICO_MEMORY_FAIL, if the buffers could not be allocated
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getUserProbeCouplingInfo(int16_t handle, int32_t probeNumber, int32_t * couplingFirst, int32_t * couplingLast, int32_t * couplingCurrent)
+extern PICO_STATUS PREF0 PREF1 setTriggerCapture(int16_t handle, uint32_t preTriggerSamples, uint32_t postTriggerSamples, uint32_t maxRecords, 
+	uint32_t * recordLength)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_TRIGGER_CAPTURE * capture = NULL;
+	uint64_t windowLength = (uint64_t) preTriggerSamples + postTriggerSamples;
+	int16_t channel = 0;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
 	{
-		if (probeNumber >= 0 && probeNumber < (int32_t)wrapUserProbeInfo.numberOfProbes)
-		{
-			*couplingFirst = (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].couplingFirst_;
-			*couplingLast = (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].couplingLast_;
-			*couplingCurrent = (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].couplingCurrent_;
+		return status;
+	}
 
-			return PICO_OK;
-		}
-		else
+	freeTriggerCapture(wrapUnitInfo->triggerCapture);
+	wrapUnitInfo->triggerCapture = NULL;
+
+	if (recordLength != NULL)
+	{
+		*recordLength = 0;
+	}
+
+	if (maxRecords == 0)
+	{
+		return PICO_OK;
+	}
+
+	if (windowLength == 0)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	capture = (WRAP_TRIGGER_CAPTURE *) calloc(1, sizeof(WRAP_TRIGGER_CAPTURE));
+
+	if (capture == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	for (channel = (int16_t) PS4000A_CHANNEL_A; channel < wrapUnitInfo->channelCount && channel < PS4000A_MAX_CHANNELS; channel++)
+	{
+		if (wrapUnitInfo->enabledChannels[channel])
 		{
-			return PICO_INVALID_PARAMETER;
+			capture->channels[capture->nChannels++] = channel;
 		}
 	}
-	else
+
+	if (capture->nChannels == 0)
 	{
-		return PICO_INVALID_HANDLE;
+		free(capture);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// Each record must be addressable with a 32-bit sample count
+	if (windowLength * capture->nChannels > 0xFFFFFFFF || windowLength * capture->nChannels * maxRecords > (uint64_t) ((size_t) -1 / sizeof(int16_t)))
+	{
+		free(capture);
+		return PICO_MEMORY_FAIL;
+	}
+
+	capture->preTriggerSamples = preTriggerSamples;
+	capture->postTriggerSamples = postTriggerSamples;
+	capture->windowLength = (uint32_t) windowLength;
+	capture->recordLength = capture->windowLength * capture->nChannels;
+	capture->maxRecords = maxRecords;
+
+	capture->history = (preTriggerSamples > 0) ? (int16_t *) calloc((size_t) preTriggerSamples * capture->nChannels, sizeof(int16_t)) : NULL;
+	capture->recordData = (int16_t *) calloc((size_t) capture->recordLength * maxRecords, sizeof(int16_t));
+	capture->records = (WRAP_TRIGGER_CAPTURE_RECORD *) calloc(maxRecords, sizeof(WRAP_TRIGGER_CAPTURE_RECORD));
+
+	if ((preTriggerSamples > 0 && capture->history == NULL) || capture->recordData == NULL || capture->records == NULL)
+	{
+		freeTriggerCapture(capture);
+		return PICO_MEMORY_FAIL;
 	}
+
+	wrapUnitInfo->triggerCapture = capture;
+
+	if (recordLength != NULL)
+	{
+		*recordLength = capture->recordLength;
+	}
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getUserProbeBandwidthInfo
+* DrainTriggerCaptures
 *
-* Retrieves information on the probe bandwidth limiter options for the 
-* probe number specified on scope devices that support PicoConnect (TM) 
-* probes.
+* Returns the records completed by the trigger capture set up with 
+* setTriggerCapture since the last call to this function, oldest first.
 *
-* Use this function with programming languages that do not support structs.
+* Each record is copied into data as recordLength samples (see 
+* setTriggerCapture): for each captured channel in channel order, the 
+* preTriggerSamples samples before the trigger point followed by the 
+* postTriggerSamples samples from the trigger point on. If triggers is not
+* NULL, 2 values are written to it for each record:
+*
+* [0] sampleIndex - the index of the trigger point, as returned by 
+*		DrainTriggerLog.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* probeNumber - a zero-based index corresponding to the probe for which
-*				information is required.
-* filterFlags - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* filterCurrent - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
-* defaultFilter - on exit, see PS4000A_USER_PROBE_INTERACTIONS structure
+* handle - the handle of the required device.
+* data - an array of at least maxRecords * recordLength elements.
+* triggers - an array of at least maxRecords * 2 elements. May be NULL.
+* maxRecords - the maximum number of records to return.
+* nRecords - on exit, the number of records copied.
+* droppedRecords - on exit, the number of triggers that have been dropped
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is invalid
-* PICO_INVALID_PARAMETER, if probeNumber is invalid
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if data or nRecords is NULL, or no trigger capture
+*						has been set up
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getUserProbeBandwidthInfo(int16_t handle, int32_t probeNumber, int32_t * filterFlags, int32_t * filterCurrent, int32_t * defaultFilter)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerCaptures(int16_t handle, int16_t * data, uint64_t * triggers, uint32_t maxRecords, uint32_t * nRecords, 
+	uint32_t * droppedRecords)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_TRIGGER_CAPTURE * capture = NULL;
+	WRAP_TRIGGER_CAPTURE_RECORD * record = NULL;
+	uint32_t readIndex = 0;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
 	{
-		if (probeNumber >= 0 && probeNumber < (int32_t) wrapUserProbeInfo.numberOfProbes)
-		{
-			*filterFlags	= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].filterFlags_;
-			*filterCurrent	= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].filterCurrent_;
-			*defaultFilter	= (int32_t)wrapUserProbeInfo.userProbeInteractions[probeNumber].defaultFilter_;
+		return status;
+	}
 
-			return PICO_OK;
-		}
-		else
+	capture = wrapUnitInfo->triggerCapture;
+
+	if (capture == NULL || data == NULL || nRecords == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	readIndex = capture->readIndex;
+	count = capture->writeIndex - readIndex;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	if (count > maxRecords)
+	{
+		count = maxRecords;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &capture->records[(readIndex + i) % capture->maxRecords];
+
+		memcpy(&data[(size_t) i * capture->recordLength], &capture->recordData[(size_t) ((readIndex + i) % capture->maxRecords) * capture->recordLength],
+			(size_t) capture->recordLength * sizeof(int16_t));
+
+		if (triggers != NULL)
 		{
-			return PICO_INVALID_PARAMETER;
+			triggers[i * WRAP_TRIGGER_CAPTURE_FIELDS]		= record->sampleIndex;
+			triggers[i * WRAP_TRIGGER_CAPTURE_FIELDS + 1]	= record->timestamp;
 		}
 	}
-	else
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	capture->readIndex = readIndex + count;
+	*nRecords = count;
+
+	if (droppedRecords != NULL)
 	{
-		return PICO_INVALID_HANDLE;
+		dropped = capture->droppedRecords;
+		*droppedRecords = dropped - capture->reportedDroppedRecords;
+		capture->reportedDroppedRecords = dropped;
 	}
-}
\ No newline at end of file
+
+	return PICO_OK;
+}
@@ -30,6 +30,16 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+#define WRAP_LOAD_UINT64(p) ((uint64_t) InterlockedCompareExchange64((volatile LONG64 *) (p), 0, 0))
+#define WRAP_STORE_UINT64(p, v) InterlockedExchange64((volatile LONG64 *) (p), (LONG64) (v))
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #elif _WIN64
 #include "windows.h"
 #include <stdio.h>
@@ -45,13 +55,31 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+#define WRAP_LOAD_UINT64(p) ((uint64_t) InterlockedCompareExchange64((volatile LONG64 *) (p), 0, 0))
+#define WRAP_STORE_UINT64(p, v) InterlockedExchange64((volatile LONG64 *) (p), (LONG64) (v))
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #else
+// For pthread_setaffinity_np
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <sys/types.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
 #include <libps4000a-1.0/ps4000aApi.h>
 #ifndef PICO_STATUS
 #include <libps4000a-1.0/PicoStatus.h>
@@ -62,30 +90,114 @@
 #define PREF0
 #define PREF1
 
+#define WRAP_MEMORY_BARRIER() __sync_synchronize()
+#define WRAP_LOAD_UINT64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define WRAP_STORE_UINT64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef pthread_t WRAP_THREAD;
+typedef pthread_mutex_t WRAP_LOCK;
+typedef pthread_cond_t WRAP_CONDITION;
+#define WRAP_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define WRAP_CONDITION_INIT PTHREAD_COND_INITIALIZER
+
 typedef enum enBOOL
 {
   FALSE, TRUE
 } BOOL;
 #endif
 
+// Instruction set extensions used to convert ADC counts to volts and by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
+
+#define WRAP_DECIMATION_SUM_BLOCK	131072	// Samples summed in 32-bit lanes before moving the total to 64 bits
+
 ////////////////////////////////////////
 //
 //	Variable and struct declarations
 //
 ////////////////////////////////////////
 
-int16_t		_ready;
-int16_t		_autoStop;
-uint32_t	_numSamples;
-uint32_t	_triggeredAt = 0;
-int16_t		_triggered = FALSE;
-uint32_t	_startIndex;
-int16_t		_overflow = 0;
+/****************************************************************************
+* tWrapChannelScaling
+*
+* The settings used to convert the ADC counts for a channel to volts. The 
+* scale and offset are calculated from the other fields by setChannelScaling 
+* so that the streaming callback only needs a multiply and an add per sample:
+*
+* volts = counts * scale + offset
+*
+****************************************************************************/
+typedef struct tWrapChannelScaling
+{
+	int32_t		range;				// PS4000A_RANGE value set for the channel
+	float		analogueOffset;		// Analogue offset in volts set for the channel
+	int16_t		maxADCValue;		// Maximum ADC count for the device - 0 disables conversion
+	float		probeAttenuation;	// Multiplier applied to the result, e.g. 10 for a x10 probe
+	double		scale;				// Volts per ADC count
+	double		offset;				// Volts added after scaling
+} WRAP_CHANNEL_SCALING;
 
-int16_t		_channelCount = 0; // Should be set to the correct number of channels for the PicoScope from the main application.
-int16_t		_enabledChannels[PS4000A_MAX_CHANNELS] = {0, 0, 0, 0, 0, 0, 0, 0}; // Keep a record of the channels that are enabled
+/****************************************************************************
+* enWrapDecimationMode
+*
+* The ways the streaming callback can reduce the data for a channel before 
+* writing it to the decimation buffers set with setChannelDecimation.
+*
+****************************************************************************/
+typedef enum enWrapDecimationMode
+{
+	WRAP_DECIMATION_NONE,
+	WRAP_DECIMATION_MIN_MAX,	// Maximum and minimum of each block of ratio samples
+	WRAP_DECIMATION_MEAN,		// Mean of each block of ratio samples
+	WRAP_DECIMATION_EVERY_NTH	// First sample of each block of ratio samples
+} WRAP_DECIMATION_MODE;
 
-int16_t		_probeStateChanged = 0;
+/****************************************************************************
+* tWrapDecimationInfo
+*
+* The decimation settings and state for one channel. The partly complete 
+* block is kept between calls to the streaming callback so that blocks 
+* spanning two callbacks give the same result as any other block.
+*
+****************************************************************************/
+typedef struct tWrapDecimationInfo
+{
+	int32_t				mode;				// WRAP_DECIMATION_MODE value
+	uint32_t			ratio;				// Number of samples reduced to each output value
+	int16_t *			appMaxBuffer;		// Application buffer for the output values (max values in min/max mode)
+	int16_t *			appMinBuffer;		// Application buffer for the min values in min/max mode
+	uint32_t			bufferLength;		// Length of the application buffers - they are written as rings
+	uint32_t			blockCount;			// Number of samples in the current block
+	int16_t				blockMax;
+	int16_t				blockMin;
+	int64_t				blockSum;
+	volatile uint64_t	writeCount;			// Total number of output values written - accessed with WRAP_LOAD_UINT64 and WRAP_STORE_UINT64
+	uint64_t			readCount;			// Total number of output values returned by getDecimatedValues
+} WRAP_DECIMATION_INFO;
 
 typedef struct tWrapBufferInfo
 {
@@ -93,6 +205,11 @@ typedef struct tWrapBufferInfo
 	int16_t *appBuffers[PS4000A_MAX_CHANNEL_BUFFERS];
 	int32_t bufferLengths[PS4000A_MAX_CHANNELS]; // In order of A max, A min, B max, ... G min.
 
+	float *appFloatBuffers[PS4000A_MAX_CHANNEL_BUFFERS];		// Application buffers to write the data converted to volts into
+	double *appDoubleBuffers[PS4000A_MAX_CHANNEL_BUFFERS];	// Application buffers to write the data converted to volts into
+	WRAP_CHANNEL_SCALING scaling[PS4000A_MAX_CHANNELS];		// Conversion settings for each channel
+	WRAP_DECIMATION_INFO decimation[PS4000A_MAX_CHANNELS];	// Decimation settings and state for each channel
+
 } WRAP_BUFFER_INFO;
 
 typedef struct tWrapUserProbeInfo
@@ -103,8 +220,233 @@ typedef struct tWrapUserProbeInfo
 
 }WRAP_USER_PROBE_INFO;
 
-WRAP_BUFFER_INFO _wrapBufferInfo;
-WRAP_USER_PROBE_INFO wrapUserProbeInfo;
+#define WRAP_STREAMING_EVENT_QUEUE_SIZE		1024	// Number of streaming callback records held - must be a power of 2
+#define WRAP_STREAMING_EVENT_FIELDS			8		// Number of values per record returned by DrainStreamingEvents
+
+/****************************************************************************
+* tWrapStreamingEvent
+*
+* A record of the parameters passed to one call of the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEvent
+{
+	uint32_t	numSamples;
+	uint32_t	startIndex;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		overflow;
+	int16_t		autoStop;
+	uint64_t	timestamp;			// Host time in microseconds when the callback was received
+} WRAP_STREAMING_EVENT;
+
+/****************************************************************************
+* tWrapStreamingEventQueue
+*
+* Single-producer/single-consumer queue of streaming callback records. The 
+* streaming callback is the only writer of writeIndex and droppedEvents, and 
+* DrainStreamingEvents is the only writer of readIndex, so no lock is needed.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEventQueue
+{
+	WRAP_STREAMING_EVENT	events[WRAP_STREAMING_EVENT_QUEUE_SIZE];
+	volatile uint32_t		writeIndex;				// Total number of records added
+	volatile uint32_t		readIndex;				// Total number of records removed
+	volatile uint32_t		droppedEvents;			// Total number of records lost because the queue was full
+	uint32_t				reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainStreamingEvents
+} WRAP_STREAMING_EVENT_QUEUE;
+
+#define WRAP_TRIGGER_LOG_SIZE				4096	// Number of trigger records held - must be a power of 2
+#define WRAP_TRIGGER_LOG_FIELDS				2		// Number of values per record returned by DrainTriggerLog
+
+/****************************************************************************
+* tWrapTriggerRecord
+*
+* The position of one trigger reported by the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapTriggerRecord
+{
+	uint64_t	sampleIndex;		// Index of the trigger point counted from the first sample after resetTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_RECORD;
+
+/****************************************************************************
+* tWrapTriggerLog
+*
+* Single-producer/single-consumer log of streaming triggers, shared in the 
+* same way as WRAP_STREAMING_EVENT_QUEUE. sampleCount counts every sample 
+* the driver has passed to the streaming callback, so trigger positions do 
+* not depend on where the driver placed the data in its buffers and do not
+* wrap.
+*
+****************************************************************************/
+typedef struct tWrapTriggerLog
+{
+	WRAP_TRIGGER_RECORD	records[WRAP_TRIGGER_LOG_SIZE];
+	uint64_t			sampleCount;			// Samples received since the last resetTriggerLog
+	volatile uint32_t	writeIndex;				// Total number of records added
+	volatile uint32_t	readIndex;				// Total number of records removed
+	volatile uint32_t	droppedRecords;			// Total number of records lost because the log was full
+	uint32_t			reportedDroppedRecords;	// Value of droppedRecords at the last call to DrainTriggerLog
+} WRAP_TRIGGER_LOG;
+
+#define WRAP_TRIGGER_CAPTURE_FIELDS			2		// Number of values per record returned in triggers by DrainTriggerCaptures
+
+/****************************************************************************
+* tWrapTriggerCaptureRecord
+*
+* The position of the trigger for one record of a trigger capture.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCaptureRecord
+{
+	uint64_t	triggerPosition;	// Position of the trigger in the samples seen by the capture
+	uint64_t	nextPosition;		// Position of the next sample to copy into the record
+	uint64_t	sampleIndex;		// Trigger index reported to the application, as returned by DrainTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_CAPTURE_RECORD;
+
+/****************************************************************************
+* tWrapTriggerCapture
+*
+* The state used to capture a window of samples around each streaming 
+* trigger. The streaming callback keeps the last preTriggerSamples samples 
+* of each captured channel in a history ring. When a trigger is reported it
+* starts a record, copies the pre-trigger samples from the ring and the 
+* current block, and fills in the post-trigger samples from this and later
+* blocks. Records complete in trigger order and are passed to 
+* DrainTriggerCaptures through a single-producer/single-consumer queue in 
+* the same way as WRAP_STREAMING_EVENT_QUEUE.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCapture
+{
+	uint32_t						preTriggerSamples;
+	uint32_t						postTriggerSamples;
+	uint32_t						windowLength;								// preTriggerSamples + postTriggerSamples
+	uint32_t						recordLength;								// windowLength for each captured channel
+	int16_t							nChannels;
+	int16_t							channels[PS4000A_MAX_CHANNELS];				// Captured channels, in channel order
+	int16_t *						history;									// A ring of preTriggerSamples samples for each captured channel
+	uint64_t						samplesSeen;								// Samples passed to the streaming callback since the capture was set up
+
+	uint32_t						maxRecords;
+	int16_t *						recordData;									// maxRecords records of recordLength samples
+	WRAP_TRIGGER_CAPTURE_RECORD *	records;
+	uint32_t						startedRecords;								// Total number of records started - written only by the callback
+	volatile uint32_t				writeIndex;									// Total number of records completed
+	volatile uint32_t				readIndex;									// Total number of records removed
+	volatile uint32_t				droppedRecords;								// Total number of triggers lost because the queue was full
+	uint32_t						reportedDroppedRecords;						// Value of droppedRecords at the last call to DrainTriggerCaptures
+} WRAP_TRIGGER_CAPTURE;
+
+#define WRAP_WAIT_INFINITE	0xFFFFFFFF
+
+#define WRAP_MAX_HANDLE		32767
+
+#define WRAP_MAX_STREAMING_WORKERS	(PS4000A_MAX_CHANNELS - 1)	// The callback thread also processes channels
+
+/****************************************************************************
+* tWrapWorkerPool
+*
+* Threads that share the per-channel work of the streaming callback (copy, 
+* conversion to volts and decimation) with the driver's callback thread. 
+* The callback posts the enabled channels, takes channels itself along with 
+* the workers, and returns once every channel is finished.
+*
+****************************************************************************/
+typedef struct tWrapWorkerPool
+{
+	int16_t			nWorkers;									// 0 if the pool is not running
+	WRAP_THREAD		threads[WRAP_MAX_STREAMING_WORKERS];
+	uint32_t		parallelThreshold;							// Callbacks with fewer samples are processed on the callback thread
+	WRAP_LOCK		lock;										// Protects the fields below
+	WRAP_CONDITION	startCondition;								// Signalled when a callback posts channels or the pool is stopped
+	WRAP_CONDITION	doneCondition;								// Signalled when the last posted channel is finished
+	uint32_t		generation;									// Incremented each time a callback posts channels
+	int16_t			stopRequested;
+	int16_t			channels[PS4000A_MAX_CHANNELS];				// Channels posted by the callback
+	int16_t			nChannels;
+	int16_t			nextChannel;								// Index in channels of the next channel to be taken
+	int16_t			channelsRemaining;							// Channels not yet finished
+	uint32_t		startIndex;
+	uint32_t		noOfSamples;
+} WRAP_WORKER_POOL;
+
+#define WRAP_STREAMING_SNAPSHOT_FIELDS		8		// Number of values returned by GetStreamingSnapshot
+
+/****************************************************************************
+* tWrapStreamingSnapshot
+*
+* A consistent copy of the streaming status, protected by a sequence lock. 
+* The sequence is odd while the fields are being written, so a reader that 
+* sees an odd sequence, or a different sequence after reading the fields, 
+* reads them again. Readers never block the streaming callback. Writers, 
+* the callback among them, are serialised by snapshotLock, which is held 
+* only while the fields are written.
+*
+****************************************************************************/
+typedef struct tWrapStreamingSnapshot
+{
+	volatile uint32_t	sequence;
+	int16_t				ready;
+	uint32_t			numSamples;
+	uint32_t			startIndex;
+	int16_t				triggered;
+	uint32_t			triggeredAt;
+	int16_t				overflow;
+	int16_t				autoStop;
+	uint32_t			callbackCount;
+} WRAP_STREAMING_SNAPSHOT;
+
+/****************************************************************************
+* tWrapUnitInfo
+*
+* The wrapper state for one device. A structure is created for each handle 
+* the first time it is passed to a wrapper function, and is passed to the 
+* driver callbacks through pParameter, so several devices can collect data 
+* at the same time.
+*
+****************************************************************************/
+typedef struct tWrapUnitInfo
+{
+	int16_t						handle;
+	volatile int16_t			ready;
+	int16_t						autoStop;
+	uint32_t					numSamples;
+	uint32_t					triggeredAt;
+	int16_t						triggered;
+	uint32_t					startIndex;
+	int16_t						overflow;
+
+	int16_t						channelCount;							// Should be set to the correct number of channels for the PicoScope from the main application.
+	int16_t						enabledChannels[PS4000A_MAX_CHANNELS];	// Keep a record of the channels that are enabled
+
+	WRAP_BUFFER_INFO			wrapBufferInfo;
+	WRAP_STREAMING_EVENT_QUEUE	eventQueue;
+	WRAP_TRIGGER_LOG			triggerLog;
+	WRAP_TRIGGER_CAPTURE *		triggerCapture;								// NULL unless setTriggerCapture is in use
+
+	WRAP_LOCK					readyLock;								// Protects ready for WaitForStreamingData and WaitForBlockReady
+	WRAP_CONDITION				readyCondition;
+
+	uint32_t					callbackCount;							// Number of streaming callbacks received
+	WRAP_STREAMING_SNAPSHOT		snapshot;								// Status read by GetStreamingSnapshot
+	WRAP_LOCK					snapshotLock;							// Serialises writers of snapshot - readers do not take it
+
+	int16_t						probeStateChanged;
+	WRAP_USER_PROBE_INFO		userProbeInfo;
+
+	WRAP_WORKER_POOL			workerPool;
+
+	uint32_t					streamingCallsInProgress;				// GetStreamingLatestValues calls in progress, protected by _wrapUnitInfoLock
+} WRAP_UNIT_INFO;
+
+WRAP_UNIT_INFO *	_wrapUnitInfo[WRAP_MAX_HANDLE + 1];		// Wrapper state for each device, indexed by handle
+WRAP_LOCK			_wrapUnitInfoLock = WRAP_LOCK_INIT;		// Serialises creation and release of _wrapUnitInfo entries
+WRAP_CONDITION		_wrapUnitInfoCondition = WRAP_CONDITION_INIT;	// Signalled when a streaming call in progress ends
 
 /////////////////////////////////
 //
@@ -142,6 +484,18 @@ extern int16_t PREF0 PREF1 IsReady
 	int16_t handle
 );
 
+extern int16_t PREF0 PREF1 WaitForStreamingData
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
+extern int16_t PREF0 PREF1 WaitForBlockReady
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
 extern int16_t PREF0 PREF1 IsTriggerReady
 (
 	int16_t handle, 
@@ -277,4 +631,115 @@ extern PICO_STATUS PREF0 PREF1 getUserProbeBandwidthInfo
 	int32_t * defaultFilter
 );
 
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents
+(
+	int16_t handle,
+	uint32_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog
+(
+	int16_t handle,
+	uint64_t * triggers,
+	uint32_t maxTriggers,
+	uint32_t * nTriggers,
+	uint32_t * droppedTriggers
+);
+
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setChannelScaling
+(
+	int16_t handle,
+	int16_t channel,
+	int32_t range,
+	float analogueOffset,
+	int16_t maxADCValue,
+	float probeAttenuation
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	float * appMaxBuffer,
+	float * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	double * appMaxBuffer,
+	double * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 setChannelDecimation
+(
+	int16_t handle,
+	int16_t channel,
+	int32_t mode,
+	uint32_t ratio,
+	int16_t * appMaxBuffer,
+	int16_t * appMinBuffer,
+	uint32_t bufferLength
+);
+
+extern PICO_STATUS PREF0 PREF1 getDecimatedValues
+(
+	int16_t handle,
+	int16_t channel,
+	uint32_t * startIndex,
+	uint32_t * noOfValues
+);
+
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
+extern PICO_STATUS PREF0 PREF1 setStreamingWorkers
+(
+	int16_t handle,
+	int16_t nWorkers,
+	uint32_t parallelThreshold,
+	int16_t firstCpu
+);
+
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot
+(
+	int16_t handle,
+	uint32_t * snapshot
+);
+
+extern PICO_STATUS PREF0 PREF1 setTriggerCapture
+(
+	int16_t handle,
+	uint32_t preTriggerSamples,
+	uint32_t postTriggerSamples,
+	uint32_t maxRecords,
+	uint32_t * recordLength
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerCaptures
+(
+	int16_t handle,
+	int16_t * data,
+	uint64_t * triggers,
+	uint32_t maxRecords,
+	uint32_t * nRecords,
+	uint32_t * droppedRecords
+);
+
 #endif
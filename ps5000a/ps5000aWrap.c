@@ -29,21 +29,9 @@
  //
  /////////////////////////////////
 
-int16_t		_ready = 0;
-int16_t		_autoStop = 0;
-uint32_t	_numSamples = 0;
-uint32_t	_triggeredAt = 0;
-int16_t		_triggered = FALSE;
-uint32_t	_startIndex = 0;				// Start index in driver data buffer
-int16_t		_overflow = 0;
-
-int16_t		_channelCount = 0; // Should be set to 2 or 4 from the main application
-int16_t		_enabledChannels[PS5000A_MAX_CHANNELS] = { 0, 0, 0, 0 }; // Keep a record of the channels that are enabled
-
-int16_t		_digitalPortCount = 0;																							// Should be set to 2 from the main application
-int16_t		_enabledDigitalPorts[PS5000A_WRAP_MAX_DIGITAL_PORTS] = { 0, 0 };		// Keep a record of the channels that are enabled
-
-WRAP_BUFFER_INFO _wrapBufferInfo;
+WRAP_UNIT_INFO *	_wrapUnitInfo[WRAP_MAX_HANDLE + 1];
+static WRAP_LOCK	_wrapUnitInfoLock = WRAP_LOCK_INIT;		// Serialises creation and release of _wrapUnitInfo entries
+static WRAP_CONDITION	_wrapUnitInfoCondition = WRAP_CONDITION_INIT;	// Signalled when a streaming call in progress ends
 
 /////////////////////////////////
 //
@@ -51,621 +39,5435 @@ WRAP_BUFFER_INFO _wrapBufferInfo;
 //
 /////////////////////////////////
 
+static const uint32_t _rangeMillivolts[PS5000A_MAX_RANGES] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000 };
+
+static int16_t _simdLevel = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+static LARGE_INTEGER _timestampFrequency = { 0 };
+#endif
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+
+// Trigger sources that can be named in a trigger expression. Bit n of a WRAP_TRIGGER_TERM mask refers to entry n.
+static const char * _triggerSourceNames[WRAP_TRIGGER_SOURCE_COUNT] = { "A", "B", "C", "D", "EXT", "AUX", "PWQ", "PORT0", "PORT1", "PORT2", "PORT3" };
+static const PS5000A_CHANNEL _triggerSources[WRAP_TRIGGER_SOURCE_COUNT] = { PS5000A_CHANNEL_A, PS5000A_CHANNEL_B, PS5000A_CHANNEL_C, PS5000A_CHANNEL_D, PS5000A_EXTERNAL, 
+	PS5000A_TRIGGER_AUX, PS5000A_PULSE_WIDTH_SOURCE, PS5000A_DIGITAL_PORT0, PS5000A_DIGITAL_PORT1, PS5000A_DIGITAL_PORT2, PS5000A_DIGITAL_PORT3 };
+
+static WRAP_EXPRESSION_CACHE_ENTRY _expressionCache[WRAP_EXPRESSION_CACHE_SIZE];
+static WRAP_LOCK _expressionCacheLock = WRAP_LOCK_INIT;					// Protects _expressionCache and _coverSearch
+static WRAP_TRIGGER_COVER_SEARCH _coverSearch;
+
 /****************************************************************************
-* Streaming Callback
+* detectSimdLevel
 *
-* See ps5000aStreamingReady (callback)
+* Returns the widest instruction set extension that can be used for the 
+* volts conversion and the streaming copy on this processor (WRAP_SIMD_NONE,
+* WRAP_SIMD_SSE2, WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512). The volts conversion
+* uses the AVX2 kernels on processors with AVX-512.
 *
 ****************************************************************************/
-void PREF1 StreamingCallback(
-  int16_t handle,
-	int32_t noOfSamples,
-	uint32_t startIndex,
-	int16_t overflow,
-	uint32_t triggerAt,
-	int16_t triggered,
-	int16_t autoStop,
-	void * pParameter)
+static int16_t detectSimdLevel(void)
 {
-	int16_t channel = 0;
-	int16_t digitalPort = 0;
-	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
-	
-	if (pParameter != NULL)
-	{
-		_wrapBufferInfo = (WRAP_BUFFER_INFO *) pParameter;
-	}
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
 
-	_numSamples = noOfSamples;
-	_autoStop = autoStop;
-	_startIndex = startIndex;
+	__cpuid(cpuInfo, 1);
 
-	_triggered = triggered;
-	_triggeredAt = triggerAt;
+	if ((cpuInfo[3] & (1 << 26)) == 0)
+	{
+		return WRAP_SIMD_NONE;
+	}
 
-	_overflow = overflow;
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
 
-	if (_wrapBufferInfo != NULL && noOfSamples)
+	if (osSavesAvxState && maxLeaf >= 7)
 	{
-		// Analogue channels
-		for (channel = (int16_t) PS5000A_CHANNEL_A; channel < _channelCount; channel++)
-		{
-			if (_enabledChannels[channel])
-			{
-				if (_wrapBufferInfo->appBuffers && _wrapBufferInfo->driverBuffers)
-				{
-					// Max buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t));
-					}
+		__cpuidex(cpuInfo, 7, 0);
 
-					// Min buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-					}
-				}
-			}
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
 		}
 
-		// Digital channels
-		if (_digitalPortCount > 0)
+		if (cpuInfo[1] & (1 << 5))
 		{
-			// Use index 0 to indicate Digital Port 0
-			for (digitalPort = (int16_t)PS5000A_WRAP_DIGITAL_PORT0; digitalPort < _digitalPortCount; digitalPort++)
-			{
-				if (_enabledDigitalPorts[digitalPort])
-				{
-					// Copy data...
-					if (_wrapBufferInfo->appDigiBuffers && _wrapBufferInfo->driverDigiBuffers)
-					{
-						// Max digital buffers
-						if (_wrapBufferInfo->appDigiBuffers[digitalPort * 2] && _wrapBufferInfo->driverDigiBuffers[digitalPort * 2])
-						{
-								memcpy_s(&_wrapBufferInfo->appDigiBuffers[digitalPort * 2][startIndex], noOfSamples * sizeof(int16_t),
-										&_wrapBufferInfo->driverDigiBuffers[digitalPort * 2][startIndex], noOfSamples * sizeof(int16_t));
-						}
-
-						// Min digital buffers
-						if (_wrapBufferInfo->appDigiBuffers[digitalPort * 2 + 1] && _wrapBufferInfo->driverDigiBuffers[digitalPort * 2 + 1])
-						{
-								memcpy_s(&_wrapBufferInfo->appDigiBuffers[digitalPort * 2 + 1][startIndex], noOfSamples * sizeof(int16_t),
-										&_wrapBufferInfo->driverDigiBuffers[digitalPort * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-						}
-					}
-				}
-			}
+			return WRAP_SIMD_AVX2;
 		}
 	}
-  
-  _ready = 1;
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
 }
 
 /****************************************************************************
-* BlockCallback
+* getSimdLevel
 *
-* See ps5000aBlockReady (callback)
+* Returns the result of detectSimdLevel, which is only run the first time.
 *
 ****************************************************************************/
-void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+static int16_t getSimdLevel(void)
 {
-  _ready = 1;
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
 }
 
+#ifdef WRAP_SIMD_X86
 /****************************************************************************
-* RunBlock
-*
-* This function starts collecting data in block mode without the requirement 
-* for specifying callback functions. Use the IsReady function in conjunction 
-* to poll the driver once this function has been called.
-*
-* Input Arguments:
+* copyNonTemporalSse2
 *
-* handle - the handle of the required device.
-* preTriggerSamples - see noOfPreTriggerSamples in ps5000aRunBlock.
-* postTriggerSamples - see noOfPreTriggerSamples in ps5000aRunBlock.
-* timebase - see ps5000aRunBlock.
-* segmentIndex - see ps5000aRunBlock.
-*
-* Returns:
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
 *
-* PICO_OK or other code from PicoStatus.h
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 RunBlock(int16_t handle, int32_t preTriggerSamples, int32_t postTriggerSamples,
-            uint32_t timebase, uint32_t segmentIndex)
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
 {
-	_ready = 0;
-	_numSamples = preTriggerSamples + postTriggerSamples;
+	uint32_t i = 0;
 
-	return ps5000aRunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, 
-		NULL, segmentIndex, BlockCallback, NULL);
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
+
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
 }
+#endif
 
 /****************************************************************************
-* GetStreamingLatestValues
+* copySamples
 *
-* facilitates communication with the driver to return the next block of 
-* values to your application when capturing data in streaming mode. Use with 
-* programming languages that do not support callback functions.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-*
-* Returns:
-*
-* PICO_OK or other code from PicoStatus.h
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
 {
-	_ready = 0;
-	_numSamples = 0;
-	_autoStop = 0;
+	size_t nBytes = noOfSamples * sizeof(int16_t);
+
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
 
-	return ps5000aGetStreamingLatestValues(handle, StreamingCallback, &_wrapBufferInfo);
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
 }
 
 /****************************************************************************
-* AvailableData
+* copyToRingBuffer
 *
-* Returns the number of samples returned from the driver and shows 
-* the start index of the data in the buffer when collecting data in 
-* streaming mode.
+* Copies a block of samples from a driver buffer into an application ring 
+* buffer, splitting the copy in two where the block wraps around the end of 
+* the ring. If the block is longer than the ring, only the most recent 
+* ringLength samples are kept.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* startIndex - on exit, an index to the first valid sample in the buffer 
-*				(When data is available).
-*
-* Returns:
-*
-* 0 - Data is not yet available.
-* Non-zero - the number of samples returned from the driver.
+* ringBuffer - the application ring buffer.
+* ringPosition - the index in the ring to start writing at.
+* ringLength - the length of the ring buffer in samples.
+* source - the first sample to copy from the driver buffer.
+* noOfSamples - the number of samples to copy.
 *
 ****************************************************************************/
-extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+static void copyToRingBuffer(int16_t * ringBuffer, uint32_t ringPosition, uint32_t ringLength, int16_t * source, uint32_t noOfSamples)
 {
-	if ( _ready ) 
+	uint32_t firstPart = 0;
+
+	if (noOfSamples > ringLength)
 	{
-		*startIndex = _startIndex;
-		return _numSamples;
+		// Only the last ringLength samples survive - skip the rest
+		ringPosition = (uint32_t) ((ringPosition + (noOfSamples - ringLength)) % ringLength);
+		source += noOfSamples - ringLength;
+		noOfSamples = ringLength;
 	}
 
-	return 0;
+	firstPart = ringLength - ringPosition;
+
+	if (noOfSamples <= firstPart)
+	{
+		copySamples(&ringBuffer[ringPosition], source, noOfSamples);
+	}
+	else
+	{
+		copySamples(&ringBuffer[ringPosition], source, firstPart);
+		copySamples(ringBuffer, &source[firstPart], noOfSamples - firstPart);
+	}
 }
 
 /****************************************************************************
-* AutoStopped
-*
-* Indicates if the device has stopped on collection of the number of samples 
-* specified in the call to the ps5000aRunStreaming function (if the 
-* ps5000aRunStreaming function's autostop flag is set).
-*
-* Input Arguments:
+* copyStreamingData
 *
-* handle - the handle of the required device.
-*
-* Returns:
-*
-* Non-zero - if streaming has autostopped.
+* Copies noOfSamples samples starting at startIndex in a driver buffer to the
+* corresponding application buffer, either at the same index or, in ring 
+* buffer mode, at the current ring write position.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+static void copyStreamingData(WRAP_UNIT_INFO * wrapUnitInfo, int16_t * appBuffer, int16_t * driverBuffer, uint32_t startIndex, uint32_t noOfSamples, 
+	uint32_t ringPosition)
 {
-	if ( _ready) 
+	if (wrapUnitInfo->ringMode)
 	{
-		return _autoStop;
+		copyToRingBuffer(appBuffer, ringPosition, wrapUnitInfo->ringLength, &driverBuffer[startIndex], noOfSamples);
 	}
 	else
 	{
-		return 0;
+		copySamples(&appBuffer[startIndex], &driverBuffer[startIndex], noOfSamples);
 	}
 }
 
 /****************************************************************************
-* IsReady
-*
-* This function is used to poll the driver to verify that data is ready to be 
-* received. The RunBlock or GetStreamingLatestValues function must have been 
-* called prior to calling this function.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
+* convertToFloatScalar
 *
-* Returns:
-*
-* 0 - Data is not yet available.
-* Non-zero - Data is ready to be collected.
+* Converts noOfSamples ADC counts to volts one sample at a time. Used when 
+* the processor has no suitable extensions and for the samples left over 
+* at the end of the vector loops.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+static void convertToFloatScalar(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
 {
-	return _ready;
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		destination[i] = (float) source[i] * scale + offset;
+	}
 }
 
 /****************************************************************************
-* IsTriggerReady
-*
-* Indicates whether a trigger has occurred when collecting data in streaming 
-* mode, and the location of the trigger point in the buffer.
-*
-* Input Arguments:
-*
-* handle - the handle of the required device.
-* triggeredAt - on exit, the index of the sample in the buffer where the 
-* trigger occurred.
-*
-* Returns:
+* convertToDoubleScalar
 *
-* 0 - The device has not triggered.
-* Non-zero - The device has been triggered.
+* As convertToFloatScalar, for double precision application buffers.
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+static void convertToDoubleScalar(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
 {
-	if (_triggered)
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
 	{
-		*triggeredAt = _triggeredAt;
+		destination[i] = (double) source[i] * scale + offset;
 	}
-
-	return _triggered;
 }
 
+#ifdef WRAP_SIMD_X86
+
 /****************************************************************************
-* ClearTriggerReady
-*
-* Clears the triggered and triggeredAt flags in relation to streaming mode 
-* capture.
-*
-* Input Arguments:
+* convertToFloatSse2
 *
-* handle - the handle of the required device.
-*
-* Returns:
-*
-* PICO_OK
+* Converts ADC counts to volts 8 samples at a time using SSE2. The counts 
+* are sign extended to 32 bits by unpacking each one into the upper half of 
+* a 32-bit lane and shifting it back down.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 ClearTriggerReady(int16_t handle)
+static WRAP_TARGET_SSE2 void convertToFloatSse2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
 {
-	_triggeredAt = 0;
-	_triggered = FALSE;
-	return PICO_OK;
+	uint32_t i = 0;
+	__m128 scaleVector = _mm_set1_ps(scale);
+	__m128 offsetVector = _mm_set1_ps(offset);
+	__m128i counts;
+	__m128i low;
+	__m128i high;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		counts = _mm_loadu_si128((const __m128i *) &source[i]);
+
+		low = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+		high = _mm_srai_epi32(_mm_unpackhi_epi16(counts, counts), 16);
+
+		_mm_storeu_ps(&destination[i], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm_storeu_ps(&destination[i + 4], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), scaleVector), offsetVector));
+	}
+
+	convertToFloatScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
 }
 
 /****************************************************************************
-* SetTriggerConditions
+* convertToFloatAvx2
 *
-* NOTE: This function is deprecated - use SetTriggerConditionsV2 instead.
+* Converts ADC counts to volts 16 samples at a time using AVX2, leaving any 
+* remaining samples to convertToFloatSse2.
 *
-* This function sets up trigger conditions on the scope's inputs. The trigger 
+****************************************************************************/
+static WRAP_TARGET_AVX2 void convertToFloatAvx2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
+{
+	uint32_t i = 0;
+	__m256 scaleVector = _mm256_set1_ps(scale);
+	__m256 offsetVector = _mm256_set1_ps(offset);
+	__m256i counts;
+	__m256i low;
+	__m256i high;
+
+	for (i = 0; i + 16 <= noOfSamples; i += 16)
+	{
+		counts = _mm256_loadu_si256((const __m256i *) &source[i]);
+
+		low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(counts));
+		high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(counts, 1));
+
+		_mm256_storeu_ps(&destination[i], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm256_storeu_ps(&destination[i + 8], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(high), scaleVector), offsetVector));
+	}
+
+	convertToFloatSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+/****************************************************************************
+* convertToDoubleSse2
+*
+* Converts ADC counts to volts 4 samples at a time using SSE2.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void convertToDoubleSse2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
+{
+	uint32_t i = 0;
+	__m128d scaleVector = _mm_set1_pd(scale);
+	__m128d offsetVector = _mm_set1_pd(offset);
+	__m128i counts;
+	__m128i words;
+
+	for (i = 0; i + 4 <= noOfSamples; i += 4)
+	{
+		counts = _mm_loadl_epi64((const __m128i *) &source[i]);
+		words = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+
+		_mm_storeu_pd(&destination[i], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(words), scaleVector), offsetVector));
+		_mm_storeu_pd(&destination[i + 2], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(words, _MM_SHUFFLE(3, 2, 3, 2))), 
+			scaleVector), offsetVector));
+	}
+
+	convertToDoubleScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+/****************************************************************************
+* convertToDoubleAvx2
+*
+* Converts ADC counts to volts 8 samples at a time using AVX2, leaving any 
+* remaining samples to convertToDoubleSse2.
+*
+****************************************************************************/
+static WRAP_TARGET_AVX2 void convertToDoubleAvx2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
+{
+	uint32_t i = 0;
+	__m256d scaleVector = _mm256_set1_pd(scale);
+	__m256d offsetVector = _mm256_set1_pd(offset);
+	__m256i words;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		words = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &source[i]));
+
+		_mm256_storeu_pd(&destination[i], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(words)), 
+			scaleVector), offsetVector));
+		_mm256_storeu_pd(&destination[i + 4], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(words, 1)), 
+			scaleVector), offsetVector));
+	}
+
+	convertToDoubleSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+#endif
+
+/****************************************************************************
+* convertSamples
+*
+* Converts noOfSamples ADC counts to volts using the scaling for a channel, 
+* writing the result to the float and/or double buffer given. Either buffer 
+* may be NULL.
+*
+****************************************************************************/
+static void convertSamples(WRAP_CHANNEL_SCALING * scaling, const int16_t * source, float * floatBuffer, double * doubleBuffer, uint32_t noOfSamples)
+{
+	int16_t simdLevel = getSimdLevel();
+
+	if (floatBuffer != NULL)
+	{
+		switch (simdLevel)
+		{
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToFloatAvx2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToFloatSse2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+#endif
+			default:
+				convertToFloatScalar(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+		}
+	}
+
+	if (doubleBuffer != NULL)
+	{
+		switch (simdLevel)
+		{
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToDoubleAvx2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToDoubleSse2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+#endif
+			default:
+				convertToDoubleScalar(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+		}
+	}
+}
+
+/****************************************************************************
+* minMaxScalar
+*
+* Updates maxValue and minValue with the largest sample in maxSource and the 
+* smallest sample in minSource.
+*
+****************************************************************************/
+static void minMaxScalar(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		if (maxSource[i] > *maxValue)
+		{
+			*maxValue = maxSource[i];
+		}
+
+		if (minSource[i] < *minValue)
+		{
+			*minValue = minSource[i];
+		}
+	}
+}
+
+/****************************************************************************
+* sumScalar
+*
+* Returns the sum of noOfSamples samples.
+*
+****************************************************************************/
+static int64_t sumScalar(const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	int64_t sum = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		sum += source[i];
+	}
+
+	return sum;
+}
+
+#ifdef WRAP_SIMD_X86
+
+/****************************************************************************
+* minMaxSse2
+*
+* As minMaxScalar, comparing 8 samples at a time using SSE2.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void minMaxSse2(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+	uint32_t i = 0;
+	int16_t maxLanes[8];
+	int16_t minLanes[8];
+	__m128i maxVector = _mm_set1_epi16(*maxValue);
+	__m128i minVector = _mm_set1_epi16(*minValue);
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		maxVector = _mm_max_epi16(maxVector, _mm_loadu_si128((const __m128i *) &maxSource[i]));
+		minVector = _mm_min_epi16(minVector, _mm_loadu_si128((const __m128i *) &minSource[i]));
+	}
+
+	_mm_storeu_si128((__m128i *) maxLanes, maxVector);
+	_mm_storeu_si128((__m128i *) minLanes, minVector);
+	minMaxScalar(maxLanes, minLanes, 8, maxValue, minValue);
+
+	minMaxScalar(&maxSource[i], &minSource[i], noOfSamples - i, maxValue, minValue);
+}
+
+/****************************************************************************
+* sumSse2
+*
+* As sumScalar, adding 8 samples at a time using SSE2. The 32-bit lane 
+* totals are moved into the 64-bit sum before they can overflow.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 int64_t sumSse2(const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	uint32_t end = 0;
+	int32_t lanes[4];
+	int64_t sum = 0;
+	__m128i ones = _mm_set1_epi16(1);
+	__m128i total;
+
+	while (i + 8 <= noOfSamples)
+	{
+		end = (noOfSamples - i > WRAP_DECIMATION_SUM_BLOCK) ? i + WRAP_DECIMATION_SUM_BLOCK : noOfSamples;
+		total = _mm_setzero_si128();
+
+		for (; i + 8 <= end; i += 8)
+		{
+			// Multiplying by 1 and adding pairs widens the samples to 32 bits
+			total = _mm_add_epi32(total, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &source[i]), ones));
+		}
+
+		_mm_storeu_si128((__m128i *) lanes, total);
+		sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+
+	return sum + sumScalar(&source[i], noOfSamples - i);
+}
+
+#endif
+
+/****************************************************************************
+* minMaxSamples
+*
+* Calls minMaxSse2 or minMaxScalar depending on the processor.
+*
+****************************************************************************/
+static void minMaxSamples(const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples, int16_t * maxValue, int16_t * minValue)
+{
+#ifdef WRAP_SIMD_X86
+	if (getSimdLevel() >= WRAP_SIMD_SSE2)
+	{
+		minMaxSse2(maxSource, minSource, noOfSamples, maxValue, minValue);
+		return;
+	}
+#endif
+	minMaxScalar(maxSource, minSource, noOfSamples, maxValue, minValue);
+}
+
+/****************************************************************************
+* sumSamples
+*
+* Calls sumSse2 or sumScalar depending on the processor.
+*
+****************************************************************************/
+static int64_t sumSamples(const int16_t * source, uint32_t noOfSamples)
+{
+#ifdef WRAP_SIMD_X86
+	if (getSimdLevel() >= WRAP_SIMD_SSE2)
+	{
+		return sumSse2(source, noOfSamples);
+	}
+#endif
+	return sumScalar(source, noOfSamples);
+}
+
+/****************************************************************************
+* resetDecimationBlock
+*
+* Clears the state of the partly complete block for a channel.
+*
+****************************************************************************/
+static void resetDecimationBlock(WRAP_DECIMATION_INFO * decimation)
+{
+	decimation->blockCount = 0;
+	decimation->blockMax = INT16_MIN;
+	decimation->blockMin = INT16_MAX;
+	decimation->blockSum = 0;
+}
+
+/****************************************************************************
+* decimateStreamingData
+*
+* Adds noOfSamples samples to the decimation for a channel, writing a value 
+* to the application buffers each time a block of ratio samples completes.
+* minSource is only used in min/max mode, and may be the same as maxSource 
+* when the data is not aggregated.
+*
+****************************************************************************/
+static void decimateStreamingData(WRAP_DECIMATION_INFO * decimation, const int16_t * maxSource, const int16_t * minSource, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	uint32_t blockSamples = 0;
+	uint32_t outputIndex = 0;
+
+	while (i < noOfSamples)
+	{
+		blockSamples = decimation->ratio - decimation->blockCount;
+
+		if (blockSamples > noOfSamples - i)
+		{
+			blockSamples = noOfSamples - i;
+		}
+
+		switch (decimation->mode)
+		{
+			case WRAP_DECIMATION_MIN_MAX:
+				minMaxSamples(&maxSource[i], &minSource[i], blockSamples, &decimation->blockMax, &decimation->blockMin);
+				break;
+
+			case WRAP_DECIMATION_MEAN:
+				decimation->blockSum += sumSamples(&maxSource[i], blockSamples);
+				break;
+
+			case WRAP_DECIMATION_EVERY_NTH:
+				if (decimation->blockCount == 0)
+				{
+					decimation->blockMax = maxSource[i];
+				}
+				break;
+
+			default:
+				return;
+		}
+
+		decimation->blockCount += blockSamples;
+		i += blockSamples;
+
+		if (decimation->blockCount == decimation->ratio)
+		{
+			outputIndex = (uint32_t) (decimation->writeCount % decimation->bufferLength);
+
+			if (decimation->mode == WRAP_DECIMATION_MEAN)
+			{
+				decimation->appMaxBuffer[outputIndex] = (int16_t) (decimation->blockSum / (int64_t) decimation->ratio);
+			}
+			else
+			{
+				decimation->appMaxBuffer[outputIndex] = decimation->blockMax;
+			}
+
+			if (decimation->mode == WRAP_DECIMATION_MIN_MAX)
+			{
+				decimation->appMinBuffer[outputIndex] = decimation->blockMin;
+			}
+
+			// The release store makes sure the value is in the buffer before it is counted
+			WRAP_STORE_UINT64(&decimation->writeCount, decimation->writeCount + 1);
+
+			resetDecimationBlock(decimation);
+		}
+	}
+}
+
+/****************************************************************************
+* convertStreamingData
+*
+* Converts noOfSamples samples starting at startIndex in a driver buffer to 
+* volts, writing them to the float and double application buffers registered 
+* for it either at the same index or, in ring buffer mode, at the current 
+* ring write position.
+*
+****************************************************************************/
+static void convertStreamingData(WRAP_UNIT_INFO * wrapUnitInfo, int16_t channel, int16_t bufferIndex, uint32_t startIndex, uint32_t noOfSamples, 
+	uint32_t ringPosition)
+{
+	WRAP_BUFFER_INFO * wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+	WRAP_CHANNEL_SCALING * scaling = &wrapBufferInfo->scaling[channel];
+	float * floatBuffer = wrapBufferInfo->appFloatBuffers[bufferIndex];
+	double * doubleBuffer = wrapBufferInfo->appDoubleBuffers[bufferIndex];
+	int16_t * source = NULL;
+	uint32_t ringLength = wrapUnitInfo->ringLength;
+	uint32_t firstPart = 0;
+
+	if (wrapBufferInfo->driverBuffers[bufferIndex] == NULL || (floatBuffer == NULL && doubleBuffer == NULL))
+	{
+		return;
+	}
+
+	source = &wrapBufferInfo->driverBuffers[bufferIndex][startIndex];
+
+	if (!wrapUnitInfo->ringMode)
+	{
+		convertSamples(scaling, source, floatBuffer ? &floatBuffer[startIndex] : NULL, doubleBuffer ? &doubleBuffer[startIndex] : NULL, noOfSamples);
+		return;
+	}
+
+	if (noOfSamples > ringLength)
+	{
+		// Only the last ringLength samples survive - skip the rest
+		ringPosition = (uint32_t) ((ringPosition + (noOfSamples - ringLength)) % ringLength);
+		source += noOfSamples - ringLength;
+		noOfSamples = ringLength;
+	}
+
+	firstPart = ringLength - ringPosition;
+
+	if (firstPart > noOfSamples)
+	{
+		firstPart = noOfSamples;
+	}
+
+	convertSamples(scaling, source, floatBuffer ? &floatBuffer[ringPosition] : NULL, doubleBuffer ? &doubleBuffer[ringPosition] : NULL, firstPart);
+
+	if (noOfSamples > firstPart)
+	{
+		convertSamples(scaling, &source[firstPart], floatBuffer, doubleBuffer, noOfSamples - firstPart);
+	}
+}
+
+/****************************************************************************
+* getHostTimestamp
+*
+* Returns a monotonic host time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getHostTimestamp(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	LARGE_INTEGER counter;
+
+	// The frequency is fixed at boot, so it is only read once
+	if (_timestampFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&_timestampFrequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / _timestampFrequency.QuadPart) * 1000000 + 
+		((counter.QuadPart % _timestampFrequency.QuadPart) * 1000000) / _timestampFrequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
+}
+
+/****************************************************************************
+* pushStreamingEvent
+*
+* Adds a record of a streaming callback to the event queue. Called only from 
+* the streaming callback. If the queue is full, the record is discarded and 
+* counted as dropped. Neither path takes a lock.
+*
+****************************************************************************/
+static void pushStreamingEvent(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t numSamples, uint32_t startIndex, int16_t triggered, 
+	uint32_t triggeredAt, int16_t overflow, int16_t autoStop)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_STREAMING_EVENT_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+	event->numSamples = numSamples;
+	event->startIndex = startIndex;
+	event->triggered = triggered;
+	event->triggeredAt = triggeredAt;
+	event->overflow = overflow;
+	event->autoStop = autoStop;
+	event->timestamp = getHostTimestamp();
+
+	// Make sure the record is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* drainStreamingEventQueue
+*
+* Copies up to maxEvents records out of the event queue into a flat array and
+* removes them from the queue. Called only from DrainStreamingEvents.
+*
+****************************************************************************/
+static void drainStreamingEventQueue(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, 
+	uint32_t * droppedEvents)
+{
+	uint32_t readIndex = queue->readIndex;
+	uint32_t writeIndex = queue->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+		events[j]		= event->numSamples;
+		events[j + 1]	= event->startIndex;
+		events[j + 2]	= (uint32_t) event->triggered;
+		events[j + 3]	= event->triggeredAt;
+		events[j + 4]	= (uint32_t) (uint16_t) event->overflow;
+		events[j + 5]	= (uint32_t) event->autoStop;
+		events[j + 6]	= (uint32_t) (event->timestamp & 0xFFFFFFFF);
+		events[j + 7]	= (uint32_t) (event->timestamp >> 32);
+
+		j = j + WRAP_STREAMING_EVENT_FIELDS;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+}
+
+/****************************************************************************
+* logStreamingTrigger
+*
+* Adds the trigger reported by a streaming callback, if any, to the trigger 
+* log and advances the sample count past the samples in the callback. 
+* Called only from the streaming callback. If the log is full, the trigger 
+* is discarded and counted as dropped.
+*
+****************************************************************************/
+static void logStreamingTrigger(WRAP_TRIGGER_LOG * log, int32_t numSamples, int16_t triggered, uint32_t triggeredAt)
+{
+	uint32_t writeIndex = log->writeIndex;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	if (triggered)
+	{
+		if (writeIndex - log->readIndex >= WRAP_TRIGGER_LOG_SIZE)
+		{
+			log->droppedRecords = log->droppedRecords + 1;
+		}
+		else
+		{
+			record = &log->records[writeIndex & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+			record->sampleIndex = log->sampleCount + triggeredAt;
+			record->timestamp = getHostTimestamp();
+
+			// Make sure the record is complete before it is made visible to the reader
+			WRAP_MEMORY_BARRIER();
+
+			log->writeIndex = writeIndex + 1;
+		}
+	}
+
+	if (numSamples > 0)
+	{
+		log->sampleCount += (uint32_t) numSamples;
+	}
+}
+
+/****************************************************************************
+* drainTriggerLog
+*
+* Copies up to maxTriggers records out of the trigger log into a flat array
+* and removes them from the log. Called only from DrainTriggerLog.
+*
+****************************************************************************/
+static void drainTriggerLog(WRAP_TRIGGER_LOG * log, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, 
+	uint32_t * droppedTriggers)
+{
+	uint32_t readIndex = log->readIndex;
+	uint32_t writeIndex = log->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxTriggers)
+	{
+		count = maxTriggers;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &log->records[(readIndex + i) & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS]		= record->sampleIndex;
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS + 1]	= record->timestamp;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	log->readIndex = readIndex + count;
+	*nTriggers = count;
+
+	if (droppedTriggers != NULL)
+	{
+		dropped = log->droppedRecords;
+		*droppedTriggers = dropped - log->reportedDroppedRecords;
+		log->reportedDroppedRecords = dropped;
+	}
+}
+
+/****************************************************************************
+* copyTriggerHistory
+*
+* Copies count samples starting at position from (toHistory set) or to a 
+* history ring of length samples. The ring holds sample n at index 
+* n % length.
+*
+****************************************************************************/
+static void copyTriggerHistory(int16_t * ring, uint32_t length, uint64_t position, int16_t * samples, uint32_t count, int16_t toHistory)
+{
+	uint32_t index = (uint32_t) (position % length);
+	uint32_t first = (count < length - index) ? count : length - index;
+
+	if (toHistory)
+	{
+		memcpy(&ring[index], samples, first * sizeof(int16_t));
+		memcpy(ring, &samples[first], (count - first) * sizeof(int16_t));
+	}
+	else
+	{
+		memcpy(samples, &ring[index], first * sizeof(int16_t));
+		memcpy(&samples[first], ring, (count - first) * sizeof(int16_t));
+	}
+}
+
+/****************************************************************************
+* startTriggerCaptureRecord
+*
+* Starts a record for a trigger at triggerPosition, reported in a block 
+* starting at position, and copies in the pre-trigger samples held in the 
+* history rings. Pre-trigger samples from before the start of the capture 
+* are set to 0.
+*
+****************************************************************************/
+static void startTriggerCaptureRecord(WRAP_TRIGGER_CAPTURE * capture, uint64_t position, uint64_t triggerPosition, uint64_t sampleIndex)
+{
+	WRAP_TRIGGER_CAPTURE_RECORD * record = &capture->records[capture->startedRecords % capture->maxRecords];
+	int16_t * data = &capture->recordData[(size_t) (capture->startedRecords % capture->maxRecords) * capture->recordLength];
+	uint64_t windowStart = 0;
+	uint64_t historyStart = 0;
+	uint32_t missing = 0;
+	int16_t i = 0;
+
+	if (capture->startedRecords - capture->readIndex >= capture->maxRecords)
+	{
+		capture->droppedRecords = capture->droppedRecords + 1;
+		return;
+	}
+
+	if (triggerPosition < capture->preTriggerSamples)
+	{
+		missing = capture->preTriggerSamples - (uint32_t) triggerPosition;
+	}
+	else
+	{
+		windowStart = triggerPosition - capture->preTriggerSamples;
+	}
+
+	historyStart = windowStart;
+
+	for (i = 0; i < capture->nChannels; i++)
+	{
+		memset(&data[i * capture->windowLength], 0, missing * sizeof(int16_t));
+
+		if (historyStart < position)
+		{
+			copyTriggerHistory(&capture->history[i * capture->preTriggerSamples], capture->preTriggerSamples, historyStart, 
+				&data[i * capture->windowLength + missing], (uint32_t) (position - historyStart), 0);
+		}
+	}
+
+	record->triggerPosition = triggerPosition;
+	record->nextPosition = (historyStart < position) ? position : historyStart;
+	record->sampleIndex = sampleIndex;
+	record->timestamp = getHostTimestamp();
+
+	capture->startedRecords++;
+}
+
+/****************************************************************************
+* updateTriggerCapture
+*
+* Updates the trigger capture for one streaming callback: starts a record if
+* a trigger was reported, copies the samples in the block into the records 
+* that need them, completes any records that are full and updates the 
+* history rings. Called only from captureTriggerWindows.
+*
+****************************************************************************/
+static void updateTriggerCapture(WRAP_UNIT_INFO * wrapUnitInfo, WRAP_TRIGGER_CAPTURE * capture, int32_t noOfSamples, uint32_t startIndex, 
+	int16_t triggered, uint32_t triggeredAt)
+{
+	WRAP_TRIGGER_CAPTURE_RECORD * record = NULL;
+	int16_t * source = NULL;
+	int16_t * data = NULL;
+	uint64_t position = 0;
+	uint64_t end = 0;
+	uint64_t windowEnd = 0;
+	uint32_t numSamples = (noOfSamples > 0) ? (uint32_t) noOfSamples : 0;
+	uint32_t count = 0;
+	uint32_t offset = 0;
+	uint32_t r = 0;
+	int16_t i = 0;
+
+	position = capture->samplesSeen;
+	end = position + numSamples;
+
+	if (triggered)
+	{
+		startTriggerCaptureRecord(capture, position, position + triggeredAt, wrapUnitInfo->triggerLog.sampleCount + triggeredAt);
+	}
+
+	// Copy the block into every record still being filled
+	for (r = capture->writeIndex; r != capture->startedRecords; r++)
+	{
+		record = &capture->records[r % capture->maxRecords];
+		data = &capture->recordData[(size_t) (r % capture->maxRecords) * capture->recordLength];
+		windowEnd = record->triggerPosition + capture->postTriggerSamples;
+
+		if (record->nextPosition >= end || record->nextPosition >= windowEnd)
+		{
+			continue;
+		}
+
+		count = (uint32_t) (((end < windowEnd) ? end : windowEnd) - record->nextPosition);
+		offset = (uint32_t) (record->nextPosition + capture->preTriggerSamples - record->triggerPosition);
+
+		for (i = 0; i < capture->nChannels; i++)
+		{
+			source = wrapUnitInfo->wrapBufferInfo.driverBuffers[capture->channels[i] * 2];
+
+			if (source != NULL)
+			{
+				memcpy(&data[i * capture->windowLength + offset], &source[startIndex + (uint32_t) (record->nextPosition - position)], count * sizeof(int16_t));
+			}
+			else
+			{
+				memset(&data[i * capture->windowLength + offset], 0, count * sizeof(int16_t));
+			}
+		}
+
+		record->nextPosition += count;
+	}
+
+	// Records complete in the order they were started
+	while (capture->writeIndex != capture->startedRecords)
+	{
+		record = &capture->records[capture->writeIndex % capture->maxRecords];
+
+		if (record->nextPosition < record->triggerPosition + capture->postTriggerSamples)
+		{
+			break;
+		}
+
+		// Make sure the record is complete before it is made visible to the reader
+		WRAP_MEMORY_BARRIER();
+
+		capture->writeIndex = capture->writeIndex + 1;
+	}
+
+	// Keep the last preTriggerSamples samples of each channel
+	if (capture->preTriggerSamples > 0 && numSamples > 0)
+	{
+		count = (numSamples < capture->preTriggerSamples) ? numSamples : capture->preTriggerSamples;
+
+		for (i = 0; i < capture->nChannels; i++)
+		{
+			source = wrapUnitInfo->wrapBufferInfo.driverBuffers[capture->channels[i] * 2];
+
+			if (source != NULL)
+			{
+				copyTriggerHistory(&capture->history[i * capture->preTriggerSamples], capture->preTriggerSamples, end - count, 
+					&source[startIndex + numSamples - count], count, 1);
+			}
+		}
+	}
+
+	capture->samplesSeen = end;
+}
+
+/****************************************************************************
+* captureTriggerWindows
+*
+* Updates the trigger capture, if one is set up, for one streaming callback.
+* Called only from the streaming callback.
+*
+****************************************************************************/
+static void captureTriggerWindows(WRAP_UNIT_INFO * wrapUnitInfo, int32_t noOfSamples, uint32_t startIndex, int16_t triggered, uint32_t triggeredAt)
+{
+	// setTriggerCapture may be replacing the capture from another thread
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	if (wrapUnitInfo->triggerCapture != NULL)
+	{
+		updateTriggerCapture(wrapUnitInfo, wrapUnitInfo->triggerCapture, noOfSamples, startIndex, triggered, triggeredAt);
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+}
+
+/****************************************************************************
+* freeTriggerCapture
+*
+* Frees a trigger capture and its buffers.
+*
+****************************************************************************/
+static void freeTriggerCapture(WRAP_TRIGGER_CAPTURE * capture)
+{
+	if (capture == NULL)
+	{
+		return;
+	}
+
+	free(capture->history);
+	free(capture->recordData);
+	free(capture->records);
+	free(capture);
+}
+
+/****************************************************************************
+* findInRangeScalar
+*
+* Returns the index of the first of noOfSamples samples that is inside the 
+* range low to high inclusive (or outside it if inside is 0), or noOfSamples
+* if there is none.
+*
+****************************************************************************/
+static uint32_t findInRangeScalar(const int16_t * samples, uint32_t noOfSamples, int16_t low, int16_t high, int16_t inside)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		if ((samples[i] >= low && samples[i] <= high) == (inside != 0))
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+#ifdef WRAP_SIMD_X86
+
+/****************************************************************************
+* findInRangeSse2
+*
+* Compares 8 samples at a time with the range using SSE2, and finds the 
+* matching sample in the first block that contains one with 
+* findInRangeScalar.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 uint32_t findInRangeSse2(const int16_t * samples, uint32_t noOfSamples, int16_t low, int16_t high, int16_t inside)
+{
+	uint32_t i = 0;
+	int32_t none = inside ? 0xFFFF : 0;		// Mask of samples outside the range when no sample matches
+	__m128i lowVector = _mm_set1_epi16(low);
+	__m128i highVector = _mm_set1_epi16(high);
+	__m128i values;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		values = _mm_loadu_si128((const __m128i *) &samples[i]);
+
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi16(values, lowVector), _mm_cmpgt_epi16(values, highVector))) != none)
+		{
+			break;
+		}
+	}
+
+	return i + findInRangeScalar(&samples[i], noOfSamples - i, low, high, inside);
+}
+
+/****************************************************************************
+* findInRangeAvx2
+*
+* Compares 16 samples at a time with the range using AVX2, leaving the 
+* remaining samples to findInRangeSse2.
+*
+****************************************************************************/
+static WRAP_TARGET_AVX2 uint32_t findInRangeAvx2(const int16_t * samples, uint32_t noOfSamples, int16_t low, int16_t high, int16_t inside)
+{
+	uint32_t i = 0;
+	int32_t none = inside ? -1 : 0;
+	__m256i lowVector = _mm256_set1_epi16(low);
+	__m256i highVector = _mm256_set1_epi16(high);
+	__m256i values;
+
+	for (i = 0; i + 16 <= noOfSamples; i += 16)
+	{
+		values = _mm256_loadu_si256((const __m256i *) &samples[i]);
+
+		if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpgt_epi16(lowVector, values), _mm256_cmpgt_epi16(values, highVector))) != none)
+		{
+			break;
+		}
+	}
+
+	return i + findInRangeSse2(&samples[i], noOfSamples - i, low, high, inside);
+}
+
+#endif
+
+/****************************************************************************
+* findInRange
+*
+* Returns the index of the first of noOfSamples samples that is inside the 
+* range low to high inclusive (or outside it if inside is 0), or noOfSamples
+* if there is none. The range may extend beyond the ADC counts, and is empty
+* if low is greater than high.
+*
+****************************************************************************/
+static uint32_t findInRange(const int16_t * samples, uint32_t noOfSamples, int32_t low, int32_t high, int16_t inside)
+{
+	low = (low < INT16_MIN) ? INT16_MIN : low;
+	high = (high > INT16_MAX) ? INT16_MAX : high;
+
+	if (low > high)
+	{
+		return inside ? noOfSamples : 0;
+	}
+
+	switch (getSimdLevel())
+	{
+#ifdef WRAP_SIMD_X86
+		case WRAP_SIMD_AVX512:
+		case WRAP_SIMD_AVX2:
+			return findInRangeAvx2(samples, noOfSamples, (int16_t) low, (int16_t) high, inside);
+
+		case WRAP_SIMD_SSE2:
+			return findInRangeSse2(samples, noOfSamples, (int16_t) low, (int16_t) high, inside);
+#endif
+		default:
+			return findInRangeScalar(samples, noOfSamples, (int16_t) low, (int16_t) high, inside);
+	}
+}
+
+/****************************************************************************
+* setSoftwareTriggerSearch
+*
+* Sets the range searched for by a software trigger in one state.
+*
+****************************************************************************/
+static void setSoftwareTriggerSearch(WRAP_SOFTWARE_TRIGGER * trigger, int16_t state, int32_t low, int32_t high, int16_t inside)
+{
+	trigger->searchLow[state] = low;
+	trigger->searchHigh[state] = high;
+	trigger->searchInside[state] = inside;
+}
+
+/****************************************************************************
+* pushSoftwareTriggerEvent
+*
+* Adds an event to the software trigger queue. Called only from the 
+* streaming callback. If the queue is full, the event is discarded and 
+* counted as dropped.
+*
+****************************************************************************/
+static void pushSoftwareTriggerEvent(WRAP_SOFTWARE_TRIGGER_QUEUE * queue, int16_t channel, uint64_t sampleIndex, uint64_t width)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_SOFTWARE_TRIGGER_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_SOFTWARE_TRIGGER_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_SOFTWARE_TRIGGER_QUEUE_SIZE - 1)];
+
+	event->sampleIndex = sampleIndex;
+	event->width = (width > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t) width;
+	event->channel = channel;
+
+	// Make sure the event is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* endSoftwareTriggerPulse
+*
+* Adds an event for a pulse ending at sampleIndex if its start was seen and
+* its width is within the limits set for the trigger.
+*
+****************************************************************************/
+static void endSoftwareTriggerPulse(WRAP_SOFTWARE_TRIGGER * trigger, WRAP_SOFTWARE_TRIGGER_QUEUE * queue, int16_t channel, uint64_t sampleIndex)
+{
+	uint64_t width = sampleIndex - trigger->pulseStart;
+
+	if (trigger->pulseStarted && width >= trigger->minWidth && (trigger->maxWidth == 0 || width <= trigger->maxWidth))
+	{
+		pushSoftwareTriggerEvent(queue, channel, sampleIndex, width);
+	}
+
+	trigger->pulseStarted = 0;
+}
+
+/****************************************************************************
+* runSoftwareTrigger
+*
+* Runs the software trigger detector for a channel over a block of 
+* noOfSamples samples, the first of which has the index position, adding 
+* any events found to the queue. Called only from the streaming callback.
+*
+****************************************************************************/
+static void runSoftwareTrigger(WRAP_SOFTWARE_TRIGGER * trigger, WRAP_SOFTWARE_TRIGGER_QUEUE * queue, int16_t channel, const int16_t * samples, 
+	uint32_t noOfSamples, uint64_t position)
+{
+	uint32_t i = 0;
+	uint32_t found = 0;
+	int16_t state = 0;
+	int16_t value = 0;
+	uint64_t sampleIndex = 0;
+
+	while (i < noOfSamples)
+	{
+		state = trigger->state;
+		found = i + findInRange(&samples[i], noOfSamples - i, trigger->searchLow[state], trigger->searchHigh[state], trigger->searchInside[state]);
+
+		if (found >= noOfSamples)
+		{
+			break;
+		}
+
+		value = samples[found];
+		sampleIndex = position + found;
+
+		switch (state)
+		{
+			case WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN:
+
+				if (trigger->type == WRAP_SOFTWARE_TRIGGER_WINDOW)
+				{
+					trigger->state = (value >= trigger->threshold && value <= trigger->upperThreshold) ? WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE : 
+						WRAP_SOFTWARE_TRIGGER_STATE_IDLE;
+				}
+				else if (trigger->type == WRAP_SOFTWARE_TRIGGER_RUNT)
+				{
+					// The idle region is the one searched for in the active state
+					trigger->state = (value >= trigger->searchLow[WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE] && 
+						value <= trigger->searchHigh[WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE]) ? WRAP_SOFTWARE_TRIGGER_STATE_IDLE : 
+						WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE;
+				}
+				else
+				{
+					trigger->state = (value >= trigger->threshold) ? WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE : WRAP_SOFTWARE_TRIGGER_STATE_IDLE;
+				}
+				break;
+
+			case WRAP_SOFTWARE_TRIGGER_STATE_IDLE:
+
+				if (trigger->type == WRAP_SOFTWARE_TRIGGER_RUNT)
+				{
+					trigger->state = WRAP_SOFTWARE_TRIGGER_STATE_STARTED;
+					trigger->pulseStart = sampleIndex;
+					trigger->pulseStarted = 1;
+					break;
+				}
+
+				trigger->state = WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE;
+
+				if (trigger->type == WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH)
+				{
+					if (trigger->direction == WRAP_SOFTWARE_TRIGGER_POSITIVE)
+					{
+						trigger->pulseStart = sampleIndex;
+						trigger->pulseStarted = 1;
+					}
+					else
+					{
+						endSoftwareTriggerPulse(trigger, queue, channel, sampleIndex);
+					}
+				}
+				else if (trigger->direction != WRAP_SOFTWARE_TRIGGER_FALLING)
+				{
+					pushSoftwareTriggerEvent(queue, channel, sampleIndex, 0);
+				}
+				break;
+
+			case WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE:
+
+				trigger->state = WRAP_SOFTWARE_TRIGGER_STATE_IDLE;
+
+				if (trigger->type == WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH)
+				{
+					if (trigger->direction == WRAP_SOFTWARE_TRIGGER_POSITIVE)
+					{
+						endSoftwareTriggerPulse(trigger, queue, channel, sampleIndex);
+					}
+					else
+					{
+						trigger->pulseStart = sampleIndex;
+						trigger->pulseStarted = 1;
+					}
+				}
+				else if (trigger->type != WRAP_SOFTWARE_TRIGGER_RUNT && trigger->direction != WRAP_SOFTWARE_TRIGGER_RISING)
+				{
+					pushSoftwareTriggerEvent(queue, channel, sampleIndex, 0);
+				}
+				break;
+
+			case WRAP_SOFTWARE_TRIGGER_STATE_STARTED:
+
+				// The sample is either beyond the second threshold or back beyond the hysteresis band of the first
+				if ((trigger->direction == WRAP_SOFTWARE_TRIGGER_POSITIVE) ? value > trigger->searchHigh[state] : value < trigger->searchLow[state])
+				{
+					trigger->state = WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE;
+					trigger->pulseStarted = 0;
+				}
+				else
+				{
+					trigger->state = WRAP_SOFTWARE_TRIGGER_STATE_IDLE;
+					endSoftwareTriggerPulse(trigger, queue, channel, sampleIndex);
+				}
+				break;
+		}
+
+		// A sample that starts a runt may also reach the second threshold, so it is searched again
+		i = (trigger->state == WRAP_SOFTWARE_TRIGGER_STATE_STARTED) ? found : found + 1;
+	}
+}
+
+/****************************************************************************
+* runSoftwareTriggers
+*
+* Runs the software trigger detectors of the enabled channels over the 
+* block passed to a streaming callback. Called only from the streaming 
+* callback, before the trigger log sample count is advanced past the block.
+*
+****************************************************************************/
+static void runSoftwareTriggers(WRAP_UNIT_INFO * wrapUnitInfo, int32_t noOfSamples, uint32_t startIndex)
+{
+	int16_t channel = 0;
+	int16_t * source = NULL;
+
+	if (noOfSamples <= 0)
+	{
+		return;
+	}
+
+	// setSoftwareTrigger may be replacing a detector from another thread
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->softwareTriggerLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->softwareTriggerLock);
+#endif
+
+	for (channel = (int16_t) PS5000A_CHANNEL_A; wrapUnitInfo->softwareTriggerCount > 0 && channel < wrapUnitInfo->channelCount && 
+		channel < PS5000A_MAX_CHANNELS; channel++)
+	{
+		source = wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2];
+
+		if (wrapUnitInfo->enabledChannels[channel] && wrapUnitInfo->softwareTriggers[channel].type != WRAP_SOFTWARE_TRIGGER_NONE && source != NULL)
+		{
+			runSoftwareTrigger(&wrapUnitInfo->softwareTriggers[channel], &wrapUnitInfo->softwareTriggerQueue, channel, &source[startIndex], 
+				(uint32_t) noOfSamples, wrapUnitInfo->triggerLog.sampleCount);
+		}
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->softwareTriggerLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->softwareTriggerLock);
+#endif
+}
+
+/****************************************************************************
+* initMonotonicCondition
+*
+* Initialises a condition variable whose timed waits are measured against 
+* CLOCK_MONOTONIC, so that waitForReady is not affected by changes to the 
+* system time.
+*
+****************************************************************************/
+#if !defined(WIN32) && !defined(_WIN64)
+static void initMonotonicCondition(WRAP_CONDITION * condition)
+{
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+#endif
+
+/****************************************************************************
+* setReady
+*
+* Sets a ready flag and wakes any threads waiting for it in waitForReady.
+*
+****************************************************************************/
+static void setReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(lock);
+	*ready = 1;
+	ReleaseSRWLockExclusive(lock);
+	WakeAllConditionVariable(condition);
+#else
+	pthread_mutex_lock(lock);
+	*ready = 1;
+	pthread_cond_broadcast(condition);
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+/****************************************************************************
+* waitForReady
+*
+* Blocks the calling thread until a ready flag is set by setReady or the 
+* timeout expires, and returns the value of the flag. A timeout of 
+* WRAP_WAIT_INFINITE waits indefinitely.
+*
+****************************************************************************/
+static int16_t waitForReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready, uint32_t timeoutMs)
+{
+	int16_t isReady = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	ULONGLONG now = 0;
+
+	AcquireSRWLockExclusive(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+			continue;
+		}
+
+		now = GetTickCount64();
+
+		if (now >= deadline)
+		{
+			break;
+		}
+
+		SleepConditionVariableSRW(condition, lock, (DWORD) (deadline - now), 0);
+	}
+
+	isReady = *ready;
+	ReleaseSRWLockExclusive(lock);
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			pthread_cond_wait(condition, lock);
+		}
+		else if (pthread_cond_timedwait(condition, lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	isReady = *ready;
+	pthread_mutex_unlock(lock);
+#endif
+
+	return isReady;
+}
+
+/****************************************************************************
+* publishStreamingSnapshot
+*
+* Copies the streaming status into the snapshot read by GetStreamingSnapshot,
+* with ready set to the value given. Writers are serialised by snapshotLock.
+*
+****************************************************************************/
+static void publishStreamingSnapshot(WRAP_UNIT_INFO * wrapUnitInfo, int16_t ready)
+{
+	WRAP_STREAMING_SNAPSHOT * snapshot = &wrapUnitInfo->snapshot;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->snapshotLock);
+#endif
+
+	snapshot->sequence++;
+	WRAP_MEMORY_BARRIER();
+
+	snapshot->ready = ready;
+	snapshot->numSamples = wrapUnitInfo->numSamples;
+	snapshot->startIndex = wrapUnitInfo->startIndex;
+	snapshot->triggered = wrapUnitInfo->triggered;
+	snapshot->triggeredAt = wrapUnitInfo->triggeredAt;
+	snapshot->overflow = wrapUnitInfo->overflow;
+	snapshot->autoStop = wrapUnitInfo->autoStop;
+	snapshot->callbackCount = wrapUnitInfo->callbackCount;
+
+	WRAP_MEMORY_BARRIER();
+	snapshot->sequence++;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->snapshotLock);
+#endif
+}
+
+/****************************************************************************
+* hashBytes
+*
+* Returns the FNV-1a hash of a block of memory.
+*
+****************************************************************************/
+static uint32_t hashBytes(const void * data, size_t length)
+{
+	uint32_t hash = 2166136261U;
+	const uint8_t * bytes = (const uint8_t *) data;
+	size_t i = 0;
+
+	for (i = 0; i < length; i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+/****************************************************************************
+* hashTriggerValues
+*
+* Returns the FNV-1a hash of an array of trigger values.
+*
+****************************************************************************/
+static uint32_t hashTriggerValues(const int32_t * values, int32_t nValues)
+{
+	return hashBytes(values, nValues * sizeof(int32_t));
+}
+
+/****************************************************************************
+* isTriggerCached
+*
+* Returns TRUE if the values and info match those held in the trigger cache 
+* entry, so the driver already has these settings.
+*
+****************************************************************************/
+static int16_t isTriggerCached(WRAP_UNIT_INFO * wrapUnitInfo, WRAP_TRIGGER_CACHE_INDEX index, const int32_t * values, int32_t nValues, int32_t info)
+{
+	WRAP_TRIGGER_CACHE_ENTRY * entry = NULL;
+
+	if (wrapUnitInfo == NULL)
+	{
+		return FALSE;
+	}
+
+	entry = &wrapUnitInfo->triggerCache[index];
+
+	if (!entry->valid || entry->nValues != nValues || entry->info != info)
+	{
+		return FALSE;
+	}
+
+	if (nValues == 0)
+	{
+		return TRUE;
+	}
+
+	if (values == NULL || entry->hash != hashTriggerValues(values, nValues))
+	{
+		return FALSE;
+	}
+
+	return memcmp(entry->values, values, nValues * sizeof(int32_t)) == 0;
+}
+
+/****************************************************************************
+* updateTriggerCache
+*
+* Records the values passed to the driver in a trigger cache entry if the 
+* driver accepted them, otherwise marks the entry as invalid because the 
+* driver settings are not known. Arrays longer than 
+* WRAP_TRIGGER_CACHE_MAX_VALUES are not cached.
+*
+****************************************************************************/
+static void updateTriggerCache(WRAP_UNIT_INFO * wrapUnitInfo, WRAP_TRIGGER_CACHE_INDEX index, const int32_t * values, int32_t nValues, int32_t info, 
+	PICO_STATUS status)
+{
+	WRAP_TRIGGER_CACHE_ENTRY * entry = NULL;
+
+	if (wrapUnitInfo == NULL)
+	{
+		return;
+	}
+
+	entry = &wrapUnitInfo->triggerCache[index];
+
+	if (status != PICO_OK || nValues < 0 || nValues > WRAP_TRIGGER_CACHE_MAX_VALUES || (nValues > 0 && values == NULL))
+	{
+		entry->valid = FALSE;
+		return;
+	}
+
+	if (nValues > 0)
+	{
+		memcpy_s(entry->values, sizeof(entry->values), values, nValues * sizeof(int32_t));
+		entry->hash = hashTriggerValues(values, nValues);
+	}
+
+	entry->nValues = nValues;
+	entry->info = info;
+	entry->valid = TRUE;
+}
+
+/****************************************************************************
+* invalidateTriggerCache
+*
+* Marks every trigger cache entry for a device as invalid, so the next call
+* to each V2 trigger function is passed to the driver.
+*
+****************************************************************************/
+static void invalidateTriggerCache(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	int16_t i = 0;
+
+	if (wrapUnitInfo == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < WRAP_TRIGGER_CACHE_ENTRIES; i++)
+	{
+		wrapUnitInfo->triggerCache[i].valid = FALSE;
+	}
+
+	wrapUnitInfo->appliedExpressionValid = FALSE;
+}
+
+/****************************************************************************
+* getWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device, creating it the first time the handle is used.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_MEMORY_FAIL, if the structure could not be allocated.
+*
+****************************************************************************/
+static PICO_STATUS getWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	WRAP_UNIT_INFO * unitInfo = NULL;
+
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo != NULL)
+	{
+		*wrapUnitInfo = unitInfo;
+		return PICO_OK;
+	}
+
+	// Threads using a new handle at the same time must share one structure
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo == NULL)
+	{
+		unitInfo = (WRAP_UNIT_INFO *) calloc(1, sizeof(WRAP_UNIT_INFO));
+
+		if (unitInfo != NULL)
+		{
+			unitInfo->handle = handle;
+
+#if defined(WIN32) || defined(_WIN64)
+			InitializeSRWLock(&unitInfo->readyLock);
+			InitializeConditionVariable(&unitInfo->readyCondition);
+			InitializeSRWLock(&unitInfo->snapshotLock);
+			InitializeSRWLock(&unitInfo->softwareTriggerLock);
+			InitializeSRWLock(&unitInfo->triggerCaptureLock);
+#else
+			pthread_mutex_init(&unitInfo->readyLock, NULL);
+			initMonotonicCondition(&unitInfo->readyCondition);
+			pthread_mutex_init(&unitInfo->snapshotLock, NULL);
+			pthread_mutex_init(&unitInfo->softwareTriggerLock, NULL);
+			pthread_mutex_init(&unitInfo->triggerCaptureLock, NULL);
+#endif
+
+			WRAP_MEMORY_BARRIER();
+
+			_wrapUnitInfo[handle] = unitInfo;
+		}
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (unitInfo == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	*wrapUnitInfo = unitInfo;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* findWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device without creating it. Used by the functions that only read or clear
+* the results of a capture, which have nothing to report for a device that 
+* has not been set up.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS findWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	if (handle <= 0 || _wrapUnitInfo[handle] == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	*wrapUnitInfo = _wrapUnitInfo[handle];
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* beginStreamingCall
+*
+* Finds the wrapper state for a device and records that a call to the 
+* driver that may run StreamingCallback with it is in progress, so that 
+* releaseWrapUnitInfo does not free the state until endStreamingCall.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS beginStreamingCall(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	PICO_STATUS status = PICO_OK;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	status = findWrapUnitInfo(handle, wrapUnitInfo);
+
+	if (status == PICO_OK)
+	{
+		(*wrapUnitInfo)->streamingCallsInProgress++;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	return status;
+}
+
+/****************************************************************************
+* endStreamingCall
+*
+* Records the end of a call started with beginStreamingCall and wakes 
+* releaseWrapUnitInfo if it is waiting for the state of the device.
+*
+****************************************************************************/
+static void endStreamingCall(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+	WakeAllConditionVariable(&_wrapUnitInfoCondition);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	pthread_cond_broadcast(&_wrapUnitInfoCondition);
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* isRingLengthValid
+*
+* Returns TRUE if every application buffer registered for a channel or 
+* digital port is at least ringLength samples long, so that the streaming 
+* callback does not write past the end of a buffer in ring mode.
+*
+****************************************************************************/
+static int16_t isRingLengthValid(WRAP_BUFFER_INFO * wrapBufferInfo, uint32_t ringLength)
+{
+	int16_t channel = 0;
+	int16_t port = 0;
+
+	for (channel = 0; channel < PS5000A_MAX_CHANNELS; channel++)
+	{
+		if ((wrapBufferInfo->appBuffers[channel * 2] || wrapBufferInfo->appBuffers[channel * 2 + 1] || 
+			wrapBufferInfo->appFloatBuffers[channel * 2] || wrapBufferInfo->appFloatBuffers[channel * 2 + 1] ||
+			wrapBufferInfo->appDoubleBuffers[channel * 2] || wrapBufferInfo->appDoubleBuffers[channel * 2 + 1]) && 
+			wrapBufferInfo->bufferLengths[channel] < ringLength)
+		{
+			return FALSE;
+		}
+	}
+
+	for (port = 0; port < PS5000A_WRAP_MAX_DIGITAL_PORTS; port++)
+	{
+		if ((wrapBufferInfo->appDigiBuffers[port * 2] || wrapBufferInfo->appDigiBuffers[port * 2 + 1]) && 
+			wrapBufferInfo->digiBufferLengths[port] < ringLength)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/****************************************************************************
+* getTriggerArena
+*
+* Returns the trigger arena for a device, cleared for nStructures structures
+* of structureSize bytes. If there are more structures than the arena holds,
+* heap space kept for the device is returned instead, grown if needed.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_INVALID_PARAMETER, if nStructures is negative.
+* PICO_MEMORY_FAIL, if the WRAP_UNIT_INFO structure or the heap space could
+*					not be allocated.
+*
+****************************************************************************/
+static PICO_STATUS getTriggerArena(int16_t handle, int16_t nStructures, size_t structureSize, void ** arena)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+	size_t size = (size_t) nStructures * structureSize;
+	void * overflow = NULL;
+
+	if (nStructures < 0)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	// The arena holds WRAP_MAX_TRIGGER_STRUCTURES of the largest structure
+	if (size <= sizeof(WRAP_TRIGGER_ARENA))
+	{
+		memset(&wrapUnitInfo->triggerArena, 0, size);
+		*arena = &wrapUnitInfo->triggerArena;
+
+		return PICO_OK;
+	}
+
+	if (wrapUnitInfo->triggerArenaOverflowSize < size)
+	{
+		overflow = realloc(wrapUnitInfo->triggerArenaOverflow, size);
+
+		if (overflow == NULL)
+		{
+			return PICO_MEMORY_FAIL;
+		}
+
+		wrapUnitInfo->triggerArenaOverflow = overflow;
+		wrapUnitInfo->triggerArenaOverflowSize = size;
+	}
+
+	memset(wrapUnitInfo->triggerArenaOverflow, 0, size);
+	*arena = wrapUnitInfo->triggerArenaOverflow;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* getRingReadCursor
+*
+* Returns the position of the oldest unread sample in the ring buffers for a
+* given write cursor. Samples that have been overwritten count as read, 
+* without the read cursor itself being changed.
+*
+****************************************************************************/
+static uint64_t getRingReadCursor(WRAP_UNIT_INFO * wrapUnitInfo, uint64_t writeCursor)
+{
+	uint64_t readCursor = WRAP_LOAD_UINT64(&wrapUnitInfo->ringReadCursor);
+
+	if (writeCursor > wrapUnitInfo->ringLength && readCursor < writeCursor - wrapUnitInfo->ringLength)
+	{
+		readCursor = writeCursor - wrapUnitInfo->ringLength;
+	}
+
+	return readCursor;
+}
+
+/****************************************************************************
+* advanceRingWriteCursor
+*
+* Called from the streaming callback once a block has been copied into the 
+* ring buffers. Counts the unread samples that the block has overwritten and
+* then publishes the new write cursor, so that the application never sees 
+* the cursor before the data.
+*
+****************************************************************************/
+static void advanceRingWriteCursor(WRAP_UNIT_INFO * wrapUnitInfo, uint32_t noOfSamples)
+{
+	uint64_t writeCursor = wrapUnitInfo->ringWriteCursor;
+	uint64_t lostFrom = getRingReadCursor(wrapUnitInfo, writeCursor);
+	uint64_t lostTo = 0;
+
+	writeCursor += noOfSamples;
+
+	if (writeCursor > wrapUnitInfo->ringLength)
+	{
+		lostTo = writeCursor - wrapUnitInfo->ringLength;
+	}
+
+	if (lostTo > lostFrom)
+	{
+		WRAP_STORE_UINT64(&wrapUnitInfo->ringOverrunCount, wrapUnitInfo->ringOverrunCount + (lostTo - lostFrom));
+	}
+
+	WRAP_STORE_UINT64(&wrapUnitInfo->ringWriteCursor, writeCursor);
+}
+
+/****************************************************************************
+* Streaming Callback
+*
+* See ps5000aStreamingReady (callback)
+*
+* The event queue, trigger log and ring cursors are updated without locks. 
+* The callback does take some short per-device locks, so it can wait while 
+* another thread holds one of them:
+*
+* softwareTriggerLock - while setSoftwareTrigger changes a detector.
+* triggerCaptureLock - while setTriggerCapture replaces the capture or 
+*						DrainTriggerCaptures copies records out.
+* snapshotLock - while another writer updates the streaming snapshot.
+* readyLock - while a thread in WaitForStreamingData checks ready.
+*
+****************************************************************************/
+void PREF1 StreamingCallback(
+  int16_t handle,
+	int32_t noOfSamples,
+	uint32_t startIndex,
+	int16_t overflow,
+	uint32_t triggerAt,
+	int16_t triggered,
+	int16_t autoStop,
+	void * pParameter)
+{
+	int16_t channel = 0;
+	int16_t digitalPort = 0;
+	uint32_t ringPosition = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
+	
+	if (pParameter == NULL)
+	{
+		return;
+	}
+
+	wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+	_wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+
+	wrapUnitInfo->numSamples = noOfSamples;
+	wrapUnitInfo->autoStop = autoStop;
+	wrapUnitInfo->startIndex = startIndex;
+
+	wrapUnitInfo->triggered = triggered;
+	wrapUnitInfo->triggeredAt = triggerAt;
+
+	wrapUnitInfo->overflow = overflow;
+
+	if (wrapUnitInfo->ringMode && wrapUnitInfo->ringLength > 0)
+	{
+		ringPosition = (uint32_t) (wrapUnitInfo->ringWriteCursor % wrapUnitInfo->ringLength);
+	}
+
+	if (noOfSamples)
+	{
+		// Analogue channels
+		for (channel = (int16_t) PS5000A_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+		{
+			if (wrapUnitInfo->enabledChannels[channel])
+			{
+				if (_wrapBufferInfo->appBuffers && _wrapBufferInfo->driverBuffers)
+				{
+					// Max buffers
+					if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
+					{
+						copyStreamingData(wrapUnitInfo, _wrapBufferInfo->appBuffers[channel * 2], _wrapBufferInfo->driverBuffers[channel * 2],
+							startIndex, noOfSamples, ringPosition);
+					}
+
+					// Min buffers
+					if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
+					{
+						copyStreamingData(wrapUnitInfo, _wrapBufferInfo->appBuffers[channel * 2 + 1], _wrapBufferInfo->driverBuffers[channel * 2 + 1],
+							startIndex, noOfSamples, ringPosition);
+					}
+				}
+
+				// Conversion to volts
+				if (_wrapBufferInfo->scaling[channel].maxADCValue > 0)
+				{
+					convertStreamingData(wrapUnitInfo, channel, channel * 2, startIndex, noOfSamples, ringPosition);
+					convertStreamingData(wrapUnitInfo, channel, channel * 2 + 1, startIndex, noOfSamples, ringPosition);
+				}
+
+				// Decimation
+				if (_wrapBufferInfo->decimation[channel].mode != WRAP_DECIMATION_NONE && _wrapBufferInfo->driverBuffers[channel * 2])
+				{
+					decimateStreamingData(&_wrapBufferInfo->decimation[channel], &_wrapBufferInfo->driverBuffers[channel * 2][startIndex],
+						_wrapBufferInfo->driverBuffers[channel * 2 + 1] ? &_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex] : 
+						&_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
+				}
+			}
+		}
+
+		// Digital channels
+		if (wrapUnitInfo->digitalPortCount > 0)
+		{
+			// Use index 0 to indicate Digital Port 0
+			for (digitalPort = (int16_t)PS5000A_WRAP_DIGITAL_PORT0; digitalPort < wrapUnitInfo->digitalPortCount; digitalPort++)
+			{
+				if (wrapUnitInfo->enabledDigitalPorts[digitalPort])
+				{
+					// Copy data...
+					if (_wrapBufferInfo->appDigiBuffers && _wrapBufferInfo->driverDigiBuffers)
+					{
+						// Max digital buffers
+						if (_wrapBufferInfo->appDigiBuffers[digitalPort * 2] && _wrapBufferInfo->driverDigiBuffers[digitalPort * 2])
+						{
+								copyStreamingData(wrapUnitInfo, _wrapBufferInfo->appDigiBuffers[digitalPort * 2], _wrapBufferInfo->driverDigiBuffers[digitalPort * 2],
+										startIndex, noOfSamples, ringPosition);
+						}
+
+						// Min digital buffers
+						if (_wrapBufferInfo->appDigiBuffers[digitalPort * 2 + 1] && _wrapBufferInfo->driverDigiBuffers[digitalPort * 2 + 1])
+						{
+								copyStreamingData(wrapUnitInfo, _wrapBufferInfo->appDigiBuffers[digitalPort * 2 + 1], _wrapBufferInfo->driverDigiBuffers[digitalPort * 2 + 1],
+										startIndex, noOfSamples, ringPosition);
+						}
+					}
+				}
+			}
+		}
+
+		if (wrapUnitInfo->ringMode && wrapUnitInfo->ringLength > 0)
+		{
+			advanceRingWriteCursor(wrapUnitInfo, (uint32_t) noOfSamples);
+
+			// Report the position of this block in the ring buffers
+			wrapUnitInfo->startIndex = ringPosition;
+		}
+	}
+  
+  runSoftwareTriggers(wrapUnitInfo, noOfSamples, startIndex);
+  captureTriggerWindows(wrapUnitInfo, noOfSamples, startIndex, triggered, triggerAt);
+  logStreamingTrigger(&wrapUnitInfo->triggerLog, noOfSamples, triggered, triggerAt);
+  pushStreamingEvent(&wrapUnitInfo->eventQueue, noOfSamples, wrapUnitInfo->startIndex, triggered, triggerAt, overflow, autoStop);
+
+  wrapUnitInfo->callbackCount++;
+  publishStreamingSnapshot(wrapUnitInfo, 1);
+
+  setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+}
+
+/****************************************************************************
+* BlockCallback
+*
+* See ps5000aBlockReady (callback)
+*
+****************************************************************************/
+void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+{
+  WRAP_UNIT_INFO * wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+
+  // Holding the lock stops releaseWrapUnitInfo freeing the state until the callback has finished
+#if defined(WIN32) || defined(_WIN64)
+  AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+  pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+  // The state may have been released since the capture was started
+  if (wrapUnitInfo != NULL && handle > 0 && _wrapUnitInfo[handle] == wrapUnitInfo)
+  {
+    publishStreamingSnapshot(wrapUnitInfo, 1);
+    setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+  }
+
+#if defined(WIN32) || defined(_WIN64)
+  ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+  pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* RunBlock
+*
+* This function starts collecting data in block mode without the requirement 
+* for specifying callback functions. Use the IsReady function in conjunction 
+* to poll the driver once this function has been called.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* preTriggerSamples - see noOfPreTriggerSamples in ps5000aRunBlock.
+* postTriggerSamples - see noOfPreTriggerSamples in ps5000aRunBlock.
+* timebase - see ps5000aRunBlock.
+* segmentIndex - see ps5000aRunBlock.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 RunBlock(int16_t handle, int32_t preTriggerSamples, int32_t postTriggerSamples,
+            uint32_t timebase, uint32_t segmentIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = preTriggerSamples + postTriggerSamples;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	return ps5000aRunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, 
+		NULL, segmentIndex, BlockCallback, wrapUnitInfo);
+}
+
+/****************************************************************************
+* GetStreamingLatestValues
+*
+* facilitates communication with the driver to return the next block of 
+* values to your application when capturing data in streaming mode. Use with 
+* programming languages that do not support callback functions.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = beginStreamingCall(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = 0;
+	wrapUnitInfo->autoStop = 0;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	status = ps5000aGetStreamingLatestValues(handle, StreamingCallback, wrapUnitInfo);
+
+	endStreamingCall(wrapUnitInfo);
+
+	return status;
+}
+
+/****************************************************************************
+* AvailableData
+*
+* Returns the number of samples returned from the driver and shows 
+* the start index of the data in the buffer when collecting data in 
+* streaming mode.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* startIndex - on exit, an index to the first valid sample in the buffer 
+*				(When data is available).
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - the number of samples returned from the driver.
+*
+****************************************************************************/
+extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if ( wrapUnitInfo->ready ) 
+	{
+		*startIndex = wrapUnitInfo->startIndex;
+		return wrapUnitInfo->numSamples;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+* AutoStopped
+*
+* Indicates if the device has stopped on collection of the number of samples 
+* specified in the call to the ps5000aRunStreaming function (if the 
+* ps5000aRunStreaming function's autostop flag is set).
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* Non-zero - if streaming has autostopped.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if ( wrapUnitInfo->ready) 
+	{
+		return wrapUnitInfo->autoStop;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/****************************************************************************
+* IsReady
+*
+* This function is used to poll the driver to verify that data is ready to be 
+* received. The RunBlock or GetStreamingLatestValues function must have been 
+* called prior to calling this function.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return wrapUnitInfo->ready;
+}
+
+/****************************************************************************
+* WaitForStreamingData
+*
+* Blocks the calling thread until the streaming callback has been called 
+* following a call to GetStreamingLatestValues, or until the timeout 
+* expires. Use this function instead of polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - Data is not yet available (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForStreamingData(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* WaitForBlockReady
+*
+* Blocks the calling thread until a block mode capture started with RunBlock
+* has completed, or until the timeout expires. Use this function instead of
+* polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - The capture has not completed (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForBlockReady(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* IsTriggerReady
+*
+* Indicates whether a trigger has occurred when collecting data in streaming 
+* mode, and the location of the trigger point in the buffer.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* triggeredAt - on exit, the index of the sample in the buffer where the 
+* trigger occurred.
+*
+* Returns:
+*
+* 0 - The device has not triggered.
+* Non-zero - The device has been triggered.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if (wrapUnitInfo->triggered)
+	{
+		*triggeredAt = wrapUnitInfo->triggeredAt;
+	}
+
+	return wrapUnitInfo->triggered;
+}
+
+/****************************************************************************
+* ClearTriggerReady
+*
+* Clears the triggered and triggeredAt flags in relation to streaming mode 
+* capture.
+*
+* Triggers recorded for DrainTriggerLog are not affected.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* PICO_OK
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 ClearTriggerReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->triggeredAt = 0;
+	wrapUnitInfo->triggered = FALSE;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* SetTriggerConditions
+*
+* NOTE: This function is deprecated - use SetTriggerConditionsV2 instead.
+*
+* This function sets up trigger conditions on the scope's inputs. The trigger 
 * is defined by one or more sets of integers corresponding to 
 * PS5000A_TRIGGER_CONDITIONS structures which are then converted and passed 
 * to the ps5000aSetTriggerChannelConditions function.
 *
-* Use this function with programming languages that do not support structs.
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* conditionsArray - an array of integer values specifying the conditions 
+*					for each channel.
+* nConditions - the number that will be passed after the wrapper code has 
+* created its structures. (i.e. the number of conditionsArray elements / 7)
+* More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted in 
+* heap memory instead of the trigger arena.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	PS5000A_TRIGGER_CONDITIONS * conditions = NULL;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS5000A_TRIGGER_CONDITIONS), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nConditions; i++)
+	{
+		conditions[i].channelA				= (PS5000A_TRIGGER_STATE) conditionsArray[j];
+		conditions[i].channelB				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 1];
+		conditions[i].channelC				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 2];
+		conditions[i].channelD				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 3];
+		conditions[i].external				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 4];
+		conditions[i].aux					= (PS5000A_TRIGGER_STATE) conditionsArray[j + 5];
+		conditions[i].pulseWidthQualifier	= (PS5000A_TRIGGER_STATE) conditionsArray[j + 6];
+
+		j = j + 7;
+	}
+	status = ps5000aSetTriggerChannelConditions(handle, conditions, nConditions);
+
+	// The V1 settings replace any set by the V2 functions
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		invalidateTriggerCache(wrapUnitInfo);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* SetTriggerProperties
+*
+* NOTE: This function is deprecated - use SetTriggerPropertiesV2 instead.
+* 
+* This function is used to enable or disable triggering and set its 
+* parameters by means of assigning the values from the propertiesArray to an 
+* array of TRIGGER_CHANNEL_PROPERTIES structures which are then passed to 
+* the ps5000aSetTriggerChannelProperties function with the other parameters.
+
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* propertiesArray - an array of sets of integers corresponding to 
+*					TRIGGER_CHANNEL_PROPERTIES structures describing the 
+*					required properties to be set. See also channelProperties
+*					in ps5000aSetTriggerChannelProperties.
+*
+* nProperties - the number that will be passed after the wrapper code has 
+*				created its structures. (i.e. the number of propertiesArray 
+*				elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
+* autoTrig - see autoTriggerMilliseconds in ps5000aSetTriggerChannelProperties.
+*
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nProperties is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(
+	int16_t handle, 
+	int32_t *propertiesArray, 
+	int16_t nProperties, 
+	int32_t autoTrig)
+{
+	PS5000A_TRIGGER_CHANNEL_PROPERTIES * channelProperties = NULL;
+	int16_t i;
+	int16_t j=0;
+	int16_t auxEnable = 0;
+	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	
+	status = getTriggerArena(handle, nProperties, sizeof(PS5000A_TRIGGER_CHANNEL_PROPERTIES), (void **) &channelProperties);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nProperties; i++)
+	{
+		channelProperties[i].thresholdUpper				= propertiesArray[j];
+		channelProperties[i].thresholdUpperHysteresis	= propertiesArray[j + 1];
+		channelProperties[i].thresholdLower				= propertiesArray[j + 2];
+		channelProperties[i].thresholdLowerHysteresis	= propertiesArray[j + 3];
+		channelProperties[i].channel					= (PS5000A_CHANNEL) propertiesArray[j + 4];
+		channelProperties[i].thresholdMode				= (PS5000A_THRESHOLD_MODE) propertiesArray[j + 5];
+
+		j = j + 6;
+	}
+	status = ps5000aSetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
+
+	// The V1 settings replace any set by the V2 functions
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		invalidateTriggerCache(wrapUnitInfo);
+	}
+	
+	return status;
+}
+
+/****************************************************************************
+* SetPulseWidthQualifier
+*
+* This function is used to enable pulse-width triggering and set 
+* its parameters by means of assigning the values from the pwqConditionsArray 
+* to an array of PS5000A_PWQ_CONDITIONS structures which are then passed to 
+* the ps5000aSetPulseWidthQualifier function with the other parameters.
+
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* pwqConditionsArray - an array of sets of integers corresponding to 
+*					PS5000A_PWQ_CONDITIONS structures describing the 
+*					required properties to be set. See also conditions
+*					in ps5000aSetPulseWidthQualifier.
+*
+* nConditions - the number that will be passed after the wrapper code has 
+*				created its structures. (i.e. the number of conditionsArray 
+*				elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
+*
+* direction - the direction of the signal required for the pulse width
+*				trigger to fire (See PS5000A_THRESHOLD_DIRECTION constants)
+* lower - the lower limit of the pulse-width counter with relation to
+			number of samples captured on the device.
+* upper - the upper limit of the pulse-width counter with relation to
+*			number of samples captured on the device.
+* type - the pulse-width type (see ps5000aSetPulseWidthQualifier).
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(
+	int16_t handle,
+	int32_t *pwqConditionsArray,
+	int16_t nConditions,
+	int32_t direction,
+	uint32_t lower,
+	uint32_t upper,
+	int32_t type)
+{
+	PS5000A_PWQ_CONDITIONS * pwqConditions = NULL;
+
+	int16_t i;
+	int16_t j = 0;
+
+	PICO_STATUS status;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS5000A_PWQ_CONDITIONS), (void **) &pwqConditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nConditions; i++)
+	{
+		pwqConditions[i].channelA = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j];
+		pwqConditions[i].channelB = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 1];
+		pwqConditions[i].channelC = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 2];
+		pwqConditions[i].channelD = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 3];
+		pwqConditions[i].external = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 4];
+		pwqConditions[i].aux      = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 5];
+
+		j = j + 6;
+	}
+
+	status = ps5000aSetPulseWidthQualifier(handle, pwqConditions, nConditions, (PS5000A_THRESHOLD_DIRECTION) direction, lower, upper, (PS5000A_PULSE_WIDTH_TYPE) type);
+	return status;
+}
+
+/****************************************************************************
+* setChannelCount
+*
+* Sets the number of analogue channels and digital ports on the device.  
+* copying data in the streaming callback.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channelCount - not used.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
+{
+  int8_t variant[15];
+	int16_t requiredSize = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	// Obtain the model number
+	status = ps5000aGetUnitInfo(handle, variant, sizeof(variant), &requiredSize, PICO_VARIANT_INFO);
+	
+	if (status == PICO_OK)
+	{
+			// Set the number of analogue channels
+			wrapUnitInfo->channelCount = (int16_t) variant[1];
+			wrapUnitInfo->channelCount = wrapUnitInfo->channelCount - 48; // Subtract ASCII 0 (48)
+
+			// Determine if the device is an MSO
+			if (strstr(variant, "MSO") != NULL)
+			{
+				 wrapUnitInfo->digitalPortCount = 2;
+			}
+			else
+			{
+			  wrapUnitInfo->digitalPortCount = 0;
+			}
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* setEnabledChannels
+*
+* Sets the number of enabled analogue channels on the device. This is used to 
+* assist with copying data in the streaming callback.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* enabledChannels - an array representing the channel states. This should be 
+*					4 elements in size.
+*
+* Returns:
+*
+* PICO_OK if successful,
+* PICO_INVALID_HANDLE if handle <= 0, or 
+* PICO_INVALID_PARAMETER if the channel count is out of range
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (wrapUnitInfo->channelCount > 0 && wrapUnitInfo->channelCount <= PS5000A_MAX_CHANNELS)
+		{
+			memcpy_s((int16_t *)wrapUnitInfo->enabledChannels, PS5000A_MAX_CHANNELS * sizeof(int16_t), 
+				(int16_t *)enabledChannels, PS5000A_MAX_CHANNELS * sizeof(int16_t));
+			
+			return PICO_OK;
+		}
+		else
+		{
+		  return PICO_INVALID_PARAMETER;
+		}
+	}
+
+	return PICO_INVALID_HANDLE;
+}
+
+/****************************************************************************
+* setAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffer in order for the 
+* streaming callback to copy the data for the channel/digital port from the 
+* driver buffer to the application buffer.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channel - the channel/ digital port number (should be a PS5000A_CHANNEL 
+*						enumeration value).
+* appBuffer - the application buffer.
+* driverBuffer - the buffer set by the driver.
+* bufferLength - the length of the buffers (the length of the buffers must be
+*								equal).
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if an invalid handle is used, or 
+* PICO_INVALID_CHANNEL if an invalid channel/digital port is used, or
+* PICO_INVALID_PARAMETER if the bufferLength is less than or equal to 0, or if ring
+*						mode is enabled and bufferLength is less than the ring length.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, PS5000A_CHANNEL channel, int16_t * appBuffer, int16_t * driverBuffer, uint32_t bufferLength)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+  // Map port number to internal enumeration for MSO devices.
+	PS5000A_WRAP_DIGITAL_PORT_INDEX portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (bufferLength <= 0)
+		{
+		  return PICO_INVALID_PARAMETER;
+		}
+
+		// In ring mode the callback writes up to ringLength samples into the buffer
+		if (wrapUnitInfo->ringMode && bufferLength < wrapUnitInfo->ringLength)
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+
+		if (channel == PS5000A_DIGITAL_PORT0 || channel == PS5000A_DIGITAL_PORT1)
+		{
+				if (channel == PS5000A_DIGITAL_PORT0)
+				{
+					portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+				}
+				else
+				{
+					portIndex = PS5000A_WRAP_DIGITAL_PORT1;
+				}
+
+				wrapUnitInfo->wrapBufferInfo.appDigiBuffers[portIndex * 2] = appBuffer;
+				wrapUnitInfo->wrapBufferInfo.driverDigiBuffers[portIndex * 2] = driverBuffer;
+
+				wrapUnitInfo->wrapBufferInfo.digiBufferLengths[portIndex] = bufferLength;
+
+				return PICO_OK;
+		}
+		else if (channel < PS5000A_CHANNEL_A || channel >= PS5000A_MAX_CHANNELS)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
+				
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* setMaxMinAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffers in order for the 
+* streaming callback to copy the data for the channel/digital port from the 
+* driver max and min buffers to the respective application buffers for 
+* aggregated data collection.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channel - the channel/digital port number (should be a PS5000A_CHANNEL 
+*						enumeration value).
+* appMaxBuffer - the application max buffer.
+* appMinBuffer - the application min buffer.
+* driverMaxBuffer - the max buffer set by the driver.
+* driverMinBuffer - the min buffer set by the driver.
+* bufferLength - the length of the buffers (the length of the buffers must be
+*								equal).
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if an invalid handle is used, or
+* PICO_INVALID_CHANNEL if an invalid channel/digital port is used, or
+* PICO_INVALID_PARAMETER if the bufferLength is less than or equal to 0, or if ring
+*						mode is enabled and bufferLength is less than the ring length.
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, PS5000A_CHANNEL channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, uint32_t bufferLength)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	// Map port number to internal enumeration for MSO devices.
+	PS5000A_WRAP_DIGITAL_PORT_INDEX portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (bufferLength <= 0)
+		{
+				return PICO_INVALID_PARAMETER;
+		}
+
+		// In ring mode the callback writes up to ringLength samples into the buffer
+		if (wrapUnitInfo->ringMode && bufferLength < wrapUnitInfo->ringLength)
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+
+		if (channel == PS5000A_DIGITAL_PORT0 || channel == PS5000A_DIGITAL_PORT1)
+		{
+				if (channel == PS5000A_DIGITAL_PORT0)
+				{
+						portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+				}
+				else
+				{
+						portIndex = PS5000A_WRAP_DIGITAL_PORT1;
+				}
+
+				wrapUnitInfo->wrapBufferInfo.appDigiBuffers[portIndex * 2] = appMaxBuffer;
+				wrapUnitInfo->wrapBufferInfo.driverDigiBuffers[portIndex * 2] = driverMaxBuffer;
+
+				wrapUnitInfo->wrapBufferInfo.appDigiBuffers[portIndex * 2 + 1] = appMinBuffer;
+				wrapUnitInfo->wrapBufferInfo.driverDigiBuffers[portIndex * 2 + 1] = driverMinBuffer;
+
+				wrapUnitInfo->wrapBufferInfo.digiBufferLengths[portIndex] = bufferLength;
+
+				return PICO_OK;
+		}
+		else if (channel < PS5000A_CHANNEL_A || channel >= PS5000A_MAX_CHANNELS)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
+
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
+
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* setEnabledDigitalPorts
+*
+* Set the number of enabled digital ports on the device. This is used to
+* assist with copying data in the streaming callback.
+*
+* This function does not need to be called for non-MSO models.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* enabledDigitalPorts - an array representing the digital port states. This
+*												must be 2 elements in size.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if the digital port count is not 0 or 2
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(int16_t handle, int16_t * enabledDigitalPorts)
+{
+		WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+		if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+		{
+				if (wrapUnitInfo->digitalPortCount == 0 || wrapUnitInfo->digitalPortCount == PS5000A_WRAP_MAX_DIGITAL_PORTS)
+				{
+						memcpy_s((int16_t *) wrapUnitInfo->enabledDigitalPorts, PS5000A_WRAP_MAX_DIGITAL_PORTS * sizeof(int16_t),
+								(int16_t *) enabledDigitalPorts, PS5000A_WRAP_MAX_DIGITAL_PORTS * sizeof(int16_t));
+
+						return PICO_OK;
+				}
+				else
+				{
+						return PICO_INVALID_PARAMETER;
+				}
+		}
+		else
+		{
+				return PICO_INVALID_HANDLE;
+		}
+}
+
+/****************************************************************************
+* getOverflow
+*
+* Returns indication if there has been an overvoltage on one or more 
+* analogue inputs when collecting data in streaming mode.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* overflow - on exit, a set of flags that indicate whether an overvoltage 
+*						has occurred on any of the channels. It is a bit field with 
+*						bit 0 denoting channel A.
+*
+* Returns:
+*
+* PICO_OK, if successful, or
+* PICO_INVALID_HANDLE if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getOverflow(int16_t handle, int16_t * overflow)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+  if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		*overflow = wrapUnitInfo->overflow;
+		return PICO_OK;
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
+}
+
+/****************************************************************************
+* SetTriggerConditionsV2
+*
+* This function sets up trigger conditions on the scope's inputs. The trigger
+* is defined by one or more sets of integers corresponding to
+* PS5000A_CONDITION structures which are then converted and passed
+* to the ps5000aSetTriggerChannelConditionsV2 function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* conditionsArray - an array of integer values specifying the conditions
+*										for each channel.
+* nConditions - the number that will be passed after the wrapper code has
+*								created its structures (i.e. the number of conditionsArray 
+*								elements / 2). Set to 0 to switch off triggering.
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+* info - see ps5000aSetTriggerChannelConditionsV2
+*
+* If info includes PS5000A_CLEAR and the conditions are the same as those
+* last set, the driver is not called again. Calls that only add conditions
+* are always passed to the driver. Call clearTriggerCache after setting the
+* trigger with the driver functions directly.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, int32_t *conditionsArray, int16_t nConditions, PS5000A_CONDITIONS_INFO info)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PS5000A_CONDITION *conditions = NULL;
+
+	getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if ((info & PS5000A_CLEAR) && isTriggerCached(wrapUnitInfo, WRAP_TRIGGER_CACHE_CONDITIONS, conditionsArray, nConditions * 2, info))
+	{
+		return PICO_OK;
+	}
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS5000A_CONDITION), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nConditions; i++)
+	{
+		conditions[i].source = (PS5000A_CHANNEL)conditionsArray[j];
+		conditions[i].condition = (PS5000A_TRIGGER_STATE)conditionsArray[j + 1];
+
+		j = j + 2;
+	}
+	status = ps5000aSetTriggerChannelConditionsV2(handle, conditions, nConditions, info);
+
+	if (wrapUnitInfo != NULL)
+	{
+		wrapUnitInfo->appliedExpressionValid = FALSE;
+	}
+
+	if (info & PS5000A_CLEAR)
+	{
+		updateTriggerCache(wrapUnitInfo, WRAP_TRIGGER_CACHE_CONDITIONS, conditionsArray, nConditions * 2, info, status);
+	}
+	else
+	{
+		// Conditions added to those already set are not cached
+		updateTriggerCache(wrapUnitInfo, WRAP_TRIGGER_CACHE_CONDITIONS, NULL, -1, info, status);
+	}
+
+	return status;
+}
+
+
+/****************************************************************************
+* SetTriggerDirectionsV2
+*
+* This function sets the direction of the trigger for each channel. The 
+* directions are defined by one or more sets of integers corresponding to
+* PS5000A_DIRECTION structures which are then converted and passed to the 
+* ps5000aSetTriggerChannelDirectionsV2 function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* directionsArray - an array of integer values specifying the directions
+*										for each channel.
+* nConditions - the number that will be passed after the wrapper code has
+*								created its structures (i.e. the number of directionsArray
+*								elements / 3). 
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+*
+* If the directions are the same as those last set, the driver is not 
+* called again.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nDirections is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerDirectionsV2(int16_t handle, int32_t * directionsArray, int16_t nDirections)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PS5000A_DIRECTION *directions = NULL;
+
+	getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (isTriggerCached(wrapUnitInfo, WRAP_TRIGGER_CACHE_DIRECTIONS, directionsArray, nDirections * 3, 0))
+	{
+		return PICO_OK;
+	}
+
+	status = getTriggerArena(handle, nDirections, sizeof(PS5000A_DIRECTION), (void **) &directions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nDirections; i++)
+	{
+		directions[i].source = (PS5000A_CHANNEL) directionsArray[j];
+		directions[i].direction = (PS5000A_THRESHOLD_DIRECTION) directionsArray[j + 1];
+		directions[i].mode = (PS5000A_THRESHOLD_MODE) directionsArray[j + 2];
+
+		j = j + 3;
+	}
+
+	status = ps5000aSetTriggerChannelDirectionsV2(handle, directions, (uint16_t)nDirections);
+
+	updateTriggerCache(wrapUnitInfo, WRAP_TRIGGER_CACHE_DIRECTIONS, directionsArray, nDirections * 3, 0, status);
+
+	return status;
+}
+
+/****************************************************************************
+* SetTriggerPropertiesV2
+*
+* This function is used to enable or disable triggering and set its
+* parameters by means of assigning the values from the propertiesArray to an
+* array of PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 structures which are then 
+* passed to the ps5000aSetTriggerChannelPropertiesV2 function with the other
+* parameters.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* propertiesArray - an array of sets of integers corresponding to
+*					PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 structures describing the
+*					required properties to be set. See also channelProperties
+*					in ps5000aSetTriggerChannelPropertiesV2.
+*
+* nProperties - the number that will be passed after the wrapper code has
+*								created its structures. (i.e. the number of propertiesArray
+*								elements / 5)
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+*
+* If the properties are the same as those last set, the driver is not 
+* called again.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nProperties is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerPropertiesV2(int16_t handle, int32_t *propertiesArray, int16_t nProperties)
+{
+	int16_t i;
+	int16_t j = 0;
+	int16_t auxEnable = 0;
+	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 *channelProperties = NULL;
+
+	getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (isTriggerCached(wrapUnitInfo, WRAP_TRIGGER_CACHE_PROPERTIES, propertiesArray, nProperties * 5, 0))
+	{
+		return PICO_OK;
+	}
+
+	status = getTriggerArena(handle, nProperties, sizeof(PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2), (void **) &channelProperties);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nProperties; i++)
+	{
+		channelProperties[i].thresholdUpper = propertiesArray[j];
+		channelProperties[i].thresholdUpperHysteresis = propertiesArray[j + 1];
+		channelProperties[i].thresholdLower = propertiesArray[j + 2];
+		channelProperties[i].thresholdLowerHysteresis = propertiesArray[j + 3];
+		channelProperties[i].channel = (PS5000A_CHANNEL) propertiesArray[j + 4];
+
+		j = j + 5;
+	}
+
+	status = ps5000aSetTriggerChannelPropertiesV2(handle, channelProperties, nProperties, auxEnable);
+
+	updateTriggerCache(wrapUnitInfo, WRAP_TRIGGER_CACHE_PROPERTIES, propertiesArray, nProperties * 5, 0, status);
+
+	return status;
+}
+
+/****************************************************************************
+* SetTriggerDigitalPortProperties
+*
+* This function is used to set the individual digital channels' trigger 
+* directions by means of assigning the values from the digitalDirections 
+* array to an array of PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures 
+* which are then passed to the ps5000aSetTriggerDigitalPortProperties 
+* function with the other parameters.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* digitalDirections - an array of sets of integers corresponding to
+*											PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures 
+*											describing the required properties to be set. See 
+*											also directions in ps5000aSetTriggerDigitalPortProperties.
+*
+* nDirections - the number that will be passed after the wrapper code has
+*								created its structures. (i.e. the number of 
+*								digitalDirections elements / 2)
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nDirections is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerDigitalPortProperties(int16_t handle, int32_t *digitalDirections, int16_t nDirections)
+{
+	int16_t i;
+	int16_t j = 0;
+	PICO_STATUS status;
+
+	PS5000A_DIGITAL_CHANNEL_DIRECTIONS * directions = NULL;
+
+	status = getTriggerArena(handle, nDirections, sizeof(PS5000A_DIGITAL_CHANNEL_DIRECTIONS), (void **) &directions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nDirections; i++)
+	{
+		directions[i].channel = digitalDirections[j];
+		directions[i].direction = digitalDirections[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps5000aSetTriggerDigitalPortProperties(handle, directions, nDirections);
+
+	return status;
+}
+
+/****************************************************************************
+* SetPulseWidthQualifierConditions
+*
+* This function applies a condition to the pulse-width qualifier. The condition
+* is defined by one or more sets of integers corresponding to
+* PS5000A_CONDITION structures which are then converted and passed
+* to the ps5000aSetPulseWidthQualifierConditions function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* pwqConditionsArray - an array of integer values specifying the conditions
+*										for each channel.
+* nConditions - the number that will be passed after the wrapper code has
+*								created its structures (i.e. the number of pwqConditionsArray
+*								elements / 2). Set to 0 to switch off the pulse-width qualifier.
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+* info - see ps5000aSetPulseWidthQualifierConditions
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierConditions(int16_t handle, int32_t *pwqConditionsArray, int16_t nConditions, PS5000A_CONDITIONS_INFO info)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS5000A_CONDITION * pwqConditions = NULL;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS5000A_CONDITION), (void **) &pwqConditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nConditions; i++)
+	{
+		pwqConditions[i].source = (PS5000A_CHANNEL) pwqConditionsArray[j];
+		pwqConditions[i].condition = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps5000aSetPulseWidthQualifierConditions(handle, pwqConditions, nConditions, info);
+
+	return status;
+}
+
+/****************************************************************************
+* SetPulseWidthQualifierDirections
+*
+* This function sets the direction ofor all trigger sources used with the 
+* pulse width qualifier. The directions are defined by one or more sets of 
+* integers corresponding to PS5000A_DIRECTION structures which are then 
+* converted and passed to the ps5000aSetPulseWidthQualifierDirections function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* pwqDirectionsArray - an array of integer values specifying the directions
+*										for each channel.
+* nConditions - the number that will be passed after the wrapper code has
+*								created its structures (i.e. the number of pwqDirectionsArray
+*								elements / 3).
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nDirections is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierDirections(int16_t handle, int32_t * pwqDirectionsArray, int16_t nDirections)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS5000A_DIRECTION * pwqDirections = NULL;
+
+	status = getTriggerArena(handle, nDirections, sizeof(PS5000A_DIRECTION), (void **) &pwqDirections);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nDirections; i++)
+	{
+		pwqDirections[i].source = (PS5000A_CHANNEL) pwqDirectionsArray[j];
+		pwqDirections[i].direction = (PS5000A_THRESHOLD_DIRECTION) pwqDirectionsArray[j + 1];
+		pwqDirections[i].mode = (PS5000A_THRESHOLD_MODE) pwqDirectionsArray[j + 2];
+
+		j = j + 3;
+	}
+
+	status = ps5000aSetPulseWidthQualifierDirections(handle, pwqDirections, nDirections);
+
+	return status;
+}
+
+/****************************************************************************
+* SetPulseWidthDigitalPortProperties
+*
+* This function is used to set the individual digital channels' pulse-width 
+* trigger directions by means of assigning the values from the digitalDirections
+* array to an array of PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures
+* which are then passed to the ps5000aSetSetPulseWidthDigitalPortProperties
+* function with the other parameters.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* pwqDigitalDirections - an array of sets of integers corresponding to
+*											PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures
+*											describing the required properties to be set. See
+*											also directions in ps5000aSetPulseWidthDigitalPortProperties.
+*
+* nDirections - the number that will be passed after the wrapper code has
+*								created its structures. (i.e. the number of
+*								pwqDigitalDirections elements / 2)
+*								More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*								in heap memory instead of the trigger arena.
+*
+* Returns:
+*
+* PICO_OK or other code from PicoStatus.h
+* PICO_INVALID_PARAMETER, if nDirections is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetPulseWidthDigitalPortProperties(int16_t handle, int32_t *pwqDigitalDirections, int16_t nDirections)
+{
+	int16_t i;
+	int16_t j = 0;
+	PICO_STATUS status;
+
+	PS5000A_DIGITAL_CHANNEL_DIRECTIONS * pwqDirections = NULL;
+
+	status = getTriggerArena(handle, nDirections, sizeof(PS5000A_DIGITAL_CHANNEL_DIRECTIONS), (void **) &pwqDirections);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nDirections; i++)
+	{
+		pwqDirections[i].channel = pwqDigitalDirections[j];
+		pwqDirections[i].direction = pwqDigitalDirections[j + 1];
+
+		j = j + 2;
+	}
+
+	status = ps5000aSetPulseWidthDigitalPortProperties(handle, pwqDirections, nDirections);
+
+	return status;
+}
+
+/****************************************************************************
+* isTriggerSource
+*
+* Returns TRUE if source is one of the first channelCount analogue channels,
+* the external or AUX input, the pulse-width qualifier or a digital port.
+*
+****************************************************************************/
+static int16_t isTriggerSource(int32_t source, int16_t channelCount)
+{
+	return (source >= PS5000A_CHANNEL_A && source < channelCount) || source == PS5000A_EXTERNAL || source == PS5000A_TRIGGER_AUX ||
+		source == PS5000A_PULSE_WIDTH_SOURCE || (source >= PS5000A_DIGITAL_PORT0 && source <= PS5000A_DIGITAL_PORT3);
+}
+
+/****************************************************************************
+* isTriggerPropertiesChannel
+*
+* Returns TRUE if channel is one of the first channelCount analogue channels
+* or the external or AUX input, the channels that can be given trigger 
+* properties.
+*
+****************************************************************************/
+static int16_t isTriggerPropertiesChannel(int32_t channel, int16_t channelCount)
+{
+	return (channel >= PS5000A_CHANNEL_A && channel < channelCount) || channel == PS5000A_EXTERNAL || channel == PS5000A_TRIGGER_AUX;
+}
+
+/****************************************************************************
+* validateTriggerRecords
+*
+* Checks the records of one section of a SetAdvancedTrigger descriptor 
+* against the ranges of the driver enumerations and structure fields. 
+* Analogue channels must be below channelCount; the external and AUX inputs
+* are accepted as sources and property channels.
+*
+* Returns:
+*
+* PICO_OK, if every record is valid.
+* PICO_INVALID_PARAMETER, if a value is out of range.
+*
+****************************************************************************/
+static PICO_STATUS validateTriggerRecords(WRAP_ADVANCED_TRIGGER_SECTION section, const int32_t * records, int32_t nRecords, int16_t channelCount)
+{
+	int32_t i = 0;
+	const int32_t * record = records;
+
+	for (i = 0; i < nRecords; i++)
+	{
+		switch (section)
+		{
+			case WRAP_ADVANCED_TRIGGER_CONDITIONS:
+			case WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS:
+
+				// source, condition
+				if (!isTriggerSource(record[0], channelCount) || record[1] < PS5000A_CONDITION_DONT_CARE || record[1] >= PS5000A_CONDITION_MAX)
+				{
+					return PICO_INVALID_PARAMETER;
+				}
+
+				record += 2;
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_DIRECTIONS:
+			case WRAP_ADVANCED_TRIGGER_PWQ_DIRECTIONS:
+
+				// source, direction, mode
+				if (!isTriggerSource(record[0], channelCount) || record[1] < PS5000A_ABOVE || record[1] > PS5000A_NEGATIVE_RUNT || (record[2] != PS5000A_LEVEL && record[2] != PS5000A_WINDOW))
+				{
+					return PICO_INVALID_PARAMETER;
+				}
+
+				record += 3;
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_PROPERTIES:
+
+				// thresholdUpper, thresholdUpperHysteresis, thresholdLower, thresholdLowerHysteresis, channel
+				if (record[0] < INT16_MIN || record[0] > INT16_MAX || record[1] < 0 || record[1] > UINT16_MAX ||
+					record[2] < INT16_MIN || record[2] > INT16_MAX || record[3] < 0 || record[3] > UINT16_MAX ||
+					!isTriggerPropertiesChannel(record[4], channelCount))
+				{
+					return PICO_INVALID_PARAMETER;
+				}
+
+				record += 5;
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_DIGITAL_DIRECTIONS:
+			case WRAP_ADVANCED_TRIGGER_PWQ_DIGITAL_DIRECTIONS:
+
+				// channel, direction
+				if (record[0] < PS5000A_DIGITAL_CHANNEL_0 || record[0] >= PS5000A_MAX_DIGITAL_CHANNELS ||
+					record[1] < PS5000A_DIGITAL_DONT_CARE || record[1] >= PS5000A_DIGITAL_MAX_DIRECTION)
+				{
+					return PICO_INVALID_PARAMETER;
+				}
+
+				record += 2;
+				break;
+
+			default:
+
+				return PICO_INVALID_PARAMETER;
+		}
+	}
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* SetAdvancedTrigger
+*
+* This function sets up an advanced trigger, including pulse-width 
+* qualification and digital port triggers, in one call. It takes the place
+* of calls to SetTriggerConditionsV2, SetTriggerDirectionsV2, 
+* SetTriggerPropertiesV2, SetTriggerDigitalPortProperties, 
+* SetPulseWidthQualifierConditions, SetPulseWidthQualifierDirections and 
+* SetPulseWidthDigitalPortProperties, which are applied in that order.
+*
+* The whole descriptor is checked before the driver is called. If the driver
+* then rejects one of the settings, no further settings are applied and 
+* the trigger and pulse-width qualifier conditions are cleared, so the 
+* device is not left with a partly applied trigger.
+*
+* Settings that are the same as those last applied are not passed to the 
+* driver again (see SetTriggerConditionsV2).
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* descriptor - a WRAP_ADVANCED_TRIGGER_HEADER_SIZE value header, giving the
+*				number of records in each section and the 
+*				PS5000A_CONDITIONS_INFO values to use with the conditions, 
+*				followed by the records of each section (see 
+*				enWrapAdvancedTriggerHeader in ps5000aWrap.h). A section 
+*				with no records is not applied, except that conditions with 
+*				an info value including PS5000A_CLEAR are applied to clear 
+*				the existing conditions.
+* descriptorLength - the number of values in the descriptor.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_INVALID_PARAMETER, if descriptor is NULL, descriptorLength does not 
+*							match the header, a section has more than 
+*							32767 records, or a value in the descriptor is
+*							out of range. Sources
+*							and property channels must be valid for the 
+*							number of channels set by setChannelCount. The 
+*							driver is not called.
+* Other codes from PicoStatus.h, as returned by the driver for the first 
+* setting rejected.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetAdvancedTrigger(int16_t handle, int32_t * descriptor, int32_t descriptorLength)
+{
+	static const int16_t recordSizes[WRAP_ADVANCED_TRIGGER_SECTIONS] = { 2, 3, 5, 2, 2, 3, 2 };
+
+	int32_t counts[WRAP_ADVANCED_TRIGGER_SECTIONS];
+	int32_t * sections[WRAP_ADVANCED_TRIGGER_SECTIONS];
+	int32_t conditionsInfo = 0;
+	int32_t pwqConditionsInfo = 0;
+	int32_t length = WRAP_ADVANCED_TRIGGER_HEADER_SIZE;
+	int16_t section = 0;
+	int16_t channelCount = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+
+	if (descriptor == NULL || descriptorLength < WRAP_ADVANCED_TRIGGER_HEADER_SIZE)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	// Use every channel if setChannelCount has not been called
+	channelCount = (wrapUnitInfo->channelCount > 0) ? wrapUnitInfo->channelCount : (int16_t) PS5000A_MAX_CHANNELS;
+
+	counts[WRAP_ADVANCED_TRIGGER_CONDITIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_CONDITIONS];
+	counts[WRAP_ADVANCED_TRIGGER_DIRECTIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_DIRECTIONS];
+	counts[WRAP_ADVANCED_TRIGGER_PROPERTIES] = descriptor[WRAP_ADVANCED_TRIGGER_N_PROPERTIES];
+	counts[WRAP_ADVANCED_TRIGGER_DIGITAL_DIRECTIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_DIGITAL_DIRECTIONS];
+	counts[WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_PWQ_CONDITIONS];
+	counts[WRAP_ADVANCED_TRIGGER_PWQ_DIRECTIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_PWQ_DIRECTIONS];
+	counts[WRAP_ADVANCED_TRIGGER_PWQ_DIGITAL_DIRECTIONS] = descriptor[WRAP_ADVANCED_TRIGGER_N_PWQ_DIGITAL_DIRECTIONS];
+
+	conditionsInfo = descriptor[WRAP_ADVANCED_TRIGGER_CONDITIONS_INFO];
+	pwqConditionsInfo = descriptor[WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS_INFO];
+
+	// Check the header and find the start of each section
+	for (section = 0; section < WRAP_ADVANCED_TRIGGER_SECTIONS; section++)
+	{
+		if (counts[section] < 0 || counts[section] > INT16_MAX || 
+			counts[section] > (descriptorLength - length) / recordSizes[section])
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+
+		sections[section] = descriptor + length;
+		length += counts[section] * recordSizes[section];
+	}
+
+	if (length != descriptorLength)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if ((conditionsInfo & ~(PS5000A_CLEAR | PS5000A_ADD)) || (pwqConditionsInfo & ~(PS5000A_CLEAR | PS5000A_ADD)) ||
+		(counts[WRAP_ADVANCED_TRIGGER_CONDITIONS] > 0 && !(conditionsInfo & PS5000A_ADD)) ||
+		(counts[WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS] > 0 && !(pwqConditionsInfo & PS5000A_ADD)))
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	for (section = 0; section < WRAP_ADVANCED_TRIGGER_SECTIONS; section++)
+	{
+		status = validateTriggerRecords((WRAP_ADVANCED_TRIGGER_SECTION) section, sections[section], counts[section], channelCount);
+
+		if (status != PICO_OK)
+		{
+			return status;
+		}
+	}
+
+	// Apply the settings, stopping at the first one the driver rejects
+	for (section = 0; section < WRAP_ADVANCED_TRIGGER_SECTIONS && status == PICO_OK; section++)
+	{
+		int16_t count = (int16_t) counts[section];
+
+		switch (section)
+		{
+			case WRAP_ADVANCED_TRIGGER_CONDITIONS:
+
+				if (count > 0 || (conditionsInfo & PS5000A_CLEAR))
+				{
+					status = SetTriggerConditionsV2(handle, sections[section], count, (PS5000A_CONDITIONS_INFO) conditionsInfo);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_DIRECTIONS:
+
+				if (count > 0)
+				{
+					status = SetTriggerDirectionsV2(handle, sections[section], count);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_PROPERTIES:
+
+				if (count > 0)
+				{
+					status = SetTriggerPropertiesV2(handle, sections[section], count);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_DIGITAL_DIRECTIONS:
+
+				if (count > 0)
+				{
+					status = SetTriggerDigitalPortProperties(handle, sections[section], count);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS:
+
+				if (count > 0 || (pwqConditionsInfo & PS5000A_CLEAR))
+				{
+					status = SetPulseWidthQualifierConditions(handle, sections[section], count, (PS5000A_CONDITIONS_INFO) pwqConditionsInfo);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_PWQ_DIRECTIONS:
+
+				if (count > 0)
+				{
+					status = SetPulseWidthQualifierDirections(handle, sections[section], count);
+				}
+				break;
+
+			case WRAP_ADVANCED_TRIGGER_PWQ_DIGITAL_DIRECTIONS:
+
+				if (count > 0)
+				{
+					status = SetPulseWidthDigitalPortProperties(handle, sections[section], count);
+				}
+				break;
+		}
+	}
+
+	if (status != PICO_OK)
+	{
+		// Do not leave a partly applied trigger armed
+		SetTriggerConditionsV2(handle, NULL, 0, PS5000A_CLEAR);
+		SetPulseWidthQualifierConditions(handle, NULL, 0, PS5000A_CLEAR);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* countTriggerSources
+*
+* Returns the number of sources in a WRAP_TRIGGER_TERM mask.
+*
+****************************************************************************/
+static int16_t countTriggerSources(uint16_t sources)
+{
+	int16_t count = 0;
+
+	while (sources)
+	{
+		sources &= sources - 1;
+		count++;
+	}
+
+	return count;
+}
+
+/****************************************************************************
+* isTermCovered
+*
+* Returns TRUE if every input that satisfies term also satisfies cover, 
+* i.e. cover has no conditions that term does not have.
+*
+****************************************************************************/
+static int16_t isTermCovered(WRAP_TRIGGER_TERM term, WRAP_TRIGGER_TERM cover)
+{
+	return (cover.trueSources & ~term.trueSources) == 0 && (cover.falseSources & ~term.falseSources) == 0;
+}
+
+/****************************************************************************
+* addTriggerTerm
+*
+* Adds a condition set to an expression. A set that can never be true, or 
+* that is covered by a set already in the expression, is not added, and 
+* sets covered by the new set are removed.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_MEMORY_FAIL, if the expression already has WRAP_MAX_TRIGGER_TERMS sets.
+*
+****************************************************************************/
+static PICO_STATUS addTriggerTerm(WRAP_TRIGGER_EXPRESSION * expression, WRAP_TRIGGER_TERM term)
+{
+	int16_t i = 0;
+	int16_t n = 0;
+
+	if (term.trueSources & term.falseSources)
+	{
+		return PICO_OK;
+	}
+
+	for (i = 0; i < expression->nTerms; i++)
+	{
+		if (isTermCovered(term, expression->terms[i]))
+		{
+			return PICO_OK;
+		}
+	}
+
+	for (i = 0; i < expression->nTerms; i++)
+	{
+		if (!isTermCovered(expression->terms[i], term))
+		{
+			expression->terms[n++] = expression->terms[i];
+		}
+	}
+
+	expression->nTerms = n;
+
+	if (n == WRAP_MAX_TRIGGER_TERMS)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	expression->terms[expression->nTerms++] = term;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* combineTriggerOr
+*
+* Sets result to result OR other.
+*
+****************************************************************************/
+static PICO_STATUS combineTriggerOr(WRAP_TRIGGER_EXPRESSION * result, const WRAP_TRIGGER_EXPRESSION * other)
+{
+	PICO_STATUS status = PICO_OK;
+	int16_t i = 0;
+
+	for (i = 0; i < other->nTerms && status == PICO_OK; i++)
+	{
+		status = addTriggerTerm(result, other->terms[i]);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* combineTriggerAnd
+*
+* Sets result to result AND other, by combining each set of result with 
+* each set of other.
+*
+****************************************************************************/
+static PICO_STATUS combineTriggerAnd(WRAP_TRIGGER_EXPRESSION * result, const WRAP_TRIGGER_EXPRESSION * other)
+{
+	WRAP_TRIGGER_EXPRESSION left = *result;
+	WRAP_TRIGGER_TERM term;
+	PICO_STATUS status = PICO_OK;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	result->nTerms = 0;
+
+	for (i = 0; i < left.nTerms && status == PICO_OK; i++)
+	{
+		for (j = 0; j < other->nTerms && status == PICO_OK; j++)
+		{
+			term.trueSources = left.terms[i].trueSources | other->terms[j].trueSources;
+			term.falseSources = left.terms[i].falseSources | other->terms[j].falseSources;
+			status = addTriggerTerm(result, term);
+		}
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* skipExpressionSpaces
+*
+* Moves the parser past any white space.
+*
+****************************************************************************/
+static void skipExpressionSpaces(WRAP_EXPRESSION_PARSER * parser)
+{
+	while (parser->text[parser->position] == ' ' || parser->text[parser->position] == '\t' || 
+		parser->text[parser->position] == '\r' || parser->text[parser->position] == '\n')
+	{
+		parser->position++;
+	}
+}
+
+/****************************************************************************
+* isExpressionOperator
+*
+* Moves the parser past the operator if the next character is op. The & 
+* and | operators may be doubled (&& or ||).
+*
+****************************************************************************/
+static int16_t isExpressionOperator(WRAP_EXPRESSION_PARSER * parser, char op)
+{
+	skipExpressionSpaces(parser);
+
+	if (parser->text[parser->position] != op)
+	{
+		return FALSE;
+	}
+
+	parser->position++;
+
+	if ((op == '&' || op == '|') && parser->text[parser->position] == op)
+	{
+		parser->position++;
+	}
+
+	return TRUE;
+}
+
+static PICO_STATUS parseTriggerOr(WRAP_EXPRESSION_PARSER * parser, int16_t negate, WRAP_TRIGGER_EXPRESSION * result);
+
+/****************************************************************************
+* parseTriggerFactor
+*
+* Parses a source name, a negated factor or an expression in parentheses.
+* If negate is set the result is the negation of the factor.
+*
+****************************************************************************/
+static PICO_STATUS parseTriggerFactor(WRAP_EXPRESSION_PARSER * parser, int16_t negate, WRAP_TRIGGER_EXPRESSION * result)
+{
+	PICO_STATUS status = PICO_OK;
+	WRAP_TRIGGER_TERM term;
+	int32_t start = 0;
+	int32_t length = 0;
+	int16_t source = 0;
+	int16_t i = 0;
+	char ch = 0;
+
+	if (isExpressionOperator(parser, '!'))
+	{
+		return parseTriggerFactor(parser, !negate, result);
+	}
+
+	if (isExpressionOperator(parser, '('))
+	{
+		if (++parser->depth > WRAP_MAX_EXPRESSION_DEPTH)
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+
+		status = parseTriggerOr(parser, negate, result);
+
+		if (status == PICO_OK && !isExpressionOperator(parser, ')'))
+		{
+			status = PICO_INVALID_PARAMETER;
+		}
+
+		parser->depth--;
+
+		return status;
+	}
+
+	// Source name
+	start = parser->position;
+
+	for (;;)
+	{
+		ch = parser->text[parser->position];
+
+		if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') || ch == '_')
+		{
+			parser->position++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	length = parser->position - start;
+
+	for (source = 0; source < WRAP_TRIGGER_SOURCE_COUNT; source++)
+	{
+		if ((int32_t) strlen(_triggerSourceNames[source]) != length)
+		{
+			continue;
+		}
+
+		for (i = 0; i < length; i++)
+		{
+			ch = parser->text[start + i];
+
+			if (ch >= 'a' && ch <= 'z')
+			{
+				ch = ch - 'a' + 'A';
+			}
+
+			if (ch != _triggerSourceNames[source][i])
+			{
+				break;
+			}
+		}
+
+		if (i == length)
+		{
+			break;
+		}
+	}
+
+	if (length == 0 || source == WRAP_TRIGGER_SOURCE_COUNT)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	term.trueSources = negate ? 0 : (uint16_t) (1 << source);
+	term.falseSources = negate ? (uint16_t) (1 << source) : 0;
+
+	result->nTerms = 0;
+
+	return addTriggerTerm(result, term);
+}
+
+/****************************************************************************
+* parseTriggerAnd
+*
+* Parses factors separated by &. If negate is set the result is the 
+* negation, i.e. the OR of the negated factors.
+*
+****************************************************************************/
+static PICO_STATUS parseTriggerAnd(WRAP_EXPRESSION_PARSER * parser, int16_t negate, WRAP_TRIGGER_EXPRESSION * result)
+{
+	WRAP_TRIGGER_EXPRESSION factor;
+	PICO_STATUS status = parseTriggerFactor(parser, negate, result);
+
+	while (status == PICO_OK && isExpressionOperator(parser, '&'))
+	{
+		status = parseTriggerFactor(parser, negate, &factor);
+
+		if (status == PICO_OK)
+		{
+			status = negate ? combineTriggerOr(result, &factor) : combineTriggerAnd(result, &factor);
+		}
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* parseTriggerOr
+*
+* Parses terms separated by |. If negate is set the result is the negation,
+* i.e. the AND of the negated terms.
+*
+****************************************************************************/
+static PICO_STATUS parseTriggerOr(WRAP_EXPRESSION_PARSER * parser, int16_t negate, WRAP_TRIGGER_EXPRESSION * result)
+{
+	WRAP_TRIGGER_EXPRESSION term;
+	PICO_STATUS status = parseTriggerAnd(parser, negate, result);
+
+	while (status == PICO_OK && isExpressionOperator(parser, '|'))
+	{
+		status = parseTriggerAnd(parser, negate, &term);
+
+		if (status == PICO_OK)
+		{
+			status = negate ? combineTriggerAnd(result, &term) : combineTriggerOr(result, &term);
+		}
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* searchTriggerCover
+*
+* Depth-first search for the smallest set of condition sets that covers 
+* every input satisfying the expression. The uncovered input with the 
+* fewest sets covering it is chosen at each step, and each of those sets is
+* tried in turn. The search stops after WRAP_MAX_COVER_SEARCH_NODES steps, 
+* keeping the best cover found.
+*
+****************************************************************************/
+static void searchTriggerCover(WRAP_TRIGGER_COVER_SEARCH * search, const uint64_t * covered, int16_t depth)
+{
+	uint64_t nextCovered[WRAP_TRIGGER_INPUT_WORDS];
+	uint64_t uncovered = 0;
+	int16_t input = -1;
+	int16_t bestCovers = WRAP_MAX_TRIGGER_TERMS + 1;
+	int16_t covers = 0;
+	int16_t bit = 0;
+	int16_t w = 0;
+	int16_t i = 0;
+
+	if (++search->nodes > WRAP_MAX_COVER_SEARCH_NODES)
+	{
+		return;
+	}
+
+	for (w = 0; w < WRAP_TRIGGER_INPUT_WORDS; w++)
+	{
+		uncovered = search->needed[w] & ~covered[w];
+
+		for (bit = 0; uncovered != 0; bit++, uncovered >>= 1)
+		{
+			if (uncovered & 1)
+			{
+				covers = 0;
+
+				for (i = 0; i < search->nTerms; i++)
+				{
+					covers += (int16_t) ((search->coverage[i][w] >> bit) & 1);
+				}
+
+				if (covers < bestCovers)
+				{
+					input = w * 64 + bit;
+					bestCovers = covers;
+				}
+			}
+		}
+	}
+
+	if (input < 0)
+	{
+		// Every input is covered
+		search->bestCount = depth;
+		memcpy_s(search->best, sizeof(search->best), search->chosen, depth * sizeof(int16_t));
+		return;
+	}
+
+	if (depth + 1 >= search->bestCount)
+	{
+		return;
+	}
+
+	for (i = 0; i < search->nTerms; i++)
+	{
+		if ((search->coverage[i][input / 64] >> (input % 64)) & 1)
+		{
+			for (w = 0; w < WRAP_TRIGGER_INPUT_WORDS; w++)
+			{
+				nextCovered[w] = covered[w] | search->coverage[i][w];
+			}
+
+			search->chosen[depth] = i;
+			searchTriggerCover(search, nextCovered, depth + 1);
+		}
+	}
+}
+
+/****************************************************************************
+* selectTriggerTerms
+*
+* Keeps the smallest set of the condition sets of an expression that 
+* covers every input satisfying it (see searchTriggerCover). Inputs are the
+* sets of sources that are true. The order of the sets is kept.
+*
+* The search state is held in _coverSearch, so the caller must hold 
+* _expressionCacheLock.
+*
+****************************************************************************/
+static void selectTriggerTerms(WRAP_TRIGGER_EXPRESSION * expression)
+{
+	WRAP_TRIGGER_COVER_SEARCH * search = &_coverSearch;
+	uint64_t covered[WRAP_TRIGGER_INPUT_WORDS];
+	int16_t keep[WRAP_MAX_TRIGGER_TERMS];
+	uint16_t used = 0;
+	uint16_t freeSources = 0;
+	uint16_t subset = 0;
+	uint16_t input = 0;
+	int16_t i = 0;
+	int16_t n = 0;
+
+	memset(search, 0, sizeof(WRAP_TRIGGER_COVER_SEARCH));
+
+	for (i = 0; i < expression->nTerms; i++)
+	{
+		used |= expression->terms[i].trueSources | expression->terms[i].falseSources;
+	}
+
+	for (i = 0; i < expression->nTerms; i++)
+	{
+		freeSources = used & ~(expression->terms[i].trueSources | expression->terms[i].falseSources);
+		subset = freeSources;
+
+		// Runs through every subset of the sources that the set does not use
+		for (;;)
+		{
+			input = expression->terms[i].trueSources | subset;
+			search->coverage[i][input / 64] |= (uint64_t) 1 << (input % 64);
+			search->needed[input / 64] |= (uint64_t) 1 << (input % 64);
+
+			if (subset == 0)
+			{
+				break;
+			}
+
+			subset = (subset - 1) & freeSources;
+		}
+
+		search->best[i] = i;
+		keep[i] = FALSE;
+	}
+
+	search->nTerms = expression->nTerms;
+	search->bestCount = expression->nTerms;
+
+	memset(covered, 0, sizeof(covered));
+	searchTriggerCover(search, covered, 0);
+
+	for (i = 0; i < search->bestCount; i++)
+	{
+		keep[search->best[i]] = TRUE;
+	}
+
+	for (i = 0; i < expression->nTerms; i++)
+	{
+		if (keep[i])
+		{
+			expression->terms[n++] = expression->terms[i];
+		}
+	}
+
+	expression->nTerms = n;
+}
+
+/****************************************************************************
+* compareTriggerTerms
+*
+* Orders condition sets by the number of conditions, then by the sources 
+* used, then by the sources that must be true.
+*
+****************************************************************************/
+static int16_t compareTriggerTerms(WRAP_TRIGGER_TERM left, WRAP_TRIGGER_TERM right)
+{
+	uint16_t leftSources = left.trueSources | left.falseSources;
+	uint16_t rightSources = right.trueSources | right.falseSources;
+
+	if (countTriggerSources(leftSources) != countTriggerSources(rightSources))
+	{
+		return countTriggerSources(leftSources) < countTriggerSources(rightSources) ? -1 : 1;
+	}
+
+	if (leftSources != rightSources)
+	{
+		return leftSources < rightSources ? -1 : 1;
+	}
+
+	if (left.trueSources != right.trueSources)
+	{
+		return left.trueSources < right.trueSources ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+* minimiseTriggerExpression
+*
+* Reduces an expression to as few condition sets as possible. Consensus 
+* sets are added until every prime implicant is present, and the sets are 
+* sorted so that the result does not depend on the order in which they were
+* found. A cover of the expression is then chosen from them.
+*
+****************************************************************************/
+static PICO_STATUS minimiseTriggerExpression(WRAP_TRIGGER_EXPRESSION * expression)
+{
+	WRAP_TRIGGER_TERM term;
+	PICO_STATUS status = PICO_OK;
+	uint16_t opposed = 0;
+	int16_t changed = TRUE;
+	int16_t i = 0;
+	int16_t j = 0;
+	int16_t n = 0;
+
+	while (changed && status == PICO_OK)
+	{
+		changed = FALSE;
+
+		for (i = 0; i < expression->nTerms && !changed && status == PICO_OK; i++)
+		{
+			for (j = i + 1; j < expression->nTerms && !changed && status == PICO_OK; j++)
+			{
+				opposed = (expression->terms[i].trueSources & expression->terms[j].falseSources) | 
+					(expression->terms[i].falseSources & expression->terms[j].trueSources);
+
+				if (countTriggerSources(opposed) != 1)
+				{
+					continue;
+				}
+
+				term.trueSources = (expression->terms[i].trueSources | expression->terms[j].trueSources) & ~opposed;
+				term.falseSources = (expression->terms[i].falseSources | expression->terms[j].falseSources) & ~opposed;
+
+				for (n = 0; n < expression->nTerms; n++)
+				{
+					if (isTermCovered(term, expression->terms[n]))
+					{
+						break;
+					}
+				}
+
+				if (n == expression->nTerms)
+				{
+					status = addTriggerTerm(expression, term);
+					changed = TRUE;
+				}
+			}
+		}
+	}
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	// Sort by number of conditions, then by sources
+	for (i = 1; i < expression->nTerms; i++)
+	{
+		term = expression->terms[i];
+
+		for (j = i; j > 0 && compareTriggerTerms(expression->terms[j - 1], term) > 0; j--)
+		{
+			expression->terms[j] = expression->terms[j - 1];
+		}
+
+		expression->terms[j] = term;
+	}
+
+	selectTriggerTerms(expression);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* compileTriggerExpression
+*
+* Compiles a trigger expression, or copies the compiled form from the cache
+* if the same text has been compiled before.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if the expression is NULL, longer than 
+*							WRAP_MAX_EXPRESSION_LENGTH, not valid, or can 
+*							never be true.
+* PICO_MEMORY_FAIL, if the expression needs more than 
+*							WRAP_MAX_TRIGGER_TERMS condition sets.
+*
+****************************************************************************/
+static PICO_STATUS compileTriggerExpression(const char * text, WRAP_TRIGGER_EXPRESSION * compiled)
+{
+	WRAP_EXPRESSION_CACHE_ENTRY * entry = NULL;
+	WRAP_EXPRESSION_PARSER parser;
+	PICO_STATUS status = PICO_OK;
+	size_t length = 0;
+	uint32_t hash = 0;
+
+	if (text == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	length = strlen(text);
+
+	if (length > WRAP_MAX_EXPRESSION_LENGTH)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	hash = hashBytes(text, length);
+	entry = &_expressionCache[hash & (WRAP_EXPRESSION_CACHE_SIZE - 1)];
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_expressionCacheLock);
+#else
+	pthread_mutex_lock(&_expressionCacheLock);
+#endif
+
+	if (entry->valid && entry->hash == hash && memcmp(entry->text, text, length + 1) == 0)
+	{
+		*compiled = entry->compiled;
+	}
+	else
+	{
+		parser.text = text;
+		parser.position = 0;
+		parser.depth = 0;
+
+		status = parseTriggerOr(&parser, FALSE, compiled);
+
+		skipExpressionSpaces(&parser);
+
+		if (status == PICO_OK && (parser.text[parser.position] != '\0' || compiled->nTerms == 0))
+		{
+			status = PICO_INVALID_PARAMETER;
+		}
+
+		if (status == PICO_OK)
+		{
+			status = minimiseTriggerExpression(compiled);
+		}
+
+		if (status == PICO_OK)
+		{
+			entry->valid = TRUE;
+			entry->hash = hash;
+			memcpy_s(entry->text, sizeof(entry->text), text, length + 1);
+			entry->compiled = *compiled;
+		}
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_expressionCacheLock);
+#else
+	pthread_mutex_unlock(&_expressionCacheLock);
+#endif
+
+	return status;
+}
+
+/****************************************************************************
+* writeTriggerTerm
+*
+* Writes the conditions of one condition set as source and condition pairs,
+* in the layout of the conditionsArray of SetTriggerConditionsV2. Returns 
+* the number of conditions written.
+*
+****************************************************************************/
+static int16_t writeTriggerTerm(WRAP_TRIGGER_TERM term, int32_t * values)
+{
+	int16_t source = 0;
+	int16_t n = 0;
+
+	for (source = 0; source < WRAP_TRIGGER_SOURCE_COUNT; source++)
+	{
+		if ((term.trueSources | term.falseSources) & (1 << source))
+		{
+			values[2 * n] = _triggerSources[source];
+			values[2 * n + 1] = (term.trueSources & (1 << source)) ? PS5000A_CONDITION_TRUE : PS5000A_CONDITION_FALSE;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/****************************************************************************
+* CompileTriggerExpression
+*
+* Compiles a trigger expression without applying it, and returns the 
+* condition sets that SetTriggerExpression would pass to the driver. 
+* Condition set n can be passed to SetTriggerConditionsV2 with 
+* termLengths[n] conditions, PS5000A_CLEAR | PS5000A_ADD for the first set 
+* and PS5000A_ADD for the others.
+*
+* Expressions are made of the source names A, B, C, D, EXT, AUX, PWQ and 
+* PORT0 to PORT3 (in upper or lower case), the operators ! (not), & (and) 
+* and | (or), which may be doubled, and parentheses, e.g. 
+* "(A & !B) | (EXT & PWQ)". ! binds most tightly, then &, then |.
+*
+* The expression is reduced to the fewest condition sets, each of which is 
+* passed to the driver in a separate call. An expression that is always 
+* true compiles to one set with no conditions, which switches triggering 
+* off.
+*
+* Input Arguments:
+*
+* expression - the trigger expression, terminated by a null character.
+* conditionsArray - on exit, the conditions of each set as source and 
+*				condition pairs (see SetTriggerConditionsV2).
+* maxValues - the number of elements in conditionsArray.
+* termLengths - on exit, the number of conditions in each set.
+* maxTerms - the number of elements in termLengths.
+* nTerms - on exit, the number of condition sets.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if an argument is NULL, the expression is not 
+*							valid or can never be true, or the arrays are 
+*							too small.
+* PICO_MEMORY_FAIL, if the expression needs more than 
+*							WRAP_MAX_TRIGGER_TERMS condition sets.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 CompileTriggerExpression(int8_t * expression, int32_t * conditionsArray, int32_t maxValues, int16_t * termLengths,
+	int16_t maxTerms, int16_t * nTerms)
+{
+	WRAP_TRIGGER_EXPRESSION compiled;
+	PICO_STATUS status = PICO_OK;
+	int32_t nValues = 0;
+	int16_t i = 0;
+
+	if (conditionsArray == NULL || termLengths == NULL || nTerms == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	status = compileTriggerExpression((const char *) expression, &compiled);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (compiled.nTerms > maxTerms)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	for (i = 0; i < compiled.nTerms; i++)
+	{
+		nValues += 2 * countTriggerSources(compiled.terms[i].trueSources | compiled.terms[i].falseSources);
+	}
+
+	if (nValues > maxValues)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	nValues = 0;
+
+	for (i = 0; i < compiled.nTerms; i++)
+	{
+		termLengths[i] = writeTriggerTerm(compiled.terms[i], conditionsArray + nValues);
+		nValues += 2 * termLengths[i];
+	}
+
+	*nTerms = compiled.nTerms;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* SetTriggerExpression
+*
+* Sets the trigger conditions from a trigger expression such as 
+* "(A & !B) | (EXT & PWQ)" (see CompileTriggerExpression). Compiled 
+* expressions are cached, so an expression is only parsed the first time it
+* is used. Each condition set is passed to the driver in one call to 
+* ps5000aSetTriggerChannelConditionsV2, and no calls are made if the same 
+* conditions were applied by the last call for the device.
+*
+* The directions and properties for the sources used must be set 
+* separately, e.g. with SetTriggerDirectionsV2 and SetTriggerPropertiesV2.
+*
+* If the driver rejects a condition set, the trigger conditions are cleared
+* so that a partly applied expression is not left armed.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* expression - the trigger expression, terminated by a null character.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_PARAMETER, if the expression is not valid or can never be 
+*							true.
+* PICO_MEMORY_FAIL, if the expression needs more than 
+*							WRAP_MAX_TRIGGER_TERMS condition sets.
+* Other codes from PicoStatus.h, as returned by the driver.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerExpression(int16_t handle, int8_t * expression)
+{
+	WRAP_TRIGGER_EXPRESSION compiled;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PS5000A_CONDITION * conditions = NULL;
+	PICO_STATUS status = PICO_OK;
+	int32_t values[2 * WRAP_TRIGGER_SOURCE_COUNT];
+	int16_t nConditions = 0;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	status = compileTriggerExpression((const char *) expression, &compiled);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (wrapUnitInfo->appliedExpressionValid && wrapUnitInfo->appliedExpression.nTerms == compiled.nTerms &&
+		memcmp(wrapUnitInfo->appliedExpression.terms, compiled.terms, compiled.nTerms * sizeof(WRAP_TRIGGER_TERM)) == 0)
+	{
+		return PICO_OK;
+	}
+
+	status = getTriggerArena(handle, WRAP_TRIGGER_SOURCE_COUNT, sizeof(PS5000A_CONDITION), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->appliedExpressionValid = FALSE;
+	wrapUnitInfo->triggerCache[WRAP_TRIGGER_CACHE_CONDITIONS].valid = FALSE;
+
+	for (i = 0; i < compiled.nTerms && status == PICO_OK; i++)
+	{
+		nConditions = writeTriggerTerm(compiled.terms[i], values);
+
+		for (j = 0; j < nConditions; j++)
+		{
+			conditions[j].source = (PS5000A_CHANNEL) values[2 * j];
+			conditions[j].condition = (PS5000A_TRIGGER_STATE) values[2 * j + 1];
+		}
+
+		if (nConditions == 0)
+		{
+			// Always true - switch triggering off
+			status = ps5000aSetTriggerChannelConditionsV2(handle, conditions, 0, PS5000A_CLEAR);
+		}
+		else
+		{
+			status = ps5000aSetTriggerChannelConditionsV2(handle, conditions, nConditions, 
+				(PS5000A_CONDITIONS_INFO) (i == 0 ? (PS5000A_CLEAR | PS5000A_ADD) : PS5000A_ADD));
+		}
+	}
+
+	if (status != PICO_OK)
+	{
+		// i is one past the set that was rejected
+		if (i > 1)
+		{
+			// Do not leave a partly applied expression armed
+			ps5000aSetTriggerChannelConditionsV2(handle, conditions, 0, PS5000A_CLEAR);
+		}
+
+		return status;
+	}
+
+	wrapUnitInfo->appliedExpression = compiled;
+	wrapUnitInfo->appliedExpressionValid = TRUE;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* setStreamingRingMode
+*
+* Enables or disables ring buffer streaming mode. In this mode each 
+* application buffer registered using setAppAndDriverBuffers or 
+* setMaxMinAppAndDriverBuffers is treated as a ring of ringLength samples. 
+* The streaming callback writes new data at the ring write cursor, wrapping 
+* around at the end of the buffer, so that the application buffers do not 
+* need to be as large as the whole acquisition.
+*
+* The application reads the data between the read and write cursors (modulo
+* ringLength) and then calls advanceRingReadCursor. If the application falls
+* more than ringLength samples behind, the oldest data is overwritten, the
+* read cursor reported by getRingBufferCursors skips the lost samples and 
+* the overrun count is increased.
+*
+* While ring mode is enabled, the startIndex returned by AvailableData is the
+* position in the ring buffers of the first sample of the latest block.
+*
+* Calling this function resets the cursors and the overrun count, so it 
+* should be called before ps5000aRunStreaming.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* conditionsArray - an array of integer values specifying the conditions 
-*					for each channel.
-* nConditions - the number that will be passed after the wrapper code has 
-* created its structures. (i.e. the number of conditionsArray elements / 7)
+* enable - 1 to enable ring mode, 0 to disable it.
+* ringLength - the length of every application buffer in samples. Each 
+*							application buffer must be at least this long. Ignored if
+*							enable is 0.
 *
-* Returns:
+* Buffers set while ring mode is enabled must also be at least ringLength
+* samples long.
 *
-* PICO_OK or other code from PicoStatus.h
+* Returns:
 *
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if enable is set and ringLength is 0 or greater 
+*						than the length of a registered application buffer
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions)
+extern PICO_STATUS PREF0 PREF1 setStreamingRingMode(int16_t handle, int16_t enable, uint32_t ringLength)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
-
-	PS5000A_TRIGGER_CONDITIONS *conditions = (PS5000A_TRIGGER_CONDITIONS *) calloc (nConditions, sizeof(PS5000A_TRIGGER_CONDITIONS));
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
 
-	for (i = 0; i < nConditions; i++)
+	if (status != PICO_OK)
 	{
-		conditions[i].channelA				= (PS5000A_TRIGGER_STATE) conditionsArray[j];
-		conditions[i].channelB				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 1];
-		conditions[i].channelC				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 2];
-		conditions[i].channelD				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 3];
-		conditions[i].external				= (PS5000A_TRIGGER_STATE) conditionsArray[j + 4];
-		conditions[i].aux					= (PS5000A_TRIGGER_STATE) conditionsArray[j + 5];
-		conditions[i].pulseWidthQualifier	= (PS5000A_TRIGGER_STATE) conditionsArray[j + 6];
+		return status;
+	}
 
-		j = j + 7;
+	if (enable && (ringLength == 0 || !isRingLengthValid(&wrapUnitInfo->wrapBufferInfo, ringLength)))
+	{
+		return PICO_INVALID_PARAMETER;
 	}
-	status = ps5000aSetTriggerChannelConditions(handle, conditions, nConditions);
-	free (conditions);
 
-	return status;
+	wrapUnitInfo->ringMode = enable ? 1 : 0;
+	wrapUnitInfo->ringLength = enable ? ringLength : 0;
+	WRAP_STORE_UINT64(&wrapUnitInfo->ringWriteCursor, 0);
+	WRAP_STORE_UINT64(&wrapUnitInfo->ringReadCursor, 0);
+	WRAP_STORE_UINT64(&wrapUnitInfo->ringOverrunCount, 0);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetTriggerProperties
+* getRingBufferCursors
 *
-* NOTE: This function is deprecated - use SetTriggerPropertiesV2 instead.
-* 
-* This function is used to enable or disable triggering and set its 
-* parameters by means of assigning the values from the propertiesArray to an 
-* array of TRIGGER_CHANNEL_PROPERTIES structures which are then passed to 
-* the ps5000aSetTriggerChannelProperties function with the other parameters.
-
-* Use this function with programming languages that do not support structs.
+* Returns the ring buffer cursors when streaming in ring buffer mode. The 
+* cursors are 64-bit sample counts from the start of the capture, so they 
+* do not wrap. The index into the application buffers for a cursor value is 
+* the cursor modulo the ring length.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* propertiesArray - an array of sets of integers corresponding to 
-*					TRIGGER_CHANNEL_PROPERTIES structures describing the 
-*					required properties to be set. See also channelProperties
-*					in ps5000aSetTriggerChannelProperties.
+* writeCursor - on exit, the total number of samples written to the rings.
+* readCursor - on exit, the total number of samples consumed by the 
+*							application or skipped due to overrun.
+* overrunCount - on exit, the total number of samples overwritten before the
+*								application read them.
 *
-* nProperties - the number that will be passed after the wrapper code has 
-*				created its structures. (i.e. the number of propertiesArray 
-*				elements / 6)
-* autoTrig - see autoTriggerMilliseconds in ps5000aSetTriggerChannelProperties.
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 getRingBufferCursors(int16_t handle, uint64_t * writeCursor, uint64_t * readCursor, uint64_t * overrunCount)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+	uint64_t currentWriteCursor = 0;
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	currentWriteCursor = WRAP_LOAD_UINT64(&wrapUnitInfo->ringWriteCursor);
+
+	if (writeCursor != NULL)
+	{
+		*writeCursor = currentWriteCursor;
+	}
+
+	if (readCursor != NULL)
+	{
+		*readCursor = getRingReadCursor(wrapUnitInfo, currentWriteCursor);
+	}
+
+	if (overrunCount != NULL)
+	{
+		*overrunCount = WRAP_LOAD_UINT64(&wrapUnitInfo->ringOverrunCount);
+	}
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* advanceRingReadCursor
 *
+* Marks samples in the ring buffers as read, so that they may be overwritten
+* without being counted as an overrun. nSamples is counted from the read 
+* cursor returned by getRingBufferCursors.
 *
-* Returns:
+* Input Arguments:
 *
-* PICO_OK or other code from PicoStatus.h
+* handle - the handle of the required device.
+* nSamples - the number of samples the application has consumed.
+*
+* Returns:
 *
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if nSamples would move the read cursor past the 
+*													write cursor
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(
-	int16_t handle, 
-	int32_t *propertiesArray, 
-	int16_t nProperties, 
-	int32_t autoTrig)
+extern PICO_STATUS PREF0 PREF1 advanceRingReadCursor(int16_t handle, uint32_t nSamples)
 {
-	PS5000A_TRIGGER_CHANNEL_PROPERTIES *channelProperties = (PS5000A_TRIGGER_CHANNEL_PROPERTIES *) calloc(nProperties, sizeof(PS5000A_TRIGGER_CHANNEL_PROPERTIES));
-	int16_t i;
-	int16_t j=0;
-	int16_t auxEnable = 0;
-	PICO_STATUS status;
-	
-	for (i = 0; i < nProperties; i++)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+	uint64_t writeCursor = 0;
+	uint64_t readCursor = 0;
+
+	if (status != PICO_OK)
 	{
-		channelProperties[i].thresholdUpper				= propertiesArray[j];
-		channelProperties[i].thresholdUpperHysteresis	= propertiesArray[j + 1];
-		channelProperties[i].thresholdLower				= propertiesArray[j + 2];
-		channelProperties[i].thresholdLowerHysteresis	= propertiesArray[j + 3];
-		channelProperties[i].channel					= (PS5000A_CHANNEL) propertiesArray[j + 4];
-		channelProperties[i].thresholdMode				= (PS5000A_THRESHOLD_MODE) propertiesArray[j + 5];
+		return status;
+	}
 
-		j = j + 6;
+	writeCursor = WRAP_LOAD_UINT64(&wrapUnitInfo->ringWriteCursor);
+	readCursor = getRingReadCursor(wrapUnitInfo, writeCursor);
+
+	if (readCursor + nSamples > writeCursor)
+	{
+		return PICO_INVALID_PARAMETER;
 	}
-	status = ps5000aSetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
-	free(channelProperties);
-	
-	return status;
+
+	WRAP_STORE_UINT64(&wrapUnitInfo->ringReadCursor, readCursor + nSamples);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetPulseWidthQualifier
+* DrainStreamingEvents
 *
-* This function is used to enable pulse-width triggering and set 
-* its parameters by means of assigning the values from the pwqConditionsArray 
-* to an array of PS5000A_PWQ_CONDITIONS structures which are then passed to 
-* the ps5000aSetPulseWidthQualifier function with the other parameters.
-
-* Use this function with programming languages that do not support structs.
+* Returns the records of all streaming callbacks received since the last call
+* to this function, oldest first, in a single call. Unlike AvailableData and 
+* IsTriggerReady, which only report the latest callback, no callback 
+* information is lost if the application polls slowly, provided the queue of
+* 1024 records does not fill up.
+*
+* Each record is returned as 8 consecutive values in the events array:
+*
+* [0] numSamples - the number of samples collected.
+* [1] startIndex - an index to the first valid sample in the buffer.
+* [2] triggered - non-zero if a trigger occurred.
+* [3] triggeredAt - the index of the trigger point relative to startIndex.
+* [4] overflow - overvoltage flags, bit 0 denoting channel A.
+* [5] autoStop - non-zero if streaming has autostopped.
+* [6] timestamp (low 32 bits) - host time in microseconds when the callback
+*		was received.
+* [7] timestamp (high 32 bits).
+*
+* See also ps5000aStreamingReady for a description of the callback parameters.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* pwqConditionsArray - an array of sets of integers corresponding to 
-*					PS5000A_PWQ_CONDITIONS structures describing the 
-*					required properties to be set. See also conditions
-*					in ps5000aSetPulseWidthQualifier.
+* events - an array of at least maxEvents * 8 elements.
+* maxEvents - the maximum number of records to return.
+* nEvents - on exit, the number of records copied into events.
+* droppedEvents - on exit, the number of records that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
-* nConditions - the number that will be passed after the wrapper code has 
-*				created its structures. (i.e. the number of conditionsArray 
-*				elements / 6)
+* Returns:
 *
-* direction - the direction of the signal required for the pulse width
-*				trigger to fire (See PS5000A_THRESHOLD_DIRECTION constants)
-* lower - the lower limit of the pulse-width counter with relation to
-			number of samples captured on the device.
-* upper - the upper limit of the pulse-width counter with relation to
-*			number of samples captured on the device.
-* type - the pulse-width type (see ps5000aSetPulseWidthQualifier).
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if events or nEvents is NULL
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents(int16_t handle, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (events == NULL || nEvents == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	drainStreamingEventQueue(&wrapUnitInfo->eventQueue, events, maxEvents, nEvents, droppedEvents);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* DrainTriggerLog
 *
-* Returns:
+* Returns the triggers reported by the streaming callback since the last 
+* call to this function, oldest first. Every trigger is kept until it is
+* read, provided the log of 4096 records does not fill up, so unlike 
+* IsTriggerReady no trigger is lost if the application polls slowly, and 
+* ClearTriggerReady has no effect on the log.
 *
-* PICO_OK or other code from PicoStatus.h
+* Each record is returned as 2 consecutive values in the triggers array:
 *
+* [0] sampleIndex - the index of the trigger point counted from the first 
+*		sample received after resetTriggerLog (or after the wrapper state 
+*		was created). It counts every sample passed to the streaming 
+*		callback (aggregated samples if aggregation is used) and does not
+*		wrap or depend on the size of the driver buffers.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received, on the same clock as the timestamps 
+*		returned by DrainStreamingEvents.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* triggers - an array of at least maxTriggers * 2 elements.
+* maxTriggers - the maximum number of records to return.
+* nTriggers - on exit, the number of records copied into triggers.
+* droppedTriggers - on exit, the number of triggers that have been 
+*					discarded because the log was full since the last call 
+*					to this function. May be NULL.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if triggers or nTriggers is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(
-	int16_t handle,
-	int32_t *pwqConditionsArray,
-	int16_t nConditions,
-	int32_t direction,
-	uint32_t lower,
-	uint32_t upper,
-	int32_t type)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog(int16_t handle, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, uint32_t * droppedTriggers)
 {
-	// Allocate memory
-	PS5000A_PWQ_CONDITIONS *pwqConditions = (PS5000A_PWQ_CONDITIONS *) calloc(nConditions, sizeof(PS5000A_PWQ_CONDITIONS));
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	int16_t i;
-	int16_t j = 0;
-
-	PICO_STATUS status;
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
-	for (i = 0; i < nConditions; i++)
+	if (triggers == NULL || nTriggers == NULL)
 	{
-		pwqConditions[i].channelA = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j];
-		pwqConditions[i].channelB = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 1];
-		pwqConditions[i].channelC = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 2];
-		pwqConditions[i].channelD = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 3];
-		pwqConditions[i].external = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 4];
-		pwqConditions[i].aux      = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 5];
+		return PICO_INVALID_PARAMETER;
+	}
 
-		j = j + 6;
+	drainTriggerLog(&wrapUnitInfo->triggerLog, triggers, maxTriggers, nTriggers, droppedTriggers);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* resetTriggerLog
+*
+* Discards any triggers in the trigger log and restarts the sample count 
+* used for trigger positions from zero. Call this function before 
+* ps5000aRunStreaming, while the device is not streaming, so that trigger
+* positions are counted from the start of the capture.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
 	}
 
-	status = ps5000aSetPulseWidthQualifier(handle, pwqConditions, nConditions, (PS5000A_THRESHOLD_DIRECTION) direction, lower, upper, (PS5000A_PULSE_WIDTH_TYPE) type);
-	free(pwqConditions);
-	return status;
+	wrapUnitInfo->triggerLog.sampleCount = 0;
+	wrapUnitInfo->triggerLog.readIndex = wrapUnitInfo->triggerLog.writeIndex;
+	wrapUnitInfo->triggerLog.reportedDroppedRecords = wrapUnitInfo->triggerLog.droppedRecords;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setChannelCount
+* releaseWrapUnitInfo
 *
-* Sets the number of analogue channels and digital ports on the device.  
-* copying data in the streaming callback.
+* Frees the wrapper state held for a device. Call this function after
+* ps5000aCloseUnit so that the memory is returned and a device opened later 
+* with the same handle starts from a clean state.
+*
+* The function waits for any call to GetStreamingLatestValues in progress on
+* another thread to return before freeing the state, and a BlockCallback 
+* arriving afterwards finds no state and is ignored.
 *
 * Input Arguments:
 *
-* handle - the device handle.
-* channelCount - not used.
+* handle - the handle of the required device.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the wrapper holds no state for the handle.
+*
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo(int16_t handle)
 {
-  int8_t variant[15];
-	int16_t requiredSize = 0;
-	PICO_STATUS status = PICO_OK;
-	
-	// Obtain the model number
-	status = ps5000aGetUnitInfo(handle, variant, sizeof(variant), &requiredSize, PICO_VARIANT_INFO);
-	
-	if (status == PICO_OK)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (handle <= 0)
 	{
-			// Set the number of analogue channels
-			_channelCount = (int16_t) variant[1];
-			_channelCount = _channelCount - 48; // Subtract ASCII 0 (48)
+		return PICO_INVALID_HANDLE;
+	}
 
-			// Determine if the device is an MSO
-			if (strstr(variant, "MSO") != NULL)
-			{
-				 _digitalPortCount = 2;
-			}
-			else
-			{
-			  _digitalPortCount = 0;
-			}
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	wrapUnitInfo = _wrapUnitInfo[handle];
+	_wrapUnitInfo[handle] = NULL;
+
+	// Wait for any GetStreamingLatestValues call that may still run StreamingCallback with the state
+	while (wrapUnitInfo != NULL && wrapUnitInfo->streamingCallsInProgress > 0)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		SleepConditionVariableSRW(&_wrapUnitInfoCondition, &_wrapUnitInfoLock, INFINITE, 0);
+#else
+		pthread_cond_wait(&_wrapUnitInfoCondition, &_wrapUnitInfoLock);
+#endif
 	}
 
-	return status;
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	freeTriggerCapture(wrapUnitInfo->triggerCapture);
+
+#if !defined(WIN32) && !defined(_WIN64)
+	pthread_mutex_destroy(&wrapUnitInfo->readyLock);
+	pthread_cond_destroy(&wrapUnitInfo->readyCondition);
+	pthread_mutex_destroy(&wrapUnitInfo->snapshotLock);
+	pthread_mutex_destroy(&wrapUnitInfo->softwareTriggerLock);
+	pthread_mutex_destroy(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	free(wrapUnitInfo->triggerArenaOverflow);
+	free(wrapUnitInfo);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setEnabledChannels
+* setChannelScaling
 *
-* Sets the number of enabled analogue channels on the device. This is used to 
-* assist with copying data in the streaming callback.
+* Sets the values used to convert the data for a channel to volts when float 
+* or double application buffers have been set with setAppFloatBuffers or 
+* setAppDoubleBuffers. The values should match those passed to the driver 
+* for the channel, and should be set before streaming starts.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* enabledChannels - an array representing the channel states. This should be 
-*					4 elements in size.
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* range - the PS5000A_RANGE value set for the channel.
+* analogueOffset - the analogue offset in volts set for the channel.
+* maxADCValue - the value returned by ps5000aMaximumValue. Set to 0 to stop 
+*				converting the data for the channel.
+* probeAttenuation - the probe attenuation, e.g. 10 for a x10 probe, or 1 if 
+*				 no probe scaling is required.
 *
 * Returns:
 *
-* PICO_OK if successful,
-* PICO_INVALID_HANDLE if handle <= 0, or 
-* PICO_INVALID_PARAMETER if _channelCount is out of range
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_VOLTAGE_RANGE, if range is not a valid PS5000A_RANGE value
+* PICO_INVALID_PARAMETER, if maxADCValue is negative or probeAttenuation is 
+*							not greater than 0
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+extern PICO_STATUS PREF0 PREF1 setChannelScaling(int16_t handle, int16_t channel, int32_t range, float analogueOffset, int16_t maxADCValue, float probeAttenuation)
 {
-	if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_CHANNEL_SCALING * scaling = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	if (channel < PS5000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+	{
+		return PICO_INVALID_CHANNEL;
+	}
+	else if (range < PS5000A_10MV || range >= PS5000A_MAX_RANGES)
+	{
+		return PICO_INVALID_VOLTAGE_RANGE;
+	}
+	else if (maxADCValue < 0 || probeAttenuation <= 0.0f)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+	else
 	{
-		if (_channelCount > 0 && _channelCount <= PS5000A_MAX_CHANNELS)
+		scaling = &wrapUnitInfo->wrapBufferInfo.scaling[channel];
+
+		scaling->range = range;
+		scaling->analogueOffset = analogueOffset;
+		scaling->maxADCValue = maxADCValue;
+		scaling->probeAttenuation = probeAttenuation;
+
+		if (maxADCValue > 0)
 		{
-			memcpy_s((int16_t *)_enabledChannels, PS5000A_MAX_CHANNELS * sizeof(int16_t), 
-				(int16_t *)enabledChannels, PS5000A_MAX_CHANNELS * sizeof(int16_t));
-			
-			return PICO_OK;
+			scaling->scale = (_rangeMillivolts[range] / 1000.0) * probeAttenuation / maxADCValue;
+			scaling->offset = -(double) analogueOffset * probeAttenuation;
 		}
 		else
 		{
-		  return PICO_INVALID_PARAMETER;
+			scaling->scale = 0.0;
+			scaling->offset = 0.0;
 		}
-	}
 
-	return PICO_INVALID_HANDLE;
+		return PICO_OK;
+	}
 }
 
 /****************************************************************************
-* setAppAndDriverBuffers
+* setAppFloatBuffers
 *
-* Set the application and corresponding driver buffer in order for the 
-* streaming callback to copy the data for the channel/digital port from the 
-* driver buffer to the application buffer.
+* Set the application buffers that the streaming callback writes the data 
+* for a channel into after converting it to volts, using the values set with 
+* setChannelScaling. The buffers are filled from the driver buffers set 
+* with setAppAndDriverBuffers or setMaxMinAppAndDriverBuffers, and must be 
+* the same length.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channel - the channel/ digital port number (should be a PS5000A_CHANNEL 
-*						enumeration value).
-* appBuffer - the application buffer.
-* driverBuffer - the buffer set by the driver.
-* bufferLength - the length of the buffers (the length of the buffers must be
-*								equal).
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if an invalid handle is used, or 
-* PICO_INVALID_CHANNEL if an invalid channel/digital port is used, or
-* PICO_INVALID_PARAMETER if the bufferLength is less than or equal to 0.
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, PS5000A_CHANNEL channel, int16_t * appBuffer, int16_t * driverBuffer, uint32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers(int16_t handle, int16_t channel, float * appMaxBuffer, float * appMinBuffer)
 {
-  // Map port number to internal enumeration for MSO devices.
-	PS5000A_WRAP_DIGITAL_PORT_INDEX portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	if (handle > 0)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		if (bufferLength <= 0)
-		{
-		  return PICO_INVALID_PARAMETER;
-		}
-
-		if (channel == PS5000A_DIGITAL_PORT0 || channel == PS5000A_DIGITAL_PORT1)
-		{
-				if (channel == PS5000A_DIGITAL_PORT0)
-				{
-					portIndex = PS5000A_WRAP_DIGITAL_PORT0;
-				}
-				else
-				{
-					portIndex = PS5000A_WRAP_DIGITAL_PORT1;
-				}
-
-				_wrapBufferInfo.appDigiBuffers[portIndex * 2] = appBuffer;
-				_wrapBufferInfo.driverDigiBuffers[portIndex * 2] = driverBuffer;
-
-				_wrapBufferInfo.digiBufferLengths[portIndex] = bufferLength;
-
-				return PICO_OK;
-		}
-		else if (channel < PS5000A_CHANNEL_A || channel >= PS5000A_MAX_CHANNELS)
+		if (channel < PS5000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
 		{
 			return PICO_INVALID_CHANNEL;
 		}
 		else
 		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
-				
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2 + 1] = appMinBuffer;
 
 			return PICO_OK;
 		}
@@ -677,78 +5479,39 @@ extern PICO_STATUS PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, PS5000A_CH
 }
 
 /****************************************************************************
-* setMaxMinAppAndDriverBuffers
+* setAppDoubleBuffers
 *
-* Set the application and corresponding driver buffers in order for the 
-* streaming callback to copy the data for the channel/digital port from the 
-* driver max and min buffers to the respective application buffers for 
-* aggregated data collection.
+* As setAppFloatBuffers, for double precision application buffers. Float 
+* and double buffers may be set for the same channel.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channel - the channel/digital port number (should be a PS5000A_CHANNEL 
-*						enumeration value).
-* appMaxBuffer - the application max buffer.
-* appMinBuffer - the application min buffer.
-* driverMaxBuffer - the max buffer set by the driver.
-* driverMinBuffer - the min buffer set by the driver.
-* bufferLength - the length of the buffers (the length of the buffers must be
-*								equal).
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if an invalid handle is used, or
-* PICO_INVALID_CHANNEL if an invalid channel/digital port is used, or
-* PICO_INVALID_PARAMETER if the bufferLength is less than or equal to 0.
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, PS5000A_CHANNEL channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, uint32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers(int16_t handle, int16_t channel, double * appMaxBuffer, double * appMinBuffer)
 {
-	// Map port number to internal enumeration for MSO devices.
-	PS5000A_WRAP_DIGITAL_PORT_INDEX portIndex = PS5000A_WRAP_DIGITAL_PORT0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	if (handle > 0)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		if (bufferLength <= 0)
-		{
-				return PICO_INVALID_PARAMETER;
-		}
-
-		if (channel == PS5000A_DIGITAL_PORT0 || channel == PS5000A_DIGITAL_PORT1)
-		{
-				if (channel == PS5000A_DIGITAL_PORT0)
-				{
-						portIndex = PS5000A_WRAP_DIGITAL_PORT0;
-				}
-				else
-				{
-						portIndex = PS5000A_WRAP_DIGITAL_PORT1;
-				}
-
-				_wrapBufferInfo.appDigiBuffers[portIndex * 2] = appMaxBuffer;
-				_wrapBufferInfo.driverDigiBuffers[portIndex * 2] = driverMaxBuffer;
-
-				_wrapBufferInfo.appDigiBuffers[portIndex * 2 + 1] = appMinBuffer;
-				_wrapBufferInfo.driverDigiBuffers[portIndex * 2 + 1] = driverMinBuffer;
-
-				_wrapBufferInfo.digiBufferLengths[portIndex] = bufferLength;
-
-				return PICO_OK;
-		}
-		else if (channel < PS5000A_CHANNEL_A || channel >= PS5000A_MAX_CHANNELS)
+		if (channel < PS5000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
 		{
 			return PICO_INVALID_CHANNEL;
 		}
 		else
 		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
-
-			_wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
-
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2 + 1] = appMinBuffer;
 
 			return PICO_OK;
 		}
@@ -760,418 +5523,853 @@ extern PICO_STATUS PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, PS50
 }
 
 /****************************************************************************
-* setEnabledDigitalPorts
+* setChannelDecimation
 *
-* Set the number of enabled digital ports on the device. This is used to
-* assist with copying data in the streaming callback.
+* Sets up the streaming callback to reduce the data for a channel by a 
+* fixed ratio and write the result to a separate set of application buffers, 
+* alongside the data copied to the buffers set with setAppAndDriverBuffers or 
+* setMaxMinAppAndDriverBuffers. The application buffers are written as rings, 
+* use getDecimatedValues to find the new values. Any partly complete block 
+* and count of values is cleared, so call this before each streaming run.
+* The settings cannot be changed while GetStreamingLatestValues is running 
+* for the device on another thread.
 *
-* This function does not need to be called for non-MSO models.
+* In min/max mode the max and min driver buffers are used if the data is 
+* aggregated, otherwise both values are taken from the one driver buffer. 
+* The other modes use the max (or non-aggregated) driver buffer.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* enabledDigitalPorts - an array representing the digital port states. This
-*												must be 2 elements in size.
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* mode - a WRAP_DECIMATION_MODE value. WRAP_DECIMATION_NONE turns the 
+*		 decimation for the channel off.
+* ratio - the number of samples reduced to each output value.
+* appMaxBuffer - the application buffer for the output values, or the max 
+*				 values in min/max mode.
+* appMinBuffer - the application buffer for the min values in min/max mode. 
+*				 Not used in the other modes and may be NULL.
+* bufferLength - the length of the application buffers.
 *
 * Returns:
 *
 * PICO_OK, if successful
-* PICO_INVALID_HANDLE, if handle is less than or equal to 0
-* PICO_INVALID_PARAMETER, if _digitalPortCount is not 0 or 2
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_PARAMETER, if mode is not valid, or ratio or bufferLength is 0, 
+*							or a buffer needed for the mode is NULL
+* PICO_BUSY, if GetStreamingLatestValues is running for the device
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 setEnabledDigitalPorts(int16_t handle, int16_t * enabledDigitalPorts)
+extern PICO_STATUS PREF0 PREF1 setChannelDecimation(int16_t handle, int16_t channel, int32_t mode, uint32_t ratio, int16_t * appMaxBuffer, 
+	int16_t * appMinBuffer, uint32_t bufferLength)
 {
-		if (handle > 0)
-		{
-				if (_digitalPortCount == 0 || _digitalPortCount == PS5000A_WRAP_MAX_DIGITAL_PORTS)
-				{
-						memcpy_s((int16_t *) _enabledDigitalPorts, PS5000A_WRAP_MAX_DIGITAL_PORTS * sizeof(int16_t),
-								(int16_t *) enabledDigitalPorts, PS5000A_WRAP_MAX_DIGITAL_PORTS * sizeof(int16_t));
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DECIMATION_INFO * decimation = NULL;
 
-						return PICO_OK;
-				}
-				else
-				{
-						return PICO_INVALID_PARAMETER;
-				}
-		}
-		else
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	if (channel < PS5000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+	{
+		return PICO_INVALID_CHANNEL;
+	}
+
+	if (mode < WRAP_DECIMATION_NONE || mode > WRAP_DECIMATION_EVERY_NTH)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if (mode != WRAP_DECIMATION_NONE)
+	{
+		if (ratio == 0 || bufferLength == 0 || appMaxBuffer == NULL || (mode == WRAP_DECIMATION_MIN_MAX && appMinBuffer == NULL))
 		{
-				return PICO_INVALID_HANDLE;
+			return PICO_INVALID_PARAMETER;
 		}
+	}
+
+	decimation = &wrapUnitInfo->wrapBufferInfo.decimation[channel];
+
+	// Holding the lock stops a streaming call starting while the settings change
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	if (wrapUnitInfo->streamingCallsInProgress > 0)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+		pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+		return PICO_BUSY;
+	}
+
+	decimation->mode = mode;
+	decimation->ratio = ratio;
+	decimation->appMaxBuffer = appMaxBuffer;
+	decimation->appMinBuffer = appMinBuffer;
+	decimation->bufferLength = bufferLength;
+	WRAP_STORE_UINT64(&decimation->writeCount, 0);
+	decimation->readCount = 0;
+	resetDecimationBlock(decimation);
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getOverflow
+* getDecimatedValues
 *
-* Returns indication if there has been an overvoltage on one or more 
-* analogue inputs when collecting data in streaming mode.
+* Returns the position of the decimated values written for a channel since 
+* the last call, and marks them as read. The values may wrap around the end 
+* of the application buffers. If more than bufferLength values have been 
+* written, only the most recent bufferLength values are returned.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* overflow - on exit, a set of flags that indicate whether an overvoltage 
-*						has occurred on any of the channels. It is a bit field with 
-*						bit 0 denoting channel A.
+* handle - the device handle.
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* startIndex - on exit, the index in the application buffers of the first 
+*				new value.
+* noOfValues - on exit, the number of new values.
 *
 * Returns:
 *
-* PICO_OK, if successful, or
-* PICO_INVALID_HANDLE if handle is less than or equal to 0
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_PARAMETER, if startIndex or noOfValues is NULL, or decimation 
+*							is not set up for the channel
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getOverflow(int16_t handle, int16_t * overflow)
+extern PICO_STATUS PREF0 PREF1 getDecimatedValues(int16_t handle, int16_t channel, uint32_t * startIndex, uint32_t * noOfValues)
 {
-  if (handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DECIMATION_INFO * decimation = NULL;
+	uint64_t writeCount = 0;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		*overflow = _overflow;
-		return PICO_OK;
+		return PICO_INVALID_HANDLE;
 	}
-	else
+
+	if (channel < PS5000A_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
 	{
-		return PICO_INVALID_HANDLE;
+		return PICO_INVALID_CHANNEL;
+	}
+
+	decimation = &wrapUnitInfo->wrapBufferInfo.decimation[channel];
+
+	if (startIndex == NULL || noOfValues == NULL || decimation->mode == WRAP_DECIMATION_NONE)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// A single 64-bit load, so the count cannot be torn on a 32-bit build
+	writeCount = WRAP_LOAD_UINT64(&decimation->writeCount);
+
+	if (writeCount - decimation->readCount > decimation->bufferLength)
+	{
+		decimation->readCount = writeCount - decimation->bufferLength;
 	}
+
+	*startIndex = (uint32_t) (decimation->readCount % decimation->bufferLength);
+	*noOfValues = (uint32_t) (writeCount - decimation->readCount);
+
+	decimation->readCount = writeCount;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetTriggerConditionsV2
+* setNonTemporalCopyThreshold
 *
-* This function sets up trigger conditions on the scope's inputs. The trigger
-* is defined by one or more sets of integers corresponding to
-* PS5000A_CONDITION structures which are then converted and passed
-* to the ps5000aSetTriggerChannelConditionsV2 function.
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
 *
-* Use this function with programming languages that do not support structs.
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* conditionsArray - an array of integer values specifying the conditions
-*										for each channel.
-* nConditions - the number that will be passed after the wrapper code has
-*								created its structures (i.e. the number of conditionsArray 
-*								elements / 2). Set to 0 to switch off triggering.
-* info - see ps5000aSetTriggerChannelConditionsV2
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK.
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerConditionsV2(int16_t handle, int32_t *conditionsArray, int16_t nConditions, PS5000A_CONDITIONS_INFO info)
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
-
-	PS5000A_CONDITION *conditions = (PS5000A_CONDITION *)calloc(nConditions, sizeof(PS5000A_CONDITION));
-
-	for (i = 0; i < nConditions; i++)
-	{
-		conditions[i].source = (PS5000A_CHANNEL)conditionsArray[j];
-		conditions[i].condition = (PS5000A_TRIGGER_STATE)conditionsArray[j + 1];
-
-		j = j + 2;
-	}
-	status = ps5000aSetTriggerChannelConditionsV2(handle, conditions, nConditions, info);
-	free(conditions);
+	_nonTemporalCopyThreshold = thresholdBytes;
 
-	return status;
+	return PICO_OK;
 }
 
-
 /****************************************************************************
-* SetTriggerDirectionsV2
+* GetStreamingSnapshot
 *
-* This function sets the direction of the trigger for each channel. The 
-* directions are defined by one or more sets of integers corresponding to
-* PS5000A_DIRECTION structures which are then converted and passed to the 
-* ps5000aSetTriggerChannelDirectionsV2 function.
+* Returns the streaming status from the latest streaming callback in one 
+* call. Unlike separate calls to AvailableData, IsTriggerReady, AutoStopped
+* and getOverflow, which can see values written by different callbacks,
+* all of the values come from the same callback. The function does not 
+* block the streaming callback.
 *
-* Use this function with programming languages that do not support structs.
+* The values are written to the snapshot array in the order:
+*
+* [0] ready - non-zero if data is available, as returned by IsReady. This 
+*		is cleared by GetStreamingLatestValues and RunBlock.
+* [1] numSamples - the number of samples collected.
+* [2] startIndex - an index to the first valid sample in the buffer.
+* [3] triggered - non-zero if a trigger occurred.
+* [4] triggeredAt - the index of the trigger point relative to startIndex.
+* [5] overflow - overvoltage flags, bit 0 denoting channel A.
+* [6] autoStop - non-zero if streaming has autostopped.
+* [7] callbackCount - the number of streaming callbacks received for the 
+*		device, which can be used to tell whether the data is new.
+*
+* ClearTriggerReady does not change the snapshot.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* directionsArray - an array of integer values specifying the directions
-*										for each channel.
-* nConditions - the number that will be passed after the wrapper code has
-*								created its structures (i.e. the number of directionsArray
-*								elements / 3). 
+* snapshot - an array of at least 8 elements.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if snapshot is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerDirectionsV2(int16_t handle, int32_t * directionsArray, int16_t nDirections)
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot(int16_t handle, uint32_t * snapshot)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_SNAPSHOT copy;
+	uint32_t sequence = 0;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	PS5000A_DIRECTION *directions = (PS5000A_DIRECTION *)calloc(nDirections, sizeof(PS5000A_DIRECTION));
-
-	for (i = 0; i < nDirections; i++)
+	if (status != PICO_OK)
 	{
-		directions[i].source = (PS5000A_CHANNEL) directionsArray[j];
-		directions[i].direction = (PS5000A_THRESHOLD_DIRECTION) directionsArray[j + 1];
-		directions[i].mode = (PS5000A_THRESHOLD_MODE) directionsArray[j + 2];
+		return status;
+	}
 
-		j = j + 3;
+	if (snapshot == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
 	}
 
-	status = ps5000aSetTriggerChannelDirectionsV2(handle, directions, (uint16_t)nDirections);
-	free(directions);
+	// Read again if the callback was writing the snapshot
+	do
+	{
+		sequence = wrapUnitInfo->snapshot.sequence;
+		WRAP_MEMORY_BARRIER();
 
-	return status;
-}
+		copy = wrapUnitInfo->snapshot;
 
-/****************************************************************************
-* SetTriggerPropertiesV2
-*
-* This function is used to enable or disable triggering and set its
-* parameters by means of assigning the values from the propertiesArray to an
-* array of PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 structures which are then 
-* passed to the ps5000aSetTriggerChannelPropertiesV2 function with the other
-* parameters.
+		WRAP_MEMORY_BARRIER();
+	}
+	while ((sequence & 1) != 0 || wrapUnitInfo->snapshot.sequence != sequence);
+
+	snapshot[0] = (uint32_t) copy.ready;
+	snapshot[1] = copy.numSamples;
+	snapshot[2] = copy.startIndex;
+	snapshot[3] = (uint32_t) copy.triggered;
+	snapshot[4] = copy.triggeredAt;
+	snapshot[5] = (uint32_t) (uint16_t) copy.overflow;
+	snapshot[6] = (uint32_t) copy.autoStop;
+	snapshot[7] = copy.callbackCount;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* clearTriggerCache
 *
-* Use this function with programming languages that do not support structs.
+* Clears the trigger settings held by the wrapper for a device, so the next
+* call to SetTriggerConditionsV2, SetTriggerDirectionsV2 and 
+* SetTriggerPropertiesV2 is passed to the driver even if the values have not
+* changed. Call this function after setting the trigger with the driver 
+* functions directly (e.g. ps5000aSetSimpleTrigger), or after the device has
+* been closed and opened again without calling releaseWrapUnitInfo.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* propertiesArray - an array of sets of integers corresponding to
-*					PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 structures describing the
-*					required properties to be set. See also channelProperties
-*					in ps5000aSetTriggerChannelPropertiesV2.
-*
-* nProperties - the number that will be passed after the wrapper code has
-*								created its structures. (i.e. the number of propertiesArray
-*								elements / 5)
-*
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the wrapper holds no state for the handle.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerPropertiesV2(int16_t handle, int32_t *propertiesArray, int16_t nProperties)
+extern PICO_STATUS PREF0 PREF1 clearTriggerCache(int16_t handle)
 {
-	int16_t i;
-	int16_t j = 0;
-	int16_t auxEnable = 0;
-	PICO_STATUS status;
-
-	PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 *channelProperties = (PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2 *)calloc(nProperties, sizeof(PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2));
-
-	for (i = 0; i < nProperties; i++)
+	if (handle <= 0 || _wrapUnitInfo[handle] == NULL)
 	{
-		channelProperties[i].thresholdUpper = propertiesArray[j];
-		channelProperties[i].thresholdUpperHysteresis = propertiesArray[j + 1];
-		channelProperties[i].thresholdLower = propertiesArray[j + 2];
-		channelProperties[i].thresholdLowerHysteresis = propertiesArray[j + 3];
-		channelProperties[i].channel = (PS5000A_CHANNEL) propertiesArray[j + 4];
-
-		j = j + 5;
+		return PICO_INVALID_HANDLE;
 	}
 
-	status = ps5000aSetTriggerChannelPropertiesV2(handle, channelProperties, nProperties, auxEnable);
-	free(channelProperties);
+	invalidateTriggerCache(_wrapUnitInfo[handle]);
 
-	return status;
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetTriggerDigitalPortProperties
-*
-* This function is used to set the individual digital channels' trigger 
-* directions by means of assigning the values from the digitalDirections 
-* array to an array of PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures 
-* which are then passed to the ps5000aSetTriggerDigitalPortProperties 
-* function with the other parameters.
-*
-* Use this function with programming languages that do not support structs.
+* setTriggerCapture
+*
+* Sets up the capture of a window of samples around each trigger reported 
+* while streaming, so that the application does not need to keep the whole
+* stream to see the samples before a trigger. The streaming callback keeps 
+* a history of the last preTriggerSamples samples of each channel and, for 
+* each trigger, assembles a record of preTriggerSamples samples before the
+* trigger point followed by postTriggerSamples samples from the trigger 
+* point on. Completed records are read with DrainTriggerCaptures.
+*
+* The channels enabled when this function is called are captured, from the
+* driver buffers (the max buffers if aggregation is used), which must be 
+* set before streaming starts. Each record holds the window for each 
+* captured channel in turn, in channel order.
+*
+* This function may be called while the device is streaming; the new 
+* capture starts with the next streaming callback, without any history. 
+* Any records not yet read are discarded. Call with maxRecords set to 0 to 
+* stop capturing and free the buffers.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* digitalDirections - an array of sets of integers corresponding to
-*											PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures 
-*											describing the required properties to be set. See 
-*											also directions in ps5000aSetTriggerDigitalPortProperties.
-*
-* nDirections - the number that will be passed after the wrapper code has
-*								created its structures. (i.e. the number of 
-*								digitalDirections elements / 2)
+* preTriggerSamples - the number of samples before the trigger point in 
+*						each record.
+* postTriggerSamples - the number of samples from the trigger point on in
+*						each record.
+* maxRecords - the number of completed records that can be held until 
+*				they are read. Triggers that arrive while the queue is full
+*				are dropped.
+* recordLength - on exit, the number of samples in each record (the window
+*				length multiplied by the number of captured channels). May
+*				be NULL.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if maxRecords is not 0 and the window is empty or
+*						no channels are enabled
+* PICO_MEMORY_FAIL, if the buffers could not be allocated
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerDigitalPortProperties(int16_t handle, int32_t *digitalDirections, int16_t nDirections)
+extern PICO_STATUS PREF0 PREF1 setTriggerCapture(int16_t handle, uint32_t preTriggerSamples, uint32_t postTriggerSamples, uint32_t maxRecords, 
+	uint32_t * recordLength)
 {
-	int16_t i;
-	int16_t j = 0;
-	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_TRIGGER_CAPTURE * capture = NULL;
+	uint64_t windowLength = (uint64_t) preTriggerSamples + postTriggerSamples;
+	int16_t channel = 0;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
-	PS5000A_DIGITAL_CHANNEL_DIRECTIONS *directions = (PS5000A_DIGITAL_CHANNEL_DIRECTIONS *)calloc(nDirections, sizeof(PS5000A_DIGITAL_CHANNEL_DIRECTIONS));
+	// Remove the old capture under the lock, so the callback and DrainTriggerCaptures are not using it when it is freed
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->triggerCaptureLock);
+#endif
 
-	for (i = 0; i < nDirections; i++)
+	capture = wrapUnitInfo->triggerCapture;
+	wrapUnitInfo->triggerCapture = NULL;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	freeTriggerCapture(capture);
+	capture = NULL;
+
+	if (recordLength != NULL)
 	{
-		directions[i].channel = digitalDirections[j];
-		directions[i].direction = digitalDirections[j + 1];
+		*recordLength = 0;
+	}
 
-		j = j + 2;
+	if (maxRecords == 0)
+	{
+		return PICO_OK;
 	}
 
-	status = ps5000aSetTriggerDigitalPortProperties(handle, directions, nDirections);
-	free(directions);
+	if (windowLength == 0)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
 
-	return status;
+	capture = (WRAP_TRIGGER_CAPTURE *) calloc(1, sizeof(WRAP_TRIGGER_CAPTURE));
+
+	if (capture == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	for (channel = (int16_t) PS5000A_CHANNEL_A; channel < wrapUnitInfo->channelCount && channel < PS5000A_MAX_CHANNELS; channel++)
+	{
+		if (wrapUnitInfo->enabledChannels[channel])
+		{
+			capture->channels[capture->nChannels++] = channel;
+		}
+	}
+
+	if (capture->nChannels == 0)
+	{
+		free(capture);
+		return PICO_INVALID_PARAMETER;
+	}
+
+	// Each record must be addressable with a 32-bit sample count
+	if (windowLength * capture->nChannels > 0xFFFFFFFF || windowLength * capture->nChannels * maxRecords > (uint64_t) ((size_t) -1 / sizeof(int16_t)))
+	{
+		free(capture);
+		return PICO_MEMORY_FAIL;
+	}
+
+	capture->preTriggerSamples = preTriggerSamples;
+	capture->postTriggerSamples = postTriggerSamples;
+	capture->windowLength = (uint32_t) windowLength;
+	capture->recordLength = capture->windowLength * capture->nChannels;
+	capture->maxRecords = maxRecords;
+
+	capture->history = (preTriggerSamples > 0) ? (int16_t *) calloc((size_t) preTriggerSamples * capture->nChannels, sizeof(int16_t)) : NULL;
+	capture->recordData = (int16_t *) calloc((size_t) capture->recordLength * maxRecords, sizeof(int16_t));
+	capture->records = (WRAP_TRIGGER_CAPTURE_RECORD *) calloc(maxRecords, sizeof(WRAP_TRIGGER_CAPTURE_RECORD));
+
+	if ((preTriggerSamples > 0 && capture->history == NULL) || capture->recordData == NULL || capture->records == NULL)
+	{
+		freeTriggerCapture(capture);
+		return PICO_MEMORY_FAIL;
+	}
+
+	if (recordLength != NULL)
+	{
+		*recordLength = capture->recordLength;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	wrapUnitInfo->triggerCapture = capture;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetPulseWidthQualifierConditions
+* DrainTriggerCaptures
 *
-* This function applies a condition to the pulse-width qualifier. The condition
-* is defined by one or more sets of integers corresponding to
-* PS5000A_CONDITION structures which are then converted and passed
-* to the ps5000aSetPulseWidthQualifierConditions function.
+* Returns the records completed by the trigger capture set up with 
+* setTriggerCapture since the last call to this function, oldest first.
 *
-* Use this function with programming languages that do not support structs.
+* Each record is copied into data as recordLength samples (see 
+* setTriggerCapture): for each captured channel in channel order, the 
+* preTriggerSamples samples before the trigger point followed by the 
+* postTriggerSamples samples from the trigger point on. If triggers is not
+* NULL, 2 values are written to it for each record:
+*
+* [0] sampleIndex - the index of the trigger point, as returned by 
+*		DrainTriggerLog.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received.
+*
+* The streaming callback waits for the records to be copied before it 
+* updates the capture, so keep maxRecords small at high sample rates.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* pwqConditionsArray - an array of integer values specifying the conditions
-*										for each channel.
-* nConditions - the number that will be passed after the wrapper code has
-*								created its structures (i.e. the number of pwqConditionsArray
-*								elements / 2). Set to 0 to switch off the pulse-width qualifier.
-* info - see ps5000aSetPulseWidthQualifierConditions
+* data - an array of at least maxRecords * recordLength elements.
+* triggers - an array of at least maxRecords * 2 elements. May be NULL.
+* maxRecords - the maximum number of records to return.
+* nRecords - on exit, the number of records copied.
+* droppedRecords - on exit, the number of triggers that have been dropped
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if data or nRecords is NULL, or no trigger capture
+*						has been set up
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierConditions(int16_t handle, int32_t *pwqConditionsArray, int16_t nConditions, PS5000A_CONDITIONS_INFO info)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerCaptures(int16_t handle, int16_t * data, uint64_t * triggers, uint32_t maxRecords, uint32_t * nRecords, 
+	uint32_t * droppedRecords)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_TRIGGER_CAPTURE * capture = NULL;
+	WRAP_TRIGGER_CAPTURE_RECORD * record = NULL;
+	uint32_t readIndex = 0;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	PS5000A_CONDITION * pwqConditions = (PS5000A_CONDITION *)calloc(nConditions, sizeof(PS5000A_CONDITION));
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
-	for (i = 0; i < nConditions; i++)
+	if (data == NULL || nRecords == NULL)
 	{
-		pwqConditions[i].source = (PS5000A_CHANNEL) pwqConditionsArray[j];
-		pwqConditions[i].condition = (PS5000A_TRIGGER_STATE) pwqConditionsArray[j + 1];
+		return PICO_INVALID_PARAMETER;
+	}
 
-		j = j + 2;
+	// The lock stops setTriggerCapture freeing the capture while the records are copied
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	capture = wrapUnitInfo->triggerCapture;
+
+	if (capture == NULL)
+	{
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+		pthread_mutex_unlock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+		return PICO_INVALID_PARAMETER;
 	}
 
-	status = ps5000aSetPulseWidthQualifierConditions(handle, pwqConditions, nConditions, info);
-	free(pwqConditions);
+	readIndex = capture->readIndex;
+	count = capture->writeIndex - readIndex;
 
-	return status;
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	if (count > maxRecords)
+	{
+		count = maxRecords;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &capture->records[(readIndex + i) % capture->maxRecords];
+
+		memcpy(&data[(size_t) i * capture->recordLength], &capture->recordData[(size_t) ((readIndex + i) % capture->maxRecords) * capture->recordLength],
+			(size_t) capture->recordLength * sizeof(int16_t));
+
+		if (triggers != NULL)
+		{
+			triggers[i * WRAP_TRIGGER_CAPTURE_FIELDS]		= record->sampleIndex;
+			triggers[i * WRAP_TRIGGER_CAPTURE_FIELDS + 1]	= record->timestamp;
+		}
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	capture->readIndex = readIndex + count;
+	*nRecords = count;
+
+	if (droppedRecords != NULL)
+	{
+		dropped = capture->droppedRecords;
+		*droppedRecords = dropped - capture->reportedDroppedRecords;
+		capture->reportedDroppedRecords = dropped;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->triggerCaptureLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->triggerCaptureLock);
+#endif
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetPulseWidthQualifierDirections
-*
-* This function sets the direction ofor all trigger sources used with the 
-* pulse width qualifier. The directions are defined by one or more sets of 
-* integers corresponding to PS5000A_DIRECTION structures which are then 
-* converted and passed to the ps5000aSetPulseWidthQualifierDirections function.
-*
-* Use this function with programming languages that do not support structs.
+* setSoftwareTrigger
+*
+* Sets up a software trigger for a channel. While streaming, the streaming 
+* callback runs the detector over each block of data received for the 
+* channel (the max buffer if aggregation is used) and records every event 
+* found, which can then be read with DrainSoftwareTriggers. Unlike the 
+* hardware trigger, which fires once in a run, the software trigger reports
+* every event. The detector state is kept between callbacks, so events 
+* spanning two blocks are found.
+*
+* The channel must be enabled with setEnabledChannels and have a driver 
+* buffer set. Thresholds are in ADC counts. The trigger types are:
+*
+* WRAP_SOFTWARE_TRIGGER_LEVEL - the signal crosses threshold, rising (from
+*	below threshold to threshold or above), falling, or either. hysteresis
+*	is not used.
+* WRAP_SOFTWARE_TRIGGER_EDGE - as for LEVEL, but the signal must go below 
+*	threshold - hysteresis between a rising and a falling crossing, so 
+*	noise near the threshold does not cause repeated events.
+* WRAP_SOFTWARE_TRIGGER_WINDOW - the signal enters the window from 
+*	threshold to upperThreshold inclusive (going at least hysteresis counts
+*	inside it), exits it, or either.
+* WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH - a positive pulse (from rising to 
+*	falling edge, as for EDGE) or negative pulse (falling to rising) ends,
+*	with a width from minWidth to maxWidth samples inclusive. Set maxWidth
+*	to 0 for no upper limit.
+* WRAP_SOFTWARE_TRIGGER_RUNT - a positive pulse rises to threshold and 
+*	returns below threshold - hysteresis without reaching upperThreshold, 
+*	or a negative pulse falls to upperThreshold and returns above 
+*	upperThreshold + hysteresis without reaching threshold. The width 
+*	limits apply as for PULSE_WIDTH.
+*
+* Events are reported at the sample that completes them. Setting a trigger
+* restarts its detector. Set type to WRAP_SOFTWARE_TRIGGER_NONE to remove 
+* the trigger for the channel. A trigger can be set while streaming; the 
+* new detector is used from the next block received by the streaming 
+* callback.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* pwqDirectionsArray - an array of integer values specifying the directions
-*										for each channel.
-* nConditions - the number that will be passed after the wrapper code has
-*								created its structures (i.e. the number of pwqDirectionsArray
-*								elements / 3).
+* channel - the channel number (should be a PS5000A_CHANNEL enumeration value).
+* type - a WRAP_SOFTWARE_TRIGGER_TYPE value.
+* direction - a WRAP_SOFTWARE_TRIGGER_DIRECTION value. RISING_OR_FALLING 
+*				(ENTER_OR_EXIT) is not valid for pulse width and runt 
+*				triggers.
+* threshold - the threshold, or the lower threshold for window and runt 
+*				triggers.
+* upperThreshold - the upper threshold for window and runt triggers. Must 
+*				be greater than threshold for these types.
+* hysteresis - the hysteresis in ADC counts. For window triggers, twice the
+*				hysteresis must be less than upperThreshold - threshold.
+* minWidth - the minimum pulse width in samples.
+* maxWidth - the maximum pulse width in samples, or 0 for no limit.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if a parameter is out of range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifierDirections(int16_t handle, int32_t * pwqDirectionsArray, int16_t nDirections)
+extern PICO_STATUS PREF0 PREF1 setSoftwareTrigger(int16_t handle, int16_t channel, int16_t type, int16_t direction, int16_t threshold, 
+	int16_t upperThreshold, uint16_t hysteresis, uint32_t minWidth, uint32_t maxWidth)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_SOFTWARE_TRIGGER trigger;
+	int16_t pulse = (type == WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH || type == WRAP_SOFTWARE_TRIGGER_RUNT);
+	int32_t band = (type == WRAP_SOFTWARE_TRIGGER_LEVEL) ? 0 : hysteresis;
+	int32_t lower = threshold;
+	int32_t upper = upperThreshold;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
-	PS5000A_DIRECTION * pwqDirections = (PS5000A_DIRECTION *)calloc(nDirections, sizeof(PS5000A_DIRECTION));
+	if (channel < PS5000A_CHANNEL_A || channel >= PS5000A_MAX_CHANNELS || type < WRAP_SOFTWARE_TRIGGER_NONE || type >= WRAP_SOFTWARE_TRIGGER_TYPES)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
 
-	for (i = 0; i < nDirections; i++)
+	if (type != WRAP_SOFTWARE_TRIGGER_NONE && (direction < WRAP_SOFTWARE_TRIGGER_RISING || direction > WRAP_SOFTWARE_TRIGGER_RISING_OR_FALLING || 
+		(pulse && direction == WRAP_SOFTWARE_TRIGGER_RISING_OR_FALLING) || (maxWidth != 0 && maxWidth < minWidth) ||
+		((type == WRAP_SOFTWARE_TRIGGER_WINDOW || type == WRAP_SOFTWARE_TRIGGER_RUNT) && upperThreshold <= threshold)))
 	{
-		pwqDirections[i].source = (PS5000A_CHANNEL) pwqDirectionsArray[j];
-		pwqDirections[i].direction = (PS5000A_THRESHOLD_DIRECTION) pwqDirectionsArray[j + 1];
-		pwqDirections[i].mode = (PS5000A_THRESHOLD_MODE) pwqDirectionsArray[j + 2];
+		return PICO_INVALID_PARAMETER;
+	}
 
-		j = j + 3;
+	// The signal could never get hysteresis counts inside the window
+	if (type == WRAP_SOFTWARE_TRIGGER_WINDOW && 2 * band >= upper - lower)
+	{
+		return PICO_INVALID_PARAMETER;
 	}
 
-	status = ps5000aSetPulseWidthQualifierDirections(handle, pwqDirections, nDirections);
-	free(pwqDirections);
+	memset(&trigger, 0, sizeof(WRAP_SOFTWARE_TRIGGER));
 
-	return status;
+	trigger.type = type;
+	trigger.direction = direction;
+	trigger.threshold = threshold;
+	trigger.upperThreshold = upperThreshold;
+	trigger.minWidth = minWidth;
+	trigger.maxWidth = maxWidth;
+	trigger.state = WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN;
+
+	switch (type)
+	{
+		case WRAP_SOFTWARE_TRIGGER_LEVEL:
+		case WRAP_SOFTWARE_TRIGGER_EDGE:
+		case WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH:
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN, lower - band, lower - 1, 0);
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_IDLE, lower, INT16_MAX, 1);
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE, INT16_MIN, lower - band - 1, 1);
+			break;
+
+		case WRAP_SOFTWARE_TRIGGER_WINDOW:
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN, 1, 0, 0);
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_IDLE, lower + band, upper - band, 1);
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE, lower, upper, 0);
+			break;
+
+		case WRAP_SOFTWARE_TRIGGER_RUNT:
+			setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN, 1, 0, 0);
+
+			if (direction == WRAP_SOFTWARE_TRIGGER_POSITIVE)
+			{
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_IDLE, lower, INT16_MAX, 1);
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_STARTED, lower - band, upper - 1, 0);
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE, INT16_MIN, lower - band - 1, 1);
+			}
+			else
+			{
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_IDLE, INT16_MIN, upper, 1);
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_STARTED, lower + 1, upper + band, 0);
+				setSoftwareTriggerSearch(&trigger, WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE, upper + band + 1, INT16_MAX, 1);
+			}
+			break;
+	}
+
+	// The streaming callback may be running the detector being replaced
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->softwareTriggerLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->softwareTriggerLock);
+#endif
+
+	if (wrapUnitInfo->softwareTriggers[channel].type == WRAP_SOFTWARE_TRIGGER_NONE && type != WRAP_SOFTWARE_TRIGGER_NONE)
+	{
+		wrapUnitInfo->softwareTriggerCount++;
+	}
+	else if (wrapUnitInfo->softwareTriggers[channel].type != WRAP_SOFTWARE_TRIGGER_NONE && type == WRAP_SOFTWARE_TRIGGER_NONE)
+	{
+		wrapUnitInfo->softwareTriggerCount--;
+	}
+
+	wrapUnitInfo->softwareTriggers[channel] = trigger;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->softwareTriggerLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->softwareTriggerLock);
+#endif
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetPulseWidthDigitalPortProperties
+* DrainSoftwareTriggers
 *
-* This function is used to set the individual digital channels' pulse-width 
-* trigger directions by means of assigning the values from the digitalDirections
-* array to an array of PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures
-* which are then passed to the ps5000aSetSetPulseWidthDigitalPortProperties
-* function with the other parameters.
+* Returns the events found by the software triggers set with 
+* setSoftwareTrigger since the last call to this function, oldest first, 
+* provided the queue of 4096 events does not fill up.
 *
-* Use this function with programming languages that do not support structs.
+* Each event is returned as 3 consecutive values in the events array:
+*
+* [0] sampleIndex - the index of the sample at which the event was 
+*		detected, counted in the same way as the indices returned by 
+*		DrainTriggerLog.
+* [1] channel - the channel on which the event was detected.
+* [2] width - the width in samples of the pulse, for pulse width and runt
+*		triggers, otherwise 0.
+*
+* Events on different channels in the same block are returned channel by 
+* channel, so they are in order of sampleIndex for each channel.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* pwqDigitalDirections - an array of sets of integers corresponding to
-*											PS5000A_DIGITAL_CHANNEL_DIRECTIONS structures
-*											describing the required properties to be set. See
-*											also directions in ps5000aSetPulseWidthDigitalPortProperties.
-*
-* nDirections - the number that will be passed after the wrapper code has
-*								created its structures. (i.e. the number of
-*								pwqDigitalDirections elements / 2)
+* events - an array of at least maxEvents * 3 elements.
+* maxEvents - the maximum number of events to return.
+* nEvents - on exit, the number of events copied into events.
+* droppedEvents - on exit, the number of events that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
 * Returns:
 *
-* PICO_OK or other code from PicoStatus.h
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if events or nEvents is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetPulseWidthDigitalPortProperties(int16_t handle, int32_t *pwqDigitalDirections, int16_t nDirections)
+extern PICO_STATUS PREF0 PREF1 DrainSoftwareTriggers(int16_t handle, uint64_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
 {
-	int16_t i;
-	int16_t j = 0;
-	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_SOFTWARE_TRIGGER_QUEUE * queue = NULL;
+	WRAP_SOFTWARE_TRIGGER_EVENT * event = NULL;
+	uint32_t readIndex = 0;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	PS5000A_DIGITAL_CHANNEL_DIRECTIONS *pwqDirections = (PS5000A_DIGITAL_CHANNEL_DIRECTIONS *)calloc(nDirections, sizeof(PS5000A_DIGITAL_CHANNEL_DIRECTIONS));
+	if (status != PICO_OK)
+	{
+		return status;
+	}
 
-	for (i = 0; i < nDirections; i++)
+	if (events == NULL || nEvents == NULL)
 	{
-		pwqDirections[i].channel = pwqDigitalDirections[j];
-		pwqDirections[i].direction = pwqDigitalDirections[j + 1];
+		return PICO_INVALID_PARAMETER;
+	}
 
-		j = j + 2;
+	queue = &wrapUnitInfo->softwareTriggerQueue;
+	readIndex = queue->readIndex;
+	count = queue->writeIndex - readIndex;
+
+	// Make sure the events are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
 	}
 
-	status = ps5000aSetPulseWidthDigitalPortProperties(handle, pwqDirections, nDirections);
-	free(pwqDirections);
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_SOFTWARE_TRIGGER_QUEUE_SIZE - 1)];
 
-	return status;
-}
\ No newline at end of file
+		events[i * WRAP_SOFTWARE_TRIGGER_FIELDS]		= event->sampleIndex;
+		events[i * WRAP_SOFTWARE_TRIGGER_FIELDS + 1]	= (uint64_t) event->channel;
+		events[i * WRAP_SOFTWARE_TRIGGER_FIELDS + 2]	= event->width;
+	}
+
+	// Make sure the events have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+
+	return PICO_OK;
+}
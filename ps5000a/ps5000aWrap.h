@@ -30,6 +30,15 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+#define WRAP_LOAD_UINT64(p) ((uint64_t) InterlockedCompareExchange64((volatile LONG64 *) (p), 0, 0))
+#define WRAP_STORE_UINT64(p, v) InterlockedExchange64((volatile LONG64 *) (p), (LONG64) (v))
+
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #elif _WIN64
 #include "windows.h"
 #include <stdio.h>
@@ -45,6 +54,15 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+#define WRAP_LOAD_UINT64(p) ((uint64_t) InterlockedCompareExchange64((volatile LONG64 *) (p), 0, 0))
+#define WRAP_STORE_UINT64(p, v) InterlockedExchange64((volatile LONG64 *) (p), (LONG64) (v))
+
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #else
 #include <sys/types.h>
 #include <string.h>
@@ -52,6 +70,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #include <libps5000a-1.1/ps5000aApi.h>
 #ifndef PICO_STATUS
 #include <libps5000a-1.1/PicoStatus.h>
@@ -62,12 +83,50 @@
 #define PREF0
 #define PREF1
 
+#define WRAP_MEMORY_BARRIER() __sync_synchronize()
+#define WRAP_LOAD_UINT64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define WRAP_STORE_UINT64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef pthread_mutex_t WRAP_LOCK;
+typedef pthread_cond_t WRAP_CONDITION;
+#define WRAP_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define WRAP_CONDITION_INIT PTHREAD_COND_INITIALIZER
+
 typedef enum enBOOL
 {
   FALSE, TRUE
 } BOOL;
 #endif
 
+// Instruction set extensions used to convert ADC counts to volts and by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
+
+#define WRAP_DECIMATION_SUM_BLOCK	131072	// Samples summed in 32-bit lanes before moving the total to 64 bits
+
 #define PS5000A_WRAP_MAX_CHANNEL_BUFFERS		(2 * PS5000A_MAX_CHANNELS)
 #define PS5000A_WRAP_MAX_DIGITAL_PORTS			2
 #define PS5000A_WRAP_MAX_DIGITAL_BUFFERS		4  // 4 - Port 0 Max/Min and Port 1 Max/Min
@@ -78,19 +137,63 @@ typedef enum enBOOL
 //
 /////////////////////////////////
 
-extern int16_t		_ready;
-extern int16_t		_autoStop;
-extern uint32_t		_numSamples;
-extern uint32_t		_triggeredAt;
-extern int16_t		_triggered;
-extern uint32_t		_startIndex;				// Start index in driver data buffer
-extern int16_t		_overflow;
+/****************************************************************************
+* tWrapChannelScaling
+*
+* The settings used to convert the ADC counts for a channel to volts. The 
+* scale and offset are calculated from the other fields by setChannelScaling 
+* so that the streaming callback only needs a multiply and an add per sample:
+*
+* volts = counts * scale + offset
+*
+****************************************************************************/
+typedef struct tWrapChannelScaling
+{
+	int32_t		range;				// PS5000A_RANGE value set for the channel
+	float		analogueOffset;		// Analogue offset in volts set for the channel
+	int16_t		maxADCValue;		// Maximum ADC count for the device - 0 disables conversion
+	float		probeAttenuation;	// Multiplier applied to the result, e.g. 10 for a x10 probe
+	double		scale;				// Volts per ADC count
+	double		offset;				// Volts added after scaling
+} WRAP_CHANNEL_SCALING;
 
-extern int16_t		_channelCount; // Should be set to 2 or 4 from the main application
-extern int16_t		_enabledChannels[PS5000A_MAX_CHANNELS]; // Keep a record of the channels that are enabled
+/****************************************************************************
+* enWrapDecimationMode
+*
+* The ways the streaming callback can reduce the data for a channel before 
+* writing it to the decimation buffers set with setChannelDecimation.
+*
+****************************************************************************/
+typedef enum enWrapDecimationMode
+{
+	WRAP_DECIMATION_NONE,
+	WRAP_DECIMATION_MIN_MAX,	// Maximum and minimum of each block of ratio samples
+	WRAP_DECIMATION_MEAN,		// Mean of each block of ratio samples
+	WRAP_DECIMATION_EVERY_NTH	// First sample of each block of ratio samples
+} WRAP_DECIMATION_MODE;
 
-extern int16_t		_digitalPortCount;																			// Should be set to 2 from the main application
-extern int16_t		_enabledDigitalPorts[PS5000A_WRAP_MAX_DIGITAL_PORTS];		// Keep a record of the channels that are enabled
+/****************************************************************************
+* tWrapDecimationInfo
+*
+* The decimation settings and state for one channel. The partly complete 
+* block is kept between calls to the streaming callback so that blocks 
+* spanning two callbacks give the same result as any other block.
+*
+****************************************************************************/
+typedef struct tWrapDecimationInfo
+{
+	int32_t				mode;				// WRAP_DECIMATION_MODE value
+	uint32_t			ratio;				// Number of samples reduced to each output value
+	int16_t *			appMaxBuffer;		// Application buffer for the output values (max values in min/max mode)
+	int16_t *			appMinBuffer;		// Application buffer for the min values in min/max mode
+	uint32_t			bufferLength;		// Length of the application buffers - they are written as rings
+	uint32_t			blockCount;			// Number of samples in the current block
+	int16_t				blockMax;
+	int16_t				blockMin;
+	int64_t				blockSum;
+	volatile uint64_t	writeCount;			// Total number of output values written - accessed with WRAP_LOAD_UINT64 and WRAP_STORE_UINT64
+	uint64_t			readCount;			// Total number of output values returned by getDecimatedValues
+} WRAP_DECIMATION_INFO;
 
 typedef struct tWrapBufferInfo
 {
@@ -103,9 +206,522 @@ typedef struct tWrapBufferInfo
 	int16_t *appDigiBuffers[PS5000A_WRAP_MAX_DIGITAL_BUFFERS];				// Application buffers to copy the driver digital data into
 	uint32_t digiBufferLengths[PS5000A_WRAP_MAX_DIGITAL_BUFFERS];			// Buffer lengths for digital ports - only 2 ports.
 
+	float *appFloatBuffers[PS5000A_WRAP_MAX_CHANNEL_BUFFERS];		// Application buffers to write the data converted to volts into
+	double *appDoubleBuffers[PS5000A_WRAP_MAX_CHANNEL_BUFFERS];	// Application buffers to write the data converted to volts into
+	WRAP_CHANNEL_SCALING scaling[PS5000A_MAX_CHANNELS];		// Conversion settings for each channel
+	WRAP_DECIMATION_INFO decimation[PS5000A_MAX_CHANNELS];	// Decimation settings and state for each channel
+
 } WRAP_BUFFER_INFO;
 
-extern WRAP_BUFFER_INFO _wrapBufferInfo;
+#define WRAP_STREAMING_EVENT_QUEUE_SIZE		1024	// Number of streaming callback records held - must be a power of 2
+#define WRAP_STREAMING_EVENT_FIELDS			8		// Number of values per record returned by DrainStreamingEvents
+
+/****************************************************************************
+* tWrapStreamingEvent
+*
+* A record of the parameters passed to one call of the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEvent
+{
+	uint32_t	numSamples;
+	uint32_t	startIndex;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		overflow;
+	int16_t		autoStop;
+	uint64_t	timestamp;			// Host time in microseconds when the callback was received
+} WRAP_STREAMING_EVENT;
+
+/****************************************************************************
+* tWrapStreamingEventQueue
+*
+* Single-producer/single-consumer queue of streaming callback records. The 
+* streaming callback is the only writer of writeIndex and droppedEvents, and 
+* DrainStreamingEvents is the only writer of readIndex, so no lock is needed.
+* When the queue is full the callback discards the record and counts it in 
+* droppedEvents; it does not wait for the reader on either path.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEventQueue
+{
+	WRAP_STREAMING_EVENT	events[WRAP_STREAMING_EVENT_QUEUE_SIZE];
+	volatile uint32_t		writeIndex;				// Total number of records added
+	volatile uint32_t		readIndex;				// Total number of records removed
+	volatile uint32_t		droppedEvents;			// Total number of records lost because the queue was full
+	uint32_t				reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainStreamingEvents
+} WRAP_STREAMING_EVENT_QUEUE;
+
+#define WRAP_TRIGGER_LOG_SIZE				4096	// Number of trigger records held - must be a power of 2
+#define WRAP_TRIGGER_LOG_FIELDS				2		// Number of values per record returned by DrainTriggerLog
+
+/****************************************************************************
+* tWrapTriggerRecord
+*
+* The position of one trigger reported by the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapTriggerRecord
+{
+	uint64_t	sampleIndex;		// Index of the trigger point counted from the first sample after resetTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_RECORD;
+
+/****************************************************************************
+* tWrapTriggerLog
+*
+* Single-producer/single-consumer log of streaming triggers, shared in the 
+* same way as WRAP_STREAMING_EVENT_QUEUE. sampleCount counts every sample 
+* the driver has passed to the streaming callback, so trigger positions do 
+* not depend on where the driver placed the data in its buffers and do not
+* wrap.
+*
+****************************************************************************/
+typedef struct tWrapTriggerLog
+{
+	WRAP_TRIGGER_RECORD	records[WRAP_TRIGGER_LOG_SIZE];
+	uint64_t			sampleCount;			// Samples received since the last resetTriggerLog
+	volatile uint32_t	writeIndex;				// Total number of records added
+	volatile uint32_t	readIndex;				// Total number of records removed
+	volatile uint32_t	droppedRecords;			// Total number of records lost because the log was full
+	uint32_t			reportedDroppedRecords;	// Value of droppedRecords at the last call to DrainTriggerLog
+} WRAP_TRIGGER_LOG;
+
+#define WRAP_TRIGGER_CAPTURE_FIELDS			2		// Number of values per record returned in triggers by DrainTriggerCaptures
+
+/****************************************************************************
+* tWrapTriggerCaptureRecord
+*
+* The position of the trigger for one record of a trigger capture.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCaptureRecord
+{
+	uint64_t	triggerPosition;	// Position of the trigger in the samples seen by the capture
+	uint64_t	nextPosition;		// Position of the next sample to copy into the record
+	uint64_t	sampleIndex;		// Trigger index reported to the application, as returned by DrainTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_CAPTURE_RECORD;
+
+/****************************************************************************
+* tWrapTriggerCapture
+*
+* The state used to capture a window of samples around each streaming 
+* trigger. The streaming callback keeps the last preTriggerSamples samples 
+* of each captured channel in a history ring. When a trigger is reported it
+* starts a record, copies the pre-trigger samples from the ring and the 
+* current block, and fills in the post-trigger samples from this and later
+* blocks. Records complete in trigger order and are passed to 
+* DrainTriggerCaptures through a single-producer/single-consumer queue in 
+* the same way as WRAP_STREAMING_EVENT_QUEUE. The triggerCaptureLock of the
+* device is held while the callback updates the capture, so that 
+* setTriggerCapture cannot free it from under the callback or 
+* DrainTriggerCaptures.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCapture
+{
+	uint32_t						preTriggerSamples;
+	uint32_t						postTriggerSamples;
+	uint32_t						windowLength;								// preTriggerSamples + postTriggerSamples
+	uint32_t						recordLength;								// windowLength for each captured channel
+	int16_t							nChannels;
+	int16_t							channels[PS5000A_MAX_CHANNELS];				// Captured channels, in channel order
+	int16_t *						history;									// A ring of preTriggerSamples samples for each captured channel
+	uint64_t						samplesSeen;								// Samples passed to the streaming callback since the capture was set up
+
+	uint32_t						maxRecords;
+	int16_t *						recordData;									// maxRecords records of recordLength samples
+	WRAP_TRIGGER_CAPTURE_RECORD *	records;
+	uint32_t						startedRecords;								// Total number of records started - written only by the callback
+	volatile uint32_t				writeIndex;									// Total number of records completed
+	volatile uint32_t				readIndex;									// Total number of records removed
+	volatile uint32_t				droppedRecords;								// Total number of triggers lost because the queue was full
+	uint32_t						reportedDroppedRecords;						// Value of droppedRecords at the last call to DrainTriggerCaptures
+} WRAP_TRIGGER_CAPTURE;
+
+#define WRAP_SOFTWARE_TRIGGER_QUEUE_SIZE	4096	// Number of software trigger events held - must be a power of 2
+#define WRAP_SOFTWARE_TRIGGER_FIELDS		3		// Number of values per event returned by DrainSoftwareTriggers
+
+typedef enum enWrapSoftwareTriggerType
+{
+	WRAP_SOFTWARE_TRIGGER_NONE,
+	WRAP_SOFTWARE_TRIGGER_LEVEL,			// The signal crosses the threshold
+	WRAP_SOFTWARE_TRIGGER_EDGE,				// The signal crosses the threshold, after leaving the hysteresis band below it
+	WRAP_SOFTWARE_TRIGGER_WINDOW,			// The signal enters or leaves the window between the thresholds
+	WRAP_SOFTWARE_TRIGGER_PULSE_WIDTH,		// A pulse across the threshold, of qualifying width, ends
+	WRAP_SOFTWARE_TRIGGER_RUNT,				// A pulse crosses the first threshold and returns without reaching the second
+	WRAP_SOFTWARE_TRIGGER_TYPES
+} WRAP_SOFTWARE_TRIGGER_TYPE;
+
+typedef enum enWrapSoftwareTriggerDirection
+{
+	WRAP_SOFTWARE_TRIGGER_RISING = 0,
+	WRAP_SOFTWARE_TRIGGER_FALLING = 1,
+	WRAP_SOFTWARE_TRIGGER_RISING_OR_FALLING = 2,
+
+	WRAP_SOFTWARE_TRIGGER_ENTER = 0,		// Window
+	WRAP_SOFTWARE_TRIGGER_EXIT = 1,
+	WRAP_SOFTWARE_TRIGGER_ENTER_OR_EXIT = 2,
+
+	WRAP_SOFTWARE_TRIGGER_POSITIVE = 0,		// Pulse width and runt
+	WRAP_SOFTWARE_TRIGGER_NEGATIVE = 1
+} WRAP_SOFTWARE_TRIGGER_DIRECTION;
+
+/****************************************************************************
+* enWrapSoftwareTriggerState
+*
+* The state of a software trigger detector between samples:
+*
+* Level, edge and pulse width - ACTIVE at or above the threshold, IDLE 
+*	below the hysteresis band.
+* Window - ACTIVE inside the window, IDLE outside it.
+* Runt - IDLE beyond the hysteresis band of the first threshold, STARTED 
+*	once the first threshold is crossed, ACTIVE once the second is reached.
+*
+****************************************************************************/
+typedef enum enWrapSoftwareTriggerState
+{
+	WRAP_SOFTWARE_TRIGGER_STATE_UNKNOWN,	// No sample classified since the trigger was set
+	WRAP_SOFTWARE_TRIGGER_STATE_IDLE,
+	WRAP_SOFTWARE_TRIGGER_STATE_ACTIVE,
+	WRAP_SOFTWARE_TRIGGER_STATE_STARTED,
+	WRAP_SOFTWARE_TRIGGER_STATES
+} WRAP_SOFTWARE_TRIGGER_STATE;
+
+/****************************************************************************
+* tWrapSoftwareTrigger
+*
+* The settings and state of the software trigger detector for a channel. 
+* For each state, the detector searches the block for the first sample 
+* inside (or outside) a range of ADC counts, set up by setSoftwareTrigger, 
+* at which the state changes. The state is kept between callbacks, so 
+* events that span two blocks are found.
+*
+****************************************************************************/
+typedef struct tWrapSoftwareTrigger
+{
+	int16_t		type;
+	int16_t		direction;
+	int16_t		threshold;											// Lower threshold for window and runt triggers
+	int16_t		upperThreshold;										// Window and runt triggers only
+	uint32_t	minWidth;											// Pulse width and runt triggers only
+	uint32_t	maxWidth;											// 0 for no limit
+	int32_t		searchLow[WRAP_SOFTWARE_TRIGGER_STATES];			// Range searched for in each state
+	int32_t		searchHigh[WRAP_SOFTWARE_TRIGGER_STATES];
+	int16_t		searchInside[WRAP_SOFTWARE_TRIGGER_STATES];			// Zero to search for a sample outside the range
+	int16_t		state;
+	int16_t		pulseStarted;										// Set if pulseStart is the start of the current pulse
+	uint64_t	pulseStart;
+} WRAP_SOFTWARE_TRIGGER;
+
+/****************************************************************************
+* tWrapSoftwareTriggerEvent
+*
+* An event found by a software trigger detector.
+*
+****************************************************************************/
+typedef struct tWrapSoftwareTriggerEvent
+{
+	uint64_t	sampleIndex;		// Index of the sample at which the event was detected, as returned by DrainTriggerLog
+	uint32_t	width;				// Pulse width and runt triggers: the width of the pulse in samples
+	int16_t		channel;
+} WRAP_SOFTWARE_TRIGGER_EVENT;
+
+/****************************************************************************
+* tWrapSoftwareTriggerQueue
+*
+* Single-producer/single-consumer queue of software trigger events, shared 
+* in the same way as WRAP_STREAMING_EVENT_QUEUE.
+*
+****************************************************************************/
+typedef struct tWrapSoftwareTriggerQueue
+{
+	WRAP_SOFTWARE_TRIGGER_EVENT	events[WRAP_SOFTWARE_TRIGGER_QUEUE_SIZE];
+	volatile uint32_t			writeIndex;				// Total number of events added
+	volatile uint32_t			readIndex;				// Total number of events removed
+	volatile uint32_t			droppedEvents;			// Total number of events lost because the queue was full
+	uint32_t					reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainSoftwareTriggers
+} WRAP_SOFTWARE_TRIGGER_QUEUE;
+
+#define WRAP_WAIT_INFINITE	0xFFFFFFFF
+
+#define WRAP_MAX_HANDLE		32767
+
+#define WRAP_STREAMING_SNAPSHOT_FIELDS		8		// Number of values returned by GetStreamingSnapshot
+
+/****************************************************************************
+* tWrapStreamingSnapshot
+*
+* A consistent copy of the streaming status, protected by a sequence lock. 
+* The sequence is odd while the fields are being written, so a reader that 
+* sees an odd sequence, or a different sequence after reading the fields, 
+* reads them again. Readers never block the streaming callback. Writers, 
+* the callback among them, are serialised by snapshotLock, which is held 
+* only while the fields are written.
+*
+****************************************************************************/
+typedef struct tWrapStreamingSnapshot
+{
+	volatile uint32_t	sequence;
+	int16_t				ready;
+	uint32_t			numSamples;
+	uint32_t			startIndex;
+	int16_t				triggered;
+	uint32_t			triggeredAt;
+	int16_t				overflow;
+	int16_t				autoStop;
+	uint32_t			callbackCount;
+} WRAP_STREAMING_SNAPSHOT;
+
+#define WRAP_TRIGGER_CACHE_MAX_VALUES		64		// Largest array, in values, held by a trigger cache entry
+
+/****************************************************************************
+* tWrapTriggerCacheEntry
+*
+* The last array of values passed to one of the V2 trigger functions that 
+* the driver accepted. A call with the same values is not passed to the 
+* driver again. hash is checked before the values are compared.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCacheEntry
+{
+	int16_t		valid;
+	uint32_t	hash;
+	int32_t		nValues;
+	int32_t		info;								// PS5000A_CONDITIONS_INFO for the conditions, otherwise 0
+	int32_t		values[WRAP_TRIGGER_CACHE_MAX_VALUES];
+} WRAP_TRIGGER_CACHE_ENTRY;
+
+// Enum to define the trigger cache entries
+typedef enum enWrapTriggerCacheIndex
+{
+	WRAP_TRIGGER_CACHE_CONDITIONS,
+	WRAP_TRIGGER_CACHE_DIRECTIONS,
+	WRAP_TRIGGER_CACHE_PROPERTIES,
+	WRAP_TRIGGER_CACHE_ENTRIES
+} WRAP_TRIGGER_CACHE_INDEX;
+
+#define WRAP_MAX_TRIGGER_STRUCTURES			32		// Largest number of structures converted by one call to a trigger function
+
+/****************************************************************************
+* uWrapTriggerArena
+*
+* The space in which the trigger functions convert their arrays of integers
+* to driver structures. The arena is held in the WRAP_UNIT_INFO structure
+* for the device, so that setting up a trigger does not allocate memory.
+* A trigger function passed more than WRAP_MAX_TRIGGER_STRUCTURES 
+* structures uses triggerArenaOverflow, heap memory that is allocated when
+* first needed and kept until the device is released.
+*
+****************************************************************************/
+typedef union uWrapTriggerArena
+{
+	PS5000A_TRIGGER_CONDITIONS				conditions[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_TRIGGER_CHANNEL_PROPERTIES		channelProperties[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_PWQ_CONDITIONS					pwqConditions[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_CONDITION						conditionsV2[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_DIRECTION						directionsV2[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_TRIGGER_CHANNEL_PROPERTIES_V2	channelPropertiesV2[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS5000A_DIGITAL_CHANNEL_DIRECTIONS		digitalDirections[WRAP_MAX_TRIGGER_STRUCTURES];
+} WRAP_TRIGGER_ARENA;
+
+/****************************************************************************
+* enWrapAdvancedTriggerHeader
+*
+* The position of each value in the header of a SetAdvancedTrigger 
+* descriptor. The header is followed by the sections in the order below, 
+* each holding the stated number of records in the same layout as the array
+* passed to the corresponding wrapper function:
+*
+* conditions - 2 values per record, see SetTriggerConditionsV2
+* directions - 3 values per record, see SetTriggerDirectionsV2
+* properties - 5 values per record, see SetTriggerPropertiesV2
+* digitalDirections - 2 values per record, see SetTriggerDigitalPortProperties
+* pwqConditions - 2 values per record, see SetPulseWidthQualifierConditions
+* pwqDirections - 3 values per record, see SetPulseWidthQualifierDirections
+* pwqDigitalDirections - 2 values per record, see 
+*						SetPulseWidthDigitalPortProperties
+*
+****************************************************************************/
+typedef enum enWrapAdvancedTriggerHeader
+{
+	WRAP_ADVANCED_TRIGGER_N_CONDITIONS,
+	WRAP_ADVANCED_TRIGGER_CONDITIONS_INFO,
+	WRAP_ADVANCED_TRIGGER_N_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_N_PROPERTIES,
+	WRAP_ADVANCED_TRIGGER_N_DIGITAL_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_N_PWQ_CONDITIONS,
+	WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS_INFO,
+	WRAP_ADVANCED_TRIGGER_N_PWQ_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_N_PWQ_DIGITAL_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_HEADER_SIZE
+} WRAP_ADVANCED_TRIGGER_HEADER;
+
+// Enum to define the sections of a SetAdvancedTrigger descriptor, in the order they are applied
+typedef enum enWrapAdvancedTriggerSection
+{
+	WRAP_ADVANCED_TRIGGER_CONDITIONS,
+	WRAP_ADVANCED_TRIGGER_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_PROPERTIES,
+	WRAP_ADVANCED_TRIGGER_DIGITAL_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_PWQ_CONDITIONS,
+	WRAP_ADVANCED_TRIGGER_PWQ_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_PWQ_DIGITAL_DIRECTIONS,
+	WRAP_ADVANCED_TRIGGER_SECTIONS
+} WRAP_ADVANCED_TRIGGER_SECTION;
+
+#define WRAP_MAX_TRIGGER_TERMS				32		// Largest number of condition sets in a compiled trigger expression
+#define WRAP_MAX_EXPRESSION_LENGTH			255		// Longest trigger expression, in characters
+#define WRAP_MAX_EXPRESSION_DEPTH			32		// Deepest nesting of parentheses in a trigger expression
+#define WRAP_EXPRESSION_CACHE_SIZE			16		// Number of compiled trigger expressions held - must be a power of 2
+#define WRAP_TRIGGER_SOURCE_COUNT			11		// Number of sources that can be named in a trigger expression
+#define WRAP_TRIGGER_INPUT_WORDS			((1 << WRAP_TRIGGER_SOURCE_COUNT) / 64)	// Words in a bit set of trigger source inputs
+#define WRAP_MAX_COVER_SEARCH_NODES			20000	// Steps taken to find the fewest condition sets for an expression
+
+/****************************************************************************
+* tWrapTriggerTerm
+*
+* One condition set of a compiled trigger expression. Bit n of each mask 
+* refers to entry n of the table of trigger source names in ps5000aWrap.c.
+* The set is true when every source in trueSources is true and every source
+* in falseSources is false.
+*
+****************************************************************************/
+typedef struct tWrapTriggerTerm
+{
+	uint16_t	trueSources;
+	uint16_t	falseSources;
+} WRAP_TRIGGER_TERM;
+
+/****************************************************************************
+* tWrapTriggerExpression
+*
+* A trigger expression compiled to the OR of condition sets, each of which 
+* is passed to the driver in one call to 
+* ps5000aSetTriggerChannelConditionsV2.
+*
+****************************************************************************/
+typedef struct tWrapTriggerExpression
+{
+	int16_t				nTerms;
+	WRAP_TRIGGER_TERM	terms[WRAP_MAX_TRIGGER_TERMS];
+} WRAP_TRIGGER_EXPRESSION;
+
+/****************************************************************************
+* tWrapExpressionCacheEntry
+*
+* A compiled trigger expression held with its text. Entries are indexed by
+* the hash of the text.
+*
+****************************************************************************/
+typedef struct tWrapExpressionCacheEntry
+{
+	int16_t					valid;
+	uint32_t				hash;
+	char					text[WRAP_MAX_EXPRESSION_LENGTH + 1];
+	WRAP_TRIGGER_EXPRESSION	compiled;
+} WRAP_EXPRESSION_CACHE_ENTRY;
+
+/****************************************************************************
+* tWrapTriggerCoverSearch
+*
+* The state of the search for the fewest condition sets of an expression.
+* Bit n of a coverage or needed set is set if the input in which the 
+* sources with bits set in n are true satisfies the condition set, or the 
+* expression.
+*
+****************************************************************************/
+typedef struct tWrapTriggerCoverSearch
+{
+	uint64_t	coverage[WRAP_MAX_TRIGGER_TERMS][WRAP_TRIGGER_INPUT_WORDS];
+	uint64_t	needed[WRAP_TRIGGER_INPUT_WORDS];
+	int16_t		nTerms;
+	int16_t		chosen[WRAP_MAX_TRIGGER_TERMS];
+	int16_t		best[WRAP_MAX_TRIGGER_TERMS];
+	int16_t		bestCount;
+	int32_t		nodes;
+} WRAP_TRIGGER_COVER_SEARCH;
+
+/****************************************************************************
+* tWrapExpressionParser
+*
+* The state of the trigger expression parser.
+*
+****************************************************************************/
+typedef struct tWrapExpressionParser
+{
+	const char *	text;
+	int32_t			position;
+	int16_t			depth;
+} WRAP_EXPRESSION_PARSER;
+
+/****************************************************************************
+* tWrapUnitInfo
+*
+* The wrapper state for one device. A structure is created for each handle 
+* the first time it is passed to a wrapper function, and is passed to the 
+* driver callbacks through pParameter, so several devices can collect data 
+* at the same time.
+*
+****************************************************************************/
+typedef struct tWrapUnitInfo
+{
+	int16_t						handle;
+	volatile int16_t			ready;
+	int16_t						autoStop;
+	uint32_t					numSamples;
+	uint32_t					triggeredAt;
+	int16_t						triggered;
+	uint32_t					startIndex;											// Start index in driver data buffer
+	int16_t						overflow;
+
+	int16_t						channelCount;										// Should be set to 2 or 4 from the main application
+	int16_t						enabledChannels[PS5000A_MAX_CHANNELS];				// Keep a record of the channels that are enabled
+
+	int16_t						digitalPortCount;									// Should be set to 2 from the main application
+	int16_t						enabledDigitalPorts[PS5000A_WRAP_MAX_DIGITAL_PORTS];	// Keep a record of the digital ports that are enabled
+
+	WRAP_BUFFER_INFO			wrapBufferInfo;
+
+	// Ring buffer streaming mode - application buffers are treated as fixed size rings.
+	// The write cursor and overrun count are only written by the streaming callback and
+	// the read cursor only by advanceRingReadCursor, using WRAP_STORE_UINT64.
+	int16_t						ringMode;
+	uint32_t					ringLength;											// Length of each application ring buffer in samples
+	uint64_t					ringWriteCursor;									// Total number of samples written into the rings
+	uint64_t					ringReadCursor;										// Total number of samples consumed by the application
+	uint64_t					ringOverrunCount;									// Total number of samples overwritten before being read
+
+	WRAP_STREAMING_EVENT_QUEUE	eventQueue;
+	WRAP_TRIGGER_LOG			triggerLog;
+	WRAP_TRIGGER_CAPTURE *		triggerCapture;								// NULL unless setTriggerCapture is in use
+	WRAP_LOCK					triggerCaptureLock;									// Held while the capture is updated, drained or replaced
+	WRAP_SOFTWARE_TRIGGER		softwareTriggers[PS5000A_MAX_CHANNELS];				// Software trigger detector for each channel
+	int16_t						softwareTriggerCount;								// Number of channels with a software trigger set
+	WRAP_LOCK					softwareTriggerLock;								// Held while the detectors run and while setSoftwareTrigger changes them
+	WRAP_SOFTWARE_TRIGGER_QUEUE	softwareTriggerQueue;
+
+	WRAP_LOCK					readyLock;											// Protects ready for WaitForStreamingData and WaitForBlockReady
+	WRAP_CONDITION				readyCondition;
+
+	uint32_t					callbackCount;							// Number of streaming callbacks received
+	WRAP_STREAMING_SNAPSHOT		snapshot;								// Status read by GetStreamingSnapshot
+	WRAP_LOCK					snapshotLock;							// Serialises writers of snapshot - readers do not take it
+
+	WRAP_TRIGGER_CACHE_ENTRY	triggerCache[WRAP_TRIGGER_CACHE_ENTRIES];	// Last trigger settings applied by SetTrigger...V2
+
+	WRAP_TRIGGER_ARENA			triggerArena;							// Space used by the trigger functions to convert their arrays
+	void *						triggerArenaOverflow;					// Heap space used in place of triggerArena for more structures than it holds
+	size_t						triggerArenaOverflowSize;				// Size of triggerArenaOverflow in bytes
+
+	int16_t						appliedExpressionValid;					// TRUE if the trigger conditions are those of appliedExpression
+	WRAP_TRIGGER_EXPRESSION		appliedExpression;						// Last expression applied by SetTriggerExpression
+
+	uint32_t					streamingCallsInProgress;				// GetStreamingLatestValues calls in progress, protected by _wrapUnitInfoLock
+} WRAP_UNIT_INFO;
+
+extern WRAP_UNIT_INFO *	_wrapUnitInfo[WRAP_MAX_HANDLE + 1];		// Wrapper state for each device, indexed by handle
 
 // Enum to define Digital Port indices
 typedef enum enPS5000AWrapDigitalPortIndex
@@ -150,6 +766,18 @@ extern int16_t PREF0 PREF1 IsReady
 	int16_t handle
 );
 
+extern int16_t PREF0 PREF1 WaitForStreamingData
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
+extern int16_t PREF0 PREF1 WaitForBlockReady
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
 extern int16_t PREF0 PREF1 IsTriggerReady
 (
 	int16_t handle, 
@@ -284,4 +912,179 @@ extern PICO_STATUS PREF0 PREF1 SetPulseWidthDigitalPortProperties
 	int32_t * pwqDigitalDirections,
 	int16_t nDirections
 );
+
+extern PICO_STATUS PREF0 PREF1 SetAdvancedTrigger
+(
+	int16_t handle,
+	int32_t * descriptor,
+	int32_t descriptorLength
+);
+
+extern PICO_STATUS PREF0 PREF1 setStreamingRingMode
+(
+	int16_t handle,
+	int16_t enable,
+	uint32_t ringLength
+);
+
+extern PICO_STATUS PREF0 PREF1 getRingBufferCursors
+(
+	int16_t handle,
+	uint64_t * writeCursor,
+	uint64_t * readCursor,
+	uint64_t * overrunCount
+);
+
+extern PICO_STATUS PREF0 PREF1 advanceRingReadCursor
+(
+	int16_t handle,
+	uint32_t nSamples
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents
+(
+	int16_t handle,
+	uint32_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog
+(
+	int16_t handle,
+	uint64_t * triggers,
+	uint32_t maxTriggers,
+	uint32_t * nTriggers,
+	uint32_t * droppedTriggers
+);
+
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setChannelScaling
+(
+	int16_t handle,
+	int16_t channel,
+	int32_t range,
+	float analogueOffset,
+	int16_t maxADCValue,
+	float probeAttenuation
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	float * appMaxBuffer,
+	float * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	double * appMaxBuffer,
+	double * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 setChannelDecimation
+(
+	int16_t handle,
+	int16_t channel,
+	int32_t mode,
+	uint32_t ratio,
+	int16_t * appMaxBuffer,
+	int16_t * appMinBuffer,
+	uint32_t bufferLength
+);
+
+extern PICO_STATUS PREF0 PREF1 getDecimatedValues
+(
+	int16_t handle,
+	int16_t channel,
+	uint32_t * startIndex,
+	uint32_t * noOfValues
+);
+
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot
+(
+	int16_t handle,
+	uint32_t * snapshot
+);
+
+extern PICO_STATUS PREF0 PREF1 clearTriggerCache
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 CompileTriggerExpression
+(
+	int8_t * expression,
+	int32_t * conditionsArray,
+	int32_t maxValues,
+	int16_t * termLengths,
+	int16_t maxTerms,
+	int16_t * nTerms
+);
+
+extern PICO_STATUS PREF0 PREF1 SetTriggerExpression
+(
+	int16_t handle,
+	int8_t * expression
+);
+
+extern PICO_STATUS PREF0 PREF1 setTriggerCapture
+(
+	int16_t handle,
+	uint32_t preTriggerSamples,
+	uint32_t postTriggerSamples,
+	uint32_t maxRecords,
+	uint32_t * recordLength
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerCaptures
+(
+	int16_t handle,
+	int16_t * data,
+	uint64_t * triggers,
+	uint32_t maxRecords,
+	uint32_t * nRecords,
+	uint32_t * droppedRecords
+);
+
+extern PICO_STATUS PREF0 PREF1 setSoftwareTrigger
+(
+	int16_t handle,
+	int16_t channel,
+	int16_t type,
+	int16_t direction,
+	int16_t threshold,
+	int16_t upperThreshold,
+	uint16_t hysteresis,
+	uint32_t minWidth,
+	uint32_t maxWidth
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainSoftwareTriggers
+(
+	int16_t handle,
+	uint64_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
 #endif
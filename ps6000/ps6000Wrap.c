@@ -29,640 +29,3344 @@
 //
 /////////////////////////////////
 
+static const uint32_t _rangeMillivolts[PS6000_MAX_RANGES] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000 };
+
+static int16_t _simdLevel = -1;
+
+#if defined(WIN32) || defined(_WIN64)
+static LARGE_INTEGER _timestampFrequency = { 0 };
+#endif
+static uint32_t _nonTemporalCopyThreshold = WRAP_NON_TEMPORAL_COPY_THRESHOLD;
+
+/****************************************************************************
+* detectSimdLevel
+*
+* Returns the widest instruction set extension that can be used for the 
+* volts conversion and the streaming copy on this processor (WRAP_SIMD_NONE,
+* WRAP_SIMD_SSE2, WRAP_SIMD_AVX2 or WRAP_SIMD_AVX512). The volts conversion
+* uses the AVX2 kernels on processors with AVX-512.
+*
+****************************************************************************/
+static int16_t detectSimdLevel(void)
+{
+#if !defined(WRAP_SIMD_X86)
+	return WRAP_SIMD_NONE;
+#elif defined(_MSC_VER)
+	int cpuInfo[4];
+	int maxLeaf = 0;
+	int16_t osSavesAvxState = 0;
+
+	__cpuid(cpuInfo, 0);
+	maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[3] & (1 << 26)) == 0)
+	{
+		return WRAP_SIMD_NONE;
+	}
+
+	// AVX2 also needs the operating system to save the YMM registers (OSXSAVE and AVX bits, then XCR0)
+	osSavesAvxState = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+
+	if (osSavesAvxState && maxLeaf >= 7)
+	{
+		__cpuidex(cpuInfo, 7, 0);
+
+		// AVX-512 also needs the opmask and ZMM registers to be saved
+		if ((cpuInfo[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6))
+		{
+			return WRAP_SIMD_AVX512;
+		}
+
+		if (cpuInfo[1] & (1 << 5))
+		{
+			return WRAP_SIMD_AVX2;
+		}
+	}
+
+	return WRAP_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return WRAP_SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return WRAP_SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return WRAP_SIMD_SSE2;
+	}
+	else
+	{
+		return WRAP_SIMD_NONE;
+	}
+#endif
+}
+
+/****************************************************************************
+* getSimdLevel
+*
+* Returns the result of detectSimdLevel, which is only run the first time.
+*
+****************************************************************************/
+static int16_t getSimdLevel(void)
+{
+	if (_simdLevel < 0)
+	{
+		_simdLevel = detectSimdLevel();
+	}
+
+	return _simdLevel;
+}
+
+#ifdef WRAP_SIMD_X86
+/****************************************************************************
+* copyNonTemporalSse2
+*
+* Copies noOfSamples samples using streaming stores, which write to memory
+* without reading the destination into the cache, and prefetches the source
+* WRAP_COPY_PREFETCH_DISTANCE bytes ahead. The samples before the first 
+* aligned address and after the last full vector are copied one at a time.
+*
+* copyNonTemporalAvx2 and copyNonTemporalAvx512 do the same with 32 and 64 
+* byte stores.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void copyNonTemporalSse2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 15) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	// One cache line per iteration
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+		_mm_stream_si128((__m128i *) &destination[i + 8], _mm_loadu_si128((const __m128i *) &source[i + 8]));
+		_mm_stream_si128((__m128i *) &destination[i + 16], _mm_loadu_si128((const __m128i *) &source[i + 16]));
+		_mm_stream_si128((__m128i *) &destination[i + 24], _mm_loadu_si128((const __m128i *) &source[i + 24]));
+	}
+
+	for (; i + 8 <= noOfSamples; i += 8)
+	{
+		_mm_stream_si128((__m128i *) &destination[i], _mm_loadu_si128((const __m128i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	// Streaming stores are weakly ordered - complete them before the callback reports the data
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX2 void copyNonTemporalAvx2(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 31) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+		_mm256_stream_si256((__m256i *) &destination[i + 16], _mm256_loadu_si256((const __m256i *) &source[i + 16]));
+	}
+
+	for (; i + 16 <= noOfSamples; i += 16)
+	{
+		_mm256_stream_si256((__m256i *) &destination[i], _mm256_loadu_si256((const __m256i *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+
+static WRAP_TARGET_AVX512 void copyNonTemporalAvx512(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+
+	while (i < noOfSamples && ((uintptr_t) &destination[i] & 63) != 0)
+	{
+		destination[i] = source[i];
+		i++;
+	}
+
+	for (; i + 32 <= noOfSamples; i += 32)
+	{
+		_mm_prefetch((const char *) &source[i] + WRAP_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+		_mm512_stream_si512((__m512i *) &destination[i], _mm512_loadu_si512((const void *) &source[i]));
+	}
+
+	for (; i < noOfSamples; i++)
+	{
+		destination[i] = source[i];
+	}
+
+	_mm_sfence();
+}
+#endif
+
+/****************************************************************************
+* copySamples
+*
+* Copies noOfSamples samples from a driver buffer to an application buffer
+* in the streaming callback. Copies of at least _nonTemporalCopyThreshold 
+* bytes use non-temporal stores where the processor supports them, so that
+* data the callback only writes does not evict the application's working 
+* set from the cache. Smaller copies use memcpy_s.
+*
+****************************************************************************/
+static void copySamples(int16_t * destination, const int16_t * source, uint32_t noOfSamples)
+{
+	size_t nBytes = noOfSamples * sizeof(int16_t);
+
+#ifdef WRAP_SIMD_X86
+	if (_nonTemporalCopyThreshold > 0 && nBytes >= _nonTemporalCopyThreshold)
+	{
+		switch (getSimdLevel())
+		{
+			case WRAP_SIMD_AVX512:
+				copyNonTemporalAvx512(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_AVX2:
+				copyNonTemporalAvx2(destination, source, noOfSamples);
+				return;
+
+			case WRAP_SIMD_SSE2:
+				copyNonTemporalSse2(destination, source, noOfSamples);
+				return;
+
+			default:
+				break;
+		}
+	}
+#endif
+
+	memcpy_s(destination, nBytes, source, nBytes);
+}
+
+/****************************************************************************
+* convertToFloatScalar
+*
+* Converts noOfSamples ADC counts to volts one sample at a time. Used when 
+* the processor has no suitable extensions and for the samples left over 
+* at the end of the vector loops.
+*
+****************************************************************************/
+static void convertToFloatScalar(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		destination[i] = (float) source[i] * scale + offset;
+	}
+}
+
+/****************************************************************************
+* convertToDoubleScalar
+*
+* As convertToFloatScalar, for double precision application buffers.
+*
+****************************************************************************/
+static void convertToDoubleScalar(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		destination[i] = (double) source[i] * scale + offset;
+	}
+}
+
+#ifdef WRAP_SIMD_X86
+
+/****************************************************************************
+* convertToFloatSse2
+*
+* Converts ADC counts to volts 8 samples at a time using SSE2. The counts 
+* are sign extended to 32 bits by unpacking each one into the upper half of 
+* a 32-bit lane and shifting it back down.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void convertToFloatSse2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
+{
+	uint32_t i = 0;
+	__m128 scaleVector = _mm_set1_ps(scale);
+	__m128 offsetVector = _mm_set1_ps(offset);
+	__m128i counts;
+	__m128i low;
+	__m128i high;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		counts = _mm_loadu_si128((const __m128i *) &source[i]);
+
+		low = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+		high = _mm_srai_epi32(_mm_unpackhi_epi16(counts, counts), 16);
+
+		_mm_storeu_ps(&destination[i], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm_storeu_ps(&destination[i + 4], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), scaleVector), offsetVector));
+	}
+
+	convertToFloatScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+/****************************************************************************
+* convertToFloatAvx2
+*
+* Converts ADC counts to volts 16 samples at a time using AVX2, leaving any 
+* remaining samples to convertToFloatSse2.
+*
+****************************************************************************/
+static WRAP_TARGET_AVX2 void convertToFloatAvx2(const int16_t * source, float * destination, uint32_t noOfSamples, float scale, float offset)
+{
+	uint32_t i = 0;
+	__m256 scaleVector = _mm256_set1_ps(scale);
+	__m256 offsetVector = _mm256_set1_ps(offset);
+	__m256i counts;
+	__m256i low;
+	__m256i high;
+
+	for (i = 0; i + 16 <= noOfSamples; i += 16)
+	{
+		counts = _mm256_loadu_si256((const __m256i *) &source[i]);
+
+		low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(counts));
+		high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(counts, 1));
+
+		_mm256_storeu_ps(&destination[i], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(low), scaleVector), offsetVector));
+		_mm256_storeu_ps(&destination[i + 8], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(high), scaleVector), offsetVector));
+	}
+
+	convertToFloatSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+/****************************************************************************
+* convertToDoubleSse2
+*
+* Converts ADC counts to volts 4 samples at a time using SSE2.
+*
+****************************************************************************/
+static WRAP_TARGET_SSE2 void convertToDoubleSse2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
+{
+	uint32_t i = 0;
+	__m128d scaleVector = _mm_set1_pd(scale);
+	__m128d offsetVector = _mm_set1_pd(offset);
+	__m128i counts;
+	__m128i words;
+
+	for (i = 0; i + 4 <= noOfSamples; i += 4)
+	{
+		counts = _mm_loadl_epi64((const __m128i *) &source[i]);
+		words = _mm_srai_epi32(_mm_unpacklo_epi16(counts, counts), 16);
+
+		_mm_storeu_pd(&destination[i], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(words), scaleVector), offsetVector));
+		_mm_storeu_pd(&destination[i + 2], _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(words, _MM_SHUFFLE(3, 2, 3, 2))), 
+			scaleVector), offsetVector));
+	}
+
+	convertToDoubleScalar(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+/****************************************************************************
+* convertToDoubleAvx2
+*
+* Converts ADC counts to volts 8 samples at a time using AVX2, leaving any 
+* remaining samples to convertToDoubleSse2.
+*
+****************************************************************************/
+static WRAP_TARGET_AVX2 void convertToDoubleAvx2(const int16_t * source, double * destination, uint32_t noOfSamples, double scale, double offset)
+{
+	uint32_t i = 0;
+	__m256d scaleVector = _mm256_set1_pd(scale);
+	__m256d offsetVector = _mm256_set1_pd(offset);
+	__m256i words;
+
+	for (i = 0; i + 8 <= noOfSamples; i += 8)
+	{
+		words = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &source[i]));
+
+		_mm256_storeu_pd(&destination[i], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(words)), 
+			scaleVector), offsetVector));
+		_mm256_storeu_pd(&destination[i + 4], _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(words, 1)), 
+			scaleVector), offsetVector));
+	}
+
+	convertToDoubleSse2(&source[i], &destination[i], noOfSamples - i, scale, offset);
+}
+
+#endif
+
+/****************************************************************************
+* convertSamples
+*
+* Converts noOfSamples ADC counts to volts using the scaling for a channel, 
+* writing the result to the float and/or double buffer given. Either buffer 
+* may be NULL.
+*
+****************************************************************************/
+static void convertSamples(WRAP_CHANNEL_SCALING * scaling, const int16_t * source, float * floatBuffer, double * doubleBuffer, uint32_t noOfSamples)
+{
+	int16_t simdLevel = getSimdLevel();
+
+	if (floatBuffer != NULL)
+	{
+		switch (simdLevel)
+		{
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToFloatAvx2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToFloatSse2(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+#endif
+			default:
+				convertToFloatScalar(source, floatBuffer, noOfSamples, (float) scaling->scale, (float) scaling->offset);
+				break;
+		}
+	}
+
+	if (doubleBuffer != NULL)
+	{
+		switch (simdLevel)
+		{
+#ifdef WRAP_SIMD_X86
+			case WRAP_SIMD_AVX512:
+			case WRAP_SIMD_AVX2:
+				convertToDoubleAvx2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+
+			case WRAP_SIMD_SSE2:
+				convertToDoubleSse2(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+#endif
+			default:
+				convertToDoubleScalar(source, doubleBuffer, noOfSamples, scaling->scale, scaling->offset);
+				break;
+		}
+	}
+}
+
+/****************************************************************************
+* convertStreamingData
+*
+* Converts noOfSamples samples starting at startIndex in a driver buffer to 
+* volts, writing them at the same index in the float and double application 
+* buffers registered for it.
+*
+****************************************************************************/
+static void convertStreamingData(WRAP_BUFFER_INFO * wrapBufferInfo, int16_t channel, int16_t bufferIndex, uint32_t startIndex, uint32_t noOfSamples)
+{
+	float * floatBuffer = wrapBufferInfo->appFloatBuffers[bufferIndex];
+	double * doubleBuffer = wrapBufferInfo->appDoubleBuffers[bufferIndex];
+
+	if (wrapBufferInfo->driverBuffers[bufferIndex] == NULL || (floatBuffer == NULL && doubleBuffer == NULL))
+	{
+		return;
+	}
+
+	convertSamples(&wrapBufferInfo->scaling[channel], &wrapBufferInfo->driverBuffers[bufferIndex][startIndex], 
+		floatBuffer ? &floatBuffer[startIndex] : NULL, doubleBuffer ? &doubleBuffer[startIndex] : NULL, noOfSamples);
+}
+
+/****************************************************************************
+* copyToSegments
+*
+* Copies noOfSamples samples to a segmented application buffer, starting at
+* the logical index position. A block may be split across segments. Samples
+* beyond the end of the last segment are discarded.
+*
+****************************************************************************/
+static void copyToSegments(WRAP_SEGMENTED_BUFFER * buffer, uint64_t position, const int16_t * source, uint32_t noOfSamples)
+{
+	uint32_t segment = buffer->currentSegment;
+	uint64_t space = 0;
+	uint32_t count = 0;
+
+	// The position only moves backwards if the sample count was reset
+	if (segment >= buffer->nSegments || position < buffer->segmentStarts[segment])
+	{
+		segment = 0;
+	}
+
+	while (noOfSamples > 0 && position < buffer->segmentStarts[buffer->nSegments])
+	{
+		while (position >= buffer->segmentStarts[segment + 1])
+		{
+			segment++;
+		}
+
+		space = buffer->segmentStarts[segment + 1] - position;
+		count = space < noOfSamples ? (uint32_t) space : noOfSamples;
+
+		copySamples(&buffer->segments[segment][(size_t) (position - buffer->segmentStarts[segment])], source, count);
+
+		source += count;
+		position += count;
+		noOfSamples -= count;
+	}
+
+	buffer->currentSegment = segment;
+}
+
+/****************************************************************************
+* getHostTimestamp
+*
+* Returns a monotonic host time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getHostTimestamp(void)
+{
+#if defined(WIN32) || defined(_WIN64)
+	LARGE_INTEGER counter;
+
+	// The frequency is fixed at boot, so it is only read once
+	if (_timestampFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&_timestampFrequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / _timestampFrequency.QuadPart) * 1000000 + 
+		((counter.QuadPart % _timestampFrequency.QuadPart) * 1000000) / _timestampFrequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
+}
+
+/****************************************************************************
+* pushStreamingEvent
+*
+* Adds a record of a streaming callback to the event queue. Called only from 
+* the streaming callback. If the queue is full, the record is discarded and 
+* counted as dropped.
+*
+****************************************************************************/
+static void pushStreamingEvent(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t numSamples, uint32_t startIndex, int16_t triggered, 
+	uint32_t triggeredAt, int16_t overflow, int16_t autoStop)
+{
+	uint32_t writeIndex = queue->writeIndex;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	if (writeIndex - queue->readIndex >= WRAP_STREAMING_EVENT_QUEUE_SIZE)
+	{
+		queue->droppedEvents = queue->droppedEvents + 1;
+		return;
+	}
+
+	event = &queue->events[writeIndex & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+	event->numSamples = numSamples;
+	event->startIndex = startIndex;
+	event->triggered = triggered;
+	event->triggeredAt = triggeredAt;
+	event->overflow = overflow;
+	event->autoStop = autoStop;
+	event->timestamp = getHostTimestamp();
+
+	// Make sure the record is complete before it is made visible to the reader
+	WRAP_MEMORY_BARRIER();
+
+	queue->writeIndex = writeIndex + 1;
+}
+
+/****************************************************************************
+* drainStreamingEventQueue
+*
+* Copies up to maxEvents records out of the event queue into a flat array and
+* removes them from the queue. Called only from DrainStreamingEvents.
+*
+****************************************************************************/
+static void drainStreamingEventQueue(WRAP_STREAMING_EVENT_QUEUE * queue, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, 
+	uint32_t * droppedEvents)
+{
+	uint32_t readIndex = queue->readIndex;
+	uint32_t writeIndex = queue->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	WRAP_STREAMING_EVENT * event = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxEvents)
+	{
+		count = maxEvents;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		event = &queue->events[(readIndex + i) & (WRAP_STREAMING_EVENT_QUEUE_SIZE - 1)];
+
+		events[j]		= event->numSamples;
+		events[j + 1]	= event->startIndex;
+		events[j + 2]	= (uint32_t) event->triggered;
+		events[j + 3]	= event->triggeredAt;
+		events[j + 4]	= (uint32_t) (uint16_t) event->overflow;
+		events[j + 5]	= (uint32_t) event->autoStop;
+		events[j + 6]	= (uint32_t) (event->timestamp & 0xFFFFFFFF);
+		events[j + 7]	= (uint32_t) (event->timestamp >> 32);
+
+		j = j + WRAP_STREAMING_EVENT_FIELDS;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	queue->readIndex = readIndex + count;
+	*nEvents = count;
+
+	if (droppedEvents != NULL)
+	{
+		dropped = queue->droppedEvents;
+		*droppedEvents = dropped - queue->reportedDroppedEvents;
+		queue->reportedDroppedEvents = dropped;
+	}
+}
+
+/****************************************************************************
+* logStreamingTrigger
+*
+* Adds the trigger reported by a streaming callback, if any, to the trigger 
+* log and advances the sample count past the samples in the callback. 
+* Called only from the streaming callback. If the log is full, the trigger 
+* is discarded and counted as dropped.
+*
+****************************************************************************/
+static void logStreamingTrigger(WRAP_TRIGGER_LOG * log, int32_t numSamples, int16_t triggered, uint32_t triggeredAt)
+{
+	uint32_t writeIndex = log->writeIndex;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	if (triggered)
+	{
+		if (writeIndex - log->readIndex >= WRAP_TRIGGER_LOG_SIZE)
+		{
+			log->droppedRecords = log->droppedRecords + 1;
+		}
+		else
+		{
+			record = &log->records[writeIndex & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+			record->sampleIndex = log->sampleCount + triggeredAt;
+			record->timestamp = getHostTimestamp();
+
+			// Make sure the record is complete before it is made visible to the reader
+			WRAP_MEMORY_BARRIER();
+
+			log->writeIndex = writeIndex + 1;
+		}
+	}
+
+	if (numSamples > 0)
+	{
+		log->sampleCount += (uint32_t) numSamples;
+	}
+}
+
+/****************************************************************************
+* drainTriggerLog
+*
+* Copies up to maxTriggers records out of the trigger log into a flat array
+* and removes them from the log. Called only from DrainTriggerLog.
+*
+****************************************************************************/
+static void drainTriggerLog(WRAP_TRIGGER_LOG * log, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, 
+	uint32_t * droppedTriggers)
+{
+	uint32_t readIndex = log->readIndex;
+	uint32_t writeIndex = log->writeIndex;
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t i = 0;
+	WRAP_TRIGGER_RECORD * record = NULL;
+
+	// Make sure the records are read after the write index
+	WRAP_MEMORY_BARRIER();
+
+	count = writeIndex - readIndex;
+
+	if (count > maxTriggers)
+	{
+		count = maxTriggers;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		record = &log->records[(readIndex + i) & (WRAP_TRIGGER_LOG_SIZE - 1)];
+
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS]		= record->sampleIndex;
+		triggers[i * WRAP_TRIGGER_LOG_FIELDS + 1]	= record->timestamp;
+	}
+
+	// Make sure the records have been copied before the slots are released to the writer
+	WRAP_MEMORY_BARRIER();
+
+	log->readIndex = readIndex + count;
+	*nTriggers = count;
+
+	if (droppedTriggers != NULL)
+	{
+		dropped = log->droppedRecords;
+		*droppedTriggers = dropped - log->reportedDroppedRecords;
+		log->reportedDroppedRecords = dropped;
+	}
+}
+
+/****************************************************************************
+* initMonotonicCondition
+*
+* Initialises a condition variable whose timed waits are measured against 
+* CLOCK_MONOTONIC, so that waitForReady is not affected by changes to the 
+* system time.
+*
+****************************************************************************/
+#if !defined(WIN32) && !defined(_WIN64)
+static void initMonotonicCondition(WRAP_CONDITION * condition)
+{
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(condition, &attributes);
+	pthread_condattr_destroy(&attributes);
+}
+#endif
+
+/****************************************************************************
+* setReady
+*
+* Sets a ready flag and wakes any threads waiting for it in waitForReady.
+*
+****************************************************************************/
+static void setReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(lock);
+	*ready = 1;
+	ReleaseSRWLockExclusive(lock);
+	WakeAllConditionVariable(condition);
+#else
+	pthread_mutex_lock(lock);
+	*ready = 1;
+	pthread_cond_broadcast(condition);
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+/****************************************************************************
+* waitForReady
+*
+* Blocks the calling thread until a ready flag is set by setReady or the 
+* timeout expires, and returns the value of the flag. A timeout of 
+* WRAP_WAIT_INFINITE waits indefinitely.
+*
+****************************************************************************/
+static int16_t waitForReady(WRAP_LOCK * lock, WRAP_CONDITION * condition, volatile int16_t * ready, uint32_t timeoutMs)
+{
+	int16_t isReady = 0;
+
+#if defined(WIN32) || defined(_WIN64)
+	ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	ULONGLONG now = 0;
+
+	AcquireSRWLockExclusive(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+			continue;
+		}
+
+		now = GetTickCount64();
+
+		if (now >= deadline)
+		{
+			break;
+		}
+
+		SleepConditionVariableSRW(condition, lock, (DWORD) (deadline - now), 0);
+	}
+
+	isReady = *ready;
+	ReleaseSRWLockExclusive(lock);
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(lock);
+
+	while (!*ready)
+	{
+		if (timeoutMs == WRAP_WAIT_INFINITE)
+		{
+			pthread_cond_wait(condition, lock);
+		}
+		else if (pthread_cond_timedwait(condition, lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	isReady = *ready;
+	pthread_mutex_unlock(lock);
+#endif
+
+	return isReady;
+}
+
+/****************************************************************************
+* publishStreamingSnapshot
+*
+* Copies the streaming status into the snapshot read by GetStreamingSnapshot,
+* with ready set to the value given. Writers are serialised by snapshotLock.
+*
+****************************************************************************/
+static void publishStreamingSnapshot(WRAP_UNIT_INFO * wrapUnitInfo, int16_t ready)
+{
+	WRAP_STREAMING_SNAPSHOT * snapshot = &wrapUnitInfo->snapshot;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->snapshotLock);
+#endif
+
+	snapshot->sequence++;
+	WRAP_MEMORY_BARRIER();
+
+	snapshot->ready = ready;
+	snapshot->numSamples = wrapUnitInfo->numSamples;
+	snapshot->startIndex = wrapUnitInfo->startIndex;
+	snapshot->triggered = wrapUnitInfo->triggered;
+	snapshot->triggeredAt = wrapUnitInfo->triggeredAt;
+	snapshot->overflow = wrapUnitInfo->overflow;
+	snapshot->autoStop = wrapUnitInfo->autoStop;
+	snapshot->callbackCount = wrapUnitInfo->callbackCount;
+	snapshot->totalSamples = wrapUnitInfo->totalSamples;
+
+	WRAP_MEMORY_BARRIER();
+	snapshot->sequence++;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->snapshotLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->snapshotLock);
+#endif
+}
+
+/****************************************************************************
+* readStreamingSnapshot
+*
+* Copies the snapshot written by publishStreamingSnapshot, reading it again
+* if the streaming callback was writing it at the same time.
+*
+****************************************************************************/
+static void readStreamingSnapshot(WRAP_UNIT_INFO * wrapUnitInfo, WRAP_STREAMING_SNAPSHOT * copy)
+{
+	uint32_t sequence = 0;
+
+	do
+	{
+		sequence = wrapUnitInfo->snapshot.sequence;
+		WRAP_MEMORY_BARRIER();
+
+		*copy = wrapUnitInfo->snapshot;
+
+		WRAP_MEMORY_BARRIER();
+	}
+	while ((sequence & 1) != 0 || wrapUnitInfo->snapshot.sequence != sequence);
+}
+
+/****************************************************************************
+* getWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device, creating it the first time the handle is used.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_MEMORY_FAIL, if the structure could not be allocated.
+*
+****************************************************************************/
+static PICO_STATUS getWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	WRAP_UNIT_INFO * unitInfo = NULL;
+
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo != NULL)
+	{
+		*wrapUnitInfo = unitInfo;
+		return PICO_OK;
+	}
+
+	// Threads using a new handle at the same time must share one structure
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	unitInfo = _wrapUnitInfo[handle];
+
+	if (unitInfo == NULL)
+	{
+		unitInfo = (WRAP_UNIT_INFO *) calloc(1, sizeof(WRAP_UNIT_INFO));
+
+		if (unitInfo != NULL)
+		{
+			unitInfo->handle = handle;
+			unitInfo->channelCount = PS6000_MAX_CHANNELS;
+
+#if defined(WIN32) || defined(_WIN64)
+			InitializeSRWLock(&unitInfo->readyLock);
+			InitializeConditionVariable(&unitInfo->readyCondition);
+			InitializeSRWLock(&unitInfo->snapshotLock);
+			InitializeSRWLock(&unitInfo->diskRecorderLock);
+#else
+			pthread_mutex_init(&unitInfo->readyLock, NULL);
+			initMonotonicCondition(&unitInfo->readyCondition);
+			pthread_mutex_init(&unitInfo->snapshotLock, NULL);
+			pthread_mutex_init(&unitInfo->diskRecorderLock, NULL);
+#endif
+
+			WRAP_MEMORY_BARRIER();
+
+			_wrapUnitInfo[handle] = unitInfo;
+		}
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (unitInfo == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	*wrapUnitInfo = unitInfo;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* findWrapUnitInfo
+*
+* Returns the WRAP_UNIT_INFO structure holding the wrapper state for a 
+* device without creating it. Used by the functions that only read or clear
+* the results of a capture, which have nothing to report for a device that 
+* has not been set up.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS findWrapUnitInfo(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	if (handle <= 0 || _wrapUnitInfo[handle] == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	*wrapUnitInfo = _wrapUnitInfo[handle];
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* beginStreamingCall
+*
+* Finds the wrapper state for a device and records that a call to the 
+* driver that may run StreamingCallback with it is in progress, so that 
+* releaseWrapUnitInfo does not free the state until endStreamingCall.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0 or the 
+*						wrapper holds no state for it.
+*
+****************************************************************************/
+static PICO_STATUS beginStreamingCall(int16_t handle, WRAP_UNIT_INFO ** wrapUnitInfo)
+{
+	PICO_STATUS status = PICO_OK;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	status = findWrapUnitInfo(handle, wrapUnitInfo);
+
+	if (status == PICO_OK)
+	{
+		(*wrapUnitInfo)->streamingCallsInProgress++;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	return status;
+}
+
+/****************************************************************************
+* endStreamingCall
+*
+* Records the end of a call started with beginStreamingCall and wakes 
+* releaseWrapUnitInfo if it is waiting for the state of the device.
+*
+****************************************************************************/
+static void endStreamingCall(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+	WakeAllConditionVariable(&_wrapUnitInfoCondition);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+	wrapUnitInfo->streamingCallsInProgress--;
+	pthread_cond_broadcast(&_wrapUnitInfoCondition);
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* getTriggerArena
+*
+* Returns the trigger arena for a device, cleared for nStructures structures
+* of structureSize bytes. If there are more structures than the arena holds,
+* heap space kept for the device is returned instead, grown if needed.
+*
+* Returns:
+*
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the handle is less than or equal to 0.
+* PICO_INVALID_PARAMETER, if nStructures is negative.
+* PICO_MEMORY_FAIL, if the WRAP_UNIT_INFO structure or the heap space could
+*					not be allocated.
+*
+****************************************************************************/
+static PICO_STATUS getTriggerArena(int16_t handle, int16_t nStructures, size_t structureSize, void ** arena)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = PICO_OK;
+	size_t size = (size_t) nStructures * structureSize;
+	void * overflow = NULL;
+
+	if (nStructures < 0)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	// The arena holds WRAP_MAX_TRIGGER_STRUCTURES of the largest structure
+	if (size <= sizeof(WRAP_TRIGGER_ARENA))
+	{
+		memset(&wrapUnitInfo->triggerArena, 0, size);
+		*arena = &wrapUnitInfo->triggerArena;
+
+		return PICO_OK;
+	}
+
+	if (wrapUnitInfo->triggerArenaOverflowSize < size)
+	{
+		overflow = realloc(wrapUnitInfo->triggerArenaOverflow, size);
+
+		if (overflow == NULL)
+		{
+			return PICO_MEMORY_FAIL;
+		}
+
+		wrapUnitInfo->triggerArenaOverflow = overflow;
+		wrapUnitInfo->triggerArenaOverflowSize = size;
+	}
+
+	memset(wrapUnitInfo->triggerArenaOverflow, 0, size);
+	*arena = wrapUnitInfo->triggerArenaOverflow;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* sleepMicroseconds
+*
+* Suspends the calling thread for at least the given time. On Windows the 
+* time is rounded up to a whole number of milliseconds.
+*
+****************************************************************************/
+static void sleepMicroseconds(uint32_t microseconds)
+{
+#if defined(WIN32) || defined(_WIN64)
+	Sleep((microseconds + 999) / 1000);
+#else
+	usleep(microseconds);
+#endif
+}
+
+/****************************************************************************
+* stagingSpace
+*
+* Returns the number of bytes free in the staging buffer of a recording.
+*
+****************************************************************************/
+static uint64_t stagingSpace(WRAP_DISK_RECORDER * recorder)
+{
+	return recorder->stagingSize - (recorder->writeCursor - recorder->readCursor);
+}
+
+/****************************************************************************
+* copyToStaging
+*
+* Copies length bytes into the staging buffer at the given total byte 
+* position, splitting the copy where it wraps around the end of the buffer.
+* The data is not visible to the writer thread until writeCursor is moved 
+* past it.
+*
+****************************************************************************/
+static void copyToStaging(WRAP_DISK_RECORDER * recorder, uint64_t position, const void * source, uint64_t length)
+{
+	uint64_t offset = position & (recorder->stagingSize - 1);
+	uint64_t firstPart = recorder->stagingSize - offset;
+
+	if (length <= firstPart)
+	{
+		memcpy(&recorder->staging[offset], source, (size_t) length);
+	}
+	else
+	{
+		memcpy(&recorder->staging[offset], source, (size_t) firstPart);
+		memcpy(recorder->staging, (const uint8_t *) source + firstPart, (size_t) (length - firstPart));
+	}
+}
+
+/****************************************************************************
+* stageRecord
+*
+* Adds a record with no data to the staging buffer. Returns 0 if there is 
+* not enough space.
+*
+****************************************************************************/
+static int16_t stageRecord(WRAP_DISK_RECORDER * recorder, uint32_t type, uint64_t sampleIndex, uint32_t noOfSamples, int16_t flags)
+{
+	WRAP_DISK_RECORD_HEADER record;
+
+	if (stagingSpace(recorder) < sizeof(record))
+	{
+		return 0;
+	}
+
+	memset(&record, 0, sizeof(record));
+	record.type = type;
+	record.sampleIndex = sampleIndex;
+	record.noOfSamples = noOfSamples;
+	record.flags = flags;
+
+	copyToStaging(recorder, recorder->writeCursor, &record, sizeof(record));
+
+	// Make sure the record is in the buffer before the writer thread can see it
+	WRAP_MEMORY_BARRIER();
+	recorder->writeCursor += sizeof(record);
+
+	return 1;
+}
+
+/****************************************************************************
+* recordStreamingData
+*
+* Called from the streaming callback to stage the data and markers for one 
+* block of samples. If the staging buffer is full the samples are counted 
+* as dropped and reported with a WRAP_DISK_RECORD_DROPPED record once there 
+* is space again, so the callback never waits for the file.
+*
+****************************************************************************/
+static void recordStreamingData(WRAP_UNIT_INFO * wrapUnitInfo, uint32_t noOfSamples, uint32_t startIndex, int16_t overflow, 
+	uint32_t triggerAt, int16_t triggered)
+{
+	WRAP_DISK_RECORDER * recorder = wrapUnitInfo->diskRecorder;
+	WRAP_BUFFER_INFO * wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+	WRAP_DISK_RECORD_HEADER record;
+	static const uint8_t padding[WRAP_DISK_RECORD_ALIGNMENT] = { 0 };
+	uint64_t position = 0;
+	uint64_t dataLength = 0;
+	uint16_t bufferMask = 0;
+	int16_t nBuffers = 0;
+	int16_t channel = 0;
+	int16_t buffer = 0;
+
+	if (recorder->status != PICO_OK)
+	{
+		return;
+	}
+
+	// Report any earlier gap before the data that follows it
+	if (recorder->pendingDroppedSamples > 0)
+	{
+		if (stageRecord(recorder, WRAP_DISK_RECORD_DROPPED, recorder->firstDroppedSample, (uint32_t) recorder->pendingDroppedSamples, 0))
+		{
+			recorder->pendingDroppedSamples = 0;
+		}
+	}
+
+	if (overflow)
+	{
+		stageRecord(recorder, WRAP_DISK_RECORD_OVERFLOW, recorder->sampleCount, noOfSamples, overflow);
+	}
+
+	if (triggered)
+	{
+		stageRecord(recorder, WRAP_DISK_RECORD_TRIGGER, recorder->sampleCount + triggerAt, 0, 0);
+	}
+
+	for (channel = (int16_t) PS6000_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+	{
+		if (wrapUnitInfo->enabledChannels[channel])
+		{
+			for (buffer = channel * 2; buffer <= channel * 2 + 1; buffer++)
+			{
+				if (wrapBufferInfo->driverBuffers[buffer])
+				{
+					bufferMask |= (uint16_t) (1 << buffer);
+					nBuffers++;
+				}
+			}
+		}
+	}
+
+	if (noOfSamples == 0)
+	{
+		return;
+	}
+
+	// Calculated in 64 bits so that a large block cannot wrap to a small length
+	dataLength = (uint64_t) nBuffers * noOfSamples * sizeof(int16_t);
+	dataLength = (dataLength + WRAP_DISK_RECORD_ALIGNMENT - 1) & ~((uint64_t) WRAP_DISK_RECORD_ALIGNMENT - 1);
+
+	if (recorder->pendingDroppedSamples > 0 || dataLength > UINT32_MAX || stagingSpace(recorder) < sizeof(record) + dataLength)
+	{
+		if (recorder->pendingDroppedSamples == 0)
+		{
+			recorder->firstDroppedSample = recorder->sampleCount;
+		}
+
+		recorder->pendingDroppedSamples += noOfSamples;
+		recorder->droppedSamples += noOfSamples;
+		recorder->sampleCount += noOfSamples;
+		return;
+	}
+
+	memset(&record, 0, sizeof(record));
+	record.type = WRAP_DISK_RECORD_SAMPLES;
+	record.length = (uint32_t) dataLength;
+	record.sampleIndex = recorder->sampleCount;
+	record.noOfSamples = noOfSamples;
+	record.bufferMask = bufferMask;
+
+	position = recorder->writeCursor;
+	copyToStaging(recorder, position, &record, sizeof(record));
+	position += sizeof(record);
+
+	for (buffer = 0; buffer < PS6000_MAX_CHANNEL_BUFFERS; buffer++)
+	{
+		if (bufferMask & (1 << buffer))
+		{
+			copyToStaging(recorder, position, &wrapBufferInfo->driverBuffers[buffer][startIndex], noOfSamples * sizeof(int16_t));
+			position += noOfSamples * sizeof(int16_t);
+		}
+	}
+
+	copyToStaging(recorder, position, padding, recorder->writeCursor + sizeof(record) + dataLength - position);
+
+	WRAP_MEMORY_BARRIER();
+	recorder->writeCursor += sizeof(record) + dataLength;
+	recorder->sampleCount += noOfSamples;
+}
+
+/****************************************************************************
+* runDiskWriter
+*
+* Body of the disk writer thread. Writes the staged data to the file a 
+* block at a time until it is asked to stop, then writes whatever is left.
+*
+****************************************************************************/
+static void runDiskWriter(WRAP_DISK_RECORDER * recorder)
+{
+	uint64_t available = 0;
+	uint64_t offset = 0;
+	uint64_t length = 0;
+	int16_t stopRequested = 0;
+
+	for (;;)
+	{
+		stopRequested = recorder->stopRequested;
+		available = recorder->writeCursor - recorder->readCursor;
+
+		// Make sure the data is read after the cursor that covers it
+		WRAP_MEMORY_BARRIER();
+
+		if (available >= WRAP_DISK_WRITE_BLOCK || (stopRequested && available > 0))
+		{
+			offset = recorder->readCursor & (recorder->stagingSize - 1);
+			length = (available < WRAP_DISK_WRITE_BLOCK) ? available : WRAP_DISK_WRITE_BLOCK;
+
+			if (length > recorder->stagingSize - offset)
+			{
+				length = recorder->stagingSize - offset;
+			}
+
+			if (fwrite(&recorder->staging[offset], 1, (size_t) length, recorder->file) != length)
+			{
+				recorder->status = PICO_OPERATION_FAILED;
+				break;
+			}
+
+			WRAP_MEMORY_BARRIER();
+			recorder->readCursor += length;
+		}
+		else if (stopRequested)
+		{
+			break;
+		}
+		else
+		{
+			sleepMicroseconds(WRAP_DISK_WRITER_POLL_US);
+		}
+	}
+
+	if (fflush(recorder->file) != 0)
+	{
+		recorder->status = PICO_OPERATION_FAILED;
+	}
+}
+
+#if defined(WIN32) || defined(_WIN64)
+static DWORD WINAPI diskWriterThread(LPVOID parameter)
+{
+	runDiskWriter((WRAP_DISK_RECORDER *) parameter);
+	return 0;
+}
+#else
+static void * diskWriterThread(void * parameter)
+{
+	runDiskWriter((WRAP_DISK_RECORDER *) parameter);
+	return NULL;
+}
+#endif
+
+/****************************************************************************
+* freeDiskRecorder
+*
+* Closes the file and frees the memory used by a recording.
+*
+****************************************************************************/
+static void freeDiskRecorder(WRAP_DISK_RECORDER * recorder)
+{
+	if (recorder->file != NULL)
+	{
+		fclose(recorder->file);
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	_aligned_free(recorder->staging);
+#else
+	free(recorder->staging);
+#endif
+
+	free(recorder);
+}
+
+/****************************************************************************
+* detachDiskRecorder
+*
+* Removes the recording from the device under diskRecorderLock and returns 
+* it, or NULL if no recording is in progress. Once this returns, the 
+* streaming callback and GetDiskRecordingStatus no longer use the recording.
+*
+****************************************************************************/
+static WRAP_DISK_RECORDER * detachDiskRecorder(WRAP_UNIT_INFO * wrapUnitInfo)
+{
+	WRAP_DISK_RECORDER * recorder = NULL;
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	recorder = wrapUnitInfo->diskRecorder;
+	wrapUnitInfo->diskRecorder = NULL;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	return recorder;
+}
+
+/****************************************************************************
+* stopDiskRecorder
+*
+* Adds the end record, waits for the writer thread to write everything 
+* that is staged and frees the recording. Returns the status of the writer.
+* The recording must already have been detached from the device with 
+* detachDiskRecorder, so the streaming callback no longer stages data in it.
+*
+****************************************************************************/
+static PICO_STATUS stopDiskRecorder(WRAP_DISK_RECORDER * recorder)
+{
+	PICO_STATUS status = PICO_OK;
+
+	if (recorder->pendingDroppedSamples > 0)
+	{
+		while (recorder->status == PICO_OK && 
+			!stageRecord(recorder, WRAP_DISK_RECORD_DROPPED, recorder->firstDroppedSample, (uint32_t) recorder->pendingDroppedSamples, 0))
+		{
+			sleepMicroseconds(WRAP_DISK_WRITER_POLL_US);
+		}
+	}
+
+	while (recorder->status == PICO_OK && !stageRecord(recorder, WRAP_DISK_RECORD_END, recorder->sampleCount, 0, 0))
+	{
+		sleepMicroseconds(WRAP_DISK_WRITER_POLL_US);
+	}
+
+	recorder->stopRequested = 1;
+
+#if defined(WIN32) || defined(_WIN64)
+	WaitForSingleObject(recorder->writerThread, INFINITE);
+	CloseHandle(recorder->writerThread);
+#else
+	pthread_join(recorder->writerThread, NULL);
+#endif
+
+	status = recorder->status;
+
+	if (fclose(recorder->file) != 0 && status == PICO_OK)
+	{
+		status = PICO_OPERATION_FAILED;
+	}
+
+	recorder->file = NULL;
+	freeDiskRecorder(recorder);
+
+	return status;
+}
+
+/****************************************************************************
+* Streaming Callback
+*
+* See ps6000StreamingReady (callback)
+*
+****************************************************************************/
+void PREF1 StreamingCallback(
+    int16_t handle,
+	uint32_t noOfSamples,
+	uint32_t startIndex,
+	int16_t overflow,
+	uint32_t triggerAt,
+	int16_t triggered,
+	int16_t autoStop,
+	void * pParameter)
+{
+	int16_t channel = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
+	
+	if (pParameter == NULL)
+	{
+		return;
+	}
+
+	wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+	_wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+
+	wrapUnitInfo->numSamples = noOfSamples;
+	wrapUnitInfo->autoStop = autoStop;
+	wrapUnitInfo->startIndex = startIndex;
+
+	wrapUnitInfo->triggered = triggered;
+	wrapUnitInfo->triggeredAt = triggerAt;
+
+	wrapUnitInfo->overflow = overflow;
+
+	// Verify if data received
+	if (noOfSamples)
+	{
+		
+		for (channel = (int16_t) PS6000_CHANNEL_A; channel < wrapUnitInfo->channelCount; channel++)
+		{
+			if (wrapUnitInfo->enabledChannels[channel])
+			{
+
+				// Copy data...
+				if (_wrapBufferInfo->appBuffers && _wrapBufferInfo->driverBuffers)
+				{
+					// Max buffers
+					if (_wrapBufferInfo->appSegments[channel * 2].nSegments && _wrapBufferInfo->driverBuffers[channel * 2])
+					{
+						copyToSegments(&_wrapBufferInfo->appSegments[channel * 2], wrapUnitInfo->totalSamples, &_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
+					}
+					else if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
+					{
+						copySamples(&_wrapBufferInfo->appBuffers[channel * 2][startIndex], &_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples);
+					}
+
+					// Min buffers
+					if (_wrapBufferInfo->appSegments[channel * 2 + 1].nSegments && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
+					{
+						copyToSegments(&_wrapBufferInfo->appSegments[channel * 2 + 1], wrapUnitInfo->totalSamples, &_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples);
+					}
+					else if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
+					{
+						copySamples(&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex], &_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples);
+					}
+				}
+
+				// Conversion to volts
+				if (_wrapBufferInfo->scaling[channel].maxADCValue > 0)
+				{
+					convertStreamingData(_wrapBufferInfo, channel, channel * 2, startIndex, noOfSamples);
+					convertStreamingData(_wrapBufferInfo, channel, channel * 2 + 1, startIndex, noOfSamples);
+				}
+			}
+		}
+	}
+  
+	if (noOfSamples || triggered || overflow)
+	{
+		// Staging never waits for the file, so StopDiskRecording is held up for one block at most
+#if defined(WIN32) || defined(_WIN64)
+		AcquireSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+		pthread_mutex_lock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+		if (wrapUnitInfo->diskRecorder != NULL)
+		{
+			recordStreamingData(wrapUnitInfo, noOfSamples, startIndex, overflow, triggerAt, triggered);
+		}
+
+#if defined(WIN32) || defined(_WIN64)
+		ReleaseSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+		pthread_mutex_unlock(&wrapUnitInfo->diskRecorderLock);
+#endif
+	}
+
+	logStreamingTrigger(&wrapUnitInfo->triggerLog, noOfSamples, triggered, triggerAt);
+	pushStreamingEvent(&wrapUnitInfo->eventQueue, noOfSamples, startIndex, triggered, triggerAt, overflow, autoStop);
+
+	wrapUnitInfo->totalSamples += noOfSamples;
+	wrapUnitInfo->callbackCount++;
+	publishStreamingSnapshot(wrapUnitInfo, 1);
+
+	setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+}
+
+/****************************************************************************
+* BlockCallback
+*
+* See ps6000BlockReady (callback)
+*
+****************************************************************************/
+void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = (WRAP_UNIT_INFO *) pParameter;
+
+	// Holding the lock stops releaseWrapUnitInfo freeing the state until the callback has finished
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
+
+	// The state may have been released since the capture was started
+	if (wrapUnitInfo != NULL && handle > 0 && _wrapUnitInfo[handle] == wrapUnitInfo)
+	{
+		publishStreamingSnapshot(wrapUnitInfo, 1);
+		setReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready);
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+}
+
+/****************************************************************************
+* RunBlock
+*
+* This function starts collecting data in block mode without the requirement 
+* for specifying callback functions. Use the IsReady function in conjunction 
+* to poll the driver once this function has been called.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* preTriggerSamples - see noOfPreTriggerSamples in ps6000RunBlock.
+* postTriggerSamples - see noOfPreTriggerSamples in ps6000RunBlock.
+* timebase - see ps6000RunBlock.
+* oversample - see ps6000RunBlock.
+* segmentIndex - see ps6000RunBlock.
+*
+*
+* Returns:
+*
+* See ps6000RunBlock return values.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 RunBlock(int16_t handle, uint32_t preTriggerSamples, uint32_t postTriggerSamples,
+            uint32_t timebase, int16_t oversample, uint32_t segmentIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return (int16_t) status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = preTriggerSamples + postTriggerSamples;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	return (int16_t) ps6000RunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, oversample, 
+		NULL, segmentIndex, BlockCallback, wrapUnitInfo);
+}
+
+/****************************************************************************
+* GetStreamingLatestValues
+*
+* Facilitates communication with the driver to return the next block of 
+* values to your application when capturing data in streaming mode. Use with 
+* programming languages that do not support callback functions.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* See ps6000GetStreamingLatestValues return values.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = beginStreamingCall(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->numSamples = 0;
+	wrapUnitInfo->autoStop = 0;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
+
+	status = ps6000GetStreamingLatestValues(handle, StreamingCallback, wrapUnitInfo);
+
+	endStreamingCall(wrapUnitInfo);
+
+	return status;
+}
+
 /****************************************************************************
-* Streaming Callback
+* Available Data
+*
+* Returns the number of samples returned from the driver and shows the start 
+* index of the data in the application buffer when collecting data in 
+* streaming mode.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* startIndex - on exit, an index to the first valid sample in the buffer 
+*				(When data is available).
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - the number of samples returned from the driver.
+*
+****************************************************************************/
+extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return (uint32_t) 0;
+	}
+
+	if ( wrapUnitInfo->ready ) 
+	{
+		*startIndex = wrapUnitInfo->startIndex;
+		return wrapUnitInfo->numSamples;
+	}
+	return (uint32_t) 0;
+}
+
+/****************************************************************************
+* AutoStopped
+*
+* Indicates if the device has stopped on collection of the number of samples 
+* specified in the call to the ps6000RunStreaming function (if the 
+* ps6000RunStreaming function's autostop flag is set).
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* Non-zero - if streaming has autostopped.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if (wrapUnitInfo->ready)
+	{
+		return wrapUnitInfo->autoStop;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+* IsReady
+*
+* This function is used to poll the driver to verify that data is ready to be 
+* received. The RunBlock or GetStreamingLatestValues function must have been 
+* called prior to calling this function.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+*
+* Returns:
+*
+* 0 - Data is not yet available.
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return wrapUnitInfo->ready;
+}
+
+/****************************************************************************
+* WaitForStreamingData
+*
+* Blocks the calling thread until the streaming callback has been called 
+* following a call to GetStreamingLatestValues, or until the timeout 
+* expires. Use this function instead of polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - Data is not yet available (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForStreamingData(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* WaitForBlockReady
+*
+* Blocks the calling thread until a block mode capture started with RunBlock
+* has completed, or until the timeout expires. Use this function instead of
+* polling IsReady in a loop.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* timeoutMs - the maximum time to wait in milliseconds, or 0xFFFFFFFF to 
+*				wait indefinitely.
+*
+* Returns:
+*
+* 0 - The capture has not completed (the timeout expired).
+* Non-zero - Data is ready to be collected.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 WaitForBlockReady(int16_t handle, uint32_t timeoutMs)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return waitForReady(&wrapUnitInfo->readyLock, &wrapUnitInfo->readyCondition, &wrapUnitInfo->ready, timeoutMs);
+}
+
+/****************************************************************************
+* IsTriggerReady
+*
+* Indicates whether a trigger has occurred when collecting data in streaming 
+* mode, and the location of the trigger point in the buffer.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* triggeredAt - on exit, the index of the sample in the buffer where the 
+* trigger occurred.
+*
+* Returns:
+*
+* 0 - The device has not triggered.
+* Non-zero - The device has been triggered.
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return 0;
+	}
+
+	if (wrapUnitInfo->triggered)
+	{
+		*triggeredAt = wrapUnitInfo->triggeredAt;
+	}
+
+	return wrapUnitInfo->triggered;
+}
+
+/****************************************************************************
+* ClearTriggerReady
+*
+* Clears the triggered and triggeredAt flags in relation to streaming mode 
+* capture.
+*
+* Triggers recorded for DrainTriggerLog are not affected.
+*
+* Input Arguments:
+*
+* None
+*
+* Returns:
+*
+* 1
+*
+****************************************************************************/
+extern int16_t PREF0 PREF1 ClearTriggerReady(int16_t handle)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		wrapUnitInfo->triggeredAt = 0;
+		wrapUnitInfo->triggered = FALSE;
+	}
+
+	return 1;
+}
+
+/****************************************************************************
+* SetTriggerConditions
+*
+* This function sets up trigger conditions on the scope's inputs. The trigger 
+* is defined by one or more sets of integers corresponding to 
+* PS6000_TRIGGER_CONDITIONS structures which are then converted and passed 
+* to the ps6000SetTriggerChannelConditions function.
+*
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* conditionsArray - an array of integer values specifying the conditions 
+*					for each channel.
+* nConditions - the number that will be passed after the wrapper code has 
+*				created its structures. (i.e. the number of conditionsArray 
+*				elements / 7)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
+*
+* Returns:
+*
+* See ps6000SetTriggerChannelConditions return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions)
+{
+	PICO_STATUS status;
+	int16_t i = 0;
+	int16_t j = 0;
+
+	PS6000_TRIGGER_CONDITIONS * conditions = NULL;
+
+	status = getTriggerArena(handle, nConditions, sizeof(PS6000_TRIGGER_CONDITIONS), (void **) &conditions);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nConditions; i++)
+	{
+		conditions[i].channelA 				= (PS6000_TRIGGER_STATE) conditionsArray[j];
+		conditions[i].channelB 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 1];
+		conditions[i].channelC 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 2];
+		conditions[i].channelD 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 3];
+		conditions[i].external 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 4];
+		conditions[i].aux					= (PS6000_TRIGGER_STATE) conditionsArray[j + 5];
+		conditions[i].pulseWidthQualifier	= (PS6000_TRIGGER_STATE) conditionsArray[j + 6];
+
+		j = j + 7;
+	}
+	status = ps6000SetTriggerChannelConditions(handle, conditions, nConditions);
+
+	return status;
+}
+
+/****************************************************************************
+* SetTriggerProperties
+*
+* This function is used to enable or disable triggering and set its 
+* parameters by means of assigning the values from the propertiesArray to an 
+* array of TRIGGER_CHANNEL_PROPERTIES structures which are then passed to 
+* the ps6000SetTriggerChannelProperties function with the other parameters.
+
+* Use this function with programming languages that do not support structs.
 *
-* See ps6000StreamingReady (callback)
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* propertiesArray - an array of sets of integers corresponding to 
+*					TRIGGER_CHANNEL_PROPERTIES structures describing the 
+*					required properties to be set. See also channelProperties
+*					in ps6000SetTriggerChannelProperties.
+*
+* nProperties - the number that will be passed after the wrapper code has 
+*				created its structures. (i.e. the number of propertiesArray 
+*				elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
+* autoTrig - see autoTriggerMilliseconds in ps6000SetTriggerChannelProperties.
+*
+*
+* Returns:
+*
+* See ps6000SetTriggerChannelProperties return values.
+* PICO_INVALID_PARAMETER, if nProperties is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
 *
 ****************************************************************************/
-void PREF1 StreamingCallback(
-    int16_t handle,
-	uint32_t noOfSamples,
-	uint32_t startIndex,
-	int16_t overflow,
-	uint32_t triggerAt,
-	int16_t triggered,
-	int16_t autoStop,
-	void * pParameter)
+extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(
+	int16_t handle, 
+	int32_t *propertiesArray, 
+	int16_t nProperties,  
+	int32_t autoTrig)
 {
-	int16_t channel = 0;
-	WRAP_BUFFER_INFO * _wrapBufferInfo = NULL;
+	PS6000_TRIGGER_CHANNEL_PROPERTIES * channelProperties = NULL;
+	int16_t i;
+	int16_t j = 0;
+	int16_t auxEnable = 0;
+	PICO_STATUS status;
 	
-	if (pParameter != NULL)
+	status = getTriggerArena(handle, nProperties, sizeof(PS6000_TRIGGER_CHANNEL_PROPERTIES), (void **) &channelProperties);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	for (i = 0; i < nProperties; i++)
 	{
-		_wrapBufferInfo = (WRAP_BUFFER_INFO *) pParameter;
+		channelProperties[i].thresholdUpper		= propertiesArray[j];
+		channelProperties[i].hysteresisUpper	= propertiesArray[j + 1];
+		channelProperties[i].thresholdLower		= propertiesArray[j + 2];
+		channelProperties[i].hysteresisLower	= propertiesArray[j + 3];
+		channelProperties[i].channel			= (PS6000_CHANNEL) propertiesArray[j + 4];
+		channelProperties[i].thresholdMode		= (PS6000_THRESHOLD_MODE) propertiesArray[j + 5];
+
+		j = j + 6;
 	}
+	
+	status = ps6000SetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
+	return status;
+}
+
+/****************************************************************************
+* SetPulseWidthQualifier
+*
+* This function is used to pulse-width triggering and set 
+* its parameters by means of assigning the values from the pwqConditionsArray 
+* to an array of PS6000_PWQ_CONDITIONS structures which are then passed to 
+* the ps6000SetPulseWidthQualifier function with the other parameters.
+
+* Use this function with programming languages that do not support structs.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* pwqConditionsArray - an array of sets of integers corresponding to 
+*					PS6000_PWQ_CONDITIONS structures describing the 
+*					required properties to be set. See also conditions
+*					in ps6000SetPulseWidthQualifier.
+*
+* nConditions - the number that will be passed after the wrapper code has 
+*				created its structures. (i.e. the number of conditionsArray 
+*				elements / 6)
+*				More than WRAP_MAX_TRIGGER_STRUCTURES (32) structures are converted 
+*				in heap memory instead of the trigger arena.
+*
+* direction - the direction of the signal required for the pulse width
+*				trigger to fire (See PS6000_THRESHOLD_DIRECTION constants)
+* lower - the lower limit of the pulse-width counter with relation to
+			number of samples captured on the device.
+* upper - the upper limit of the pulse-width counter with relation to
+*			number of samples captured on the device.
+* type - the pulse-width type (see ps6000SetPulseWidthQualifier).
+*
+* Returns:
+*
+* See ps6000SetPulseWidthQualifier return values.
+* PICO_INVALID_PARAMETER, if nConditions is negative.
+* PICO_MEMORY_FAIL, if the memory for more than WRAP_MAX_TRIGGER_STRUCTURES 
+*					structures could not be allocated.
+*
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(
+	int16_t handle,
+	int32_t *pwqConditionsArray,
+	int16_t nConditions,
+	int32_t direction,
+	uint32_t lower,
+	uint32_t upper,
+	int32_t type)
+{
+	PS6000_PWQ_CONDITIONS * pwqConditions = NULL;
 
-	_numSamples = noOfSamples;
-	_autoStop = autoStop;
-	_startIndex = startIndex;
+	int16_t i;
+	int16_t j = 0;
 
-	_triggered = triggered;
-	_triggeredAt = triggerAt;
+	PICO_STATUS status;
 
-	_overflow = overflow;
+	status = getTriggerArena(handle, nConditions, sizeof(PS6000_PWQ_CONDITIONS), (void **) &pwqConditions);
 
-	// Verify if wrapper buffer info set and data received
-	if (_wrapBufferInfo != NULL && noOfSamples)
+	if (status != PICO_OK)
 	{
-		
-		for (channel = (int16_t) PS6000_CHANNEL_A; channel < _channelCount; channel++)
-		{
-			if (_enabledChannels[channel])
-			{
+		return status;
+	}
 
-				// Copy data...
-				if (_wrapBufferInfo->appBuffers && _wrapBufferInfo->driverBuffers)
-				{
-					// Max buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2]  && _wrapBufferInfo->driverBuffers[channel * 2])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2][startIndex], noOfSamples * sizeof(int16_t));
-					}
+	for (i = 0; i < nConditions; i++)
+	{
+		pwqConditions[i].channelA = (PS6000_TRIGGER_STATE) pwqConditionsArray[j];
+		pwqConditions[i].channelB = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 1];
+		pwqConditions[i].channelC = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 2];
+		pwqConditions[i].channelD = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 3];
+		pwqConditions[i].external = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 4];
+		pwqConditions[i].aux      = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 5];
 
-					// Min buffers
-					if (_wrapBufferInfo->appBuffers[channel * 2 + 1] && _wrapBufferInfo->driverBuffers[channel * 2 + 1])
-					{
-						memcpy_s (&_wrapBufferInfo->appBuffers[channel * 2 + 1][startIndex],  noOfSamples * sizeof(int16_t),
-							&_wrapBufferInfo->driverBuffers[channel * 2 + 1][startIndex], noOfSamples * sizeof(int16_t));
-					}
-				}
-			}
-		}
+		j = j + 6;
 	}
-  
-	_ready = 1;
+
+	status = ps6000SetPulseWidthQualifier(handle, pwqConditions, nConditions, (PS6000_THRESHOLD_DIRECTION) direction, lower, upper, (PS6000_PULSE_WIDTH_TYPE) type);
+	return status;
 }
 
 /****************************************************************************
-* BlockCallback
+* setChannelCount
 *
-* See ps6000BlockReady (callback)
+* Set the number of channels on the device. This is used to assist with 
+* copying data in the streaming callback.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channelCount - the number of channels on the device.
 *
 ****************************************************************************/
-void PREF1 BlockCallback(int16_t handle, PICO_STATUS status, void * pParameter)
+extern void PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
 {
-	_ready = 1;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		wrapUnitInfo->channelCount = channelCount;
+	}
 }
 
 /****************************************************************************
-* RunBlock
+* setEnabledChannels
 *
-* This function starts collecting data in block mode without the requirement 
-* for specifying callback functions. Use the IsReady function in conjunction 
-* to poll the driver once this function has been called.
+* Set the number of enabled channels on the device. This is used to assist with 
+* copying data in the streaming callback.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* preTriggerSamples - see noOfPreTriggerSamples in ps6000RunBlock.
-* postTriggerSamples - see noOfPreTriggerSamples in ps6000RunBlock.
-* timebase - see ps6000RunBlock.
-* oversample - see ps6000RunBlock.
-* segmentIndex - see ps6000RunBlock.
+* handle - the device handle.
+* enabledChannels - an array representing the channel states. This must be 
+*					4 elements in size.
+*
+* Returns:
+*
+* 0 if successful,
+* -1 if handle <= 0 or channelCount is out of range
+****************************************************************************/
+extern int16_t PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (wrapUnitInfo->channelCount > 0 && wrapUnitInfo->channelCount <= PS6000_MAX_CHANNELS)
+		{
+			memcpy_s((int16_t *)wrapUnitInfo->enabledChannels, PS6000_MAX_CHANNELS * sizeof(int16_t), 
+				(int16_t *)enabledChannels, PS6000_MAX_CHANNELS * sizeof(int16_t));
+			return 0;
+		}
+	}
+
+	return -1;
+
+}
+
+/****************************************************************************
+* setAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffer in order for the 
+* streaming callback to copy the data for the channel from the driver buffer 
+* to the application buffer.
+*
+* Input Arguments:
 *
+* handle - the device handle.
+* channel - the channel number (should be a numerical value corresponding to 
+			an PS6000_CHANNEL enumeration value).
+* appBuffer - the application buffer.
+* driverBuffer - the buffer set by the driver.
+* bufferLength - the length of the buffers (length must be equal).
 *
 * Returns:
 *
-* See ps6000RunBlock return values.
+* 0, if successful
+* -1, otherwise
+****************************************************************************/
+extern int16_t PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, uint32_t bufferLength)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if(channel < PS6000_CHANNEL_A || channel >= PS6000_MAX_CHANNELS)
+		{
+			return -1;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
+			wrapUnitInfo->wrapBufferInfo.appSegments[channel * 2].nSegments = 0;
+				
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return 0;
+		}
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+/****************************************************************************
+* setMaxMinAppAndDriverBuffers
+*
+* Set the application and corresponding driver buffers in order for the 
+* streaming callback to copy the data for the channel from the driver max and 
+* min buffers to the respective application buffers for aggregated data 
+* collection.
+*
+* Input Arguments:
+*
+* handle - the device handle.
+* channel - the channel number ((should be a numerical value corresponding to 
+			an PS6000_CHANNEL enumeration value).
+* appMaxBuffer - the application max buffer.
+* appMinBuffer - the application min buffer.
+* driverMaxBuffer - the max buffer set by the driver.
+* driverMinBuffer - the min buffer set by the driver.
+* bufferLength - the length of the buffers (length must be equal).
 *
+* Returns:
+*
+* 0, if successful
+* -1, otherwise
 ****************************************************************************/
-extern int16_t PREF0 PREF1 RunBlock(int16_t handle, uint32_t preTriggerSamples, uint32_t postTriggerSamples,
-            uint32_t timebase, int16_t oversample, uint32_t segmentIndex)
+extern int16_t PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, uint32_t bufferLength)
 {
-	_ready = 0;
-	_numSamples = preTriggerSamples + postTriggerSamples;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channel < PS6000_CHANNEL_A || channel >= PS6000_MAX_CHANNELS)
+		{
+			return -1;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
 
-	return (int16_t) ps6000RunBlock(handle, preTriggerSamples, postTriggerSamples, timebase, oversample, 
-		NULL, segmentIndex, BlockCallback, NULL);
+			wrapUnitInfo->wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
+			wrapUnitInfo->wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
+
+			wrapUnitInfo->wrapBufferInfo.appSegments[channel * 2].nSegments = 0;
+			wrapUnitInfo->wrapBufferInfo.appSegments[channel * 2 + 1].nSegments = 0;
+
+			wrapUnitInfo->wrapBufferInfo.bufferLengths[channel] = bufferLength;
+
+			return 0;
+		}
+	}
+	else
+	{
+		return -1;
+	}
 }
 
 /****************************************************************************
-* GetStreamingLatestValues
-*
-* Facilitates communication with the driver to return the next block of 
-* values to your application when capturing data in streaming mode. Use with 
-* programming languages that do not support callback functions.
+* setSegmentedAppAndDriverBuffers
+*
+* Sets a list of segments to use as the application buffers for a channel,
+* together with the corresponding driver buffers. Instead of copying each 
+* block to the same index in the application buffer as in the driver 
+* buffer, the streaming callback appends it to the logical buffer formed by
+* the segments, so that sample n of the capture (counted from the last 
+* call to clearStreamingParameters) is written to index n of the logical 
+* buffer. The logical buffer can therefore be longer than the driver buffer,
+* than 4 G samples, or than any one allocation. Samples after the end of 
+* the last segment are discarded - compare totalSamples from 
+* GetStreamingSnapshot64 with the total length to detect this.
+*
+* The segment lists are copied, so the arrays of pointers and lengths do 
+* not need to be kept. Conversion to volts is not applied to segmented 
+* buffers.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
+* handle - the device handle.
+* channel - the channel number (should be a numerical value corresponding to 
+			an PS6000_CHANNEL enumeration value).
+* appMaxSegments - the segments of the application max buffer (or of the 
+*					application buffer if aggregation is not used).
+* appMinSegments - the segments of the application min buffer. May be NULL
+*					if aggregation is not used.
+* segmentLengths - the length of each segment in samples. The max and min 
+*					segments with the same index must have the same length.
+* nSegments - the number of segments, from 1 to 64, or 0 to stop using 
+*				segmented buffers for the channel.
+* driverMaxBuffer - the max buffer set by the driver.
+* driverMinBuffer - the min buffer set by the driver. May be NULL if 
+*					aggregation is not used.
 *
 * Returns:
 *
-* See ps6000GetStreamingLatestValues return values.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0
+* PICO_INVALID_PARAMETER, if the channel or nSegments is out of range, or a
+*						segment is NULL or has a length of 0
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 GetStreamingLatestValues(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 setSegmentedAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t ** appMaxSegments, int16_t ** appMinSegments, 
+	uint64_t * segmentLengths, uint32_t nSegments, int16_t * driverMaxBuffer, int16_t * driverMinBuffer)
 {
-	_ready = 0;
-	_numSamples = 0;
-	_autoStop = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_BUFFER_INFO * wrapBufferInfo = NULL;
+	WRAP_SEGMENTED_BUFFER * maxSegments = NULL;
+	WRAP_SEGMENTED_BUFFER * minSegments = NULL;
+	uint64_t length = 0;
+	uint32_t segment = 0;
+	PICO_STATUS status = getWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (channel < PS6000_CHANNEL_A || channel >= PS6000_MAX_CHANNELS || nSegments > WRAP_MAX_BUFFER_SEGMENTS)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	if (nSegments > 0 && (appMaxSegments == NULL || segmentLengths == NULL))
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	for (segment = 0; segment < nSegments; segment++)
+	{
+		if (appMaxSegments[segment] == NULL || (appMinSegments != NULL && appMinSegments[segment] == NULL) || segmentLengths[segment] == 0)
+		{
+			return PICO_INVALID_PARAMETER;
+		}
+	}
+
+	wrapBufferInfo = &wrapUnitInfo->wrapBufferInfo;
+	maxSegments = &wrapBufferInfo->appSegments[channel * 2];
+	minSegments = &wrapBufferInfo->appSegments[channel * 2 + 1];
+
+	memset(maxSegments, 0, sizeof(WRAP_SEGMENTED_BUFFER));
+	memset(minSegments, 0, sizeof(WRAP_SEGMENTED_BUFFER));
+
+	for (segment = 0; segment < nSegments; segment++)
+	{
+		maxSegments->segments[segment] = appMaxSegments[segment];
+		maxSegments->segmentStarts[segment] = length;
+
+		length += segmentLengths[segment];
+	}
+
+	maxSegments->segmentStarts[nSegments] = length;
+	maxSegments->nSegments = nSegments;
 
-	return ps6000GetStreamingLatestValues(handle, StreamingCallback, &_wrapBufferInfo);
+	if (appMinSegments != NULL)
+	{
+		memcpy(minSegments->segmentStarts, maxSegments->segmentStarts, sizeof(minSegments->segmentStarts));
+
+		for (segment = 0; segment < nSegments; segment++)
+		{
+			minSegments->segments[segment] = appMinSegments[segment];
+		}
+
+		minSegments->nSegments = nSegments;
+	}
+
+	wrapBufferInfo->appBuffers[channel * 2] = NULL;
+	wrapBufferInfo->appBuffers[channel * 2 + 1] = NULL;
+	wrapBufferInfo->driverBuffers[channel * 2] = driverMaxBuffer;
+	wrapBufferInfo->driverBuffers[channel * 2 + 1] = driverMinBuffer;
+
+	wrapBufferInfo->bufferLengths[channel] = length;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* Available Data
+* clearStreamingParameters
 *
-* Returns the number of samples returned from the driver and shows the start 
-* index of the data in the application buffer when collecting data in 
-* streaming mode.
+* Sets streaming parameters to 0. Call this function before 
+* ps6000RunStreaming when using segmented application buffers, so that 
+* the first sample of the capture is written to index 0 of the buffers.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* startIndex - on exit, an index to the first valid sample in the buffer 
-*				(When data is available).
-*
-* Returns:
-*
-* 0 - Data is not yet available.
-* Non-zero - the number of samples returned from the driver.
+* handle - the device handle.
 *
 ****************************************************************************/
-extern uint32_t PREF0 PREF1 AvailableData(int16_t handle, uint32_t *startIndex)
+extern void PREF0 PREF1 clearStreamingParameters(int16_t handle)
 {
-	if ( _ready ) 
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		*startIndex = _startIndex;
-		return _numSamples;
+		return;
 	}
-	return (uint32_t) 0;
+
+	wrapUnitInfo->ready = 0;
+	wrapUnitInfo->autoStop = 0;
+	wrapUnitInfo->numSamples = 0;
+	wrapUnitInfo->triggeredAt = 0;
+	wrapUnitInfo->triggered = FALSE;
+	wrapUnitInfo->startIndex = 0;
+	wrapUnitInfo->overflow = 0;
+	wrapUnitInfo->totalSamples = 0;
+
+	publishStreamingSnapshot(wrapUnitInfo, 0);
 }
 
 /****************************************************************************
-* AutoStopped
+* getOverflow
 *
-* Indicates if the device has stopped on collection of the number of samples 
-* specified in the call to the ps6000RunStreaming function (if the 
-* ps6000RunStreaming function's autostop flag is set).
+* Returns indication if there has been an overvoltage on one or more
+* analogue inputs when collecting data in streaming mode.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
+* overflow - on exit, a set of flags that indicate whether an overvoltage
+*						has occurred on any of the channels. It is a bit field with
+*						bit 0 denoting channel A.
 *
 * Returns:
 *
-* Non-zero - if streaming has autostopped.
+* PICO_OK, if successful, or
+* PICO_INVALID_HANDLE if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
 *
 ****************************************************************************/
-extern int16_t PREF0 PREF1 AutoStopped(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 getOverflow(int16_t handle, int16_t * overflow)
 {
-	if (_ready)
-	{
-		return _autoStop;
-	}
+		WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+		PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
 
-	return 0;
+		if (status == PICO_OK)
+		{
+				*overflow = wrapUnitInfo->overflow;
+		}
+
+		return status;
 }
 
 /****************************************************************************
-* IsReady
+* DrainStreamingEvents
 *
-* This function is used to poll the driver to verify that data is ready to be 
-* received. The RunBlock or GetStreamingLatestValues function must have been 
-* called prior to calling this function.
+* Returns the records of all streaming callbacks received since the last call
+* to this function, oldest first, in a single call. Unlike AvailableData and 
+* IsTriggerReady, which only report the latest callback, no callback 
+* information is lost if the application polls slowly, provided the queue of
+* 1024 records does not fill up.
+*
+* Each record is returned as 8 consecutive values in the events array:
+*
+* [0] numSamples - the number of samples collected.
+* [1] startIndex - an index to the first valid sample in the buffer.
+* [2] triggered - non-zero if a trigger occurred.
+* [3] triggeredAt - the index of the trigger point relative to startIndex.
+* [4] overflow - overvoltage flags, bit 0 denoting channel A.
+* [5] autoStop - non-zero if streaming has autostopped.
+* [6] timestamp (low 32 bits) - host time in microseconds when the callback
+*		was received.
+* [7] timestamp (high 32 bits).
+*
+* See also ps6000StreamingReady for a description of the callback parameters.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
+* events - an array of at least maxEvents * 8 elements.
+* maxEvents - the maximum number of records to return.
+* nEvents - on exit, the number of records copied into events.
+* droppedEvents - on exit, the number of records that have been discarded 
+*					because the queue was full since the last call to this
+*					function. May be NULL.
 *
 * Returns:
 *
-* 0 - Data is not yet available.
-* Non-zero - Data is ready to be collected.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if events or nEvents is NULL
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsReady(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents(int16_t handle, uint32_t * events, uint32_t maxEvents, uint32_t * nEvents, uint32_t * droppedEvents)
 {
-	return _ready;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (events == NULL || nEvents == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	drainStreamingEventQueue(&wrapUnitInfo->eventQueue, events, maxEvents, nEvents, droppedEvents);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* IsTriggerReady
+* DrainTriggerLog
 *
-* Indicates whether a trigger has occurred when collecting data in streaming 
-* mode, and the location of the trigger point in the buffer.
+* Returns the triggers reported by the streaming callback since the last 
+* call to this function, oldest first. Every trigger is kept until it is
+* read, provided the log of 4096 records does not fill up, so unlike 
+* IsTriggerReady no trigger is lost if the application polls slowly, and 
+* ClearTriggerReady has no effect on the log.
+*
+* Each record is returned as 2 consecutive values in the triggers array:
+*
+* [0] sampleIndex - the index of the trigger point counted from the first 
+*		sample received after resetTriggerLog (or after the wrapper state 
+*		was created). It counts every sample passed to the streaming 
+*		callback (aggregated samples if aggregation is used) and does not
+*		wrap or depend on the size of the driver buffers.
+* [1] timestamp - host time in microseconds when the callback reporting 
+*		the trigger was received, on the same clock as the timestamps 
+*		returned by DrainStreamingEvents.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* triggeredAt - on exit, the index of the sample in the buffer where the 
-* trigger occurred.
+* triggers - an array of at least maxTriggers * 2 elements.
+* maxTriggers - the maximum number of records to return.
+* nTriggers - on exit, the number of records copied into triggers.
+* droppedTriggers - on exit, the number of triggers that have been 
+*					discarded because the log was full since the last call 
+*					to this function. May be NULL.
 *
 * Returns:
 *
-* 0 - The device has not triggered.
-* Non-zero - The device has been triggered.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if triggers or nTriggers is NULL
 ****************************************************************************/
-extern int16_t PREF0 PREF1 IsTriggerReady(int16_t handle, uint32_t *triggeredAt)
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog(int16_t handle, uint64_t * triggers, uint32_t maxTriggers, uint32_t * nTriggers, uint32_t * droppedTriggers)
 {
-	if (_triggered)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
 	{
-		*triggeredAt = _triggeredAt;
+		return status;
 	}
 
-	return _triggered;
+	if (triggers == NULL || nTriggers == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	drainTriggerLog(&wrapUnitInfo->triggerLog, triggers, maxTriggers, nTriggers, droppedTriggers);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* ClearTriggerReady
+* resetTriggerLog
 *
-* Clears the triggered and triggeredAt flags in relation to streaming mode 
-* capture.
+* Discards any triggers in the trigger log and restarts the sample count 
+* used for trigger positions from zero. Call this function before 
+* ps6000RunStreaming, while the device is not streaming, so that trigger
+* positions are counted from the start of the capture.
 *
 * Input Arguments:
 *
-* None
+* handle - the handle of the required device.
 *
 * Returns:
 *
-* 1
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
 ****************************************************************************/
-extern int16_t PREF0 PREF1 ClearTriggerReady(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog(int16_t handle)
 {
-	_triggeredAt = 0;
-	_triggered = FALSE;
-	return 1;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	wrapUnitInfo->triggerLog.sampleCount = 0;
+	wrapUnitInfo->triggerLog.readIndex = wrapUnitInfo->triggerLog.writeIndex;
+	wrapUnitInfo->triggerLog.reportedDroppedRecords = wrapUnitInfo->triggerLog.droppedRecords;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetTriggerConditions
+* releaseWrapUnitInfo
 *
-* This function sets up trigger conditions on the scope's inputs. The trigger 
-* is defined by one or more sets of integers corresponding to 
-* PS6000_TRIGGER_CONDITIONS structures which are then converted and passed 
-* to the ps6000SetTriggerChannelConditions function.
+* Frees the wrapper state held for a device. Call this function after
+* ps6000CloseUnit so that the memory is returned and a device opened later 
+* with the same handle starts from a clean state.
 *
-* Use this function with programming languages that do not support structs.
+* The function waits for any call to GetStreamingLatestValues in progress on
+* another thread to return before freeing the state, and a BlockCallback 
+* arriving afterwards finds no state and is ignored.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* conditionsArray - an array of integer values specifying the conditions 
-*					for each channel.
-* nConditions - the number that will be passed after the wrapper code has 
-*				created its structures. (i.e. the number of conditionsArray 
-*				elements / 7)
 *
 * Returns:
 *
-* See ps6000SetTriggerChannelConditions return values.
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if the wrapper holds no state for the handle.
 *
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerConditions(int16_t handle, int32_t *conditionsArray, int16_t nConditions)
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo(int16_t handle)
 {
-	PICO_STATUS status;
-	int16_t i = 0;
-	int16_t j = 0;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DISK_RECORDER * diskRecorder = NULL;
+
+	if (handle <= 0)
+	{
+		return PICO_INVALID_HANDLE;
+	}
 
-	PS6000_TRIGGER_CONDITIONS *conditions = (PS6000_TRIGGER_CONDITIONS *) calloc (nConditions, sizeof(PS6000_TRIGGER_CONDITIONS));
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_lock(&_wrapUnitInfoLock);
+#endif
 
-	for (i = 0; i < nConditions; i++)
+	wrapUnitInfo = _wrapUnitInfo[handle];
+	_wrapUnitInfo[handle] = NULL;
+
+	// Wait for any GetStreamingLatestValues call that may still run StreamingCallback with the state
+	while (wrapUnitInfo != NULL && wrapUnitInfo->streamingCallsInProgress > 0)
 	{
-		conditions[i].channelA 				= (PS6000_TRIGGER_STATE) conditionsArray[j];
-		conditions[i].channelB 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 1];
-		conditions[i].channelC 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 2];
-		conditions[i].channelD 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 3];
-		conditions[i].external 				= (PS6000_TRIGGER_STATE) conditionsArray[j + 4];
-		conditions[i].aux					= (PS6000_TRIGGER_STATE) conditionsArray[j + 5];
-		conditions[i].pulseWidthQualifier	= (PS6000_TRIGGER_STATE) conditionsArray[j + 6];
+#if defined(WIN32) || defined(_WIN64)
+		SleepConditionVariableSRW(&_wrapUnitInfoCondition, &_wrapUnitInfoLock, INFINITE, 0);
+#else
+		pthread_cond_wait(&_wrapUnitInfoCondition, &_wrapUnitInfoLock);
+#endif
+	}
 
-		j = j + 7;
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&_wrapUnitInfoLock);
+#else
+	pthread_mutex_unlock(&_wrapUnitInfoLock);
+#endif
+
+	if (wrapUnitInfo == NULL)
+	{
+		return PICO_INVALID_HANDLE;
 	}
-	status = ps6000SetTriggerChannelConditions(handle, conditions, nConditions);
-	free (conditions);
 
-	return status;
+	diskRecorder = detachDiskRecorder(wrapUnitInfo);
+
+	if (diskRecorder != NULL)
+	{
+		stopDiskRecorder(diskRecorder);
+	}
+
+#if !defined(WIN32) && !defined(_WIN64)
+	pthread_mutex_destroy(&wrapUnitInfo->readyLock);
+	pthread_cond_destroy(&wrapUnitInfo->readyCondition);
+	pthread_mutex_destroy(&wrapUnitInfo->snapshotLock);
+	pthread_mutex_destroy(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	free(wrapUnitInfo->triggerArenaOverflow);
+	free(wrapUnitInfo);
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* SetTriggerProperties
+* setChannelScaling
 *
-* This function is used to enable or disable triggering and set its 
-* parameters by means of assigning the values from the propertiesArray to an 
-* array of TRIGGER_CHANNEL_PROPERTIES structures which are then passed to 
-* the ps6000SetTriggerChannelProperties function with the other parameters.
-
-* Use this function with programming languages that do not support structs.
+* Sets the values used to convert the data for a channel to volts when float 
+* or double application buffers have been set with setAppFloatBuffers or 
+* setAppDoubleBuffers. The values should match those passed to the driver 
+* for the channel, and should be set before streaming starts.
 *
 * Input Arguments:
 *
-* handle - the handle of the required device.
-* propertiesArray - an array of sets of integers corresponding to 
-*					TRIGGER_CHANNEL_PROPERTIES structures describing the 
-*					required properties to be set. See also channelProperties
-*					in ps6000SetTriggerChannelProperties.
-*
-* nProperties - the number that will be passed after the wrapper code has 
-*				created its structures. (i.e. the number of propertiesArray 
-*				elements / 6)
-* autoTrig - see autoTriggerMilliseconds in ps6000SetTriggerChannelProperties.
-*
+* handle - the device handle.
+* channel - the channel number (should be a PS6000_CHANNEL enumeration value).
+* range - the PS6000_RANGE value set for the channel.
+* analogueOffset - the analogue offset in volts set for the channel.
+* maxADCValue - the value returned by ps6000MaximumValue. Set to 0 to stop 
+*				converting the data for the channel.
+* probeAttenuation - the probe attenuation, e.g. 10 for a x10 probe, or 1 if 
+*				 no probe scaling is required.
 *
 * Returns:
 *
-* See ps6000SetTriggerChannelProperties return values.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
+* PICO_INVALID_VOLTAGE_RANGE, if range is not a valid PS6000_RANGE value
+* PICO_INVALID_PARAMETER, if maxADCValue is negative or probeAttenuation is 
+*							not greater than 0
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetTriggerProperties(
-	int16_t handle, 
-	int32_t *propertiesArray, 
-	int16_t nProperties,  
-	int32_t autoTrig)
+extern PICO_STATUS PREF0 PREF1 setChannelScaling(int16_t handle, int16_t channel, int32_t range, float analogueOffset, int16_t maxADCValue, float probeAttenuation)
 {
-	PS6000_TRIGGER_CHANNEL_PROPERTIES *channelProperties = (PS6000_TRIGGER_CHANNEL_PROPERTIES *) calloc(nProperties, sizeof(PS6000_TRIGGER_CHANNEL_PROPERTIES));
-	int16_t i;
-	int16_t j = 0;
-	int16_t auxEnable = 0;
-	PICO_STATUS status;
-	
-	for (i = 0; i < nProperties; i++)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_CHANNEL_SCALING * scaling = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		channelProperties[i].thresholdUpper		= propertiesArray[j];
-		channelProperties[i].hysteresisUpper	= propertiesArray[j + 1];
-		channelProperties[i].thresholdLower		= propertiesArray[j + 2];
-		channelProperties[i].hysteresisLower	= propertiesArray[j + 3];
-		channelProperties[i].channel			= (PS6000_CHANNEL) propertiesArray[j + 4];
-		channelProperties[i].thresholdMode		= (PS6000_THRESHOLD_MODE) propertiesArray[j + 5];
+		return PICO_INVALID_HANDLE;
+	}
 
-		j = j + 6;
+	if (channel < PS6000_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+	{
+		return PICO_INVALID_CHANNEL;
+	}
+	else if (range < PS6000_10MV || range >= PS6000_MAX_RANGES)
+	{
+		return PICO_INVALID_VOLTAGE_RANGE;
+	}
+	else if (maxADCValue < 0 || probeAttenuation <= 0.0f)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+	else
+	{
+		scaling = &wrapUnitInfo->wrapBufferInfo.scaling[channel];
+
+		scaling->range = range;
+		scaling->analogueOffset = analogueOffset;
+		scaling->maxADCValue = maxADCValue;
+		scaling->probeAttenuation = probeAttenuation;
+
+		if (maxADCValue > 0)
+		{
+			scaling->scale = (_rangeMillivolts[range] / 1000.0) * probeAttenuation / maxADCValue;
+			scaling->offset = -(double) analogueOffset * probeAttenuation;
+		}
+		else
+		{
+			scaling->scale = 0.0;
+			scaling->offset = 0.0;
+		}
+
+		return PICO_OK;
 	}
-	
-	status = ps6000SetTriggerChannelProperties(handle, channelProperties, nProperties, auxEnable, autoTrig);
-	free(channelProperties);
-	return status;
 }
 
 /****************************************************************************
-* SetPulseWidthQualifier
-*
-* This function is used to pulse-width triggering and set 
-* its parameters by means of assigning the values from the pwqConditionsArray 
-* to an array of PS6000_PWQ_CONDITIONS structures which are then passed to 
-* the ps6000SetPulseWidthQualifier function with the other parameters.
-
-* Use this function with programming languages that do not support structs.
-*
-* Input Arguments:
+* setAppFloatBuffers
 *
-* handle - the handle of the required device.
-* pwqConditionsArray - an array of sets of integers corresponding to 
-*					PS6000_PWQ_CONDITIONS structures describing the 
-*					required properties to be set. See also conditions
-*					in ps6000SetPulseWidthQualifier.
+* Set the application buffers that the streaming callback writes the data 
+* for a channel into after converting it to volts, using the values set with 
+* setChannelScaling. The buffers are filled from the driver buffers set 
+* with setAppAndDriverBuffers or setMaxMinAppAndDriverBuffers, and must be 
+* the same length.
 *
-* nConditions - the number that will be passed after the wrapper code has 
-*				created its structures. (i.e. the number of conditionsArray 
-*				elements / 6)
+* Input Arguments:
 *
-* direction - the direction of the signal required for the pulse width
-*				trigger to fire (See PS6000_THRESHOLD_DIRECTION constants)
-* lower - the lower limit of the pulse-width counter with relation to
-			number of samples captured on the device.
-* upper - the upper limit of the pulse-width counter with relation to
-*			number of samples captured on the device.
-* type - the pulse-width type (see ps6000SetPulseWidthQualifier).
+* handle - the device handle.
+* channel - the channel number (should be a PS6000_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
 *
 * Returns:
 *
-* See ps6000SetPulseWidthQualifier return values.
-*
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 SetPulseWidthQualifier(
-	int16_t handle,
-	int32_t *pwqConditionsArray,
-	int16_t nConditions,
-	int32_t direction,
-	uint32_t lower,
-	uint32_t upper,
-	int32_t type)
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers(int16_t handle, int16_t channel, float * appMaxBuffer, float * appMinBuffer)
 {
-	// Allocate memory
-	PS6000_PWQ_CONDITIONS *pwqConditions = (PS6000_PWQ_CONDITIONS *) calloc(nConditions, sizeof(PS6000_PWQ_CONDITIONS));
-
-	int16_t i;
-	int16_t j = 0;
-
-	PICO_STATUS status;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
 
-	for (i = 0; i < nConditions; i++)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
 	{
-		pwqConditions[i].channelA = (PS6000_TRIGGER_STATE) pwqConditionsArray[j];
-		pwqConditions[i].channelB = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 1];
-		pwqConditions[i].channelC = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 2];
-		pwqConditions[i].channelD = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 3];
-		pwqConditions[i].external = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 4];
-		pwqConditions[i].aux      = (PS6000_TRIGGER_STATE) pwqConditionsArray[j + 5];
+		if (channel < PS6000_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appFloatBuffers[channel * 2 + 1] = appMinBuffer;
 
-		j = j + 6;
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
 	}
-
-	status = ps6000SetPulseWidthQualifier(handle, pwqConditions, nConditions, (PS6000_THRESHOLD_DIRECTION) direction, lower, upper, (PS6000_PULSE_WIDTH_TYPE) type);
-	free(pwqConditions);
-	return status;
 }
 
 /****************************************************************************
-* setChannelCount
+* setAppDoubleBuffers
 *
-* Set the number of channels on the device. This is used to assist with 
-* copying data in the streaming callback.
+* As setAppFloatBuffers, for double precision application buffers. Float 
+* and double buffers may be set for the same channel.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channelCount - the number of channels on the device.
+* channel - the channel number (should be a PS6000_CHANNEL enumeration value).
+* appMaxBuffer - the application buffer for the max (or non-aggregated) data, 
+*				 or NULL.
+* appMinBuffer - the application buffer for the min data, or NULL.
+*
+* Returns:
 *
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is invalid
+* PICO_INVALID_CHANNEL, if channel is not in range
 ****************************************************************************/
-extern void PREF0 PREF1 setChannelCount(int16_t handle, int16_t channelCount)
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers(int16_t handle, int16_t channel, double * appMaxBuffer, double * appMinBuffer)
 {
-	_channelCount = channelCount;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) == PICO_OK)
+	{
+		if (channel < PS6000_CHANNEL_A || channel >= wrapUnitInfo->channelCount)
+		{
+			return PICO_INVALID_CHANNEL;
+		}
+		else
+		{
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2] = appMaxBuffer;
+			wrapUnitInfo->wrapBufferInfo.appDoubleBuffers[channel * 2 + 1] = appMinBuffer;
+
+			return PICO_OK;
+		}
+	}
+	else
+	{
+		return PICO_INVALID_HANDLE;
+	}
 }
 
 /****************************************************************************
-* setEnabledChannels
+* StartDiskRecording
 *
-* Set the number of enabled channels on the device. This is used to assist with 
-* copying data in the streaming callback.
+* Starts writing the data received by the streaming callback to a file, 
+* using the format described in ps6000Wrap.h. The data is taken from the 
+* driver buffers set with setAppAndDriverBuffers or 
+* setMaxMinAppAndDriverBuffers for the enabled channels, and is written by a 
+* separate thread so that GetStreamingLatestValues is never held up by the 
+* file. Call this after setting the buffers and before the first call to 
+* GetStreamingLatestValues.
+*
+* This function does not start the device streaming - use ps6000RunStreaming 
+* for this.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* enabledChannels - an array representing the channel states. This must be 
-*					4 elements in size.
+* filePath - the path of the file to create. An existing file is replaced.
+* channelRanges - an array of PS6000_MAX_CHANNELS PS6000_RANGE values to 
+*				  store in the file header, or NULL.
+* sampleInterval - the sample interval passed to ps6000RunStreaming, to 
+*				   store in the file header.
+* timeUnits - the PS6000_TIME_UNITS value for sampleInterval.
+* stagingSizeMB - the size of the buffer used to hold data waiting to be 
+*				  written, in MB. This is rounded up to a power of 2. Use 0 
+*				  for the default of WRAP_DISK_DEFAULT_STAGING_MB.
 *
 * Returns:
 *
-* 0 if successful,
-* -1 if handle <= 0 or channelCount is out of range
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if handle is invalid.
+* PICO_INVALID_PARAMETER, if filePath is NULL.
+* PICO_BUSY, if a recording is already in progress for this device.
+* PICO_MEMORY_FAIL, if the staging buffer could not be allocated.
+* PICO_OPERATION_FAILED, if the file could not be created or the writer 
+*						 thread could not be started.
+*
 ****************************************************************************/
-extern int16_t PREF0 PREF1 setEnabledChannels(int16_t handle, int16_t * enabledChannels)
+extern PICO_STATUS PREF0 PREF1 StartDiskRecording(int16_t handle, int8_t * filePath, int32_t * channelRanges, uint32_t sampleInterval, 
+	int32_t timeUnits, uint32_t stagingSizeMB)
 {
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DISK_RECORDER * recorder = NULL;
+	WRAP_DISK_FILE_HEADER fileHeader;
+	uint64_t stagingSize = WRAP_DISK_WRITE_BLOCK;
+	int16_t channel = 0;
+	int16_t recording = 0;
 
-	if (handle > 0)
+	if (getWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		if (_channelCount > 0 && _channelCount <= PS6000_MAX_CHANNELS)
-		{
-			memcpy_s((int16_t *)_enabledChannels, PS6000_MAX_CHANNELS * sizeof(int16_t), 
-				(int16_t *)enabledChannels, PS6000_MAX_CHANNELS * sizeof(int16_t));
-			return 0;
-		}
+		return PICO_INVALID_HANDLE;
 	}
 
-	return -1;
+	if (filePath == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	recording = (wrapUnitInfo->diskRecorder != NULL);
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	if (recording)
+	{
+		return PICO_BUSY;
+	}
+
+	if (stagingSizeMB == 0)
+	{
+		stagingSizeMB = WRAP_DISK_DEFAULT_STAGING_MB;
+	}
+
+	// A power of 2 so ring offsets can be masked, and at least two write blocks
+	while (stagingSize < (uint64_t) stagingSizeMB * 1024 * 1024 || stagingSize < 2 * WRAP_DISK_WRITE_BLOCK)
+	{
+		stagingSize <<= 1;
+	}
+
+	recorder = (WRAP_DISK_RECORDER *) calloc(1, sizeof(WRAP_DISK_RECORDER));
+
+	if (recorder == NULL)
+	{
+		return PICO_MEMORY_FAIL;
+	}
+
+	recorder->stagingSize = stagingSize;
+	recorder->status = PICO_OK;
+
+#if defined(WIN32) || defined(_WIN64)
+	recorder->staging = (uint8_t *) _aligned_malloc((size_t) stagingSize, WRAP_DISK_WRITE_BLOCK);
+#else
+	if (posix_memalign((void **) &recorder->staging, WRAP_DISK_WRITE_BLOCK, (size_t) stagingSize) != 0)
+	{
+		recorder->staging = NULL;
+	}
+#endif
+
+	if (recorder->staging == NULL)
+	{
+		freeDiskRecorder(recorder);
+		return PICO_MEMORY_FAIL;
+	}
+
+	recorder->file = fopen((const char *) filePath, "wb");
+
+	if (recorder->file == NULL)
+	{
+		freeDiskRecorder(recorder);
+		return PICO_OPERATION_FAILED;
+	}
+
+	// The writer thread does its own buffering
+	setvbuf(recorder->file, NULL, _IONBF, 0);
+
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	memcpy(fileHeader.magic, WRAP_DISK_FORMAT_MAGIC, sizeof(fileHeader.magic));
+	fileHeader.version = WRAP_DISK_FORMAT_VERSION;
+	fileHeader.headerSize = sizeof(fileHeader);
+	fileHeader.sampleInterval = sampleInterval;
+	fileHeader.timeUnits = timeUnits;
+	fileHeader.startTime = getHostTimestamp();
+
+	for (channel = (int16_t) PS6000_CHANNEL_A; channel < PS6000_MAX_CHANNELS; channel++)
+	{
+		fileHeader.ranges[channel] = (channelRanges != NULL) ? channelRanges[channel] : -1;
+		fileHeader.enabledChannels[channel] = (channel < wrapUnitInfo->channelCount) ? wrapUnitInfo->enabledChannels[channel] : 0;
+	}
+
+	copyToStaging(recorder, 0, &fileHeader, sizeof(fileHeader));
+	recorder->writeCursor = sizeof(fileHeader);
+
+#if defined(WIN32) || defined(_WIN64)
+	recorder->writerThread = CreateThread(NULL, 0, diskWriterThread, recorder, 0, NULL);
+
+	if (recorder->writerThread == NULL)
+#else
+	if (pthread_create(&recorder->writerThread, NULL, diskWriterThread, recorder) != 0)
+#endif
+	{
+		freeDiskRecorder(recorder);
+		return PICO_OPERATION_FAILED;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	// Another thread may have started a recording while this one was being set up
+	recording = (wrapUnitInfo->diskRecorder != NULL);
+
+	if (!recording)
+	{
+		wrapUnitInfo->diskRecorder = recorder;
+	}
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	if (recording)
+	{
+		stopDiskRecorder(recorder);
+		return PICO_BUSY;
+	}
 
+	return PICO_OK;
 }
 
 /****************************************************************************
-* setAppAndDriverBuffers
+* StopDiskRecording
 *
-* Set the application and corresponding driver buffer in order for the 
-* streaming callback to copy the data for the channel from the driver buffer 
-* to the application buffer.
+* Stops a recording started with StartDiskRecording, waits for all of the 
+* data received so far to be written and closes the file. It may be called
+* while GetStreamingLatestValues is running for the device on another 
+* thread. It does not stop the device - use ps6000Stop for this.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channel - the channel number (should be a numerical value corresponding to 
-			an PS6000_CHANNEL enumeration value).
-* appBuffer - the application buffer.
-* driverBuffer - the buffer set by the driver.
-* bufferLength - the length of the buffers (length must be equal).
 *
 * Returns:
 *
-* 0, if successful
-* -1, otherwise
+* PICO_OK, if successful.
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it.
+* PICO_INVALID_PARAMETER, if no recording is in progress.
+* PICO_OPERATION_FAILED, if any of the data could not be written to the file.
+*
 ****************************************************************************/
-extern int16_t PREF0 PREF1 setAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appBuffer, int16_t * driverBuffer, uint32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 StopDiskRecording(int16_t handle)
 {
-	if (handle > 0)
-	{
-		if(channel < PS6000_CHANNEL_A || channel >= PS6000_MAX_CHANNELS)
-		{
-			return -1;
-		}
-		else
-		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverBuffer;
-				
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DISK_RECORDER * recorder = NULL;
 
-			return 0;
-		}
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
+	{
+		return PICO_INVALID_HANDLE;
 	}
-	else
+
+	recorder = detachDiskRecorder(wrapUnitInfo);
+
+	if (recorder == NULL)
 	{
-		return -1;
+		return PICO_INVALID_PARAMETER;
 	}
+
+	return stopDiskRecorder(recorder);
 }
 
 /****************************************************************************
-* setMaxMinAppAndDriverBuffers
+* GetDiskRecordingStatus
 *
-* Set the application and corresponding driver buffers in order for the 
-* streaming callback to copy the data for the channel from the driver max and 
-* min buffers to the respective application buffers for aggregated data 
-* collection.
+* Returns the progress of a recording started with StartDiskRecording.
 *
 * Input Arguments:
 *
 * handle - the device handle.
-* channel - the channel number ((should be a numerical value corresponding to 
-			an PS6000_CHANNEL enumeration value).
-* appMaxBuffer - the application max buffer.
-* appMinBuffer - the application min buffer.
-* driverMaxBuffer - the max buffer set by the driver.
-* driverMinBuffer - the min buffer set by the driver.
-* bufferLength - the length of the buffers (length must be equal).
+* bytesWritten - on exit, the number of bytes written to the file so far.
+* droppedSamples - on exit, the number of samples that were not recorded 
+*				   because the staging buffer was full.
+* isRecording - on exit, 1 if a recording is in progress, otherwise 0.
+*
+* Any of the output arguments may be NULL.
 *
 * Returns:
 *
-* 0, if successful
-* -1, otherwise
+* PICO_OK, if successful or no recording is in progress.
+* PICO_INVALID_HANDLE, if handle is invalid or the wrapper 
+*						holds no state for it.
+* PICO_OPERATION_FAILED, if the file could not be written. The recording 
+*						 should be stopped with StopDiskRecording.
+*
 ****************************************************************************/
-extern int16_t PREF0 PREF1 setMaxMinAppAndDriverBuffers(int16_t handle, int16_t channel, int16_t * appMaxBuffer, int16_t * appMinBuffer, int16_t * driverMaxBuffer, int16_t * driverMinBuffer, uint32_t bufferLength)
+extern PICO_STATUS PREF0 PREF1 GetDiskRecordingStatus(int16_t handle, uint64_t * bytesWritten, uint64_t * droppedSamples, int16_t * isRecording)
 {
-	if(handle > 0)
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_DISK_RECORDER * recorder = NULL;
+	PICO_STATUS status = PICO_OK;
+
+	if (findWrapUnitInfo(handle, &wrapUnitInfo) != PICO_OK)
 	{
-		if (channel < PS6000_CHANNEL_A || channel >= PS6000_MAX_CHANNELS)
-		{
-			return -1;
-		}
-		else
-		{
-			_wrapBufferInfo.appBuffers[channel * 2] = appMaxBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2] = driverMaxBuffer;
+		return PICO_INVALID_HANDLE;
+	}
 
-			_wrapBufferInfo.appBuffers[channel * 2 + 1] = appMinBuffer;
-			_wrapBufferInfo.driverBuffers[channel * 2 + 1] = driverMinBuffer;
+	// The lock stops StopDiskRecording freeing the recording while it is read
+#if defined(WIN32) || defined(_WIN64)
+	AcquireSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_lock(&wrapUnitInfo->diskRecorderLock);
+#endif
 
-			_wrapBufferInfo.bufferLengths[channel] = bufferLength;
+	recorder = wrapUnitInfo->diskRecorder;
 
-			return 0;
-		}
+	if (bytesWritten != NULL)
+	{
+		*bytesWritten = (recorder != NULL) ? recorder->readCursor : 0;
 	}
-	else
+
+	if (droppedSamples != NULL)
 	{
-		return -1;
+		*droppedSamples = (recorder != NULL) ? recorder->droppedSamples : 0;
+	}
+
+	if (isRecording != NULL)
+	{
+		*isRecording = (recorder != NULL) ? 1 : 0;
 	}
+
+	status = (recorder != NULL) ? recorder->status : PICO_OK;
+
+#if defined(WIN32) || defined(_WIN64)
+	ReleaseSRWLockExclusive(&wrapUnitInfo->diskRecorderLock);
+#else
+	pthread_mutex_unlock(&wrapUnitInfo->diskRecorderLock);
+#endif
+
+	return status;
 }
 
 /****************************************************************************
-* clearStreamingParameters
+* setNonTemporalCopyThreshold
 *
-* Sets streaming parameters to 0.
+* Sets the size of the copy from each driver buffer to its application 
+* buffer in the streaming callback from which the wrapper uses non-temporal
+* stores, which bypass the cache. At high sample rates this stops the copy
+* evicting the data the application is working on, but it is slower if the
+* application reads the samples while they would still be in the cache.
+*
+* Non-temporal stores are used on x86 processors with SSE2, AVX2 or AVX-512,
+* the widest being selected when the first copy is made. Smaller copies, and
+* all copies on other processors, use memcpy_s.
 *
 * Input Arguments:
 *
-* handle - the device handle.
+* thresholdBytes - the size of the copy in bytes from which non-temporal 
+*				stores are used, or 0 to always use memcpy_s. The default is
+*				WRAP_NON_TEMPORAL_COPY_THRESHOLD (256 KiB).
 *
+* Returns:
+*
+* PICO_OK.
 ****************************************************************************/
-extern void PREF0 PREF1 clearStreamingParameters(int16_t handle)
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold(uint32_t thresholdBytes)
 {
-	_ready = 0;
-	_autoStop = 0;
-	_numSamples = 0;
-	_triggeredAt = 0;
-	_triggered = FALSE;
-	_startIndex = 0;
-	_overflow = 0;
+	_nonTemporalCopyThreshold = thresholdBytes;
+
+	return PICO_OK;
 }
 
 /****************************************************************************
-* getOverflow
+* GetStreamingSnapshot
 *
-* Returns indication if there has been an overvoltage on one or more
-* analogue inputs when collecting data in streaming mode.
+* Returns the streaming status from the latest streaming callback in one 
+* call. Unlike separate calls to AvailableData, IsTriggerReady, AutoStopped
+* and getOverflow, which can see values written by different callbacks,
+* all of the values come from the same callback. The function does not 
+* block the streaming callback.
+*
+* The values are written to the snapshot array in the order:
+*
+* [0] ready - non-zero if data is available, as returned by IsReady. This 
+*		is cleared by GetStreamingLatestValues and RunBlock.
+* [1] numSamples - the number of samples collected.
+* [2] startIndex - an index to the first valid sample in the buffer.
+* [3] triggered - non-zero if a trigger occurred.
+* [4] triggeredAt - the index of the trigger point relative to startIndex.
+* [5] overflow - overvoltage flags, bit 0 denoting channel A.
+* [6] autoStop - non-zero if streaming has autostopped.
+* [7] callbackCount - the number of streaming callbacks received for the 
+*		device, which can be used to tell whether the data is new.
+*
+* ClearTriggerReady does not change the snapshot.
 *
 * Input Arguments:
 *
 * handle - the handle of the required device.
-* overflow - on exit, a set of flags that indicate whether an overvoltage
-*						has occurred on any of the channels. It is a bit field with
-*						bit 0 denoting channel A.
+* snapshot - an array of at least 8 elements.
 *
 * Returns:
 *
-* PICO_OK, if successful, or
-* PICO_INVALID_HANDLE if handle is less than or equal to 0
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if snapshot is NULL
+****************************************************************************/
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot(int16_t handle, uint32_t * snapshot)
+{
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_SNAPSHOT copy;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (snapshot == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	readStreamingSnapshot(wrapUnitInfo, &copy);
+
+	snapshot[0] = (uint32_t) copy.ready;
+	snapshot[1] = copy.numSamples;
+	snapshot[2] = copy.startIndex;
+	snapshot[3] = (uint32_t) copy.triggered;
+	snapshot[4] = copy.triggeredAt;
+	snapshot[5] = (uint32_t) (uint16_t) copy.overflow;
+	snapshot[6] = (uint32_t) copy.autoStop;
+	snapshot[7] = copy.callbackCount;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* GetStreamingSnapshot64
+*
+* Returns the same consistent copy of the streaming status as 
+* GetStreamingSnapshot, as 64-bit values, together with the 64-bit count of
+* samples received, which does not wrap on long captures.
+*
+* The values are written to the snapshot array in the order:
+*
+* [0] to [7] - as returned by GetStreamingSnapshot.
+* [8] totalSamples - the number of samples received since the last call to 
+*		clearStreamingParameters. This is also the number of samples 
+*		written to each segmented application buffer set with 
+*		setSegmentedAppAndDriverBuffers, unless it exceeds the buffer length.
+*
+* Input Arguments:
+*
+* handle - the handle of the required device.
+* snapshot - an array of at least 9 elements.
+*
+* Returns:
 *
+* PICO_OK, if successful
+* PICO_INVALID_HANDLE, if handle is less than or equal to 0 or the wrapper 
+*						holds no state for it
+* PICO_INVALID_PARAMETER, if snapshot is NULL
 ****************************************************************************/
-extern PICO_STATUS PREF0 PREF1 getOverflow(int16_t handle, int16_t * overflow)
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot64(int16_t handle, uint64_t * snapshot)
 {
-		if (handle > 0)
-		{
-				*overflow = _overflow;
-				return PICO_OK;
-		}
-		else
-		{
-				return PICO_INVALID_HANDLE;
-		}
+	WRAP_UNIT_INFO * wrapUnitInfo = NULL;
+	WRAP_STREAMING_SNAPSHOT copy;
+	PICO_STATUS status = findWrapUnitInfo(handle, &wrapUnitInfo);
+
+	if (status != PICO_OK)
+	{
+		return status;
+	}
+
+	if (snapshot == NULL)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	readStreamingSnapshot(wrapUnitInfo, &copy);
+
+	snapshot[0] = (uint64_t) copy.ready;
+	snapshot[1] = copy.numSamples;
+	snapshot[2] = copy.startIndex;
+	snapshot[3] = (uint64_t) copy.triggered;
+	snapshot[4] = copy.triggeredAt;
+	snapshot[5] = (uint64_t) (uint16_t) copy.overflow;
+	snapshot[6] = (uint64_t) copy.autoStop;
+	snapshot[7] = copy.callbackCount;
+	snapshot[8] = copy.totalSamples;
+
+	return PICO_OK;
 }
@@ -29,6 +29,14 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #elif _WIN64
 #include "windows.h"
 #include <stdio.h>
@@ -44,6 +52,14 @@
 #endif
 #define PREF1 __stdcall
 
+#define WRAP_MEMORY_BARRIER() MemoryBarrier()
+
+typedef HANDLE WRAP_THREAD;
+typedef SRWLOCK WRAP_LOCK;
+typedef CONDITION_VARIABLE WRAP_CONDITION;
+#define WRAP_LOCK_INIT SRWLOCK_INIT
+#define WRAP_CONDITION_INIT CONDITION_VARIABLE_INIT
+
 #else
 #include <sys/types.h>
 #include <string.h>
@@ -51,6 +67,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #include <libps6000-1.4/ps6000Api.h>
 #ifndef PICO_STATUS
 #include <libps6000-1.4/PicoStatus.h>
@@ -61,32 +81,366 @@
 #define PREF0
 #define PREF1
 
+#define WRAP_MEMORY_BARRIER() __sync_synchronize()
+
+typedef pthread_t WRAP_THREAD;
+typedef pthread_mutex_t WRAP_LOCK;
+typedef pthread_cond_t WRAP_CONDITION;
+#define WRAP_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define WRAP_CONDITION_INIT PTHREAD_COND_INITIALIZER
+
 typedef enum enBOOL
 {
   FALSE, TRUE
 } BOOL;
 #endif
 
-int16_t		_ready;
-int16_t		_autoStop;
-uint32_t	_numSamples;
-uint32_t	_triggeredAt = 0;
-int16_t		_triggered = FALSE;
-uint32_t	_startIndex;		// Start index in driver buffer
-int16_t		_overflow = 0;
+// Instruction set extensions used to convert ADC counts to volts and by the streaming copy
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WRAP_SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WRAP_TARGET_SSE2
+#define WRAP_TARGET_AVX2
+#define WRAP_TARGET_AVX512
+#else
+#define WRAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define WRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define WRAP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define WRAP_SIMD_NONE		0
+#define WRAP_SIMD_SSE2		1
+#define WRAP_SIMD_AVX2		2
+#define WRAP_SIMD_AVX512	3
+
+#define WRAP_NON_TEMPORAL_COPY_THRESHOLD	262144	// Default size in bytes of a callback copy from which the cache is bypassed
+#define WRAP_COPY_PREFETCH_DISTANCE			512		// Bytes of the source prefetched ahead of a non-temporal copy
 
-int16_t _channelCount = 4; // Should be set to 4 from the main application
-int16_t _enabledChannels[PS6000_MAX_CHANNELS] = {0, 0, 0, 0}; // Keep a record of the channels that are enabled
+/****************************************************************************
+* tWrapChannelScaling
+*
+* The settings used to convert the ADC counts for a channel to volts. The 
+* scale and offset are calculated from the other fields by setChannelScaling 
+* so that the streaming callback only needs a multiply and an add per sample:
+*
+* volts = counts * scale + offset
+*
+****************************************************************************/
+typedef struct tWrapChannelScaling
+{
+	int32_t		range;				// PS6000_RANGE value set for the channel
+	float		analogueOffset;		// Analogue offset in volts set for the channel
+	int16_t		maxADCValue;		// Maximum ADC count for the device - 0 disables conversion
+	float		probeAttenuation;	// Multiplier applied to the result, e.g. 10 for a x10 probe
+	double		scale;				// Volts per ADC count
+	double		offset;				// Volts added after scaling
+} WRAP_CHANNEL_SCALING;
+
+#define WRAP_MAX_BUFFER_SEGMENTS			64		// Largest number of segments in a segmented application buffer
+
+/****************************************************************************
+* tWrapSegmentedBuffer
+*
+* An application buffer made up of a list of separately allocated segments.
+* Sample n of the logical buffer is held in the segment for which 
+* segmentStarts[segment] <= n < segmentStarts[segment + 1], so the logical
+* buffer can be longer than 4 G samples or than any one allocation.
+*
+****************************************************************************/
+typedef struct tWrapSegmentedBuffer
+{
+	int16_t *	segments[WRAP_MAX_BUFFER_SEGMENTS];
+	uint64_t	segmentStarts[WRAP_MAX_BUFFER_SEGMENTS + 1];	// Logical index of the first sample of each segment, then the total length
+	uint32_t	nSegments;										// 0 if the buffer is not segmented
+	uint32_t	currentSegment;									// Segment written by the last callback
+} WRAP_SEGMENTED_BUFFER;
 
 typedef struct tWrapBufferInfo
 {
 	int16_t *driverBuffers[PS6000_MAX_CHANNEL_BUFFERS]; // Array to store pointers to buffers registered with the driver
 	int16_t *appBuffers[PS6000_MAX_CHANNEL_BUFFERS];	// Array to store pointers to application buffers to copy data into
-	uint32_t bufferLengths[PS6000_MAX_CHANNELS];
+	uint64_t bufferLengths[PS6000_MAX_CHANNELS];		// Length of the application buffers for each channel
+	WRAP_SEGMENTED_BUFFER appSegments[PS6000_MAX_CHANNEL_BUFFERS];	// Segmented application buffers, used in place of appBuffers when set
+
+	float *appFloatBuffers[PS6000_MAX_CHANNEL_BUFFERS];		// Application buffers to write the data converted to volts into
+	double *appDoubleBuffers[PS6000_MAX_CHANNEL_BUFFERS];	// Application buffers to write the data converted to volts into
+	WRAP_CHANNEL_SCALING scaling[PS6000_MAX_CHANNELS];		// Conversion settings for each channel
 
 } WRAP_BUFFER_INFO;
 
-WRAP_BUFFER_INFO _wrapBufferInfo;
+#define WRAP_STREAMING_EVENT_QUEUE_SIZE		1024	// Number of streaming callback records held - must be a power of 2
+#define WRAP_STREAMING_EVENT_FIELDS			8		// Number of values per record returned by DrainStreamingEvents
+
+/****************************************************************************
+* tWrapStreamingEvent
+*
+* A record of the parameters passed to one call of the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEvent
+{
+	uint32_t	numSamples;
+	uint32_t	startIndex;
+	uint32_t	triggeredAt;
+	int16_t		triggered;
+	int16_t		overflow;
+	int16_t		autoStop;
+	uint64_t	timestamp;			// Host time in microseconds when the callback was received
+} WRAP_STREAMING_EVENT;
+
+/****************************************************************************
+* tWrapStreamingEventQueue
+*
+* Single-producer/single-consumer queue of streaming callback records. The 
+* streaming callback is the only writer of writeIndex and droppedEvents, and 
+* DrainStreamingEvents is the only writer of readIndex, so no lock is needed.
+*
+****************************************************************************/
+typedef struct tWrapStreamingEventQueue
+{
+	WRAP_STREAMING_EVENT	events[WRAP_STREAMING_EVENT_QUEUE_SIZE];
+	volatile uint32_t		writeIndex;				// Total number of records added
+	volatile uint32_t		readIndex;				// Total number of records removed
+	volatile uint32_t		droppedEvents;			// Total number of records lost because the queue was full
+	uint32_t				reportedDroppedEvents;	// Value of droppedEvents at the last call to DrainStreamingEvents
+} WRAP_STREAMING_EVENT_QUEUE;
+
+#define WRAP_TRIGGER_LOG_SIZE				4096	// Number of trigger records held - must be a power of 2
+#define WRAP_TRIGGER_LOG_FIELDS				2		// Number of values per record returned by DrainTriggerLog
+
+/****************************************************************************
+* tWrapTriggerRecord
+*
+* The position of one trigger reported by the streaming callback.
+*
+****************************************************************************/
+typedef struct tWrapTriggerRecord
+{
+	uint64_t	sampleIndex;		// Index of the trigger point counted from the first sample after resetTriggerLog
+	uint64_t	timestamp;			// Host time in microseconds when the callback reporting the trigger was received
+} WRAP_TRIGGER_RECORD;
+
+/****************************************************************************
+* tWrapTriggerLog
+*
+* Single-producer/single-consumer log of streaming triggers, shared in the 
+* same way as WRAP_STREAMING_EVENT_QUEUE. sampleCount counts every sample 
+* the driver has passed to the streaming callback, so trigger positions do 
+* not depend on where the driver placed the data in its buffers and do not
+* wrap.
+*
+****************************************************************************/
+typedef struct tWrapTriggerLog
+{
+	WRAP_TRIGGER_RECORD	records[WRAP_TRIGGER_LOG_SIZE];
+	uint64_t			sampleCount;			// Samples received since the last resetTriggerLog
+	volatile uint32_t	writeIndex;				// Total number of records added
+	volatile uint32_t	readIndex;				// Total number of records removed
+	volatile uint32_t	droppedRecords;			// Total number of records lost because the log was full
+	uint32_t			reportedDroppedRecords;	// Value of droppedRecords at the last call to DrainTriggerLog
+} WRAP_TRIGGER_LOG;
+
+#define WRAP_WAIT_INFINITE	0xFFFFFFFF
+
+/****************************************************************************
+* Disk recording file format
+*
+* StartDiskRecording writes the streaming data to a file made up of a 
+* WRAP_DISK_FILE_HEADER followed by a sequence of records. Each record is a 
+* WRAP_DISK_RECORD_HEADER followed by length bytes of data. All values are 
+* little-endian, and the file header and every record start on an 8 byte 
+* boundary.
+*
+* WRAP_DISK_RECORD_SAMPLES - noOfSamples samples starting at sampleIndex for 
+*	each buffer with its bit set in bufferMask, in order of increasing bit 
+*	number. Bit (channel * 2) is the max (or non-aggregated) buffer for a 
+*	channel and bit (channel * 2 + 1) is the min buffer. Each buffer is 
+*	stored as noOfSamples int16_t values and the data is padded with zeros 
+*	to a multiple of 8 bytes.
+* WRAP_DISK_RECORD_TRIGGER - the trigger occurred at sampleIndex.
+* WRAP_DISK_RECORD_OVERFLOW - the block of samples starting at sampleIndex 
+*	had an over-range; flags holds the overflow bits from the driver.
+* WRAP_DISK_RECORD_DROPPED - noOfSamples samples starting at sampleIndex 
+*	were not recorded because the writer could not keep up.
+* WRAP_DISK_RECORD_END - the recording was stopped after sampleIndex 
+*	samples. The file is complete if it ends with this record.
+*
+* Sample indices count the samples passed to the streaming callback since 
+* the recording started.
+*
+****************************************************************************/
+
+#define WRAP_DISK_FORMAT_MAGIC				"PSWRAPDR"
+#define WRAP_DISK_FORMAT_VERSION			1
+#define WRAP_DISK_RECORD_ALIGNMENT			8
+
+#define WRAP_DISK_RECORD_SAMPLES			1
+#define WRAP_DISK_RECORD_TRIGGER			2
+#define WRAP_DISK_RECORD_OVERFLOW			3
+#define WRAP_DISK_RECORD_DROPPED			4
+#define WRAP_DISK_RECORD_END				5
+
+#define WRAP_DISK_WRITE_BLOCK				(4 * 1024 * 1024)		// Size of each write to the file - the staging buffer is a multiple of this
+#define WRAP_DISK_DEFAULT_STAGING_MB		256						// Staging buffer size used if StartDiskRecording is passed 0
+#define WRAP_DISK_WRITER_POLL_US			500						// Time the writer thread waits when there is not a full block to write
+
+typedef struct tWrapDiskFileHeader
+{
+	char		magic[8];								// WRAP_DISK_FORMAT_MAGIC, not null terminated
+	uint32_t	version;								// WRAP_DISK_FORMAT_VERSION
+	uint32_t	headerSize;								// Size of this header in bytes - the first record follows it
+	uint32_t	sampleInterval;							// Sample interval passed to ps6000RunStreaming
+	int32_t		timeUnits;								// PS6000_TIME_UNITS value for sampleInterval
+	int32_t		ranges[PS6000_MAX_CHANNELS];			// PS6000_RANGE value for each channel, or -1 if not known
+	int16_t		enabledChannels[PS6000_MAX_CHANNELS];	// Non-zero for each channel being recorded
+	uint64_t	startTime;								// Host time in microseconds when the recording started
+	uint8_t		reserved[8];
+} WRAP_DISK_FILE_HEADER;
+
+typedef struct tWrapDiskRecordHeader
+{
+	uint32_t	type;					// WRAP_DISK_RECORD_SAMPLES, ..., WRAP_DISK_RECORD_END
+	uint32_t	length;					// Number of bytes of data after this header - a multiple of 8
+	uint64_t	sampleIndex;
+	uint32_t	noOfSamples;
+	uint16_t	bufferMask;
+	int16_t		flags;
+} WRAP_DISK_RECORD_HEADER;
+
+/****************************************************************************
+* tWrapDiskRecorder
+*
+* The state of a disk recording. The streaming callback copies each block of 
+* data into the staging ring buffer and never waits for the file, and the 
+* writer thread writes the staged data to the file in WRAP_DISK_WRITE_BLOCK 
+* pieces. The callback is the only writer of writeCursor and the writer 
+* thread is the only writer of readCursor, so no lock is needed between 
+* them. The file header is staged as well, so ring offsets and file offsets
+* are the same and every full block is written at an aligned file offset. 
+* The diskRecorderLock of the device only stops the recording being freed 
+* while the callback or GetDiskRecordingStatus is using it.
+*
+****************************************************************************/
+typedef struct tWrapDiskRecorder
+{
+	FILE *					file;
+	uint8_t *				staging;				// Staging ring buffer
+	uint64_t				stagingSize;			// Size of the staging buffer in bytes - a power of 2
+	volatile uint64_t		writeCursor;			// Total number of bytes staged
+	volatile uint64_t		readCursor;				// Total number of bytes written to the file
+	uint64_t				sampleCount;			// Total number of samples passed to the streaming callback
+	uint64_t				pendingDroppedSamples;	// Dropped samples not yet reported in the file
+	uint64_t				firstDroppedSample;		// Sample index of the first of the pending dropped samples
+	volatile uint64_t		droppedSamples;			// Total number of samples dropped
+	volatile int16_t		stopRequested;
+	volatile PICO_STATUS	status;					// PICO_OK, or PICO_OPERATION_FAILED if the file could not be written
+	WRAP_THREAD				writerThread;
+} WRAP_DISK_RECORDER;
+
+#define WRAP_MAX_HANDLE		32767
+
+#define WRAP_STREAMING_SNAPSHOT_FIELDS		8		// Number of values returned by GetStreamingSnapshot
+#define WRAP_STREAMING_SNAPSHOT64_FIELDS	9		// Number of values returned by GetStreamingSnapshot64
+
+/****************************************************************************
+* tWrapStreamingSnapshot
+*
+* A consistent copy of the streaming status, protected by a sequence lock. 
+* The sequence is odd while the fields are being written, so a reader that 
+* sees an odd sequence, or a different sequence after reading the fields, 
+* reads them again. Readers never block the streaming callback. Writers, 
+* the callback among them, are serialised by snapshotLock, which is held 
+* only while the fields are written.
+*
+****************************************************************************/
+typedef struct tWrapStreamingSnapshot
+{
+	volatile uint32_t	sequence;
+	int16_t				ready;
+	uint32_t			numSamples;
+	uint32_t			startIndex;
+	int16_t				triggered;
+	uint32_t			triggeredAt;
+	int16_t				overflow;
+	int16_t				autoStop;
+	uint32_t			callbackCount;
+	uint64_t			totalSamples;
+} WRAP_STREAMING_SNAPSHOT;
+
+#define WRAP_MAX_TRIGGER_STRUCTURES			32		// Largest number of structures converted by one call to a trigger function
+
+/****************************************************************************
+* uWrapTriggerArena
+*
+* The space in which the trigger functions convert their arrays of integers
+* to driver structures. The arena is held in the WRAP_UNIT_INFO structure
+* for the device, so that setting up a trigger does not allocate memory.
+* A trigger function passed more than WRAP_MAX_TRIGGER_STRUCTURES 
+* structures uses triggerArenaOverflow, heap memory that is allocated when
+* first needed and kept until the device is released.
+*
+****************************************************************************/
+typedef union uWrapTriggerArena
+{
+	PS6000_TRIGGER_CONDITIONS			conditions[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS6000_TRIGGER_CHANNEL_PROPERTIES	channelProperties[WRAP_MAX_TRIGGER_STRUCTURES];
+	PS6000_PWQ_CONDITIONS				pwqConditions[WRAP_MAX_TRIGGER_STRUCTURES];
+} WRAP_TRIGGER_ARENA;
+
+/****************************************************************************
+* tWrapUnitInfo
+*
+* The wrapper state for one device. A structure is created for each handle 
+* the first time it is passed to a wrapper function, and is passed to the 
+* driver callbacks through pParameter, so several devices can collect data 
+* at the same time.
+*
+****************************************************************************/
+typedef struct tWrapUnitInfo
+{
+	int16_t						handle;
+	volatile int16_t			ready;
+	int16_t						autoStop;
+	uint32_t					numSamples;
+	uint32_t					triggeredAt;
+	int16_t						triggered;
+	uint32_t					startIndex;								// Start index in driver buffer
+	int16_t						overflow;
+
+	int16_t						channelCount;							// Should be set to 4 from the main application
+	int16_t						enabledChannels[PS6000_MAX_CHANNELS];	// Keep a record of the channels that are enabled
+
+	WRAP_BUFFER_INFO			wrapBufferInfo;
+	WRAP_STREAMING_EVENT_QUEUE	eventQueue;
+	WRAP_TRIGGER_LOG			triggerLog;
+
+	WRAP_LOCK					readyLock;								// Protects ready for WaitForStreamingData and WaitForBlockReady
+	WRAP_CONDITION				readyCondition;
+
+	uint32_t					callbackCount;							// Number of streaming callbacks received
+	uint64_t					totalSamples;							// Samples received since clearStreamingParameters - the index of the next sample in segmented buffers
+	WRAP_STREAMING_SNAPSHOT		snapshot;								// Status read by GetStreamingSnapshot
+	WRAP_LOCK					snapshotLock;							// Serialises writers of snapshot - readers do not take it
+
+	WRAP_DISK_RECORDER *		diskRecorder;							// NULL unless a disk recording is in progress
+	WRAP_LOCK					diskRecorderLock;						// Protects diskRecorder and is held while the streaming callback stages data
+
+	WRAP_TRIGGER_ARENA			triggerArena;							// Space used by the trigger functions to convert their arrays
+	void *						triggerArenaOverflow;					// Heap space used in place of triggerArena for more structures than it holds
+	size_t						triggerArenaOverflowSize;				// Size of triggerArenaOverflow in bytes
+
+	uint32_t					streamingCallsInProgress;				// GetStreamingLatestValues calls in progress, protected by _wrapUnitInfoLock
+} WRAP_UNIT_INFO;
+
+WRAP_UNIT_INFO *	_wrapUnitInfo[WRAP_MAX_HANDLE + 1];		// Wrapper state for each device, indexed by handle
+WRAP_LOCK			_wrapUnitInfoLock = WRAP_LOCK_INIT;		// Serialises creation and release of _wrapUnitInfo entries
+WRAP_CONDITION		_wrapUnitInfoCondition = WRAP_CONDITION_INIT;	// Signalled when a streaming call in progress ends
 
 /////////////////////////////////
 //
@@ -125,6 +479,18 @@ extern int16_t PREF0 PREF1 IsReady
 	int16_t handle
 );
 
+extern int16_t PREF0 PREF1 WaitForStreamingData
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
+extern int16_t PREF0 PREF1 WaitForBlockReady
+(
+	int16_t handle,
+	uint32_t timeoutMs
+);
+
 extern int16_t PREF0 PREF1 IsTriggerReady
 (
 	int16_t handle, 
@@ -194,6 +560,18 @@ extern int16_t PREF0 PREF1 setMaxMinAppAndDriverBuffers
 	uint32_t bufferLength
 );
 
+extern PICO_STATUS PREF0 PREF1 setSegmentedAppAndDriverBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	int16_t ** appMaxSegments,
+	int16_t ** appMinSegments,
+	uint64_t * segmentLengths,
+	uint32_t nSegments,
+	int16_t * driverMaxBuffer,
+	int16_t * driverMinBuffer
+);
+
 extern void PREF0 PREF1 clearStreamingParameters
 (
 	int16_t handle
@@ -205,5 +583,99 @@ extern PICO_STATUS PREF0 PREF1 getOverflow
 		int16_t * overflow
 );
 
+extern PICO_STATUS PREF0 PREF1 DrainStreamingEvents
+(
+	int16_t handle,
+	uint32_t * events,
+	uint32_t maxEvents,
+	uint32_t * nEvents,
+	uint32_t * droppedEvents
+);
+
+extern PICO_STATUS PREF0 PREF1 DrainTriggerLog
+(
+	int16_t handle,
+	uint64_t * triggers,
+	uint32_t maxTriggers,
+	uint32_t * nTriggers,
+	uint32_t * droppedTriggers
+);
+
+extern PICO_STATUS PREF0 PREF1 resetTriggerLog
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setChannelScaling
+(
+	int16_t handle,
+	int16_t channel,
+	int32_t range,
+	float analogueOffset,
+	int16_t maxADCValue,
+	float probeAttenuation
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppFloatBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	float * appMaxBuffer,
+	float * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 setAppDoubleBuffers
+(
+	int16_t handle,
+	int16_t channel,
+	double * appMaxBuffer,
+	double * appMinBuffer
+);
+
+extern PICO_STATUS PREF0 PREF1 StartDiskRecording
+(
+	int16_t handle,
+	int8_t * filePath,
+	int32_t * channelRanges,
+	uint32_t sampleInterval,
+	int32_t timeUnits,
+	uint32_t stagingSizeMB
+);
+
+extern PICO_STATUS PREF0 PREF1 StopDiskRecording
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 GetDiskRecordingStatus
+(
+	int16_t handle,
+	uint64_t * bytesWritten,
+	uint64_t * droppedSamples,
+	int16_t * isRecording
+);
+
+extern PICO_STATUS PREF0 PREF1 releaseWrapUnitInfo
+(
+	int16_t handle
+);
+
+extern PICO_STATUS PREF0 PREF1 setNonTemporalCopyThreshold
+(
+	uint32_t thresholdBytes
+);
+
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot
+(
+	int16_t handle,
+	uint32_t * snapshot
+);
+
+extern PICO_STATUS PREF0 PREF1 GetStreamingSnapshot64
+(
+	int16_t handle,
+	uint64_t * snapshot
+);
+
 #endif
 
@@ -0,0 +1,944 @@
+/****************************************************************************
+ *
+ * Filename: picoSimulator.c
+ *
+ * Description:
+ *	Shared core of the simulated PicoScope drivers. See picoSimulator.h.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "picoSimulator.h"
+
+/////////////////////////////////
+//
+//	Variable definitions
+//
+/////////////////////////////////
+
+static SIM_CONFIG		_simConfig;
+static int16_t			_simConfigLoaded = 0;
+static const char *		_simVariant = NULL;
+
+static SIM_UNIT			_simUnits[SIM_MAX_UNITS];
+static pthread_mutex_t	_simUnitsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int16_t			_sineTable[SIM_SINE_TABLE_SIZE];
+static pthread_once_t	_sineTableOnce = PTHREAD_ONCE_INIT;
+
+/****************************************************************************
+* tSimBlockCapture
+*
+* The parameters passed to the thread that completes a block capture.
+*
+****************************************************************************/
+typedef struct tSimBlockCapture
+{
+	int16_t			handle;
+	uint64_t		captureTimeUs;
+	SIM_BLOCK_READY	lpReady;
+	void *			pParameter;
+} SIM_BLOCK_CAPTURE;
+
+/////////////////////////////////
+//
+//	Function definitions
+//
+/////////////////////////////////
+
+/****************************************************************************
+* getTimeMicroseconds
+*
+* Returns a monotonic time stamp in microseconds.
+*
+****************************************************************************/
+static uint64_t getTimeMicroseconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+}
+
+/****************************************************************************
+* getEnvironmentValue
+*
+* Returns the value of a numeric environment variable, or defaultValue if
+* it is not set.
+*
+****************************************************************************/
+static uint64_t getEnvironmentValue(const char * name, uint64_t defaultValue)
+{
+	const char * value = getenv(name);
+
+	if (value == NULL || *value == '\0')
+	{
+		return defaultValue;
+	}
+
+	return strtoull(value, NULL, 0);
+}
+
+/****************************************************************************
+* initSineTable
+*
+* Fills the table used to generate the sine wave channels.
+*
+****************************************************************************/
+static void initSineTable(void)
+{
+	int32_t i = 0;
+
+	for (i = 0; i < SIM_SINE_TABLE_SIZE; i++)
+	{
+		_sineTable[i] = (int16_t) (0.8 * SIM_MAX_ADC_VALUE * sin(2.0 * M_PI * i / SIM_SINE_TABLE_SIZE));
+	}
+}
+
+/****************************************************************************
+* simGetConfig
+*
+* Returns the simulator settings, reading them from the environment the
+* first time.
+*
+****************************************************************************/
+SIM_CONFIG * simGetConfig(void)
+{
+	if (!_simConfigLoaded)
+	{
+		_simConfig.sampleRate = getEnvironmentValue("PICO_SIM_SAMPLE_RATE", 0);
+		_simConfig.chunkSize = (uint32_t) getEnvironmentValue("PICO_SIM_CHUNK_SIZE", SIM_DEFAULT_CHUNK_SIZE);
+		_simConfig.overflowInterval = (uint32_t) getEnvironmentValue("PICO_SIM_OVERFLOW_INTERVAL", 0);
+		_simConfig.triggerInterval = getEnvironmentValue("PICO_SIM_TRIGGER_INTERVAL", 0);
+		_simVariant = getenv("PICO_SIM_VARIANT");
+
+		if (_simConfig.chunkSize == 0)
+		{
+			_simConfig.chunkSize = SIM_DEFAULT_CHUNK_SIZE;
+		}
+
+		_simConfigLoaded = 1;
+	}
+
+	return &_simConfig;
+}
+
+/****************************************************************************
+* simConfigure
+*
+* Changes the simulator settings. See tSimConfig. A chunkSize of 0 selects
+* SIM_DEFAULT_CHUNK_SIZE.
+*
+****************************************************************************/
+void simConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval)
+{
+	SIM_CONFIG * config = simGetConfig();
+
+	config->sampleRate = sampleRate;
+	config->chunkSize = (chunkSize > 0) ? chunkSize : SIM_DEFAULT_CHUNK_SIZE;
+	config->overflowInterval = overflowInterval;
+	config->triggerInterval = triggerInterval;
+}
+
+/****************************************************************************
+* simSampleValue
+*
+* Returns the value of a sample. Each analogue channel has a different
+* waveform and period - a sine wave, a square wave, a triangle wave or a
+* sine wave with noise - and each digital port counts up, so the data can
+* be checked after it has passed through a wrapper.
+*
+****************************************************************************/
+int16_t simSampleValue(int32_t source, uint64_t sampleIndex)
+{
+	uint64_t period = 1000 + 250 * (uint64_t) source;
+	uint64_t phase = sampleIndex % period;
+	int32_t amplitude = (int32_t) (0.8 * SIM_MAX_ADC_VALUE);
+	uint64_t noise = 0;
+
+	if (source >= SIM_MAX_ANALOGUE_CHANNELS)
+	{
+		// Digital ports
+		return (int16_t) ((sampleIndex >> (source - SIM_MAX_ANALOGUE_CHANNELS)) & 0xFF);
+	}
+
+	switch (source % 4)
+	{
+		case 0:
+			return _sineTable[(phase * SIM_SINE_TABLE_SIZE) / period];
+
+		case 1:
+			return (int16_t) ((phase < period / 2) ? amplitude : -amplitude);
+
+		case 2:
+			return (int16_t) (-amplitude + (int32_t) ((4 * (uint64_t) amplitude * ((phase < period / 2) ? phase : period - phase)) / period));
+
+		default:
+			// Deterministic noise from a hash of the sample index
+			noise = (sampleIndex + 1) * 0x9E3779B97F4A7C15ULL;
+			noise ^= noise >> 29;
+			noise *= 0xBF58476D1CE4E5B9ULL;
+			noise ^= noise >> 32;
+
+			return (int16_t) (_sineTable[(phase * SIM_SINE_TABLE_SIZE) / period] / 2 + (int16_t) (noise & 0x0FFF) - 0x0800);
+	}
+}
+
+/****************************************************************************
+* simOpenUnit
+*
+* Opens a simulated device. Returns NULL if SIM_MAX_UNITS devices are open.
+*
+****************************************************************************/
+SIM_UNIT * simOpenUnit(int16_t channelCount, int16_t digitalPortCount, const char * defaultVariant)
+{
+	SIM_UNIT * unit = NULL;
+	int16_t i = 0;
+
+	pthread_once(&_sineTableOnce, initSineTable);
+	simGetConfig();
+
+	pthread_mutex_lock(&_simUnitsLock);
+
+	for (i = 0; i < SIM_MAX_UNITS; i++)
+	{
+		if (_simUnits[i].handle == 0)
+		{
+			unit = &_simUnits[i];
+
+			memset(unit, 0, sizeof(SIM_UNIT));
+			unit->handle = i + 1;
+			unit->channelCount = channelCount;
+			unit->digitalPortCount = digitalPortCount;
+			unit->variant = (_simVariant != NULL) ? _simVariant : defaultVariant;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&_simUnitsLock);
+
+	return unit;
+}
+
+/****************************************************************************
+* simGetUnit
+*
+* Returns the simulated device for a handle, or NULL if it is not open.
+*
+****************************************************************************/
+SIM_UNIT * simGetUnit(int16_t handle)
+{
+	if (handle <= 0 || handle > SIM_MAX_UNITS || _simUnits[handle - 1].handle != handle)
+	{
+		return NULL;
+	}
+
+	return &_simUnits[handle - 1];
+}
+
+/****************************************************************************
+* simCheckHandle
+*
+* Returns PICO_OK if the handle is an open simulated device. Used by the
+* functions that only record their settings.
+*
+****************************************************************************/
+SIM_STATUS simCheckHandle(int16_t handle)
+{
+	return (simGetUnit(handle) != NULL) ? PICO_OK : PICO_INVALID_HANDLE;
+}
+
+/****************************************************************************
+* freeOverviewBuffers
+*
+* Frees the overview buffers of a device.
+*
+****************************************************************************/
+static void freeOverviewBuffers(SIM_UNIT * unit)
+{
+	int16_t i = 0;
+
+	for (i = 0; i < SIM_MAX_BUFFERS; i++)
+	{
+		free(unit->overviewBuffers[i]);
+		unit->overviewBuffers[i] = NULL;
+	}
+
+	unit->overviewBufferSize = 0;
+}
+
+/****************************************************************************
+* simCloseUnit
+*
+* Closes a simulated device.
+*
+****************************************************************************/
+SIM_STATUS simCloseUnit(int16_t handle)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	pthread_mutex_lock(&_simUnitsLock);
+
+	unit->streaming = 0;
+	freeOverviewBuffers(unit);
+	unit->handle = 0;
+
+	pthread_mutex_unlock(&_simUnitsLock);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simGetUnitInfo
+*
+* Returns a null terminated information string in the same way as the
+* driver GetUnitInfo functions.
+*
+****************************************************************************/
+SIM_STATUS simGetUnitInfo(int16_t handle, int8_t * string, int16_t stringLength, int16_t * requiredSize, uint32_t info)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	const char * value = NULL;
+	int16_t length = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	switch (info)
+	{
+		case PICO_DRIVER_VERSION:
+			value = "Simulator 1.0";
+			break;
+
+		case PICO_USB_VERSION:
+			value = "3.0";
+			break;
+
+		case PICO_HARDWARE_VERSION:
+			value = "1";
+			break;
+
+		case PICO_VARIANT_INFO:
+			value = unit->variant;
+			break;
+
+		case PICO_BATCH_AND_SERIAL:
+			value = "SIM00/0000";
+			break;
+
+		default:
+			return PICO_INVALID_INFO;
+	}
+
+	length = (int16_t) strlen(value) + 1;
+
+	if (requiredSize != NULL)
+	{
+		*requiredSize = length;
+	}
+
+	if (string != NULL && stringLength > 0)
+	{
+		strncpy((char *) string, value, stringLength);
+		string[stringLength - 1] = '\0';
+	}
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* getSource
+*
+* Converts a driver channel value to a simulator source index, or returns -1
+* if the device does not have the channel or port.
+*
+****************************************************************************/
+static int32_t getSource(SIM_UNIT * unit, int32_t channel)
+{
+	if (channel >= 0 && channel < unit->channelCount)
+	{
+		return channel;
+	}
+
+	if (channel >= SIM_DIGITAL_PORT_OFFSET && channel < SIM_DIGITAL_PORT_OFFSET + unit->digitalPortCount)
+	{
+		return SIM_MAX_ANALOGUE_CHANNELS + channel - SIM_DIGITAL_PORT_OFFSET;
+	}
+
+	return -1;
+}
+
+/****************************************************************************
+* simSetChannel
+*
+* Enables or disables a channel or digital port.
+*
+****************************************************************************/
+SIM_STATUS simSetChannel(int16_t handle, int32_t channel, int16_t enabled)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	int32_t source = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	source = getSource(unit, channel);
+
+	if (source < 0)
+	{
+		return (channel >= SIM_DIGITAL_PORT_OFFSET) ? PICO_INVALID_DIGITAL_PORT : PICO_INVALID_CHANNEL;
+	}
+
+	unit->enabled[source] = enabled ? 1 : 0;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simSetDataBuffers
+*
+* Registers the buffers that the data for a channel or digital port is
+* written to. Either buffer may be NULL. The buffers may be changed while
+* streaming, as the zero-copy mode of the ps3000a wrapper does.
+*
+****************************************************************************/
+SIM_STATUS simSetDataBuffers(int16_t handle, int32_t channel, int16_t * bufferMax, int16_t * bufferMin, uint32_t bufferLength)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	int32_t source = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	source = getSource(unit, channel);
+
+	if (source < 0)
+	{
+		return (channel >= SIM_DIGITAL_PORT_OFFSET) ? PICO_INVALID_DIGITAL_PORT : PICO_INVALID_CHANNEL;
+	}
+
+	unit->buffers[source * 2] = bufferMax;
+	unit->buffers[source * 2 + 1] = bufferMin;
+	unit->bufferLengths[source] = bufferLength;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simSetDataBufferBulk
+*
+* Registers the buffer for one capture of a channel in rapid block mode.
+*
+****************************************************************************/
+SIM_STATUS simSetDataBufferBulk(int16_t handle, int32_t channel, int16_t * buffer, uint32_t bufferLength, uint32_t waveform)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	int32_t source = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	source = getSource(unit, channel);
+
+	if (source < 0)
+	{
+		return PICO_INVALID_CHANNEL;
+	}
+
+	if (waveform >= SIM_MAX_WAVEFORMS)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	unit->bulkBuffers[source][waveform] = buffer;
+	unit->bulkBufferLengths[source][waveform] = bufferLength;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* generateSamples
+*
+* Writes noOfSamples downsampled values for a source, starting with raw
+* sample firstSample, to the given max and min buffers. Either buffer may
+* be NULL.
+*
+****************************************************************************/
+static void generateSamples(int32_t source, uint64_t firstSample, uint32_t downSampleRatio, int16_t aggregate, int16_t * bufferMax,
+	int16_t * bufferMin, uint32_t noOfSamples)
+{
+	uint32_t i = 0;
+	uint32_t j = 0;
+	uint64_t rawIndex = firstSample;
+	int16_t value = 0;
+	int16_t maxValue = 0;
+	int16_t minValue = 0;
+
+	for (i = 0; i < noOfSamples; i++)
+	{
+		maxValue = minValue = simSampleValue(source, rawIndex);
+
+		if (aggregate)
+		{
+			for (j = 1; j < downSampleRatio; j++)
+			{
+				value = simSampleValue(source, rawIndex + j);
+
+				if (value > maxValue)
+				{
+					maxValue = value;
+				}
+
+				if (value < minValue)
+				{
+					minValue = value;
+				}
+			}
+		}
+
+		rawIndex += downSampleRatio;
+
+		if (bufferMax != NULL)
+		{
+			bufferMax[i] = maxValue;
+		}
+
+		if (bufferMin != NULL)
+		{
+			bufferMin[i] = minValue;
+		}
+	}
+}
+
+/****************************************************************************
+* simRunStreaming
+*
+* Starts streaming. maxSamples is the number of samples after downsampling
+* collected before streaming stops when autoStop is set. If
+* overviewBufferSize is not 0, overview buffers of that size are allocated
+* for the ps2000 and ps3000 streaming callbacks.
+*
+****************************************************************************/
+SIM_STATUS simRunStreaming(int16_t handle, uint64_t maxSamples, int16_t autoStop, uint32_t downSampleRatio, int16_t aggregate,
+	uint32_t overviewBufferSize)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	int16_t i = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	freeOverviewBuffers(unit);
+
+	if (overviewBufferSize > 0)
+	{
+		for (i = 0; i < unit->channelCount * 2; i++)
+		{
+			unit->overviewBuffers[i] = (int16_t *) calloc(overviewBufferSize, sizeof(int16_t));
+
+			if (unit->overviewBuffers[i] == NULL)
+			{
+				freeOverviewBuffers(unit);
+				return PICO_MEMORY;
+			}
+		}
+
+		unit->overviewBufferSize = overviewBufferSize;
+	}
+
+	unit->autoStop = autoStop;
+	unit->maxSamples = maxSamples;
+	unit->downSampleRatio = (downSampleRatio > 0) ? downSampleRatio : 1;
+	unit->aggregate = (aggregate && unit->downSampleRatio > 1) ? 1 : 0;
+	unit->rawSampleCount = 0;
+	unit->samplesDelivered = 0;
+	unit->writeIndex = 0;
+	unit->callbackCount = 0;
+	unit->nextTriggerSample = simGetConfig()->triggerInterval;
+	unit->startTime = getTimeMicroseconds();
+	unit->streaming = 1;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* getStreamingBufferLength
+*
+* Returns the length of the shortest buffer registered for an enabled
+* source, which is where the driver buffers wrap round to the start, or 0
+* if no buffers are registered.
+*
+****************************************************************************/
+static uint32_t getStreamingBufferLength(SIM_UNIT * unit)
+{
+	uint32_t length = 0;
+	int32_t source = 0;
+
+	if (unit->overviewBufferSize > 0)
+	{
+		return unit->overviewBufferSize;
+	}
+
+	for (source = 0; source < SIM_MAX_SOURCES; source++)
+	{
+		if (unit->enabled[source] && (unit->buffers[source * 2] || unit->buffers[source * 2 + 1]))
+		{
+			if (length == 0 || unit->bufferLengths[source] < length)
+			{
+				length = unit->bufferLengths[source];
+			}
+		}
+	}
+
+	return length;
+}
+
+/****************************************************************************
+* simNextChunk
+*
+* Generates the next block of streaming data into the registered buffers
+* (or the overview buffers) and returns the values for the callback.
+*
+* Returns:
+*
+* PICO_OK, if the chunk holds samples or the autostop indication.
+* PICO_BUSY, if no samples are due yet.
+* PICO_INVALID_HANDLE, if the handle is not an open device.
+* PICO_NOT_USED, if the device is not streaming.
+*
+****************************************************************************/
+SIM_STATUS simNextChunk(int16_t handle, SIM_CHUNK * chunk)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	SIM_CONFIG * config = simGetConfig();
+	uint64_t due = 0;
+	uint64_t elapsed = 0;
+	uint32_t bufferLength = 0;
+	int32_t source = 0;
+	int16_t channel = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	if (!unit->streaming)
+	{
+		return PICO_NOT_USED;
+	}
+
+	memset(chunk, 0, sizeof(SIM_CHUNK));
+
+	due = config->chunkSize;
+
+	if (config->sampleRate > 0)
+	{
+		elapsed = getTimeMicroseconds() - unit->startTime;
+		due = (elapsed * config->sampleRate) / 1000000 - unit->samplesDelivered;
+
+		if (due > config->chunkSize)
+		{
+			due = config->chunkSize;
+		}
+	}
+
+	if (unit->autoStop && unit->maxSamples > 0 && due > unit->maxSamples - unit->samplesDelivered)
+	{
+		due = unit->maxSamples - unit->samplesDelivered;
+	}
+
+	bufferLength = getStreamingBufferLength(unit);
+
+	if (bufferLength > 0)
+	{
+		if (unit->writeIndex >= bufferLength)
+		{
+			unit->writeIndex = 0;
+		}
+
+		// The driver does not split a callback across the end of its buffers
+		if (due > bufferLength - unit->writeIndex)
+		{
+			due = bufferLength - unit->writeIndex;
+		}
+	}
+
+	if (due == 0 && !(unit->autoStop && unit->maxSamples > 0 && unit->samplesDelivered >= unit->maxSamples))
+	{
+		return PICO_BUSY;
+	}
+
+	chunk->noOfSamples = (uint32_t) due;
+	chunk->startIndex = (unit->overviewBufferSize > 0) ? 0 : unit->writeIndex;
+
+	for (source = 0; source < SIM_MAX_SOURCES && due > 0; source++)
+	{
+		if (!unit->enabled[source])
+		{
+			continue;
+		}
+
+		if (unit->overviewBufferSize > 0)
+		{
+			generateSamples(source, unit->rawSampleCount, unit->downSampleRatio, 1, unit->overviewBuffers[source * 2],
+				unit->overviewBuffers[source * 2 + 1], chunk->noOfSamples);
+		}
+		else if (bufferLength > 0)
+		{
+			generateSamples(source, unit->rawSampleCount, unit->downSampleRatio, unit->aggregate,
+				unit->buffers[source * 2] ? &unit->buffers[source * 2][unit->writeIndex] : NULL,
+				unit->buffers[source * 2 + 1] ? &unit->buffers[source * 2 + 1][unit->writeIndex] : NULL, chunk->noOfSamples);
+		}
+	}
+
+	if (due > 0)
+	{
+		unit->callbackCount++;
+
+		if (config->overflowInterval > 0 && (unit->callbackCount % config->overflowInterval) == 0)
+		{
+			for (channel = 0; channel < unit->channelCount; channel++)
+			{
+				if (unit->enabled[channel])
+				{
+					chunk->overflow |= (int16_t) (1 << channel);
+				}
+			}
+		}
+
+		if (config->triggerInterval > 0 && unit->nextTriggerSample < unit->samplesDelivered + due)
+		{
+			chunk->triggered = 1;
+			chunk->triggerAt = (uint32_t) (unit->nextTriggerSample - unit->samplesDelivered);
+			unit->nextTriggerSample += config->triggerInterval;
+		}
+	}
+
+	unit->rawSampleCount += due * unit->downSampleRatio;
+	unit->samplesDelivered += due;
+	unit->writeIndex += (uint32_t) due;
+
+	if (unit->autoStop && unit->maxSamples > 0 && unit->samplesDelivered >= unit->maxSamples)
+	{
+		chunk->autoStop = 1;
+		unit->streaming = 0;
+	}
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simGetStreamingLatestValues
+*
+* Calls the streaming callback with the next block of data, in the same way
+* as the driver GetStreamingLatestValues functions.
+*
+****************************************************************************/
+SIM_STATUS simGetStreamingLatestValues(int16_t handle, SIM_STREAMING_READY lpReady, void * pParameter)
+{
+	SIM_CHUNK chunk;
+	SIM_STATUS status = PICO_OK;
+
+	if (lpReady == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	status = simNextChunk(handle, &chunk);
+
+	if (status == PICO_OK)
+	{
+		lpReady(handle, (int32_t) chunk.noOfSamples, chunk.startIndex, chunk.overflow, chunk.triggerAt, chunk.triggered,
+			chunk.autoStop, pParameter);
+	}
+
+	return status;
+}
+
+/****************************************************************************
+* simGetOverviewValues
+*
+* Calls the ps2000 and ps3000 overview buffer callback with the next block
+* of data. Returns 1 if the callback was called, otherwise 0.
+*
+****************************************************************************/
+int16_t simGetOverviewValues(int16_t handle, SIM_OVERVIEW_READY lpGetOverviewBuffersMaxMin)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	SIM_CHUNK chunk;
+
+	if (unit == NULL || lpGetOverviewBuffersMaxMin == NULL || simNextChunk(handle, &chunk) != PICO_OK)
+	{
+		return 0;
+	}
+
+	lpGetOverviewBuffersMaxMin(unit->overviewBuffers, chunk.overflow, chunk.triggerAt, chunk.triggered, chunk.autoStop, chunk.noOfSamples);
+
+	return 1;
+}
+
+/****************************************************************************
+* blockCaptureThread
+*
+* Waits for the time a block capture would take and then calls the block
+* ready callback, as the driver does from its own thread.
+*
+****************************************************************************/
+static void * blockCaptureThread(void * parameter)
+{
+	SIM_BLOCK_CAPTURE * capture = (SIM_BLOCK_CAPTURE *) parameter;
+
+	if (capture->captureTimeUs > 0)
+	{
+		usleep((useconds_t) capture->captureTimeUs);
+	}
+
+	if (capture->lpReady != NULL)
+	{
+		capture->lpReady(capture->handle, PICO_OK, capture->pParameter);
+	}
+
+	free(capture);
+
+	return NULL;
+}
+
+/****************************************************************************
+* simRunBlock
+*
+* Fills the registered buffers, and any rapid block buffers, with a block
+* of noOfSamples samples and calls the block ready callback from another
+* thread once the capture time has passed.
+*
+****************************************************************************/
+SIM_STATUS simRunBlock(int16_t handle, uint32_t noOfSamples, int32_t * timeIndisposedMs, SIM_BLOCK_READY lpReady, void * pParameter)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+	SIM_CONFIG * config = simGetConfig();
+	SIM_BLOCK_CAPTURE * capture = NULL;
+	pthread_t thread;
+	uint32_t length = 0;
+	uint32_t waveform = 0;
+	int32_t source = 0;
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	for (source = 0; source < SIM_MAX_SOURCES; source++)
+	{
+		if (!unit->enabled[source])
+		{
+			continue;
+		}
+
+		length = (unit->bufferLengths[source] < noOfSamples) ? unit->bufferLengths[source] : noOfSamples;
+		generateSamples(source, 0, 1, 0, unit->buffers[source * 2], unit->buffers[source * 2 + 1], length);
+
+		for (waveform = 0; waveform < SIM_MAX_WAVEFORMS; waveform++)
+		{
+			if (unit->bulkBuffers[source][waveform] != NULL)
+			{
+				length = (unit->bulkBufferLengths[source][waveform] < noOfSamples) ? unit->bulkBufferLengths[source][waveform] : noOfSamples;
+				generateSamples(source, (uint64_t) waveform * noOfSamples, 1, 0, unit->bulkBuffers[source][waveform], NULL, length);
+			}
+		}
+	}
+
+	capture = (SIM_BLOCK_CAPTURE *) calloc(1, sizeof(SIM_BLOCK_CAPTURE));
+
+	if (capture == NULL)
+	{
+		return PICO_MEMORY;
+	}
+
+	capture->handle = handle;
+	capture->captureTimeUs = (config->sampleRate > 0) ? ((uint64_t) noOfSamples * 1000000) / config->sampleRate : 0;
+	capture->lpReady = lpReady;
+	capture->pParameter = pParameter;
+
+	if (timeIndisposedMs != NULL)
+	{
+		*timeIndisposedMs = (int32_t) (capture->captureTimeUs / 1000);
+	}
+
+	if (pthread_create(&thread, NULL, blockCaptureThread, capture) != 0)
+	{
+		free(capture);
+		return PICO_OPERATION_FAILED;
+	}
+
+	pthread_detach(thread);
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simStop
+*
+* Stops streaming.
+*
+****************************************************************************/
+SIM_STATUS simStop(int16_t handle)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	unit->streaming = 0;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* simSetProbeInteractionCallback
+*
+* Registers the probe interaction callback and calls it once, as the driver
+* does when the callback is set. The simulated devices have no intelligent
+* probes, so the callback reports 0 probes.
+*
+****************************************************************************/
+SIM_STATUS simSetProbeInteractionCallback(int16_t handle, SIM_PROBE_INTERACTIONS callback)
+{
+	SIM_UNIT * unit = simGetUnit(handle);
+
+	if (unit == NULL)
+	{
+		return PICO_INVALID_HANDLE;
+	}
+
+	unit->probeInteractions = callback;
+
+	if (callback != NULL)
+	{
+		callback(handle, PICO_OK, NULL, 0);
+	}
+
+	return PICO_OK;
+}
@@ -0,0 +1,216 @@
+/****************************************************************************
+ *
+ * Filename:    picoSimulator.h
+ *
+ * Description:
+ *	This header defines the shared core of the simulated PicoScope drivers.
+ *
+ *	The simulated drivers provide the driver functions used by the wrapper
+ *	libraries so that the wrappers can be built, tested and benchmarked on
+ *	Linux without a device connected. Each psXXXXSim.c file implements the
+ *	functions for one driver on top of this core, which generates a
+ *	deterministic signal for each channel and delivers it in streaming
+ *	callbacks of a configurable size and rate, with over-range and trigger
+ *	events added at regular intervals.
+ *
+ *	The functions are defined with types that are compatible at the binary
+ *	level with the driver headers (enumerations are passed as int32_t and
+ *	structures as void pointers), so the simulator can be built without
+ *	the PicoSDK headers installed.
+ *
+ *	The behaviour can be set from the environment before the first device
+ *	is opened:
+ *
+ *	PICO_SIM_SAMPLE_RATE - samples per second delivered for each channel,
+ *		or 0 (the default) to deliver a full chunk on every call.
+ *	PICO_SIM_CHUNK_SIZE - the maximum number of samples passed to each
+ *		streaming callback (default SIM_DEFAULT_CHUNK_SIZE).
+ *	PICO_SIM_OVERFLOW_INTERVAL - report an over-range on every Nth
+ *		streaming callback (default 0, never).
+ *	PICO_SIM_TRIGGER_INTERVAL - report a trigger once every N samples
+ *		(default 0, never).
+ *	PICO_SIM_VARIANT - the model number returned by the GetUnitInfo
+ *		functions.
+ *
+ *	or at any time with the psXXXXSimConfigure function of each simulated
+ *	driver.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#ifndef __PICOSIMULATOR_H__
+#define __PICOSIMULATOR_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef PICO_OK
+#define PICO_OK						0x00000000UL
+#define PICO_MAX_UNITS_OPENED		0x00000001UL
+#define PICO_NOT_FOUND				0x00000003UL
+#define PICO_INVALID_HANDLE			0x0000000CUL
+#define PICO_INVALID_PARAMETER		0x0000000DUL
+#define PICO_INVALID_CHANNEL		0x00000010UL
+#define PICO_NULL_PARAMETER			0x00000016UL
+#define PICO_NOT_USED				0x0000003FUL
+#define PICO_BUSY					0x00000027UL
+#define PICO_INVALID_INFO			0x00000029UL
+#define PICO_MEMORY					0x0000002DUL
+#define PICO_TOO_MANY_SAMPLES		0x0000001DUL
+#define PICO_INVALID_DIGITAL_PORT	0x00000054UL
+#define PICO_OPERATION_FAILED		0x00000006UL
+
+#define PICO_DRIVER_VERSION			0x00000000
+#define PICO_USB_VERSION			0x00000001
+#define PICO_HARDWARE_VERSION		0x00000002
+#define PICO_VARIANT_INFO			0x00000003
+#define PICO_BATCH_AND_SERIAL		0x00000004
+#endif
+
+typedef uint32_t SIM_STATUS;
+
+// The core is linked into every simulated driver, so it is kept out of their exports
+#define SIM_INTERNAL __attribute__((visibility("hidden")))
+
+#define SIM_MAX_UNITS				64
+#define SIM_MAX_ANALOGUE_CHANNELS	8
+#define SIM_MAX_DIGITAL_PORTS		4
+#define SIM_MAX_SOURCES				(SIM_MAX_ANALOGUE_CHANNELS + SIM_MAX_DIGITAL_PORTS)	// Digital port n is source SIM_MAX_ANALOGUE_CHANNELS + n
+#define SIM_MAX_BUFFERS				(SIM_MAX_SOURCES * 2)								// Max and min buffer for each source
+#define SIM_MAX_WAVEFORMS			64													// Rapid block buffers held for each source
+
+#define SIM_DEFAULT_CHUNK_SIZE		10000
+#define SIM_MAX_ADC_VALUE			32512
+#define SIM_SINE_TABLE_SIZE			1024
+
+#define SIM_DIGITAL_PORT_OFFSET		0x80		// Value of the first digital port in the driver channel enumerations
+
+// Callbacks, compatible with the driver callback types
+
+typedef void (*SIM_STREAMING_READY)(int16_t handle, int32_t noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt,
+	int16_t triggered, int16_t autoStop, void * pParameter);
+
+typedef void (*SIM_BLOCK_READY)(int16_t handle, uint32_t status, void * pParameter);
+
+typedef void (*SIM_OVERVIEW_READY)(int16_t ** overviewBuffers, int16_t overflow, uint32_t triggeredAt, int16_t triggered,
+	int16_t autoStop, uint32_t nValues);
+
+typedef void (*SIM_PROBE_INTERACTIONS)(int16_t handle, uint32_t status, void * probes, uint32_t nProbes);
+
+/****************************************************************************
+* tSimConfig
+*
+* Settings that apply to every simulated device.
+*
+****************************************************************************/
+typedef struct tSimConfig
+{
+	uint64_t	sampleRate;				// Samples per second delivered for each channel, or 0 for as fast as the caller polls
+	uint32_t	chunkSize;				// Maximum number of samples passed to each streaming callback
+	uint32_t	overflowInterval;		// Report an over-range on every Nth streaming callback, or 0 for never
+	uint64_t	triggerInterval;		// Report a trigger once every N samples, or 0 for never
+} SIM_CONFIG;
+
+/****************************************************************************
+* tSimChunk
+*
+* The values passed to one streaming callback.
+*
+****************************************************************************/
+typedef struct tSimChunk
+{
+	uint32_t	noOfSamples;
+	uint32_t	startIndex;
+	int16_t		overflow;
+	uint32_t	triggerAt;
+	int16_t		triggered;
+	int16_t		autoStop;
+} SIM_CHUNK;
+
+/****************************************************************************
+* tSimUnit
+*
+* The state of one simulated device.
+*
+****************************************************************************/
+typedef struct tSimUnit
+{
+	int16_t			handle;								// 0 if the slot is not in use
+	int16_t			channelCount;
+	int16_t			digitalPortCount;
+	const char *	variant;
+
+	int16_t			enabled[SIM_MAX_SOURCES];
+	int16_t *		buffers[SIM_MAX_BUFFERS];			// Buffers registered with SetDataBuffer(s), max then min for each source
+	uint32_t		bufferLengths[SIM_MAX_SOURCES];
+
+	int16_t *		bulkBuffers[SIM_MAX_SOURCES][SIM_MAX_WAVEFORMS];	// Buffers registered with SetDataBufferBulk
+	uint32_t		bulkBufferLengths[SIM_MAX_SOURCES][SIM_MAX_WAVEFORMS];
+
+	// Streaming
+	volatile int16_t	streaming;
+	int16_t			autoStop;
+	int16_t			aggregate;							// Max and min of each group of downSampleRatio samples, otherwise the first sample
+	uint32_t		downSampleRatio;
+	uint64_t		maxSamples;							// Samples collected before autostop
+	uint64_t		rawSampleCount;						// Samples generated before downsampling
+	uint64_t		samplesDelivered;					// Samples passed to streaming callbacks
+	uint32_t		writeIndex;							// Next index written in the driver buffers
+	uint32_t		callbackCount;
+	uint64_t		nextTriggerSample;
+	uint64_t		startTime;							// Time in microseconds that streaming started
+
+	// Overview buffers used by the ps2000 and ps3000 streaming callbacks
+	int16_t *		overviewBuffers[SIM_MAX_BUFFERS];
+	uint32_t		overviewBufferSize;
+
+	SIM_PROBE_INTERACTIONS	probeInteractions;
+} SIM_UNIT;
+
+/////////////////////////////////
+//
+//	Function declarations
+//
+/////////////////////////////////
+
+extern SIM_INTERNAL SIM_CONFIG * simGetConfig(void);
+
+extern SIM_INTERNAL void simConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval);
+
+extern SIM_INTERNAL SIM_UNIT * simOpenUnit(int16_t channelCount, int16_t digitalPortCount, const char * defaultVariant);
+
+extern SIM_INTERNAL SIM_UNIT * simGetUnit(int16_t handle);
+
+extern SIM_INTERNAL SIM_STATUS simCloseUnit(int16_t handle);
+
+extern SIM_INTERNAL SIM_STATUS simGetUnitInfo(int16_t handle, int8_t * string, int16_t stringLength, int16_t * requiredSize, uint32_t info);
+
+extern SIM_INTERNAL SIM_STATUS simSetChannel(int16_t handle, int32_t source, int16_t enabled);
+
+extern SIM_INTERNAL SIM_STATUS simSetDataBuffers(int16_t handle, int32_t source, int16_t * bufferMax, int16_t * bufferMin, uint32_t bufferLength);
+
+extern SIM_INTERNAL SIM_STATUS simSetDataBufferBulk(int16_t handle, int32_t source, int16_t * buffer, uint32_t bufferLength, uint32_t waveform);
+
+extern SIM_INTERNAL SIM_STATUS simRunStreaming(int16_t handle, uint64_t maxSamples, int16_t autoStop, uint32_t downSampleRatio, int16_t aggregate,
+	uint32_t overviewBufferSize);
+
+extern SIM_INTERNAL SIM_STATUS simNextChunk(int16_t handle, SIM_CHUNK * chunk);
+
+extern SIM_INTERNAL SIM_STATUS simGetStreamingLatestValues(int16_t handle, SIM_STREAMING_READY lpReady, void * pParameter);
+
+extern SIM_INTERNAL int16_t simGetOverviewValues(int16_t handle, SIM_OVERVIEW_READY lpGetOverviewBuffersMaxMin);
+
+extern SIM_INTERNAL SIM_STATUS simRunBlock(int16_t handle, uint32_t noOfSamples, int32_t * timeIndisposedMs, SIM_BLOCK_READY lpReady, void * pParameter);
+
+extern SIM_INTERNAL SIM_STATUS simStop(int16_t handle);
+
+extern SIM_INTERNAL SIM_STATUS simCheckHandle(int16_t handle);
+
+extern SIM_INTERNAL SIM_STATUS simSetProbeInteractionCallback(int16_t handle, SIM_PROBE_INTERACTIONS callback);
+
+extern SIM_INTERNAL int16_t simSampleValue(int32_t source, uint64_t sampleIndex);
+
+#endif
@@ -0,0 +1,152 @@
+/****************************************************************************
+ *
+ * Filename: ps2000Sim.c
+ *
+ * Description:
+ *	Simulated PS2000 driver. Provides the ps2000 driver functions used by
+ *	the ps2000Wrap library, and the functions needed to open and stream
+ *	from a device, on top of the simulator core in picoSimulator.c.
+ *
+ *	The simulated device has 2 analogue channels and reports the variant
+ *	"2204A". Streaming data is passed to the overview buffer callback in the
+ *	same way as the ps2000 driver. Block mode is not simulated.
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include "picoSimulator.h"
+
+#define PS2000_SIM_CHANNELS	2
+
+/****************************************************************************
+* ps2000SimConfigure
+*
+* Changes the simulator settings. See tSimConfig in picoSimulator.h.
+*
+****************************************************************************/
+void ps2000SimConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval)
+{
+	simConfigure(sampleRate, chunkSize, overflowInterval, triggerInterval);
+}
+
+/****************************************************************************
+* ps2000_open_unit
+*
+* Opens a simulated device.
+*
+* Returns:
+*
+* The handle of the device, or 0 if SIM_MAX_UNITS devices are already open.
+*
+****************************************************************************/
+int16_t ps2000_open_unit(void)
+{
+	SIM_UNIT * unit = simOpenUnit(PS2000_SIM_CHANNELS, 0, "2204A");
+
+	return (unit != NULL) ? unit->handle : 0;
+}
+
+/****************************************************************************
+* ps2000_close_unit
+*
+* Closes a simulated device.
+*
+****************************************************************************/
+int16_t ps2000_close_unit(int16_t handle)
+{
+	return simCloseUnit(handle) == PICO_OK;
+}
+
+/****************************************************************************
+* ps2000_get_unit_info
+*
+* Returns information about the simulated device.
+*
+* Returns:
+*
+* The length of the string, or 0 if the handle or line is invalid.
+*
+****************************************************************************/
+int16_t ps2000_get_unit_info(int16_t handle, int8_t * string, int16_t string_length, int16_t line)
+{
+	int16_t requiredSize = 0;
+
+	if (simGetUnitInfo(handle, string, string_length, &requiredSize, (uint32_t) line) != PICO_OK)
+	{
+		return 0;
+	}
+
+	return (string != NULL) ? (int16_t) strlen((char *) string) : 0;
+}
+
+/****************************************************************************
+* ps2000_set_channel
+*
+* Enables or disables a channel. The coupling and range do not change the
+* simulated signal, which is in ADC counts.
+*
+****************************************************************************/
+int16_t ps2000_set_channel(int16_t handle, int16_t channel, int16_t enabled, int16_t dc, int16_t range)
+{
+	return simSetChannel(handle, channel, enabled) == PICO_OK;
+}
+
+/****************************************************************************
+* ps2000_set_trigger
+*
+* The simulator reports triggers at the interval set by
+* PICO_SIM_TRIGGER_INTERVAL, so the trigger settings are only checked for a
+* valid handle.
+*
+****************************************************************************/
+int16_t ps2000_set_trigger(int16_t handle, int16_t source, int16_t threshold, int16_t direction, int16_t delay, int16_t auto_trigger_ms)
+{
+	return simCheckHandle(handle) == PICO_OK;
+}
+
+/****************************************************************************
+* ps2000_run_streaming_ns
+*
+* Starts streaming. Each overview buffer callback receives the maximum and
+* minimum of each group of noOfSamplesPerAggregate samples.
+*
+****************************************************************************/
+int16_t ps2000_run_streaming_ns(int16_t handle, uint32_t sample_interval, int32_t time_units, uint32_t max_samples, int16_t auto_stop,
+	uint32_t noOfSamplesPerAggregate, uint32_t overview_buffer_size)
+{
+	uint32_t ratio = (noOfSamplesPerAggregate > 0) ? noOfSamplesPerAggregate : 1;
+
+	if (overview_buffer_size == 0)
+	{
+		return 0;
+	}
+
+	return simRunStreaming(handle, max_samples / ratio, auto_stop, ratio, 1, overview_buffer_size) == PICO_OK;
+}
+
+/****************************************************************************
+* ps2000_get_streaming_last_values
+*
+* Calls lpGetOverviewBuffersMaxMin with the next block of streaming data.
+*
+* Returns:
+*
+* 1 if the callback was called, otherwise 0.
+*
+****************************************************************************/
+int16_t ps2000_get_streaming_last_values(int16_t handle, SIM_OVERVIEW_READY lpGetOverviewBuffersMaxMin)
+{
+	return simGetOverviewValues(handle, lpGetOverviewBuffersMaxMin);
+}
+
+/****************************************************************************
+* ps2000_stop
+*
+* Stops streaming.
+*
+****************************************************************************/
+int16_t ps2000_stop(int16_t handle)
+{
+	return simStop(handle) == PICO_OK;
+}
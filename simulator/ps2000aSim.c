@@ -0,0 +1,284 @@
+/****************************************************************************
+ *
+ * Filename: ps2000aSim.c
+ *
+ * Description:
+ *	Simulated PS2000A driver. Provides the ps2000a driver functions used by
+ *	the ps2000aWrap library, and the functions needed to open and stream
+ *	from a device, on top of the simulator core in picoSimulator.c.
+ *
+ *	The simulated device has 2 analogue channels and 2 digital ports and reports
+ *	the variant "2206B MSO".
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include "picoSimulator.h"
+
+#define PS2000A_SIM_CHANNELS		2
+#define PS2000A_SIM_DIGITAL_PORTS	2
+
+/****************************************************************************
+* ps2000aSimConfigure
+*
+* Changes the simulator settings. See tSimConfig in picoSimulator.h.
+*
+****************************************************************************/
+void ps2000aSimConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval)
+{
+	simConfigure(sampleRate, chunkSize, overflowInterval, triggerInterval);
+}
+
+/****************************************************************************
+* ps2000aOpenUnit
+*
+* Opens a simulated device. The serial number is ignored.
+*
+****************************************************************************/
+uint32_t ps2000aOpenUnit(int16_t * handle, int8_t * serial)
+{
+	SIM_UNIT * unit = NULL;
+
+	if (handle == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	unit = simOpenUnit(PS2000A_SIM_CHANNELS, PS2000A_SIM_DIGITAL_PORTS, "2206B MSO");
+
+	if (unit == NULL)
+	{
+		*handle = 0;
+		return PICO_MAX_UNITS_OPENED;
+	}
+
+	*handle = unit->handle;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* ps2000aCloseUnit
+*
+* Closes a simulated device.
+*
+****************************************************************************/
+uint32_t ps2000aCloseUnit(int16_t handle)
+{
+	return simCloseUnit(handle);
+}
+
+/****************************************************************************
+* ps2000aStop
+*
+* Stops streaming.
+*
+****************************************************************************/
+uint32_t ps2000aStop(int16_t handle)
+{
+	return simStop(handle);
+}
+
+/****************************************************************************
+* ps2000aGetUnitInfo
+*
+* Returns information about the simulated device.
+*
+****************************************************************************/
+uint32_t ps2000aGetUnitInfo(int16_t handle, int8_t * string, int16_t stringLength, int16_t * requiredSize, uint32_t info)
+{
+	return simGetUnitInfo(handle, string, stringLength, requiredSize, info);
+}
+
+/****************************************************************************
+* ps2000aSetChannel
+*
+* Enables or disables a channel. The coupling, range and offset do not change
+* the simulated signal, which is in ADC counts.
+*
+****************************************************************************/
+uint32_t ps2000aSetChannel(int16_t handle, int32_t channel, int16_t enabled, int32_t type, int32_t range, float analogOffset)
+{
+	return simSetChannel(handle, channel, enabled);
+}
+
+/****************************************************************************
+* ps2000aSetDigitalPort
+*
+* Enables or disables a digital port.
+*
+****************************************************************************/
+uint32_t ps2000aSetDigitalPort(int16_t handle, int32_t port, int16_t enabled, int16_t logicLevel)
+{
+	return simSetChannel(handle, port, enabled);
+}
+
+/****************************************************************************
+* ps2000aMaximumValue
+*
+* Returns the maximum ADC count of the simulated device.
+*
+****************************************************************************/
+uint32_t ps2000aMaximumValue(int16_t handle, int16_t * value)
+{
+	if (value == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	*value = SIM_MAX_ADC_VALUE;
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps2000aSetDataBuffers
+*
+* Registers the max and min buffers for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps2000aSetDataBuffers(int16_t handle, int32_t channel, int16_t * bufferMax, int16_t * bufferMin, int32_t bufferLth, uint32_t segmentIndex, int32_t mode)
+{
+	return simSetDataBuffers(handle, channel, bufferMax, bufferMin, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps2000aSetDataBuffer
+*
+* Registers the buffer for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps2000aSetDataBuffer(int16_t handle, int32_t channel, int16_t * buffer, int32_t bufferLth, uint32_t segmentIndex, int32_t mode)
+{
+	return simSetDataBuffers(handle, channel, buffer, NULL, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps2000aSetDataBufferBulk
+*
+* Registers the buffer for one capture of a channel in rapid block mode.
+*
+****************************************************************************/
+uint32_t ps2000aSetDataBufferBulk(int16_t handle, int32_t channel, int16_t * buffer, int32_t bufferLth, uint32_t waveform, int32_t mode)
+{
+	return simSetDataBufferBulk(handle, channel, buffer, (uint32_t) bufferLth, waveform);
+}
+
+/****************************************************************************
+* ps2000aMemorySegments
+*
+* Reports the memory available to each segment. Segments are not simulated,
+* so every segment has the same size.
+*
+****************************************************************************/
+uint32_t ps2000aMemorySegments(int16_t handle, uint32_t nSegments, int32_t * nMaxSamples)
+{
+	if (nMaxSamples != NULL && nSegments > 0)
+	{
+		*nMaxSamples = (int32_t) (128 * 1024 * 1024 / nSegments);
+	}
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps2000aSetNoOfCaptures
+*
+* Sets the number of captures in rapid block mode. Each registered rapid
+* block buffer is filled by RunBlock, so the number is only checked.
+*
+****************************************************************************/
+uint32_t ps2000aSetNoOfCaptures(int16_t handle, uint32_t nCaptures)
+{
+	if (nCaptures > SIM_MAX_WAVEFORMS)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps2000aRunBlock
+*
+* Starts a block capture of noOfPreTriggerSamples + noOfPostTriggerSamples
+* samples. lpReady is called from another thread when the data is ready.
+*
+****************************************************************************/
+uint32_t ps2000aRunBlock(int16_t handle, int32_t noOfPreTriggerSamples, int32_t noOfPostTriggerSamples, uint32_t timebase, int16_t oversample,
+	int32_t * timeIndisposedMs, uint32_t segmentIndex, void * lpReady, void * pParameter)
+{
+	return simRunBlock(handle, (uint32_t) (noOfPreTriggerSamples + noOfPostTriggerSamples), timeIndisposedMs, (SIM_BLOCK_READY) lpReady, pParameter);
+}
+
+/****************************************************************************
+* ps2000aRunStreaming
+*
+* Starts streaming. The sample interval is accepted as requested.
+*
+****************************************************************************/
+uint32_t ps2000aRunStreaming(int16_t handle, uint32_t * sampleInterval, int32_t sampleIntervalTimeUnits, uint32_t maxPreTriggerSamples,
+	uint32_t maxPostTriggerSamples, int16_t autoStop, uint32_t downSampleRatio, int32_t downSampleRatioMode, uint32_t overviewBufferSize)
+{
+	uint32_t ratio = (downSampleRatio > 0) ? downSampleRatio : 1;
+
+	if (sampleInterval == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	return simRunStreaming(handle, ((uint64_t) maxPreTriggerSamples + maxPostTriggerSamples) / ratio, autoStop, ratio,
+		(downSampleRatioMode & 1) ? 1 : 0, 0);
+}
+
+/****************************************************************************
+* ps2000aGetStreamingLatestValues
+*
+* Calls lpReady with the next block of streaming data.
+*
+****************************************************************************/
+uint32_t ps2000aGetStreamingLatestValues(int16_t handle, SIM_STREAMING_READY lpReady, void * pParameter)
+{
+	return simGetStreamingLatestValues(handle, lpReady, pParameter);
+}
+
+/////////////////////////////////
+//
+//	Trigger functions
+//
+//	The simulator reports triggers at the interval set by
+//	PICO_SIM_TRIGGER_INTERVAL, so the trigger settings are only checked
+//	for a valid handle.
+//
+/////////////////////////////////
+
+uint32_t ps2000aSetSimpleTrigger(int16_t handle, int16_t enable, int32_t source, int16_t threshold, int32_t direction, uint32_t delay, int16_t autoTriggerMs)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps2000aSetTriggerChannelConditions(int16_t handle, void * conditions, int16_t nConditions)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps2000aSetTriggerChannelDirections(int16_t handle, int32_t channelA, int32_t channelB, int32_t channelC, int32_t channelD, int32_t ext, int32_t aux)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps2000aSetTriggerChannelProperties(int16_t handle, void * channelProperties, int16_t nChannelProperties, int16_t auxOutputEnable, int32_t autoTriggerMilliseconds)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps2000aSetTriggerDelay(int16_t handle, uint32_t delay)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps2000aSetPulseWidthQualifier(int16_t handle, void * conditions, int16_t nConditions, int32_t direction, uint32_t lower, uint32_t upper, int32_t type)
+{
+	return simCheckHandle(handle);
+}
@@ -0,0 +1,244 @@
+/****************************************************************************
+ *
+ * Filename: ps4000aSim.c
+ *
+ * Description:
+ *	Simulated PS4000A driver. Provides the ps4000a driver functions used by
+ *	the ps4000aWrap library, and the functions needed to open and stream
+ *	from a device, on top of the simulator core in picoSimulator.c.
+ *
+ *	The simulated device has 8 analogue channels and reports
+ *	the variant "4824".
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include "picoSimulator.h"
+
+#define PS4000A_SIM_CHANNELS		8
+#define PS4000A_SIM_DIGITAL_PORTS	0
+
+/****************************************************************************
+* ps4000aSimConfigure
+*
+* Changes the simulator settings. See tSimConfig in picoSimulator.h.
+*
+****************************************************************************/
+void ps4000aSimConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval)
+{
+	simConfigure(sampleRate, chunkSize, overflowInterval, triggerInterval);
+}
+
+/****************************************************************************
+* ps4000aOpenUnit
+*
+* Opens a simulated device. The serial number is ignored.
+*
+****************************************************************************/
+uint32_t ps4000aOpenUnit(int16_t * handle, int8_t * serial)
+{
+	SIM_UNIT * unit = NULL;
+
+	if (handle == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	unit = simOpenUnit(PS4000A_SIM_CHANNELS, PS4000A_SIM_DIGITAL_PORTS, "4824");
+
+	if (unit == NULL)
+	{
+		*handle = 0;
+		return PICO_MAX_UNITS_OPENED;
+	}
+
+	*handle = unit->handle;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* ps4000aCloseUnit
+*
+* Closes a simulated device.
+*
+****************************************************************************/
+uint32_t ps4000aCloseUnit(int16_t handle)
+{
+	return simCloseUnit(handle);
+}
+
+/****************************************************************************
+* ps4000aStop
+*
+* Stops streaming.
+*
+****************************************************************************/
+uint32_t ps4000aStop(int16_t handle)
+{
+	return simStop(handle);
+}
+
+/****************************************************************************
+* ps4000aGetUnitInfo
+*
+* Returns information about the simulated device.
+*
+****************************************************************************/
+uint32_t ps4000aGetUnitInfo(int16_t handle, int8_t * string, int16_t stringLength, int16_t * requiredSize, uint32_t info)
+{
+	return simGetUnitInfo(handle, string, stringLength, requiredSize, info);
+}
+
+/****************************************************************************
+* ps4000aSetChannel
+*
+* Enables or disables a channel. The coupling, range and offset do not change
+* the simulated signal, which is in ADC counts.
+*
+****************************************************************************/
+uint32_t ps4000aSetChannel(int16_t handle, int32_t channel, int16_t enabled, int32_t type, int32_t range, float analogOffset)
+{
+	return simSetChannel(handle, channel, enabled);
+}
+
+/****************************************************************************
+* ps4000aMaximumValue
+*
+* Returns the maximum ADC count of the simulated device.
+*
+****************************************************************************/
+uint32_t ps4000aMaximumValue(int16_t handle, int16_t * value)
+{
+	if (value == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	*value = SIM_MAX_ADC_VALUE;
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps4000aSetDataBuffers
+*
+* Registers the max and min buffers for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps4000aSetDataBuffers(int16_t handle, int32_t channel, int16_t * bufferMax, int16_t * bufferMin, int32_t bufferLth, uint32_t segmentIndex, int32_t mode)
+{
+	return simSetDataBuffers(handle, channel, bufferMax, bufferMin, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps4000aSetDataBuffer
+*
+* Registers the buffer for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps4000aSetDataBuffer(int16_t handle, int32_t channel, int16_t * buffer, int32_t bufferLth, uint32_t segmentIndex, int32_t mode)
+{
+	return simSetDataBuffers(handle, channel, buffer, NULL, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps4000aRunBlock
+*
+* Starts a block capture of noOfPreTriggerSamples + noOfPostTriggerSamples
+* samples. lpReady is called from another thread when the data is ready.
+*
+****************************************************************************/
+uint32_t ps4000aRunBlock(int16_t handle, int32_t noOfPreTriggerSamples, int32_t noOfPostTriggerSamples, uint32_t timebase,
+	int32_t * timeIndisposedMs, uint32_t segmentIndex, void * lpReady, void * pParameter)
+{
+	return simRunBlock(handle, (uint32_t) (noOfPreTriggerSamples + noOfPostTriggerSamples), timeIndisposedMs, (SIM_BLOCK_READY) lpReady, pParameter);
+}
+
+/****************************************************************************
+* ps4000aRunStreaming
+*
+* Starts streaming. The sample interval is accepted as requested.
+*
+****************************************************************************/
+uint32_t ps4000aRunStreaming(int16_t handle, uint32_t * sampleInterval, int32_t sampleIntervalTimeUnits, uint32_t maxPreTriggerSamples,
+	uint32_t maxPostTriggerSamples, int16_t autoStop, uint32_t downSampleRatio, int32_t downSampleRatioMode, uint32_t overviewBufferSize)
+{
+	uint32_t ratio = (downSampleRatio > 0) ? downSampleRatio : 1;
+
+	if (sampleInterval == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	return simRunStreaming(handle, ((uint64_t) maxPreTriggerSamples + maxPostTriggerSamples) / ratio, autoStop, ratio,
+		(downSampleRatioMode & 1) ? 1 : 0, 0);
+}
+
+/****************************************************************************
+* ps4000aGetStreamingLatestValues
+*
+* Calls lpReady with the next block of streaming data.
+*
+****************************************************************************/
+uint32_t ps4000aGetStreamingLatestValues(int16_t handle, SIM_STREAMING_READY lpReady, void * pParameter)
+{
+	return simGetStreamingLatestValues(handle, lpReady, pParameter);
+}
+
+/****************************************************************************
+* ps4000aSetProbeInteractionCallback
+*
+* Registers the probe interaction callback.
+*
+****************************************************************************/
+uint32_t ps4000aSetProbeInteractionCallback(int16_t handle, SIM_PROBE_INTERACTIONS callback)
+{
+	return simSetProbeInteractionCallback(handle, callback);
+}
+
+/////////////////////////////////
+//
+//	Trigger functions
+//
+//	The simulator reports triggers at the interval set by
+//	PICO_SIM_TRIGGER_INTERVAL, so the trigger settings are only checked
+//	for a valid handle.
+//
+/////////////////////////////////
+
+uint32_t ps4000aSetSimpleTrigger(int16_t handle, int16_t enable, int32_t source, int16_t threshold, int32_t direction, uint32_t delay, int16_t autoTriggerMs)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetTriggerChannelConditions(int16_t handle, void * conditions, int16_t nConditions, int32_t info)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetTriggerChannelDirections(int16_t handle, void * directions, int16_t nDirections)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetTriggerChannelProperties(int16_t handle, void * channelProperties, int16_t nChannelProperties, int16_t auxOutputEnable, int32_t autoTriggerMilliseconds)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetTriggerDelay(int16_t handle, uint32_t delay)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetPulseWidthQualifierProperties(int16_t handle, int32_t direction, uint32_t lower, uint32_t upper, int32_t type)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps4000aSetPulseWidthQualifierConditions(int16_t handle, void * conditions, int16_t nConditions, int32_t info)
+{
+	return simCheckHandle(handle);
+}
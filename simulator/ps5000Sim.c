@@ -0,0 +1,255 @@
+/****************************************************************************
+ *
+ * Filename: ps5000Sim.c
+ *
+ * Description:
+ *	Simulated PS5000 driver. Provides the ps5000 driver functions used by
+ *	the ps5000Wrap library, and the functions needed to open and stream
+ *	from a device, on top of the simulator core in picoSimulator.c.
+ *
+ *	The simulated device has 4 analogue channels and reports
+ *	the variant "5204".
+ *
+ * Copyright (C) 2018 Pico Technology Ltd. See LICENSE file for terms.
+ *
+ ****************************************************************************/
+
+#include "picoSimulator.h"
+
+#define PS5000_SIM_CHANNELS		4
+#define PS5000_SIM_DIGITAL_PORTS	0
+
+/****************************************************************************
+* ps5000SimConfigure
+*
+* Changes the simulator settings. See tSimConfig in picoSimulator.h.
+*
+****************************************************************************/
+void ps5000SimConfigure(uint64_t sampleRate, uint32_t chunkSize, uint32_t overflowInterval, uint64_t triggerInterval)
+{
+	simConfigure(sampleRate, chunkSize, overflowInterval, triggerInterval);
+}
+
+/****************************************************************************
+* ps5000OpenUnit
+*
+* Opens a simulated device. The serial number is ignored.
+*
+****************************************************************************/
+uint32_t ps5000OpenUnit(int16_t * handle)
+{
+	SIM_UNIT * unit = NULL;
+
+	if (handle == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	unit = simOpenUnit(PS5000_SIM_CHANNELS, PS5000_SIM_DIGITAL_PORTS, "5204");
+
+	if (unit == NULL)
+	{
+		*handle = 0;
+		return PICO_MAX_UNITS_OPENED;
+	}
+
+	*handle = unit->handle;
+
+	return PICO_OK;
+}
+
+/****************************************************************************
+* ps5000CloseUnit
+*
+* Closes a simulated device.
+*
+****************************************************************************/
+uint32_t ps5000CloseUnit(int16_t handle)
+{
+	return simCloseUnit(handle);
+}
+
+/****************************************************************************
+* ps5000Stop
+*
+* Stops streaming.
+*
+****************************************************************************/
+uint32_t ps5000Stop(int16_t handle)
+{
+	return simStop(handle);
+}
+
+/****************************************************************************
+* ps5000GetUnitInfo
+*
+* Returns information about the simulated device.
+*
+****************************************************************************/
+uint32_t ps5000GetUnitInfo(int16_t handle, int8_t * string, int16_t stringLength, int16_t * requiredSize, uint32_t info)
+{
+	return simGetUnitInfo(handle, string, stringLength, requiredSize, info);
+}
+
+/****************************************************************************
+* ps5000SetChannel
+*
+* Enables or disables a channel. The coupling, range and offset do not change
+* the simulated signal, which is in ADC counts.
+*
+****************************************************************************/
+uint32_t ps5000SetChannel(int16_t handle, int32_t channel, int16_t enabled, int16_t dc, int32_t range)
+{
+	return simSetChannel(handle, channel, enabled);
+}
+
+/****************************************************************************
+* ps5000SetDataBuffers
+*
+* Registers the max and min buffers for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps5000SetDataBuffers(int16_t handle, int32_t channel, int16_t * bufferMax, int16_t * bufferMin, int32_t bufferLth)
+{
+	return simSetDataBuffers(handle, channel, bufferMax, bufferMin, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps5000SetDataBuffer
+*
+* Registers the buffer for a channel or digital port.
+*
+****************************************************************************/
+uint32_t ps5000SetDataBuffer(int16_t handle, int32_t channel, int16_t * buffer, int32_t bufferLth)
+{
+	return simSetDataBuffers(handle, channel, buffer, NULL, (uint32_t) bufferLth);
+}
+
+/****************************************************************************
+* ps5000SetDataBufferBulk
+*
+* Registers the buffer for one capture of a channel in rapid block mode.
+*
+****************************************************************************/
+uint32_t ps5000SetDataBufferBulk(int16_t handle, int32_t channel, int16_t * buffer, int32_t bufferLth, uint16_t waveform)
+{
+	return simSetDataBufferBulk(handle, channel, buffer, (uint32_t) bufferLth, waveform);
+}
+
+/****************************************************************************
+* ps5000MemorySegments
+*
+* Reports the memory available to each segment. Segments are not simulated,
+* so every segment has the same size.
+*
+****************************************************************************/
+uint32_t ps5000MemorySegments(int16_t handle, uint16_t nSegments, int32_t * nMaxSamples)
+{
+	if (nMaxSamples != NULL && nSegments > 0)
+	{
+		*nMaxSamples = (int32_t) (128 * 1024 * 1024 / nSegments);
+	}
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps5000SetNoOfCaptures
+*
+* Sets the number of captures in rapid block mode. Each registered rapid
+* block buffer is filled by RunBlock, so the number is only checked.
+*
+****************************************************************************/
+uint32_t ps5000SetNoOfCaptures(int16_t handle, uint16_t nCaptures)
+{
+	if (nCaptures > SIM_MAX_WAVEFORMS)
+	{
+		return PICO_INVALID_PARAMETER;
+	}
+
+	return simCheckHandle(handle);
+}
+
+/****************************************************************************
+* ps5000RunBlock
+*
+* Starts a block capture of noOfPreTriggerSamples + noOfPostTriggerSamples
+* samples. lpReady is called from another thread when the data is ready.
+*
+****************************************************************************/
+uint32_t ps5000RunBlock(int16_t handle, int32_t noOfPreTriggerSamples, int32_t noOfPostTriggerSamples, uint32_t timebase, int16_t oversample,
+	int32_t * timeIndisposedMs, uint16_t segmentIndex, void * lpReady, void * pParameter)
+{
+	return simRunBlock(handle, (uint32_t) (noOfPreTriggerSamples + noOfPostTriggerSamples), timeIndisposedMs, (SIM_BLOCK_READY) lpReady, pParameter);
+}
+
+/****************************************************************************
+* ps5000RunStreaming
+*
+* Starts streaming. The sample interval is accepted as requested.
+*
+****************************************************************************/
+uint32_t ps5000RunStreaming(int16_t handle, uint32_t * sampleInterval, int32_t sampleIntervalTimeUnits, uint32_t maxPreTriggerSamples,
+	uint32_t maxPostTriggerSamples, int16_t autoStop, uint32_t downSampleRatio, uint32_t overviewBufferSize)
+{
+	uint32_t ratio = (downSampleRatio > 0) ? downSampleRatio : 1;
+
+	if (sampleInterval == NULL)
+	{
+		return PICO_NULL_PARAMETER;
+	}
+
+	return simRunStreaming(handle, ((uint64_t) maxPreTriggerSamples + maxPostTriggerSamples) / ratio, autoStop, ratio,
+		1, 0);
+}
+
+/****************************************************************************
+* ps5000GetStreamingLatestValues
+*
+* Calls lpReady with the next block of streaming data.
+*
+****************************************************************************/
+uint32_t ps5000GetStreamingLatestValues(int16_t handle, SIM_STREAMING_READY lpReady, void * pParameter)
+{
+	return simGetStreamingLatestValues(handle, lpReady, pParameter);
+}
+
+/////////////////////////////////
+//
+//	Trigger functions
+//
+//	The simulator reports triggers at the interval set by
+//	PICO_SIM_TRIGGER_INTERVAL, so the trigger settings are only checked
+//	for a valid handle.
+//
+/////////////////////////////////
+
+uint32_t ps5000SetSimpleTrigger(int16_t handle, int16_t enable, int32_t source, int16_t threshold, int32_t direction, uint32_t delay, int16_t autoTriggerMs)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps5000SetTriggerChannelConditions(int16_t handle, void * conditions, int16_t nConditions)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps5000SetTriggerChannelDirections(int16_t handle, int32_t channelA, int32_t channelB, int32_t channelC, int32_t channelD, int32_t ext, int32_t aux)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps5000SetTriggerChannelProperties(int16_t handle, void * channelProperties, int16_t nChannelProperties, int16_t auxOutputEnable, int32_t autoTriggerMilliseconds)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps5000SetTriggerDelay(int16_t handle, uint32_t delay)
+{
+	return simCheckHandle(handle);
+}
+
+uint32_t ps5000SetPulseWidthQualifier(int16_t handle, void * conditions, int16_t nConditions, int32_t direction, uint32_t lower, uint32_t upper, int32_t type)
+{
+	return simCheckHandle(handle);
+}